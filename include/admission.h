@@ -0,0 +1,91 @@
+/*
+ * admission.h
+ * --------------------------------------------
+ * Public header for recovery admission control.
+ *
+ * After a switch power cycle every camera fails at once. Without a limit,
+ * each recovery loop starts probing and spawning ffmpeg at the same
+ * moment, flooding the uplink so that probes time out and cameras back
+ * off again. An admission gate combines a concurrency cap with a token
+ * bucket, so work is let through at a steady rate however many cameras
+ * are waiting. Jittered exponential backoff spreads out the retries that
+ * fail.
+ *
+ * Gates are not thread-safe; videopipe only touches them from its
+ * supervisor loop.
+ *
+ * This header is paired with admission.c.
+ */
+
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdint.h>
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct admission_t
+ * @brief  Concurrency cap plus token bucket.
+ *
+ * Members:
+ *  - max_in_flight: Concurrent admissions allowed, 0 for no cap.
+ *  - in_flight:     Admissions not yet released.
+ *  - rate:          Tokens added per second.
+ *  - burst:         Bucket capacity.
+ *  - tokens:        Tokens currently available.
+ *  - last_ms:       Time of the last refill (monotonic milliseconds).
+ */
+typedef struct {
+    int max_in_flight;
+    int in_flight;
+    double rate;
+    double burst;
+    double tokens;
+    uint64_t last_ms;
+} admission_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Initialise a gate with a full bucket.
+ *
+ * @param a              Gate to initialise.
+ * @param max_in_flight  Concurrency cap (0 = uncapped).
+ * @param rate           Tokens per second (<= 0 disables the bucket).
+ * @param burst          Bucket capacity (at least 1).
+ */
+void admission_init(admission_t *a, int max_in_flight, double rate, double burst);
+
+/**
+ * @brief Take a token and a concurrency slot if both are available.
+ * @param now_ms  Current monotonic time in milliseconds.
+ * @return 1 if admitted, 0 if the caller must wait.
+ */
+int admission_try_acquire(admission_t *a, uint64_t now_ms);
+
+/**
+ * @brief Return the concurrency slot taken by admission_try_acquire().
+ */
+void admission_release(admission_t *a);
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Exponential backoff with jitter.
+ *
+ * The delay doubles per attempt from base_ms up to cap_ms. The returned
+ * value is drawn uniformly from the upper half of that window, so cameras
+ * that failed together do not retry together.
+ *
+ * @param attempt  Failed attempts so far (1 for the first retry).
+ * @param base_ms  Delay for the first retry.
+ * @param cap_ms   Largest delay.
+ * @param seed     Per-caller random state, updated in place (non-zero).
+ * @return Delay in milliseconds.
+ */
+int backoff_jitter_ms(int attempt, int base_ms, int cap_ms, uint32_t *seed);
+
+/**
+ * @brief Current CLOCK_MONOTONIC time in milliseconds.
+ */
+uint64_t admission_now_ms(void);
+
+#endif /* ADMISSION_H */
@@ -0,0 +1,63 @@
+/*
+ * async_log.h
+ * --------------------------------------------
+ * Public header for the asynchronous log backend.
+ *
+ * log_msg() used to fprintf and fflush every line to the log file on the
+ * calling thread, so the monitor loop, probe threads and the re-probe
+ * worker all waited on disk. With this backend, each thread appends to
+ * its own ring buffer. There is one producer per ring and one consumer,
+ * the writer thread, so appending takes no lock and makes no system
+ * call. If a ring is full, the message is dropped and counted; the
+ * caller never waits.
+ *
+ * The caller still expands its printf arguments, since %s arguments may
+ * not outlive the call. The writer thread formats timestamps and
+ * prefixes. Every ALOG_FLUSH_MS it merges the rings in timestamp order
+ * and writes the lines with writev(), pointing straight into the rings.
+ * A thread's ring is freed once the thread has exited and its ring has
+ * been written out.
+ *
+ * Logging must not be used between fork() and exec() or from signal
+ * handlers: a ring has exactly one producer.
+ *
+ * This header is paired with async_log.c.
+ */
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <stdarg.h>
+
+#define ALOG_RING_BYTES (64 * 1024)  /* Per-thread ring                      */
+#define ALOG_MSG_MAX    2048         /* Longest message, excluding prefix     */
+#define ALOG_FLUSH_MS   50           /* Writer wake-up interval               */
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Open the log file for appending and start the writer thread.
+ *
+ * If the file cannot be opened, lines go to stderr instead and -1 is
+ * returned. Before this call and after alog_close(), lines are written
+ * to stderr synchronously.
+ *
+ * @param path  Log file.
+ * @return 0 on success, -1 if logging fell back to stderr.
+ */
+int alog_open(const char *path);
+
+/**
+ * @brief Queue one line: "<date time> - <level> - <message>".
+ *
+ * @param level  Level label, e.g. "INFO" (up to 11 characters are kept).
+ * @param fmt    printf format of the message.
+ * @param ap     Arguments for fmt.
+ */
+void alog_vwrite(const char *level, const char *fmt, va_list ap);
+
+/**
+ * @brief Write everything queued so far and stop the writer thread.
+ */
+void alog_close(void);
+
+#endif /* ASYNC_LOG_H */
@@ -0,0 +1,102 @@
+/*
+ * cache_persist.h
+ * --------------------------------------------
+ * Public header for the coalescing discovery-cache writer.
+ *
+ * The supervisor used to save the whole cache every 60 seconds and after
+ * every recovery, so a recovery storm caused back-to-back rewrites on the
+ * supervisor thread. Instead, the supervisor now hands changed records to
+ * a writer thread. The writer waits for a coalescing window after the
+ * first change, so every record changed within that window is written in
+ * one batch. If nothing changes, nothing is written.
+ *
+ * How hard each batch is pushed to disk is a policy choice: a synchronous
+ * msync, an asynchronous one, or none (left to kernel writeback).
+ *
+ * This header is paired with cache_persist.c.
+ */
+
+#ifndef CACHE_PERSIST_H
+#define CACHE_PERSIST_H
+
+#include <stdint.h>
+
+#include "discovery_cache.h"
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @enum  cache_sync_t
+ * @brief Durability policy applied after each batch.
+ *
+ *  - CACHE_SYNC_ALWAYS: msync(MS_SYNC); the batch is on disk when the
+ *                       writer moves on.
+ *  - CACHE_SYNC_ASYNC:  msync(MS_ASYNC); writeback is started but not
+ *                       waited for.
+ *  - CACHE_SYNC_NONE:   No msync; the kernel writes back dirty pages on
+ *                       its own schedule.
+ */
+typedef enum {
+    CACHE_SYNC_ALWAYS,
+    CACHE_SYNC_ASYNC,
+    CACHE_SYNC_NONE
+} cache_sync_t;
+
+/**
+ * @struct cache_persist_batch_t
+ * @brief  Outcome of one batch, for the supervisor's log.
+ *
+ * Members:
+ *  - submitted: Records handed over during the window.
+ *  - written:   Records whose bytes actually changed.
+ *  - write_ms:  Time spent writing and syncing.
+ *  - error:     errno of a failed msync, 0 otherwise.
+ */
+typedef struct {
+    int submitted;
+    int written;
+    int write_ms;
+    int error;
+} cache_persist_batch_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Start the writer thread.
+ *
+ * @param cache      Open cache the writer owns until cache_persist_stop().
+ * @param window_ms  Coalescing window after the first submission.
+ * @param sync       Durability policy per batch.
+ * @return 0 on success, -1 if the thread could not be started.
+ */
+int cache_persist_start(dcache_t *cache, int window_ms, cache_sync_t sync);
+
+/**
+ * @brief Queue a record for its slot, replacing any record still pending
+ *        there. The record is copied.
+ * @return 0 if queued, -1 if the writer is not running or slot is invalid.
+ */
+int cache_persist_submit(uint32_t slot, const void *record);
+
+/**
+ * @brief Fetch the result of the last batch written since the last call.
+ * @return 1 if a batch was returned, 0 if none completed.
+ */
+int cache_persist_poll(cache_persist_batch_t *out);
+
+/**
+ * @brief Write anything still pending with a synchronous msync, then stop
+ *        the thread.
+ */
+void cache_persist_stop(void);
+
+/**
+ * @brief Parse a policy name ("always", "async", "none").
+ * @return 0 on success, -1 for an unknown name.
+ */
+int cache_sync_from_name(const char *name, cache_sync_t *out);
+
+/**
+ * @brief Name of a policy, for logs.
+ */
+const char *cache_sync_name(cache_sync_t sync);
+
+#endif /* CACHE_PERSIST_H */
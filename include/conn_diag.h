@@ -0,0 +1,76 @@
+/*
+ * conn_diag.h
+ * --------------------------------------------
+ * Public header for passive RTMP connection health.
+ *
+ * Reads the kernel's view of existing TCP connections through
+ * NETLINK_SOCK_DIAG (inet_diag with the tcp_info extension), so videopipe
+ * can tell whether each ffmpeg child's stream socket is still receiving
+ * data without opening new connections to the cameras. Sockets are tied
+ * to a child by matching their inode against /proc/<pid>/fd.
+ *
+ * This header is paired with conn_diag.c.
+ */
+
+#ifndef CONN_DIAG_H
+#define CONN_DIAG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct conn_diag_t
+ * @brief  Kernel state of one TCP connection.
+ *
+ * Members:
+ *  - inode:             Socket inode, as shown in /proc/<pid>/fd.
+ *  - remote_ip:         Peer address.
+ *  - remote_port:       Peer port.
+ *  - state:             TCP state (1 = established).
+ *  - rtt_us, rttvar_us: Smoothed RTT and its variance.
+ *  - retransmits:       Retransmission timeouts since the last ACK.
+ *  - total_retrans:     Segments retransmitted over the connection.
+ *  - bytes_received:    Payload bytes received (0 on kernels before 4.1).
+ *  - last_data_recv_ms: Time since data was last received.
+ */
+typedef struct {
+    unsigned long inode;
+    char remote_ip[INET_ADDRSTRLEN];
+    int remote_port;
+    int state;
+    uint32_t rtt_us;
+    uint32_t rttvar_us;
+    uint32_t retransmits;
+    uint32_t total_retrans;
+    uint64_t bytes_received;
+    uint32_t last_data_recv_ms;
+} conn_diag_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Dump IPv4 TCP connections to a given remote port.
+ *
+ * One netlink request returns every connection on the host; only those
+ * whose peer port is remote_port are kept.
+ *
+ * @param remote_port  Peer port to keep (1935 for RTMP).
+ * @param out          Output array.
+ * @param max          Capacity of out; extra connections are dropped.
+ * @return Number of connections written, or -1 if sock_diag is unavailable.
+ */
+int conn_diag_dump(int remote_port, conn_diag_t *out, size_t max);
+
+/**
+ * @brief Find the connection owned by a process.
+ *
+ * @param pid    Process whose open descriptors are searched.
+ * @param conns  Connections from conn_diag_dump().
+ * @param n      Number of connections.
+ * @return Index into conns, or -1 if the process holds none of them.
+ */
+int conn_diag_find_pid(pid_t pid, const conn_diag_t *conns, size_t n);
+
+#endif /* CONN_DIAG_H */
@@ -0,0 +1,99 @@
+/*
+ * discovery_cache.h
+ * --------------------------------------------
+ * Public header for the memory-mapped discovery cache store.
+ *
+ * The discovery cache used to be a JSON array that was parsed in full at
+ * startup and rewritten in full on every save. This store keeps one
+ * fixed-size record per camera in a versioned, checksummed binary file
+ * that is mmap'd once, so loading is a bounds check and a copy, and a
+ * save only touches the records whose contents changed.
+ *
+ * Every slot holds two copies of its record. An update writes the
+ * inactive copy and gives it the next generation number; readers take
+ * the valid copy with the higher generation. A torn write therefore
+ * fails its CRC and the previous copy is used, so each record is
+ * replaced atomically even across a crash.
+ *
+ * The store knows nothing about what a record contains; videopipe
+ * defines the record layout and bumps the version when it changes.
+ *
+ * This header is paired with discovery_cache.c.
+ */
+
+#ifndef DISCOVERY_CACHE_H
+#define DISCOVERY_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct dcache_t
+ * @brief  An open cache file.
+ *
+ * Members:
+ *  - fd:          File descriptor of the cache file.
+ *  - map:         Shared mapping of the whole file.
+ *  - map_len:     Length of the mapping.
+ *  - record_size: Payload bytes per record.
+ *  - capacity:    Number of record slots.
+ */
+typedef struct {
+    int fd;
+    unsigned char *map;
+    size_t map_len;
+    uint32_t record_size;
+    uint32_t capacity;
+} dcache_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Open or create a cache file and map it.
+ *
+ * An existing file is used only if its header checksum, version, record
+ * size and capacity all match; otherwise it is reset to empty slots.
+ *
+ * @param c            Cache handle to initialise.
+ * @param path         File to open.
+ * @param version      Record layout version chosen by the caller.
+ * @param record_size  Payload bytes per record.
+ * @param capacity     Number of slots.
+ * @return 0 if an existing cache was mapped, 1 if the file was created or
+ *         reset (the caller may import old data), -1 on error.
+ */
+int dcache_open(dcache_t *c, const char *path, uint32_t version, uint32_t record_size, uint32_t capacity);
+
+/**
+ * @brief Copy the current record of a slot.
+ * @return 0 on success, -1 if the slot is empty or both copies are corrupt.
+ */
+int dcache_get(const dcache_t *c, uint32_t slot, void *out);
+
+/**
+ * @brief Replace the record of a slot.
+ *
+ * Nothing is written if the payload equals the current record.
+ *
+ * @return 1 if the record was written, 0 if unchanged, -1 on a bad slot.
+ */
+int dcache_put(dcache_t *c, uint32_t slot, const void *record);
+
+/**
+ * @brief Mark a slot empty.
+ * @return 1 if the slot held a record, 0 otherwise.
+ */
+int dcache_clear(dcache_t *c, uint32_t slot);
+
+/**
+ * @brief Flush the mapping to disk (msync with MS_SYNC).
+ * @return 0 on success, -1 on error.
+ */
+int dcache_sync(dcache_t *c);
+
+/**
+ * @brief Unmap and close the cache file.
+ */
+void dcache_close(dcache_t *c);
+
+#endif /* DISCOVERY_CACHE_H */
@@ -0,0 +1,165 @@
+/*
+ * event_journal.h
+ * --------------------------------------------
+ * Public header for the binary event journal written by videopipe and
+ * main_controller.
+ *
+ * The text logs describe what happened in prose that has to be grepped
+ * afterwards. The journal records the same milestones as fixed 32-byte
+ * typed records: FFmpeg spawns and exits, probes, stream switches,
+ * stalls and reachability changes. roc_journal can filter and export
+ * them.
+ *
+ * Each writer has its own file: a 64-byte header, then a ring of
+ * records, mapped MAP_SHARED. Emitting an event takes a CLOCK_MONOTONIC
+ * read (vDSO), an atomic increment of the ring head and a 32-byte store
+ * into the mapping. There is no system call and no lock, and any thread
+ * may emit. The kernel writes the pages back, so the journal survives
+ * a crash of the writer. When the ring is full, the oldest records are
+ * overwritten.
+ *
+ * Timestamps are monotonic nanoseconds, so they cannot jump when the
+ * wall clock is stepped. The writer also emits an EJ_ANCHOR record
+ * pairing the monotonic clock with the wall clock when it opens the
+ * journal and at least once a minute after that. The reader converts
+ * each record to wall time with the nearest anchor before it.
+ *
+ * This header is paired with event_journal.c.
+ */
+
+#ifndef EVENT_JOURNAL_H
+#define EVENT_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JOURNAL_DIR          "/var/lib/roc/journal"
+#define EJ_DEFAULT_CAPACITY  (128 * 1024)  /* Records per file (4 MiB) */
+#define EJ_NONE              (-1)          /* No camera or stream      */
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @enum  ej_type_t
+ * @brief Event types and the meaning of their fields.
+ *
+ *  - EJ_ANCHOR: Wall clock at mono_ns in microseconds; value holds the
+ *               low and extra the high 32 bits.
+ *  - EJ_SPAWN:  Process pid started on stream (cam and stream EJ_NONE
+ *               for main_controller restarting videopipe).
+ *  - EJ_EXIT:   Process pid ended; value is the wait status, or -1 when
+ *               unknown (adopted processes). extra is its uptime in
+ *               seconds.
+ *  - EJ_PROBE:  stream was probed; value is 1 if it played, extra is
+ *               the score x 100.
+ *  - EJ_SWITCH: Recovery moved the camera to stream; value is the
+ *               previous stream.
+ *  - EJ_STALL:  A running stream was judged dead; value is an
+ *               ej_stall_t, extra the evidence (seconds since the spawn,
+ *               ms without data, error count or errno).
+ *  - EJ_REACH:  Reachability changed; value is 1 (up) or 0 (down).
+ *               extra is the connect time in ms or the errno; cam is
+ *               EJ_NONE for the LAN gateway.
+ *  - EJ_START / EJ_STOP: The writer started or stopped.
+ */
+typedef enum {
+    EJ_ANCHOR = 1,
+    EJ_SPAWN,
+    EJ_EXIT,
+    EJ_PROBE,
+    EJ_SWITCH,
+    EJ_STALL,
+    EJ_REACH,
+    EJ_START,
+    EJ_STOP,
+    EJ_TYPE_MAX
+} ej_type_t;
+
+typedef enum {
+    EJ_STALL_NO_CONNECTION = 1,  /* FFmpeg holds no RTMP connection      */
+    EJ_STALL_NO_DATA,            /* Connection idle past the stall limit */
+    EJ_STALL_ERROR_BURST,        /* Decode or I/O errors in its log      */
+    EJ_STALL_UNREACHABLE,        /* Active connect probe failed          */
+    EJ_STALL_LINK_DOWN           /* Route to the camera went down        */
+} ej_stall_t;
+
+typedef enum {
+    EJ_SRC_VIDEOPIPE = 1,
+    EJ_SRC_MAIN
+} ej_source_t;
+
+/**
+ * @struct ej_record_t
+ * @brief  One journal record (32 bytes, native byte order).
+ *
+ * seq is the record's position in the journal plus one, truncated to 32
+ * bits. It is stored last, so the reader can skip a slot that was
+ * still being written, has not been written yet, or belongs to an older
+ * pass of the ring.
+ */
+typedef struct {
+    uint64_t mono_ns;   /* CLOCK_MONOTONIC                  */
+    uint32_t seq;
+    uint16_t type;      /* ej_type_t                        */
+    uint8_t source;     /* ej_source_t                      */
+    int8_t stream;      /* Stream type index or EJ_NONE     */
+    int16_t cam;        /* Camera index or EJ_NONE          */
+    uint16_t reserved;
+    int32_t pid;
+    int32_t value;
+    int32_t extra;
+} ej_record_t;
+
+/**
+ * @struct ej_event_t
+ * @brief  A record read back, with its wall-clock time.
+ */
+typedef struct {
+    ej_record_t rec;
+    int64_t wall_us;    /* Microseconds since the epoch, or 0 if no anchor applies */
+} ej_event_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Open or create the journal at path and map it for writing.
+ *
+ * An existing journal with the same capacity is continued; anything
+ * else at path is replaced.
+ *
+ * @param path      Journal file; its directory is created if missing.
+ * @param source    ej_source_t stored in every record.
+ * @param capacity  Ring size in records.
+ * @return 0 on success, -1 on error (errno set); ej_emit() then does nothing.
+ */
+int ej_open(const char *path, int source, uint32_t capacity);
+
+/**
+ * @brief Append one event. Safe from any thread; a no-op when not open.
+ */
+void ej_emit(int type, int cam, int stream, int pid, int32_t value, int32_t extra);
+
+/**
+ * @brief Emit EJ_STOP and unmap the journal.
+ */
+void ej_close(void);
+
+/**
+ * @brief Read a journal in write order with wall-clock times resolved.
+ *
+ * @param path  Journal file.
+ * @param out   Receives a malloc'd array (caller frees).
+ * @param n     Receives the number of events.
+ * @return 0 on success, -1 if the file is missing or not a journal.
+ */
+int ej_read(const char *path, ej_event_t **out, size_t *n);
+
+/**
+ * @brief Lower-case name of an event type, e.g. "spawn".
+ */
+const char *ej_type_name(int type);
+
+/**
+ * @brief Lower-case name of a stall reason, e.g. "no_data".
+ */
+const char *ej_stall_name(int reason);
+
+#endif /* EVENT_JOURNAL_H */
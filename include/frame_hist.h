@@ -0,0 +1,87 @@
+/*
+ * frame_hist.h
+ * --------------------------------------------
+ * Public header for the frame-interval histograms of videopipe.
+ *
+ * The fps FFmpeg reports is an average, so it hides uneven delivery: a
+ * feed that stalls for half a second and then catches up still shows
+ * 15 fps. This module opens every watched /dev/videoN as a second
+ * reader next to the viewers, dequeues each frame FFmpeg writes and
+ * records the time since the previous one. Buffers are only queued and
+ * dequeued, never mapped, so no frame data is copied.
+ *
+ * Intervals go into a log-linear histogram in the style of HdrHistogram:
+ * 32 linear sub-buckets per power of two, so every value is kept to
+ * within about 3% from 1 us to over two minutes, in a fixed 6 KiB per
+ * camera. Recording is one index computation and one atomic increment.
+ * The percentiles are worked out when read, on the metrics thread.
+ *
+ * A gap is an interval over twice the nominal one (1/fps of the FFmpeg
+ * arguments). Frames the reader itself misses (it was descheduled
+ * longer than the driver's queue) are counted apart and not recorded as
+ * gaps.
+ *
+ * This header is paired with frame_hist.c.
+ */
+
+#ifndef FRAME_HIST_H
+#define FRAME_HIST_H
+
+#include <stdint.h>
+
+#define FHIST_MAX_CAMERAS 64     /* Same range as log_tail.h */
+
+/**
+ * @struct fhist_summary_t
+ * @brief  Frame intervals of one camera since its FFmpeg was started.
+ *         Interval fields are in microseconds and 0 before two frames
+ *         have been seen.
+ */
+typedef struct {
+    uint64_t intervals;     /* Intervals recorded */
+    uint64_t sum_us;
+    uint64_t p50_us;
+    uint64_t p99_us;
+    uint64_t max_us;
+    uint64_t nominal_us;    /* 1/fps; 0 when the camera is not watched */
+    uint64_t gaps;          /* Intervals over twice nominal_us */
+    uint64_t skipped;       /* Frames the reader missed */
+    int streaming;          /* The device is open and delivering */
+} fhist_summary_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Start the reader thread.
+ *
+ * @return 0 on success, -1 on error (errno set).
+ */
+int fhist_start(void);
+
+/**
+ * @brief Close every device and stop the thread.
+ */
+void fhist_stop(void);
+
+/**
+ * @brief Watch cam's device for an FFmpeg just started with the given fps.
+ *
+ * Clears the camera's histogram. The device is opened once FFmpeg has set
+ * its format, retried every second until then.
+ *
+ * @param device  e.g. "/dev/video10".
+ */
+void fhist_watch(int cam, const char *device, double fps);
+
+/**
+ * @brief Stop watching cam's device, e.g. when its FFmpeg has exited. The
+ *        histogram is kept until the next fhist_watch().
+ */
+void fhist_unwatch(int cam);
+
+/**
+ * @brief Percentiles and counts of one camera; zeroed for an unknown
+ *        camera. Lock-free.
+ */
+void fhist_summary(int cam, fhist_summary_t *out);
+
+#endif /* FRAME_HIST_H */
@@ -0,0 +1,83 @@
+/*
+ * handoff.h
+ * --------------------------------------------
+ * Public header for passing state and file descriptors between two
+ * videopipe processes.
+ *
+ * To upgrade videopipe, the new binary is started with --takeover. It
+ * connects to the running supervisor's Unix socket. The old supervisor
+ * replies with one message that carries its per-camera state as data and
+ * its descriptors as SCM_RIGHTS ancillary data: a pidfd for every running
+ * ffmpeg and its rtnetlink socket. Then it exits without stopping the
+ * ffmpeg processes. The new supervisor continues from exactly that state.
+ * Link events queued on the socket meanwhile are not lost.
+ *
+ * The socket is SOCK_SEQPACKET, so each message arrives whole or not at
+ * all, together with its descriptors.
+ *
+ * This header is paired with handoff.c.
+ */
+
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define HANDOFF_MAX_FDS 32
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Listen for a successor on a Unix socket at path, replacing a
+ *        stale socket file left there.
+ * @return Non-blocking, close-on-exec listening socket, or -1 (errno set).
+ */
+int handoff_listen(const char *path);
+
+/**
+ * @brief Accept a pending successor connection.
+ * @return Close-on-exec socket, or -1 with errno EAGAIN if none is pending.
+ */
+int handoff_accept(int lfd);
+
+/**
+ * @brief Connect to a running supervisor's socket.
+ * @return Connected socket, or -1 (errno set).
+ */
+int handoff_connect(const char *path);
+
+/**
+ * @brief Send one message with optional descriptors.
+ *
+ * @param sock  Connected socket.
+ * @param data  Payload.
+ * @param len   Payload length.
+ * @param fds   Descriptors to pass; they stay open in the sender.
+ * @param nfds  Number of descriptors (at most HANDOFF_MAX_FDS).
+ * @return 0 on success, -1 on error (errno set).
+ */
+int handoff_send(int sock, const void *data, size_t len, const int *fds, size_t nfds);
+
+/**
+ * @brief Receive one message and any descriptors sent with it.
+ *
+ * Received descriptors are close-on-exec. If the message is larger than
+ * max, it is discarded and the call fails with EMSGSIZE.
+ *
+ * @param sock        Connected socket.
+ * @param data        Payload buffer.
+ * @param max         Size of data.
+ * @param fds         Receives up to HANDOFF_MAX_FDS descriptors.
+ * @param nfds        Receives the number of descriptors.
+ * @param timeout_ms  How long to wait for the message.
+ * @return Payload length, or -1 on error or timeout (errno set).
+ */
+ssize_t handoff_recv(int sock, void *data, size_t max, int *fds, size_t *nfds, int timeout_ms);
+
+/**
+ * @brief Credentials of the peer on a connected Unix socket.
+ * @return 0 on success, -1 (errno set).
+ */
+int handoff_peer(int sock, pid_t *pid, uid_t *uid);
+
+#endif /* HANDOFF_H */
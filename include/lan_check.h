@@ -24,12 +24,14 @@
  *  - ifname:     Interface name with default route (e.g., "eth0").
  *  - gateway:    Default gateway IP address (dotted-quad string).
  *  - local_addr: IPv4 address assigned to that interface.
+ *  - netmask:    Netmask of that address (dotted-quad string).
  *  - reachable:  Flag (1 = gateway reachable via TCP, 0 = not reachable).
  */
 typedef struct {
     char ifname[IF_NAMESIZE];
     char gateway[INET_ADDRSTRLEN];
     char local_addr[INET_ADDRSTRLEN];
+    char netmask[INET_ADDRSTRLEN];
     int reachable;
 } lan_info_t;
 
@@ -0,0 +1,86 @@
+/*
+ * lan_scan.h
+ * --------------------------------------------
+ * Public header for LAN camera discovery.
+ *
+ * Sweeps the subnet of the default-route interface (as reported by
+ * check_LAN) for hosts accepting TCP connections on the RTMP port, using
+ * thousands of concurrent non-blocking connects driven by a single epoll
+ * loop. Open ports are then confirmed with a native RTMP stream probe,
+ * so only devices that actually speak RTMP end up in a draft camera
+ * configuration.
+ *
+ * This header is paired with lan_scan.c.
+ */
+
+#ifndef LAN_SCAN_H
+#define LAN_SCAN_H
+
+#include <stddef.h>
+#include <netinet/in.h>
+
+#include "lan_check.h"
+
+#define LAN_SCAN_MAX_PREFIX_HOSTS 65534   /* Largest subnet swept (/16) */
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct lan_scan_host_t
+ * @brief  One host found listening on the scanned port.
+ *
+ * Members:
+ *  - ip:            Dotted-quad address.
+ *  - connect_ms:    Time the TCP connect took during the sweep.
+ *  - rtmp:          1 if the host completed an RTMP handshake.
+ *  - stream_ok:     1 if the main stream played with the given credentials.
+ *  - width, height: Main stream size, when stream_ok is set.
+ *  - fps:           Main stream frame rate, when stream_ok is set.
+ */
+typedef struct {
+    char ip[INET_ADDRSTRLEN];
+    int connect_ms;
+    int rtmp;
+    int stream_ok;
+    int width;
+    int height;
+    double fps;
+} lan_scan_host_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Sweep the LAN subnet for hosts with an open TCP port.
+ *
+ * Every address in the local subnet (except the network, broadcast and
+ * local addresses) gets a non-blocking connect. Up to several thousand
+ * connects are kept in flight at once; RLIMIT_NOFILE is raised towards
+ * its hard limit to allow that. Each connect is given timeout_ms.
+ *
+ * @param lan          Interface details from check_LAN().
+ * @param port         TCP port to sweep (normally 1935).
+ * @param timeout_ms   Per-host connect timeout.
+ * @param hosts        Output array, sorted by address.
+ * @param max_hosts    Capacity of hosts.
+ * @param found        Receives the number of hosts written.
+ * @return Number of addresses swept, or -1 if the subnet is unusable.
+ */
+int lan_scan_subnet(const lan_info_t *lan, int port, int timeout_ms,
+                    lan_scan_host_t *hosts, size_t max_hosts, size_t *found);
+
+/**
+ * @brief Confirm swept hosts with a native RTMP stream probe.
+ *
+ * Probes the main stream of every host in parallel. A host that completes
+ * the RTMP handshake is marked rtmp even if the credentials are refused.
+ *
+ * @param hosts       Hosts returned by lan_scan_subnet().
+ * @param count       Number of hosts.
+ * @param port        RTMP port.
+ * @param user        Camera user name used for the probe.
+ * @param password    Camera password used for the probe.
+ * @param timeout_ms  Per-host probe deadline.
+ * @return Number of hosts confirmed as RTMP servers.
+ */
+size_t lan_scan_confirm(lan_scan_host_t *hosts, size_t count, int port,
+                        const char *user, const char *password, int timeout_ms);
+
+#endif /* LAN_SCAN_H */
@@ -0,0 +1,137 @@
+/*
+ * log_capture.h
+ * --------------------------------------------
+ * Public header for the bounded capture of FFmpeg's output in videopipe.
+ *
+ * FFmpeg used to write its stdout and stderr straight into
+ * camera<N>.log with O_APPEND. Nothing limited the size, so a camera
+ * that logged an error per frame could fill the disk. This module gives
+ * each child a pipe instead. One thread reads all the pipes into a ring
+ * buffer per camera, and the rings are flushed to camera<N>.log at no
+ * more than a fixed rate per camera. When the ring fills faster than it
+ * is flushed, the oldest unwritten output is dropped and the log says
+ * how much was lost. A log that reaches its size limit is rotated to
+ * camera<N>.log.1, .2, ... So the disk space and the write rate stay
+ * bounded however much FFmpeg prints.
+ *
+ * When an FFmpeg exits while it is supervised, the last part of its
+ * output goes to camera<N>.exit.log, even output that was dropped from
+ * the rate-limited log.
+ *
+ * Both ends of each pipe are non-blocking. A full pipe costs FFmpeg a
+ * lost log line; it never stalls the stream. The read end can be
+ * passed to a successor videopipe (--takeover). A child left running
+ * without a reader (SIGHUP restart) loses its output until it is
+ * respawned.
+ *
+ * This header is paired with log_capture.c.
+ */
+
+#ifndef LOG_CAPTURE_H
+#define LOG_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define LOGCAP_MAX_CAMERAS 64    /* Same range as log_tail.h */
+
+/**
+ * @struct logcap_cfg_t
+ * @brief  Limits applied to every camera.
+ *
+ * Members:
+ *  - ring_bytes:  Output held in memory per camera (at least 4 KiB).
+ *  - flush_rate:  Bytes per second written to camera<N>.log.
+ *  - file_max:    camera<N>.log is rotated when a write would take it
+ *                 past this size.
+ *  - files:       Rotated logs kept; 0 truncates the log instead.
+ *  - exit_dump:   Bytes written to camera<N>.exit.log when FFmpeg exits;
+ *                 0 writes none.
+ */
+typedef struct {
+    size_t ring_bytes;
+    size_t flush_rate;
+    size_t file_max;
+    int files;
+    size_t exit_dump;
+} logcap_cfg_t;
+
+/**
+ * @struct logcap_counts_t
+ * @brief  Totals for one camera since logcap_start().
+ */
+typedef struct {
+    uint64_t captured;      /* Bytes read from FFmpeg */
+    uint64_t dropped;       /* Bytes lost because the ring overflowed */
+    uint64_t rotations;
+} logcap_counts_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Start the capture thread.
+ *
+ * @param dir  Directory of the camera logs.
+ * @param cfg  Limits; copied.
+ * @return 0 on success, -1 on error (errno set).
+ */
+int logcap_start(const char *dir, const logcap_cfg_t *cfg);
+
+/**
+ * @brief Write out what the rings hold, close every pipe and log and stop
+ *        the thread. Children still running lose their output.
+ */
+void logcap_stop(void);
+
+/**
+ * @brief Create the pipe for a child of camera cam about to be spawned.
+ *
+ * A pipe the camera still had is read to its end and closed first.
+ *
+ * @return The write end, for the child's stdout and stderr. The caller
+ *         closes it after fork(). -1 on error (errno set).
+ */
+int logcap_pipe(int cam);
+
+/**
+ * @brief Capture from a read end handed over by a previous videopipe.
+ *        The descriptor is owned by this module from then on.
+ *
+ * @return 0 on success, -1 on error (errno set; fd is closed).
+ */
+int logcap_attach(int cam, int fd);
+
+/**
+ * @brief The read end of cam's pipe, to pass to a successor; -1 if none.
+ *        It stays owned by this module.
+ */
+int logcap_fd(int cam);
+
+/**
+ * @brief Note that cam's FFmpeg exited under supervision.
+ *
+ * Once the pipe has been read to its end, the output tail is written to
+ * camera<N>.exit.log.
+ *
+ * @param pid     The process that exited.
+ * @param status  Its wait status, or -1 if unknown.
+ */
+void logcap_exited(int cam, pid_t pid, int status);
+
+/**
+ * @brief Stop reading the pipes and write out what the rings hold, before
+ *        the read ends are handed to a successor.
+ */
+void logcap_suspend(void);
+
+/**
+ * @brief Read the pipes again after a handover failed.
+ */
+void logcap_resume(void);
+
+/**
+ * @brief Totals of one camera; zeroed for an unknown camera. Lock-free.
+ */
+void logcap_counts(int cam, logcap_counts_t *out);
+
+#endif /* LOG_CAPTURE_H */
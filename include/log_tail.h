@@ -0,0 +1,92 @@
+/*
+ * log_tail.h
+ * --------------------------------------------
+ * Public header for videopipe's in-process FFmpeg log tailer and error
+ * classifier.
+ *
+ * videopipe used to start a detached "tail -n+1 -F | grep" shell pipeline
+ * on the camera logs. Nothing supervised it, it re-read every log from
+ * the start, and each restart of videopipe added another copy. This
+ * module replaces it with one thread that watches the log directory with
+ * inotify. For each camera<N>.log it reads only the bytes appended since
+ * its last read, using that file's saved offset. A truncated or replaced
+ * file is read again from the start.
+ *
+ * Each complete line is classified with a precompiled multi-pattern
+ * matcher (multi_match.h) into per-camera error counters. videopipe reads
+ * these counters in its health checks and metrics. Matching lines are
+ * also appended to the error log, prefixed with the camera. FFmpeg's
+ * "frame=" progress lines give the frame rate it delivers.
+ *
+ * Offsets are saved on stop and picked up again on start, as long as the
+ * file is still the same inode and has not shrunk. Otherwise a file that
+ * already exists at start is read from its end, so old lines are not
+ * counted twice.
+ *
+ * This header is paired with log_tail.c.
+ */
+
+#ifndef LOG_TAIL_H
+#define LOG_TAIL_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define LOGT_MAX_CAMERAS 64    /* Highest camera<N>.log index tracked, exclusive */
+#define LOGT_LINE_MAX    1024  /* Longer lines are classified by their first part */
+#define LOGT_PROGRESS_STALE 5  /* Seconds without progress after which fps reads 0 */
+
+/* Error classes, most specific first; a line counts towards one class */
+typedef enum {
+    LOGT_CONN_REFUSED,  /* "Connection refused"                            */
+    LOGT_TIMEOUT,       /* "timed out", "timeout"                          */
+    LOGT_IO,            /* I/O error, broken pipe, connection reset        */
+    LOGT_EOF,           /* "End of file": the camera closed the stream     */
+    LOGT_DECODE,        /* Decoder complaints: corrupt or concealed frames */
+    LOGT_OTHER,         /* Any other "error" or "failed"                   */
+    LOGT_CLASS_COUNT
+} logt_class_t;
+
+/**
+ * @struct logt_counts_t
+ * @brief  Error lines seen in one camera's log since log_tail_start().
+ */
+typedef struct {
+    uint64_t count[LOGT_CLASS_COUNT];
+    uint64_t lines;         /* All lines read, matching or not */
+    time_t last_error;      /* Time the last matching line was read, or 0 */
+    uint64_t frames;        /* Frame count of the last progress line */
+    double fps;             /* Frames per second delivered recently; 0 once progress stops */
+    time_t last_progress;   /* Time the last progress line was read, or 0 */
+} logt_counts_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Start tailing dir/camera<N>.log on a background thread.
+ *
+ * @param dir           Directory holding the camera logs.
+ * @param error_log     File that matching lines are appended to, or NULL.
+ * @param offsets_path  File that offsets are saved to and resumed from, or NULL.
+ * @return 0 on success, -1 on error (errno set).
+ */
+int log_tail_start(const char *dir, const char *error_log, const char *offsets_path);
+
+/**
+ * @brief Read what is left in the logs, save the offsets and stop the thread.
+ */
+void log_tail_stop(void);
+
+/**
+ * @brief Snapshot of one camera's counters.
+ *
+ * @param cam  Camera index (the N in camera<N>.log).
+ * @param out  Receives the counters; zeroed for an unknown camera.
+ */
+void log_tail_counts(int cam, logt_counts_t *out);
+
+/**
+ * @brief Short name of an error class, e.g. "conn_refused".
+ */
+const char *log_tail_class_name(int cls);
+
+#endif /* LOG_TAIL_H */
@@ -0,0 +1,117 @@
+/*
+ * metrics.h
+ * --------------------------------------------
+ * Public header for the Prometheus metrics endpoint of videopipe and
+ * main_controller.
+ *
+ * Each program serves GET /metrics in the Prometheus text format on a
+ * localhost port, from one background thread running an epoll loop over
+ * non-blocking sockets. A scrape calls the program's render function on
+ * that thread. The render function reads only atomics that the other
+ * threads update, so a scrape never waits for the supervisor and the
+ * supervisor never waits for a scrape.
+ *
+ * The helpers below format families and samples into a growable buffer.
+ * metrics_hist_t is a fixed-bucket histogram that any thread can observe
+ * into without a lock.
+ *
+ * This header is paired with metrics.c.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define METRICS_ADDR            "127.0.0.1"
+#define METRICS_PORT_VIDEOPIPE  9470
+#define METRICS_PORT_MAIN       9471
+#define METRICS_HIST_BUCKETS    16    /* Most upper bounds per histogram */
+
+/**
+ * @struct metrics_hist_t
+ * @brief  Histogram over integer observations (e.g. milliseconds).
+ *
+ * bound[] holds the ascending upper bounds and is fixed once observations
+ * start; metrics_hist_init() sets it. Buckets are not cumulative here;
+ * metrics_hist() adds them up when writing.
+ */
+typedef struct {
+    size_t nbounds;
+    uint64_t bound[METRICS_HIST_BUCKETS];
+    _Atomic uint64_t bucket[METRICS_HIST_BUCKETS + 1];  /* Last one is +Inf */
+    _Atomic uint64_t sum;
+} metrics_hist_t;
+
+/**
+ * @struct metrics_buf_t
+ * @brief  Growable text buffer a scrape is rendered into.
+ */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed;     /* An allocation failed; the response is a 500 */
+} metrics_buf_t;
+
+/**
+ * @brief Writes the exposition text for one scrape. Runs on the metrics thread.
+ */
+typedef void (*metrics_render_fn)(metrics_buf_t *out, void *arg);
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Start serving /metrics on addr:port.
+ *
+ * @param addr    IPv4 address to listen on, normally METRICS_ADDR.
+ * @param port    TCP port.
+ * @param render  Called for each scrape.
+ * @param arg     Passed to render.
+ * @return 0 on success, -1 on error (errno set).
+ */
+int metrics_start(const char *addr, int port, metrics_render_fn render, void *arg);
+
+/**
+ * @brief Close all connections and stop the metrics thread.
+ */
+void metrics_stop(void);
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Set the bucket bounds of a histogram and clear it.
+ *
+ * @param h       Histogram; not yet observed into by other threads.
+ * @param bounds  Ascending upper bounds; at most METRICS_HIST_BUCKETS are used.
+ * @param n       Number of bounds.
+ */
+void metrics_hist_init(metrics_hist_t *h, const uint64_t *bounds, size_t n);
+
+/**
+ * @brief Record one observation. Lock-free; safe from any thread.
+ */
+void metrics_hist_observe(metrics_hist_t *h, uint64_t value);
+
+/**
+ * @brief Append printf-style text to the buffer.
+ */
+void metrics_printf(metrics_buf_t *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Append the # HELP and # TYPE lines of a metric family.
+ *
+ * @param type  "counter", "gauge" or "histogram".
+ */
+void metrics_family(metrics_buf_t *out, const char *name, const char *type, const char *help);
+
+/**
+ * @brief Append the _bucket, _sum and _count samples of a histogram.
+ *
+ * @param labels  Label pairs without braces, e.g. "camera=\"0\"", or "".
+ * @param scale   Observations are divided by this on output, e.g. 1000 to
+ *                publish milliseconds as seconds.
+ */
+void metrics_hist(metrics_buf_t *out, const char *name, const char *labels, const metrics_hist_t *h, double scale);
+
+#endif /* METRICS_H */
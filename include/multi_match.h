@@ -0,0 +1,55 @@
+/*
+ * multi_match.h
+ * --------------------------------------------
+ * Public header for a precompiled multi-pattern substring matcher.
+ *
+ * The patterns are compiled once into an Aho-Corasick automaton. Every
+ * failure link is resolved in advance, so the automaton is a plain DFA.
+ * A scan reads each byte of the text once, whatever the number of
+ * patterns. The input bytes are folded into the few character classes
+ * that occur in the patterns, which keeps the transition table small
+ * enough to stay in cache.
+ *
+ * Matching ignores ASCII case. A scan returns a bitmask of the patterns
+ * found anywhere in the text, so the caller can classify a line in one
+ * pass.
+ *
+ * This header is paired with multi_match.c.
+ */
+
+#ifndef MULTI_MATCH_H
+#define MULTI_MATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MMATCH_MAX_PATTERNS 64
+
+typedef struct mmatch mmatch_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Compile patterns into a matcher.
+ *
+ * @param patterns  Non-empty patterns; pattern k sets bit k in scan results.
+ * @param count     Number of patterns (at most MMATCH_MAX_PATTERNS).
+ * @return Matcher, or NULL on invalid input or allocation failure.
+ */
+mmatch_t *mmatch_compile(const char *const *patterns, size_t count);
+
+/**
+ * @brief Find which patterns occur in text.
+ *
+ * @param m     Compiled matcher.
+ * @param text  Text to scan; need not be NUL-terminated.
+ * @param len   Length of text.
+ * @return Bitmask of the patterns found (bit k for pattern k).
+ */
+uint64_t mmatch_scan(const mmatch_t *m, const char *text, size_t len);
+
+/**
+ * @brief Free a matcher (NULL is ignored).
+ */
+void mmatch_free(mmatch_t *m);
+
+#endif /* MULTI_MATCH_H */
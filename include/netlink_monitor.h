@@ -0,0 +1,92 @@
+/*
+ * netlink_monitor.h
+ * --------------------------------------------
+ * Public header for rtnetlink link and neighbour event monitoring.
+ *
+ * A pulled cable used to show up only when ffmpeg gave up or the next
+ * health check failed. Subscribing to RTM_NEWLINK and RTM_NEWNEIGH lets
+ * videopipe learn within milliseconds that the camera interface lost
+ * carrier or that a camera stopped answering ARP, and likewise when
+ * either comes back.
+ *
+ * The monitor socket is non-blocking; videopipe polls it as part of its
+ * supervisor loop's sleep, so an event wakes the loop immediately.
+ *
+ * This header is paired with netlink_monitor.c.
+ */
+
+#ifndef NETLINK_MONITOR_H
+#define NETLINK_MONITOR_H
+
+#include <stddef.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @enum  nlmon_event_type_t
+ * @brief Kinds of events reported to videopipe.
+ *
+ *  - NLMON_LINK_DOWN:   Interface lost carrier or was set down.
+ *  - NLMON_LINK_UP:     Interface is up and running again.
+ *  - NLMON_NEIGH_DOWN:  Neighbour entry went FAILED (no ARP reply).
+ *  - NLMON_NEIGH_UP:    Neighbour entry became REACHABLE.
+ */
+typedef enum {
+    NLMON_LINK_DOWN,
+    NLMON_LINK_UP,
+    NLMON_NEIGH_DOWN,
+    NLMON_NEIGH_UP
+} nlmon_event_type_t;
+
+/**
+ * @struct nlmon_event_t
+ * @brief  One decoded rtnetlink event.
+ *
+ * Members:
+ *  - type:    Event kind.
+ *  - ifindex: Interface the event refers to.
+ *  - ifname:  Interface name (link events only).
+ *  - ip:      Neighbour address (neighbour events only).
+ */
+typedef struct {
+    nlmon_event_type_t type;
+    int ifindex;
+    char ifname[IF_NAMESIZE];
+    char ip[INET_ADDRSTRLEN];
+} nlmon_event_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Open a non-blocking rtnetlink socket subscribed to link and
+ *        IPv4 neighbour changes.
+ * @return Socket descriptor, or -1 on failure.
+ */
+int nlmon_open(void);
+
+/**
+ * @brief Drain pending messages and decode them into events.
+ *
+ * Link messages only produce an event when the interface's running
+ * state differs from the last one seen, so attribute-only updates are
+ * ignored. Neighbour messages produce events for FAILED and REACHABLE.
+ *
+ * @param fd      Socket from nlmon_open().
+ * @param events  Output array.
+ * @param max     Capacity of events; further events are dropped.
+ * @return Number of events written, or -1 if the socket failed.
+ */
+int nlmon_read(int fd, nlmon_event_t *events, size_t max);
+
+/**
+ * @brief Find the interface that carries traffic to an address.
+ *
+ * Asks the kernel's routing table through a connected UDP socket (no
+ * packets are sent) and maps the chosen source address to its interface.
+ *
+ * @param ip  Dotted-quad destination.
+ * @return Interface index, or 0 if no route was found.
+ */
+int nlmon_route_ifindex(const char *ip);
+
+#endif /* NETLINK_MONITOR_H */
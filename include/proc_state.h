@@ -0,0 +1,118 @@
+/*
+ * proc_state.h
+ * --------------------------------------------
+ * Public header for videopipe's runtime process table on disk.
+ *
+ * videopipe records each ffmpeg it runs (pid, camera, stream type,
+ * output device, process start time) in a small state file. If videopipe
+ * is restarted or crashes, the ffmpeg processes keep running, and the
+ * next videopipe reads the file and adopts them instead of restarting
+ * every feed.
+ *
+ * A pid alone is not a safe identity, because pids are reused. A recorded
+ * process is only treated as the same one if its start time in
+ * /proc/<pid>/stat still matches. The caller also checks its command line
+ * against what it would have started.
+ *
+ * This header is paired with proc_state.c.
+ */
+
+#ifndef PROC_STATE_H
+#define PROC_STATE_H
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define PROC_STATE_DEVICE_MAX 64
+#define PROC_STATE_IP_MAX     128
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct proc_state_entry_t
+ * @brief  One running ffmpeg as recorded in the state file.
+ *
+ * Members:
+ *  - pid:           Process id.
+ *  - cam_index:     Camera slot; the output device follows from it.
+ *  - stream_index:  Stream type index (main, ext, sub).
+ *  - start_ticks:   Start time in clock ticks since boot (/proc/<pid>/stat).
+ *  - device:        Output device, e.g. "/dev/video10".
+ *  - ip:            Camera address the process reads from.
+ */
+typedef struct {
+    pid_t pid;
+    int cam_index;
+    int stream_index;
+    unsigned long long start_ticks;
+    char device[PROC_STATE_DEVICE_MAX];
+    char ip[PROC_STATE_IP_MAX];
+} proc_state_entry_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Replace the state file with the given entries. The file is
+ *        written to a temporary name and renamed, so readers never see a
+ *        partial table.
+ *
+ * @return 0 on success, -1 on error (errno set).
+ */
+int proc_state_save(const char *path, const proc_state_entry_t *entries, size_t count);
+
+/**
+ * @brief Read the state file.
+ *
+ * Malformed lines are skipped.
+ *
+ * @return Number of entries read (0 if the file does not exist), or -1 if
+ *         it could not be read or has an unknown format.
+ */
+int proc_state_load(const char *path, proc_state_entry_t *entries, size_t max);
+
+/**
+ * @brief Read a process's start time from /proc/<pid>/stat.
+ * @return 0 on success, -1 if the process does not exist or is a zombie.
+ */
+int proc_start_ticks(pid_t pid, unsigned long long *ticks);
+
+/**
+ * @brief True if pid is alive and still the process that started at
+ *        start_ticks.
+ */
+int proc_is_same(pid_t pid, unsigned long long start_ticks);
+
+/**
+ * @brief Convert a start time in ticks since boot to wall-clock time.
+ * @return The start time, or (time_t)-1 if boot time is unavailable.
+ */
+time_t proc_start_time(unsigned long long start_ticks);
+
+/**
+ * @brief Check a process's command line.
+ *
+ * @param pid      Process to check.
+ * @param exe      Required basename of argv[0].
+ * @param needles  Strings that must each equal one of its arguments.
+ * @param count    Number of needles.
+ * @return 1 if it matches, 0 if not or if it cannot be read.
+ */
+int proc_cmdline_matches(pid_t pid, const char *exe, const char *const *needles, size_t count);
+
+/**
+ * @brief Open a pidfd for a process, confirming afterwards that it is still
+ *        the process that started at start_ticks.
+ *
+ * Unlike a pid, a pidfd keeps referring to the same process. Its exit is
+ * reported to poll(), even for processes that are not our children.
+ *
+ * @return The pidfd (close-on-exec), or -1 on error (errno set; ESRCH if
+ *         the process is gone or the pid was reused).
+ */
+int proc_pidfd_open(pid_t pid, unsigned long long start_ticks);
+
+/**
+ * @brief True if the process behind a pidfd has exited.
+ */
+int proc_pidfd_exited(int pidfd);
+
+#endif /* PROC_STATE_H */
@@ -0,0 +1,96 @@
+/*
+ * proc_stats.h
+ * --------------------------------------------
+ * Public header for per-process resource sampling of videopipe's FFmpeg
+ * children.
+ *
+ * Finding the FFmpeg that eats the CPU used to mean running top by hand.
+ * This module keeps /proc/<pid>/stat, /proc/<pid>/status and
+ * /proc/<pid>/io open for each child and re-reads them with pread() at
+ * offset 0. The kernel regenerates the text on every read, so a sample
+ * costs three system calls per process and no open() or path lookup.
+ * The open descriptors stay bound to the process they were opened for.
+ * Once it exits they return ESRCH, even if its pid is reused.
+ *
+ * Each sample gives the totals and, from the difference to the previous
+ * sample, CPU% and the per-second rates of context switches and I/O.
+ *
+ * This header is paired with proc_stats.c.
+ */
+
+#ifndef PROC_STATS_H
+#define PROC_STATS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct pstat_sample_t
+ * @brief  One sample of a process.
+ *
+ * Members:
+ *  - cpu_pct:          CPU time over wall time since the previous sample,
+ *                      in percent of one core (200 = two cores busy).
+ *  - rss_bytes:        Resident set size (VmRSS).
+ *  - threads:          Number of threads.
+ *  - vol_ctxt, nonvol_ctxt:  Voluntary and involuntary context switches
+ *                      since the process started.
+ *  - read_bytes, write_bytes:  Bytes read and written through system
+ *                      calls (rchar, wchar): sockets, devices and files.
+ *  - *_rate:           The same counters per second since the previous
+ *                      sample.
+ *  - valid_rates:      0 for the first sample, whose rates are zero.
+ */
+typedef struct {
+    double cpu_pct;
+    uint64_t rss_bytes;
+    int threads;
+    uint64_t vol_ctxt;
+    uint64_t nonvol_ctxt;
+    uint64_t read_bytes;
+    uint64_t write_bytes;
+    double vol_ctxt_rate;
+    double nonvol_ctxt_rate;
+    double read_rate;
+    double write_rate;
+    int valid_rates;
+} pstat_sample_t;
+
+/**
+ * @struct pstat_proc_t
+ * @brief  Open /proc files of one process and its previous sample.
+ *         Zero-initialise, or pstat_close(), before the first pstat_open().
+ */
+typedef struct {
+    pid_t pid;              /* 0 while closed */
+    int fd_stat;
+    int fd_status;
+    int fd_io;              /* -1 if /proc/<pid>/io is not readable */
+    uint64_t prev_ns;       /* CLOCK_MONOTONIC of the previous sample, 0 if none */
+    uint64_t prev_ticks;    /* utime + stime */
+    pstat_sample_t prev;
+} pstat_proc_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Open the /proc files of pid for sampling.
+ *
+ * @return 0 on success, -1 if the process is gone (errno set).
+ */
+int pstat_open(pstat_proc_t *p, pid_t pid);
+
+/**
+ * @brief Take one sample.
+ *
+ * @return 0 on success, -1 once the process has exited (the files stay
+ *         open until pstat_close()).
+ */
+int pstat_sample(pstat_proc_t *p, pstat_sample_t *out);
+
+/**
+ * @brief Close the files; p can then be opened for another pid.
+ */
+void pstat_close(pstat_proc_t *p);
+
+#endif /* PROC_STATS_H */
@@ -0,0 +1,55 @@
+/*
+ * reachability.h
+ * --------------------------------------------
+ * Public header for the multiplexed camera reachability checker.
+ *
+ * videopipe's periodic health check used to connect to each camera in
+ * turn, so a sweep with several unreachable cameras blocked for one
+ * timeout per camera. reach_sweep() instead starts every connect at once
+ * on a single epoll instance and gives each socket its own deadline, so
+ * a sweep takes at most one timeout however many cameras there are. It
+ * has no FD_SETSIZE limit, unlike the select() loop it replaces.
+ *
+ * This header is paired with reachability.c.
+ */
+
+#ifndef REACHABILITY_H
+#define REACHABILITY_H
+
+#include <stddef.h>
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct reach_target_t
+ * @brief  One host:port to check, and the outcome of the check.
+ *
+ * Members:
+ *  - ip:         Dotted-quad address (input).
+ *  - port:       TCP port (input).
+ *  - reachable:  1 if the connect completed (output).
+ *  - connect_ms: Time the connect took, or -1 if it did not complete.
+ *  - error:      errno of the failure, ETIMEDOUT on deadline, 0 on success.
+ */
+typedef struct {
+    const char *ip;
+    int port;
+    int reachable;
+    int connect_ms;
+    int error;
+} reach_target_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Check all targets concurrently.
+ *
+ * Every connect is started before any result is awaited; each socket is
+ * abandoned once timeout_ms has passed since its own connect began.
+ *
+ * @param targets     Targets to check; results are written in place.
+ * @param count       Number of targets.
+ * @param timeout_ms  Per-target connect deadline.
+ * @return Number of reachable targets, or -1 if epoll could not be set up.
+ */
+int reach_sweep(reach_target_t *targets, size_t count, int timeout_ms);
+
+#endif /* REACHABILITY_H */
@@ -0,0 +1,90 @@
+/*
+ * reprobe.h
+ * --------------------------------------------
+ * Public header for the background re-probe worker.
+ *
+ * videopipe re-scores the alternative stream types of healthy cameras
+ * on a rolling, rate-limited schedule so that a failover always starts
+ * from fresh, pre-validated alternatives. The probes themselves run on
+ * a single low-priority worker thread; the supervisor hands it one job
+ * at a time and collects the result on a later loop iteration, so the
+ * discovery cache is only ever touched by the supervisor.
+ *
+ * This header is paired with reprobe.c.
+ */
+
+#ifndef REPROBE_H
+#define REPROBE_H
+
+#include <time.h>
+
+#include "stream_probe.h"
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct reprobe_job_t
+ * @brief  One stream type of one camera to be re-scored.
+ */
+typedef struct {
+    int cam_index;
+    int stream_index;
+    char ip[128];
+    char user[64];
+    char password[128];
+    char stream_type[16];
+    int stream_num;
+} reprobe_job_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct reprobe_result_t
+ * @brief  Outcome of a finished job, handed back to the supervisor.
+ */
+typedef struct {
+    int cam_index;
+    int stream_index;
+    int ok;
+    stream_info_t info;
+    time_t when;
+} reprobe_result_t;
+
+/**
+ * @brief Probe callback run on the worker thread.
+ *
+ * Scoring is left to the supervisor, which owns the camera's profile.
+ *
+ * @return 1 on success (info filled in), 0 on failure.
+ */
+typedef int (*reprobe_fn)(const reprobe_job_t *job, stream_info_t *info);
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Start the worker thread at idle scheduling priority.
+ * @param fn  Probe callback used for every job.
+ * @return 0 on success, -1 if the thread could not be created.
+ */
+int reprobe_start(reprobe_fn fn);
+
+/**
+ * @brief Stop the worker, waiting for an in-flight probe to finish.
+ */
+void reprobe_stop(void);
+
+/**
+ * @brief Hand a job to the worker.
+ * @return 0 if accepted, -1 if the worker is busy or not running.
+ */
+int reprobe_submit(const reprobe_job_t *job);
+
+/**
+ * @brief Collect a finished job, if any.
+ * @return 1 if a result was copied into out, 0 otherwise.
+ */
+int reprobe_poll(reprobe_result_t *out);
+
+/**
+ * @brief Whether a job is queued, running or waiting to be collected.
+ */
+int reprobe_busy(void);
+
+#endif /* REPROBE_H */
@@ -0,0 +1,143 @@
+/*
+ * roc_log.h
+ * --------------------------------------------
+ * Public header for the leveled logging macros shared by main_controller
+ * and videopipe.
+ *
+ * Every call site names a level and a subsystem:
+ *
+ *     ROC_DEBUG(RLOG_CACHE, "Loaded %zu entries", n);
+ *
+ * There are two filters in front of the formatting:
+ *
+ *   - ROC_LOG_MIN_LEVEL is a compile-time floor (make LOG_MIN_LEVEL=...).
+ *     The comparison is between constants, so the compiler drops call
+ *     sites below the floor, arguments included.
+ *   - Each subsystem has a runtime threshold, read with one relaxed atomic
+ *     load. A call below its threshold returns before any argument is
+ *     formatted.
+ *
+ * Thresholds default to INFO. They come from LOG_LEVELS_FILE and then
+ * from the ROC_LOG environment variable, using the same syntax in both:
+ *
+ *     warning,cache=debug,probe=debug
+ *
+ * A bare level sets every subsystem; name=level overrides one. Both
+ * programs re-read the file on SIGUSR1, so levels can be changed without
+ * a restart.
+ *
+ * Formatted lines go to a sink. The default sink writes "[SUBSYS] message"
+ * to stdout, or to stderr for warnings and errors; videopipe installs its
+ * asynchronous log file instead.
+ *
+ * This header is paired with roc_log.c.
+ */
+
+#ifndef ROC_LOG_H
+#define ROC_LOG_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define LOG_LEVELS_FILE "/etc/roc/log_levels"
+
+enum roc_log_level {
+    ROC_LOG_DEBUG,
+    ROC_LOG_INFO,
+    ROC_LOG_WARNING,
+    ROC_LOG_ERROR,
+    ROC_LOG_OFF
+};
+
+enum roc_log_subsys {
+    RLOG_MAIN,      /* Start-up, shutdown, signals, the main loops          */
+    RLOG_INIT,      /* main_controller's initialization checks              */
+    RLOG_CONFIG,    /* Configuration files                                  */
+    RLOG_DEVICE,    /* v4l2loopback devices                                 */
+    RLOG_CACHE,     /* Discovery cache                                      */
+    RLOG_PROBE,     /* RTMP probing, scoring, re-probing                    */
+    RLOG_PROC,      /* Child processes: ffmpeg, daemons, adoption, handoff  */
+    RLOG_RECOVERY,  /* Stream recovery                                      */
+    RLOG_HEALTH,    /* Health checks                                        */
+    RLOG_NET,       /* Reachability and link events                         */
+    RLOG_SUBSYS_COUNT
+};
+
+#ifndef ROC_LOG_MIN_LEVEL
+#define ROC_LOG_MIN_LEVEL ROC_LOG_DEBUG
+#endif
+
+/** Runtime threshold per subsystem; use the macros rather than reading it. */
+extern _Atomic int roc_log_threshold[RLOG_SUBSYS_COUNT];
+
+#define ROC_LOG(lvl, sub, ...)                                                  \
+    do {                                                                        \
+        if ((lvl) >= ROC_LOG_MIN_LEVEL &&                                       \
+            (lvl) >= atomic_load_explicit(&roc_log_threshold[(sub)],            \
+                                          memory_order_relaxed))                \
+            roc_log_write((lvl), (sub), __VA_ARGS__);                           \
+    } while (0)
+
+#define ROC_DEBUG(sub, ...) ROC_LOG(ROC_LOG_DEBUG, sub, __VA_ARGS__)
+#define ROC_INFO(sub, ...)  ROC_LOG(ROC_LOG_INFO, sub, __VA_ARGS__)
+#define ROC_WARN(sub, ...)  ROC_LOG(ROC_LOG_WARNING, sub, __VA_ARGS__)
+#define ROC_ERROR(sub, ...) ROC_LOG(ROC_LOG_ERROR, sub, __VA_ARGS__)
+
+/** Receives each line that passed both filters. */
+typedef void (*roc_log_sink_fn)(int level, int sub, const char *fmt, va_list ap);
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Format and emit one line, without checking thresholds.
+ *
+ * Called by the macros; call them instead.
+ */
+void roc_log_write(int level, int sub, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * @brief Route lines to sink, or back to the console sink if NULL.
+ */
+void roc_log_set_sink(roc_log_sink_fn sink);
+
+/**
+ * @brief Upper-case level name, e.g. "WARNING".
+ */
+const char *roc_log_level_name(int level);
+
+/**
+ * @brief Lower-case subsystem name as used in level specs, e.g. "cache".
+ */
+const char *roc_log_subsys_name(int sub);
+
+/**
+ * @brief Apply a level spec such as "warning,cache=debug" on top of the
+ *        current thresholds.
+ *
+ * Entries are separated by commas or white space. Nothing is changed if
+ * any entry is invalid.
+ *
+ * @return 0 on success, -1 with errno EINVAL.
+ */
+int roc_log_apply(const char *spec);
+
+/**
+ * @brief Reset every threshold to INFO, then apply the file at path (if
+ *        it exists) and the ROC_LOG environment variable.
+ *
+ * Lines starting with '#' in the file are ignored. If either spec is
+ * invalid, the thresholds in effect before the call are kept.
+ *
+ * @return 0 on success, -1 with errno EINVAL (or the error opening path).
+ */
+int roc_log_configure(const char *path);
+
+/**
+ * @brief Describe the current thresholds, e.g. "info cache=debug".
+ *
+ * Only subsystems that differ from the most common level are listed.
+ */
+void roc_log_describe(char *buf, size_t len);
+
+#endif /* ROC_LOG_H */
@@ -0,0 +1,81 @@
+/*
+ * rtmp_probe.h
+ * --------------------------------------------
+ * Public header for the native RTMP stream probe.
+ *
+ * Provides a lightweight RTMP client that performs the C0/C1/C2
+ * handshake, issues connect/createStream/play against a camera's
+ * bcs application and inspects the first metadata and video packets.
+ * This lets videopipe validate a stream in milliseconds instead of
+ * running ffmpeg for several seconds.
+ *
+ * This header is paired with rtmp_probe.c.
+ */
+
+#ifndef RTMP_PROBE_H
+#define RTMP_PROBE_H
+
+#define RTMP_DEFAULT_PORT 1935
+
+/* Return codes for rtmp_probe_stream() */
+#define RTMP_PROBE_OK       0   /* Stream played, parameters filled in          */
+#define RTMP_PROBE_ENET    -1   /* Connect/handshake/read failed or timed out    */
+#define RTMP_PROBE_EREJECT -2   /* Server refused connect or play (auth, name)   */
+#define RTMP_PROBE_EPROTO  -3   /* Unexpected data or incomplete stream details  */
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct rtmp_probe_result_t
+ * @brief  Stream parameters learned from a native probe.
+ *
+ * Members:
+ *  - width, height:  Coded picture size (metadata or H.264 SPS).
+ *  - fps:            Frame rate (metadata, SPS timing info or timestamps).
+ *  - codec:          Short codec name ("h264", "hevc", ...).
+ *  - profile:        Codec profile name when known (e.g. "High").
+ *  - video_kbps:     Advertised video bitrate from onMetaData, 0 if absent.
+ *  - connect_ms:     Time spent on TCP connect plus handshake.
+ *  - first_frame_ms: Time from start of probe to first video packet.
+ *  - handshake_ok:   1 if the peer completed an RTMP handshake, even if
+ *                    it then refused the connect or play.
+ *  - got_metadata:   1 if an onMetaData packet was seen.
+ *  - got_video:      1 if at least one video packet was seen.
+ */
+typedef struct {
+    int width;
+    int height;
+    double fps;
+    char codec[16];
+    char profile[32];
+    double video_kbps;
+    int connect_ms;
+    int first_frame_ms;
+    int handshake_ok;
+    int got_metadata;
+    int got_video;
+} rtmp_probe_result_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Probe a camera stream natively over RTMP.
+ *
+ * Connects to rtmp://ip:port/bcs, plays channel0_<stream_type>.bcs with
+ * the camera credentials in the query string (same URL layout ffmpeg is
+ * given), and returns as soon as resolution, frame rate and codec are
+ * known. The whole exchange is bounded by timeout_ms.
+ *
+ * @param ip           Camera IPv4 address (dotted-quad).
+ * @param port         RTMP port (normally RTMP_DEFAULT_PORT).
+ * @param stream_type  "main", "ext" or "sub".
+ * @param stream_num   Value for the stream= query parameter.
+ * @param user         Camera user name.
+ * @param password     Camera password.
+ * @param timeout_ms   Overall deadline for the probe.
+ * @param out          Result structure, always zeroed then filled in.
+ * @return RTMP_PROBE_OK on success, or a negative RTMP_PROBE_E* code.
+ */
+int rtmp_probe_stream(const char *ip, int port, const char *stream_type,
+                      int stream_num, const char *user, const char *password,
+                      int timeout_ms, rtmp_probe_result_t *out);
+
+#endif /* RTMP_PROBE_H */
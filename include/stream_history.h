@@ -0,0 +1,136 @@
+/*
+ * stream_history.h
+ * --------------------------------------------
+ * Public header for the per-camera stream history store.
+ *
+ * The discovery cache only remembers the latest best stream of each
+ * camera. The history store keeps a compact, append-only binary log per
+ * camera of probe results, stream switches, outages and recoveries, so
+ * flapping cameras and unreliable stream types can be identified. It
+ * also feeds a reliability factor back into videopipe's stream ranking.
+ *
+ * Each camera has one file, <dir>/<ip>.hist, holding a small header and
+ * then fixed 12-byte records. Appends are single write() calls on an
+ * O_APPEND descriptor. When a file grows past its record limit it is
+ * compacted: records older than the retention period are dropped, and
+ * only the newest half of the limit is kept. The compacted file is
+ * written to a temporary file and renamed over the old one.
+ *
+ * This header is paired with stream_history.c.
+ */
+
+#ifndef STREAM_HISTORY_H
+#define STREAM_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define HIST_MAX_STREAMS    3         /* main, ext, sub                      */
+#define HIST_MAX_RECORDS    16384     /* Compaction threshold per camera      */
+#define HIST_RETENTION_SEC  (30 * 24 * 60 * 60)
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @enum  hist_kind_t
+ * @brief Event types stored in the history.
+ *
+ *  - HIST_PROBE:    A stream was probed; ok says whether it played and
+ *                   value is the score x 100.
+ *  - HIST_SWITCH:   Recovery moved to another stream type; stream is the
+ *                   new type and prev the old one.
+ *  - HIST_OUTAGE:   The stream of the given type stopped.
+ *  - HIST_RECOVERY: The camera streams again on the given type; value is
+ *                   the downtime in milliseconds.
+ */
+typedef enum {
+    HIST_PROBE = 1,
+    HIST_SWITCH,
+    HIST_OUTAGE,
+    HIST_RECOVERY
+} hist_kind_t;
+
+/**
+ * @struct hist_record_t
+ * @brief  One on-disk history record (12 bytes, native byte order).
+ */
+typedef struct {
+    uint32_t time;      /* Unix seconds                     */
+    uint8_t kind;       /* hist_kind_t                      */
+    uint8_t stream;     /* Stream type index                */
+    uint8_t ok;         /* HIST_PROBE: stream played        */
+    uint8_t prev;       /* HIST_SWITCH: previous stream     */
+    int32_t value;      /* Score x 100 or downtime in ms    */
+} hist_record_t;
+
+/**
+ * @struct hist_stats_t
+ * @brief  Per-stream summary over a time window.
+ *
+ * Members:
+ *  - probes, probe_ok:   Probes recorded and how many played.
+ *  - outages:            Times this stream stopped.
+ *  - recoveries:         Times the camera came back on this stream.
+ *  - down_ms_total:      Summed downtime of those recoveries.
+ *  - reliability:        0..1 factor for ranking; 1.0 with no history.
+ */
+typedef struct {
+    int probes;
+    int probe_ok;
+    int outages;
+    int recoveries;
+    int64_t down_ms_total;
+    double reliability;
+} hist_stats_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Append one record to a camera's history, compacting the file if
+ *        it has grown past HIST_MAX_RECORDS.
+ *
+ * @param dir  History directory (created if missing).
+ * @param ip   Camera address; names the file.
+ * @param rec  Record to append.
+ * @return 0 on success, -1 on error (errno set).
+ */
+int hist_append(const char *dir, const char *ip, const hist_record_t *rec);
+
+/**
+ * @brief Read a camera's history.
+ *
+ * @param dir    History directory.
+ * @param ip     Camera address.
+ * @param since  Skip records older than this (0 = all).
+ * @param out    Receives a malloc'd array the caller frees; NULL if none.
+ * @param count  Receives the number of records.
+ * @return 0 on success (including an empty or missing file), -1 if the
+ *         file exists but is not a history file.
+ */
+int hist_read(const char *dir, const char *ip, time_t since, hist_record_t **out, size_t *count);
+
+/**
+ * @brief Summarise history per stream type.
+ *
+ * Reliability is the smoothed probe success rate (ok + 1) / (probes + 1),
+ * divided by (1 + outages per day / 4). A stream with no history scores
+ * 1.0, so it is neither favoured nor penalised against its live score.
+ *
+ * @param recs        Records from hist_read().
+ * @param count       Number of records.
+ * @param window_sec  Length of the window the records cover.
+ * @param stats       Array of HIST_MAX_STREAMS entries to fill.
+ */
+void hist_summarise(const hist_record_t *recs, size_t count, long window_sec, hist_stats_t *stats);
+
+/**
+ * @brief Build the history file path for a camera.
+ * @return 0 on success, -1 if the path does not fit.
+ */
+int hist_path(const char *dir, const char *ip, char *buf, size_t len);
+
+/**
+ * @brief Name of a record kind, for logs and the reader tool.
+ */
+const char *hist_kind_name(int kind);
+
+#endif /* STREAM_HISTORY_H */
@@ -0,0 +1,78 @@
+/*
+ * stream_probe.h
+ * --------------------------------------------
+ * Public header for structured camera stream probing.
+ *
+ * Describes a probed video stream with structured fields (codec,
+ * profile, resolution, frame rate, bitrate, GOP length, time base)
+ * instead of numbers scraped from ffmpeg's console output. Results
+ * come from either the native RTMP probe or ffprobe's JSON writer,
+ * parsed with cJSON.
+ *
+ * This header is paired with stream_probe.c.
+ */
+
+#ifndef STREAM_PROBE_H
+#define STREAM_PROBE_H
+
+#include "rtmp_probe.h"
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct stream_info_t
+ * @brief  Structured description of the first video stream of a URL.
+ *
+ * Members:
+ *  - width, height: Picture size in pixels.
+ *  - fps:           Average frame rate (falls back to r_frame_rate).
+ *  - codec:         Codec short name as reported by ffprobe ("h264").
+ *  - profile:       Codec profile ("High", "Main", ...), empty if unknown.
+ *  - bitrate_kbps:  Stream bitrate, measured from packet sizes if the
+ *                   container does not advertise one. 0 if unknown.
+ *  - gop:           Frames between the first two keyframes seen, 0 if unknown.
+ *  - time_base:     Stream time base as "num/den".
+ *  - startup_ms:    Time from starting the probe to the first media data,
+ *                   0 if unknown.
+ *  - decode_errors: Packets flagged corrupt during the probe window.
+ */
+typedef struct {
+    int width;
+    int height;
+    double fps;
+    char codec[16];
+    char profile[32];
+    int bitrate_kbps;
+    int gop;
+    char time_base[24];
+    int startup_ms;
+    int decode_errors;
+} stream_info_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Probe a stream URL with ffprobe and parse its JSON report.
+ *
+ * Runs ffprobe on the first video stream for a few seconds of packets,
+ * with stdout captured through a pipe. The child is killed if it does
+ * not finish within timeout_sec.
+ *
+ * @param url          Stream URL (passed as a single argv entry).
+ * @param timeout_sec  Hard limit on the ffprobe run.
+ * @param out          Populated on success.
+ * @return 0 on success (video stream with a valid size found), -1 otherwise.
+ */
+int ffprobe_stream_info(const char *url, int timeout_sec, stream_info_t *out);
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Convert a native RTMP probe result into a stream_info_t.
+ *
+ * RTMP timestamps are milliseconds, so the time base is always 1/1000.
+ * The startup latency is the probe's time to first video packet.
+ *
+ * @param in   Native probe result.
+ * @param out  Structure to populate.
+ */
+void stream_info_from_rtmp(const rtmp_probe_result_t *in, stream_info_t *out);
+
+#endif /* STREAM_PROBE_H */
@@ -0,0 +1,123 @@
+/*
+ * stream_score.h
+ * --------------------------------------------
+ * Public header for the stream quality model used by videopipe.
+ *
+ * A probed stream is reduced to a vector of normalised terms (resolution,
+ * frame rate, bitrate, keyframe interval, startup latency, decode errors),
+ * each in the range 0..1. A scoring profile picks a model and weights the
+ * terms, so a replay camera can prefer fast startup and short GOPs over
+ * raw resolution. The term vector is stored next to the score in the
+ * discovery cache to show why a stream was chosen.
+ *
+ * This header is paired with stream_score.c.
+ */
+
+#ifndef STREAM_SCORE_H
+#define STREAM_SCORE_H
+
+#include <cjson/cJSON.h>
+
+#include "stream_probe.h"
+
+#define SCORE_PROFILE_NAME_MAX 32
+
+/* Indices into score_vector_t.term and score_profile_t.weight */
+enum {
+    SCORE_TERM_RESOLUTION = 0,
+    SCORE_TERM_FPS,
+    SCORE_TERM_BITRATE,
+    SCORE_TERM_GOP,
+    SCORE_TERM_LATENCY,
+    SCORE_TERM_ERRORS,
+    SCORE_TERM_COUNT
+};
+
+/* Available scoring models */
+typedef enum {
+    SCORE_MODEL_WEIGHTED = 0,   /* Weighted mean of the terms, 0..100         */
+    SCORE_MODEL_PIXEL_RATE,     /* Legacy width * height * fps                */
+    SCORE_MODEL_COUNT
+} score_model_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct score_vector_t
+ * @brief  Normalised quality terms of one stream, each 0..1.
+ *
+ * Metrics the probe could not measure (bitrate, GOP, startup latency)
+ * get a neutral 0.5 so they neither help nor sink a stream.
+ */
+typedef struct {
+    double term[SCORE_TERM_COUNT];
+} score_vector_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @struct score_profile_t
+ * @brief  Named scoring model and term weights.
+ */
+typedef struct {
+    char name[SCORE_PROFILE_NAME_MAX];
+    score_model_t model;
+    double weight[SCORE_TERM_COUNT];
+} score_profile_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Fill in the built-in "default" profile (weighted model).
+ */
+void score_profile_default(score_profile_t *p);
+
+/**
+ * @brief Build a profile from a JSON object, starting from a base profile.
+ *
+ * Recognised keys: "model" ("weighted" or "pixel_rate") and "weights", an
+ * object keyed by term name ("resolution", "fps", "bitrate", "gop",
+ * "latency", "errors"). Keys that are absent keep the base value.
+ *
+ * @param obj   JSON object from the configuration file.
+ * @param base  Profile to inherit from.
+ * @param name  Name given to the resulting profile.
+ * @param out   Populated on success.
+ * @return 0 on success, -1 on an unknown model or a negative weight.
+ */
+int score_profile_from_json(const cJSON *obj, const score_profile_t *base, const char *name,
+                            score_profile_t *out);
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Score a probed stream under a profile.
+ *
+ * @param p      Scoring profile.
+ * @param info   Probe result.
+ * @param terms  Receives the normalised term vector (may be NULL).
+ * @return The score; higher is better. Only comparable within one profile.
+ */
+double stream_score(const score_profile_t *p, const stream_info_t *info, score_vector_t *terms);
+
+/**
+ * @brief Short name of a term ("resolution", "fps", ...).
+ */
+const char *score_term_name(int term);
+
+/**
+ * @brief Short name of a model ("weighted", "pixel_rate").
+ */
+const char *score_model_name(score_model_t model);
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Serialise a term vector as a JSON object keyed by term name.
+ * @return New cJSON object, or NULL on allocation failure.
+ */
+cJSON *score_vector_to_json(const score_vector_t *v);
+
+/**
+ * @brief Read a term vector written by score_vector_to_json().
+ *
+ * Missing or malformed terms are left at zero.
+ */
+void score_vector_from_json(const cJSON *obj, score_vector_t *v);
+
+#endif /* STREAM_SCORE_H */
@@ -0,0 +1,153 @@
+/*
+ * trace.h
+ * --------------------------------------------
+ * Public header for the timing spans of main_controller and videopipe,
+ * written as a Chrome trace.
+ *
+ * The logs say that a slow start or a slow recovery happened, but not
+ * which step took the time. A span records the start and the duration of
+ * one step, e.g. one stream probe:
+ *
+ *     TRACE_SPAN(span, "probe", "probe_stream");
+ *     trace_span_args(&span, "%s %s", ip, stream_type);
+ *
+ * The span ends when the variable goes out of scope, on every return
+ * path, or earlier at TRACE_END(&span). Spans nest by scope, and each
+ * thread gets its own row in the viewer.
+ *
+ * Tracing is off unless the ROC_TRACE environment variable names a
+ * directory. The program then writes <dir>/<program>-<pid>.json when it
+ * calls trace_close(), which chrome://tracing and ui.perfetto.dev open.
+ * videopipe inherits ROC_TRACE from main_controller, so one variable
+ * traces a whole cold start. Both use CLOCK_MONOTONIC, so their files
+ * line up when opened together.
+ *
+ * While tracing is off, a span costs one relaxed atomic load and a
+ * branch at each end, and no arguments are formatted. Building with
+ * make TRACE=0 compiles the spans out. When on, recording an event takes
+ * two clock reads and a store into a per-thread buffer, with no lock.
+ * At most TRACE_MAX_EVENTS events are kept, so a long-running videopipe
+ * keeps its start-up and the first events after it and drops the rest.
+ *
+ * This header is paired with trace.c.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define TRACE_ENV         "ROC_TRACE"
+#define TRACE_MAX_EVENTS  65536   /* Kept per process; later events are dropped */
+#define TRACE_ARGS_MAX    48      /* Argument text per event, truncated beyond */
+
+#ifndef ROC_TRACE_SPANS
+#define ROC_TRACE_SPANS 1
+#endif
+
+/** Set by trace_open() when ROC_TRACE is set; use the macros rather than reading it. */
+extern _Atomic int trace_enabled;
+
+/**
+ * @struct trace_span_t
+ * @brief  A span in progress. start_ns is 0 when tracing is off or the
+ *         span has ended.
+ */
+typedef struct {
+    uint64_t start_ns;
+    const char *cat;    /* String literals: only the pointers are stored */
+    const char *name;
+    char args[TRACE_ARGS_MAX];
+} trace_span_t;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Read ROC_TRACE and, if it is set, start recording.
+ *
+ * @param program  Names the output file, e.g. "videopipe".
+ * @return 0 if tracing is on or ROC_TRACE is unset, -1 if the directory
+ *         cannot be used (errno set); tracing then stays off.
+ */
+int trace_open(const char *program);
+
+/**
+ * @brief Stop recording and write the trace file.
+ *
+ * Call it after the traced threads have been joined; events a thread is
+ * still recording may be missed.
+ */
+void trace_close(void);
+
+/**
+ * @brief Label the calling thread's row in the viewer, e.g. "recovery".
+ */
+void trace_thread_name(const char *name);
+
+/** CLOCK_MONOTONIC in nanoseconds. */
+uint64_t trace_now_ns(void);
+
+/**
+ * @brief Record a finished span. Called by the span macros.
+ */
+void trace_span_record(const trace_span_t *s, uint64_t end_ns);
+
+/**
+ * @brief Record a span whose start was measured elsewhere.
+ *
+ * @param track  -1 for the calling thread's row, or a number >= 0 for a
+ *               separate row named by trace_track_name(). Spans on one
+ *               row must nest; use one track per overlapping sequence,
+ *               e.g. per camera.
+ * @param start_ns, end_ns  CLOCK_MONOTONIC nanoseconds.
+ * @param fmt   printf-style argument text, or NULL.
+ */
+void trace_complete(int track, const char *cat, const char *name, uint64_t start_ns, uint64_t end_ns,
+                    const char *fmt, ...) __attribute__((format(printf, 6, 7)));
+
+/**
+ * @brief Name a track for trace_complete(), e.g. "camera 3".
+ */
+void trace_track_name(int track, const char *name);
+
+/**
+ * @brief Set the argument text of a span; formatted only while tracing.
+ */
+void trace_span_args_(trace_span_t *s, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/* -------------------------------------------------------------------------- */
+static inline int trace_on(void)
+{
+    return ROC_TRACE_SPANS && atomic_load_explicit(&trace_enabled, memory_order_relaxed);
+}
+
+static inline void trace_span_start(trace_span_t *s, const char *cat, const char *name)
+{
+    s->start_ns = trace_on() ? trace_now_ns() : 0;
+    s->cat = cat;
+    s->name = name;
+    s->args[0] = '\0';
+}
+
+static inline void trace_span_end(trace_span_t *s)
+{
+    if (s->start_ns) {
+        trace_span_record(s, trace_now_ns());
+        s->start_ns = 0;
+    }
+}
+
+/** Declare span and start it; it ends when it goes out of scope. */
+#define TRACE_SPAN(span, cat, name)                                             \
+    trace_span_t span __attribute__((cleanup(trace_span_end)));                 \
+    trace_span_start(&span, (cat), (name))
+
+/** End a span before the end of its scope. */
+#define TRACE_END(sp) trace_span_end(sp)
+
+#define trace_span_args(sp, ...)                                                \
+    do {                                                                        \
+        if ((sp)->start_ns) trace_span_args_((sp), __VA_ARGS__);                \
+    } while (0)
+
+#endif /* TRACE_H */
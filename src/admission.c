@@ -0,0 +1,76 @@
+/*
+ * admission.c
+ * --------------------------------------------
+ * Token-bucket admission gate and jittered backoff for videopipe's
+ * recovery loop.
+ */
+
+#include "admission.h"
+
+#include <time.h>
+
+/* -------------------------------------------------------------------------- */
+static void refill(admission_t *a, uint64_t now_ms)
+{
+    if (a->rate <= 0.0) return;
+    if (now_ms > a->last_ms) {
+        a->tokens += (double)(now_ms - a->last_ms) * a->rate / 1000.0;
+        if (a->tokens > a->burst) a->tokens = a->burst;
+    }
+    a->last_ms = now_ms;
+}
+
+void admission_init(admission_t *a, int max_in_flight, double rate, double burst)
+{
+    a->max_in_flight = max_in_flight > 0 ? max_in_flight : 0;
+    a->in_flight = 0;
+    a->rate = rate;
+    a->burst = burst >= 1.0 ? burst : 1.0;
+    a->tokens = a->burst;
+    a->last_ms = admission_now_ms();
+}
+
+int admission_try_acquire(admission_t *a, uint64_t now_ms)
+{
+    if (a->max_in_flight > 0 && a->in_flight >= a->max_in_flight) return 0;
+    refill(a, now_ms);
+    if (a->rate > 0.0) {
+        if (a->tokens < 1.0) return 0;
+        a->tokens -= 1.0;
+    }
+    a->in_flight++;
+    return 1;
+}
+
+void admission_release(admission_t *a)
+{
+    if (a->in_flight > 0) a->in_flight--;
+}
+
+/* -------------------------------------------------------------------------- */
+int backoff_jitter_ms(int attempt, int base_ms, int cap_ms, uint32_t *seed)
+{
+    if (base_ms < 1) base_ms = 1;
+    if (cap_ms < base_ms) cap_ms = base_ms;
+
+    long window = base_ms;
+    for (int i = 1; i < attempt && window < cap_ms; ++i) window *= 2;
+    if (window > cap_ms) window = cap_ms;
+
+    /* xorshift32 */
+    uint32_t x = *seed ? *seed : 0x9e3779b9u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+
+    long half = window / 2;
+    return (int)(half + (long)(x % (uint32_t)(window - half + 1)));
+}
+
+uint64_t admission_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+}
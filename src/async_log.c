@@ -0,0 +1,325 @@
+/*
+ * async_log.c
+ * --------------------------------------------
+ * Per-thread SPSC ring buffers drained by one writer thread.
+ *
+ * Ring layout: records of a 32-byte header followed by the message, each
+ * padded to a multiple of 32 bytes so that a header always fits before
+ * the end of the buffer. A record never wraps; if the space left at the
+ * end is too small, the producer fills it with a padding record and
+ * starts again at offset 0. head and tail count bytes ever written and
+ * consumed; the producer publishes with a release store of head, the
+ * writer frees space with a release store of tail.
+ *
+ * Rings are kept on a list that producers only prepend to (under a mutex,
+ * once per thread) and that only the writer removes from, so the writer
+ * can walk it without holding the mutex.
+ */
+
+#include "async_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#define REC_ALIGN     32
+#define REC_PAD       UINT32_MAX   /* len of a padding record */
+#define LEVEL_MAX     12
+#define PREFIX_MAX    48
+#define BATCH_RECORDS 256          /* 3 iovecs each, below IOV_MAX */
+
+typedef struct {
+    uint32_t size;                 /* Whole record including header and padding */
+    uint32_t len;                  /* Message bytes, or REC_PAD */
+    int64_t sec;
+    int32_t nsec;
+    char level[LEVEL_MAX];
+} rec_hdr_t;
+
+typedef struct ring {
+    _Atomic uint64_t head;
+    _Atomic uint64_t tail;
+    _Atomic uint64_t dropped;
+    _Atomic int retired;           /* Owning thread has exited */
+    uint64_t reported;             /* Writer only: drops already logged */
+    uint64_t pos;                  /* Writer only: read cursor during a drain */
+    uint64_t end;                  /* Writer only: head snapshot during a drain */
+    struct ring *_Atomic next;
+    _Alignas(REC_ALIGN) char buf[ALOG_RING_BYTES];
+} ring_t;
+
+static int out_fd = STDERR_FILENO;
+static _Atomic int running = 0;
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;   /* Ring list insertions and wake-ups */
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_key_t ring_key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static ring_t *_Atomic rings = NULL;
+
+/* -------------------------------------------------------------------------- */
+static void ring_retire(void *arg)
+{
+    ring_t *r = arg;
+    atomic_store_explicit(&r->retired, 1, memory_order_release);
+}
+
+static void key_init(void)
+{
+    pthread_key_create(&ring_key, ring_retire);
+}
+
+static ring_t *thread_ring(void)
+{
+    pthread_once(&key_once, key_init);
+    ring_t *r = pthread_getspecific(ring_key);
+    if (r) return r;
+    r = aligned_alloc(REC_ALIGN, sizeof(*r));
+    if (!r) return NULL;
+    memset(r, 0, offsetof(ring_t, buf));
+    pthread_setspecific(ring_key, r);
+    pthread_mutex_lock(&lock);
+    atomic_store(&r->next, atomic_load(&rings));
+    atomic_store(&rings, r);
+    pthread_mutex_unlock(&lock);
+    return r;
+}
+
+static size_t format_prefix(char *buf, int64_t sec, const char *level)
+{
+    /* localtime_r is the expensive part; reuse it within the same second */
+    static int64_t cached_sec = -1;
+    static char cached[32];
+    if (sec != cached_sec) {
+        time_t t = (time_t)sec;
+        struct tm tm;
+        localtime_r(&t, &tm);
+        strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &tm);
+        cached_sec = sec;
+    }
+    int n = snprintf(buf, PREFIX_MAX, "%s - %s - ", cached, level);
+    return n < 0 ? 0 : (n >= PREFIX_MAX ? PREFIX_MAX - 1 : (size_t)n);
+}
+
+/* Synchronous path: before alog_open(), after alog_close(), or without a ring */
+static void write_now(const char *level, const char *fmt, va_list ap)
+{
+    char line[PREFIX_MAX + ALOG_MSG_MAX + 1];
+    char tbuf[32];
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", &tm);
+    int n = snprintf(line, sizeof(line), "%s - %s - ", tbuf, level);
+    if (n < 0) return;
+    int m = vsnprintf(line + n, sizeof(line) - (size_t)n - 1, fmt, ap);
+    if (m < 0) return;
+    size_t len = (size_t)n + ((size_t)m < sizeof(line) - (size_t)n - 1 ? (size_t)m : sizeof(line) - (size_t)n - 2);
+    line[len++] = '\n';
+    ssize_t w = write(running ? out_fd : STDERR_FILENO, line, len);
+    (void)w;
+}
+
+/* -------------------------------------------------------------------------- */
+void alog_vwrite(const char *level, const char *fmt, va_list ap)
+{
+    ring_t *r = running ? thread_ring() : NULL;
+    if (!r) {
+        write_now(level, fmt, ap);
+        return;
+    }
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    size_t off = (size_t)(head % ALOG_RING_BYTES);
+    size_t contig = ALOG_RING_BYTES - off;
+    size_t need = sizeof(rec_hdr_t) + ALOG_MSG_MAX;
+    size_t skip = contig < need ? contig : 0;
+    if (ALOG_RING_BYTES - (head - tail) < skip + need) {
+        atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+        pthread_cond_signal(&wake);
+        return;
+    }
+    if (skip) {
+        rec_hdr_t *pad = (rec_hdr_t *)(r->buf + off);
+        pad->size = (uint32_t)skip;
+        pad->len = REC_PAD;
+        head += skip;
+        off = 0;
+    }
+
+    rec_hdr_t *h = (rec_hdr_t *)(r->buf + off);
+    int n = vsnprintf(r->buf + off + sizeof(*h), ALOG_MSG_MAX, fmt, ap);
+    if (n < 0) n = 0;
+    if (n >= ALOG_MSG_MAX) n = ALOG_MSG_MAX - 1;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    h->len = (uint32_t)n;
+    h->size = (uint32_t)((sizeof(*h) + (size_t)n + REC_ALIGN - 1) / REC_ALIGN * REC_ALIGN);
+    h->sec = ts.tv_sec;
+    h->nsec = (int32_t)ts.tv_nsec;
+    strncpy(h->level, level ? level : "", LEVEL_MAX - 1);
+    h->level[LEVEL_MAX - 1] = '\0';
+    atomic_store_explicit(&r->head, head + h->size, memory_order_release);
+
+    /* Wake the writer early once a ring is half full rather than risk drops */
+    if ((head + h->size) - tail > ALOG_RING_BYTES / 2) pthread_cond_signal(&wake);
+}
+
+/* -------------------------------------------------------------------------- */
+static void write_all(struct iovec *iov, int n)
+{
+    while (n > 0) {
+        ssize_t w = writev(out_fd, iov, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return;                 /* Nowhere to report it; drop the batch */
+        }
+        while (n > 0 && (size_t)w >= iov->iov_len) {
+            w -= (ssize_t)iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (char *)iov->iov_base + w;
+            iov->iov_len -= (size_t)w;
+        }
+    }
+}
+
+/* Record at a ring's cursor, skipping padding; NULL when drained */
+static rec_hdr_t *peek(ring_t *r)
+{
+    while (r->pos < r->end) {
+        rec_hdr_t *h = (rec_hdr_t *)(r->buf + r->pos % ALOG_RING_BYTES);
+        if (h->len != REC_PAD) return h;
+        r->pos += h->size;
+    }
+    return NULL;
+}
+
+/* Write out every published record, oldest first across rings */
+static void drain(void)
+{
+    static char prefix[BATCH_RECORDS][PREFIX_MAX];
+    static struct iovec iov[BATCH_RECORDS * 3];
+    static char newline = '\n';
+    ring_t *list = atomic_load(&rings);
+
+    for (ring_t *r = list; r; r = r->next) {
+        r->pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        r->end = atomic_load_explicit(&r->head, memory_order_acquire);
+    }
+    for (;;) {
+        int nrec = 0;
+        for (; nrec < BATCH_RECORDS; ++nrec) {
+            ring_t *best = NULL;
+            rec_hdr_t *bh = NULL;
+            for (ring_t *r = list; r; r = r->next) {
+                rec_hdr_t *h = peek(r);
+                if (h && (!bh || h->sec < bh->sec || (h->sec == bh->sec && h->nsec < bh->nsec))) {
+                    best = r;
+                    bh = h;
+                }
+            }
+            if (!best) break;
+            iov[nrec * 3] = (struct iovec){ prefix[nrec], format_prefix(prefix[nrec], bh->sec, bh->level) };
+            iov[nrec * 3 + 1] = (struct iovec){ (char *)(bh + 1), bh->len };
+            iov[nrec * 3 + 2] = (struct iovec){ &newline, 1 };
+            best->pos += bh->size;
+        }
+        if (nrec > 0) write_all(iov, nrec * 3);
+        /* Only now may producers reuse the space the iovecs pointed into */
+        for (ring_t *r = list; r; r = r->next)
+            atomic_store_explicit(&r->tail, r->pos, memory_order_release);
+        if (nrec < BATCH_RECORDS) break;
+    }
+
+    for (ring_t *r = list; r; r = r->next) {
+        uint64_t d = atomic_load_explicit(&r->dropped, memory_order_relaxed);
+        if (d == r->reported) continue;
+        char line[96];
+        char pfx[PREFIX_MAX];
+        size_t p = format_prefix(pfx, (int64_t)time(NULL), "WARNING");
+        int n = snprintf(line, sizeof(line), "%.*s%llu log message(s) dropped, ring full\n", (int)p, pfx,
+                         (unsigned long long)(d - r->reported));
+        if (n > 0) {
+            struct iovec v = { line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1 };
+            write_all(&v, 1);
+        }
+        r->reported = d;
+    }
+
+    /* Free rings whose thread has exited and whose records are written */
+    pthread_mutex_lock(&lock);
+    ring_t *_Atomic *link = &rings;
+    for (ring_t *r = atomic_load(link); r; r = atomic_load(link)) {
+        if (atomic_load_explicit(&r->retired, memory_order_acquire) &&
+            atomic_load(&r->tail) == atomic_load(&r->head)) {
+            atomic_store(link, atomic_load(&r->next));
+            free(r);
+        } else {
+            link = &r->next;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+static void *writer_main(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    while (running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += ALOG_FLUSH_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) { deadline.tv_sec++; deadline.tv_nsec -= 1000000000L; }
+        pthread_cond_timedwait(&wake, &lock, &deadline);
+        pthread_mutex_unlock(&lock);
+        drain();
+        pthread_mutex_lock(&lock);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+int alog_open(const char *path)
+{
+    if (running) return 0;
+    int rc = 0;
+    out_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (out_fd < 0) {
+        out_fd = STDERR_FILENO;
+        rc = -1;
+    }
+    running = 1;
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0) {
+        running = 0;
+        if (out_fd != STDERR_FILENO) close(out_fd);
+        out_fd = STDERR_FILENO;
+        return -1;
+    }
+    return rc;
+}
+
+void alog_close(void)
+{
+    if (!running) return;
+    pthread_mutex_lock(&lock);
+    running = 0;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writer, NULL);
+    drain();
+    if (out_fd != STDERR_FILENO) close(out_fd);
+    out_fd = STDERR_FILENO;
+}
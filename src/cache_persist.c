@@ -0,0 +1,220 @@
+/*
+ * cache_persist.c
+ * --------------------------------------------
+ * Writer thread for the memory-mapped discovery cache.
+ *
+ * Pending records live in one buffer with a slot per cache record, so a
+ * record resubmitted during the window simply replaces the pending copy.
+ * The writer swaps the buffer out under the lock and writes it without
+ * holding the lock, so the supervisor never waits on msync.
+ */
+
+#include "cache_persist.h"
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake;
+static dcache_t *store = NULL;
+static int running = 0;
+static int window = 0;
+static cache_sync_t policy = CACHE_SYNC_ALWAYS;
+
+/* Pending records, indexed by slot; swapped with the writer's batch buffer */
+static unsigned char *pending = NULL;
+static unsigned char *batch = NULL;
+static unsigned char *pending_set = NULL;
+static unsigned char *batch_set = NULL;
+static int npending = 0;
+static struct timespec first_submit;
+
+static int has_result = 0;
+static cache_persist_batch_t result_slot;
+
+static const char *SYNC_NAMES[] = { "always", "async", "none" };
+
+/* -------------------------------------------------------------------------- */
+static long elapsed_ms(const struct timespec *a, const struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1000L + (b->tv_nsec - a->tv_nsec) / 1000000L;
+}
+
+/**
+ * @brief Write the swapped-out batch and apply the sync policy.
+ */
+static cache_persist_batch_t write_batch(int submitted, cache_sync_t sync)
+{
+    cache_persist_batch_t r = { .submitted = submitted };
+    TRACE_SPAN(span, "cache", "write_batch");
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t slot = 0; slot < store->capacity; ++slot) {
+        if (!batch_set[slot]) continue;
+        batch_set[slot] = 0;
+        if (dcache_put(store, slot, batch + (size_t)slot * store->record_size) > 0) r.written++;
+    }
+    if (r.written > 0 && sync != CACHE_SYNC_NONE) {
+        int rc = sync == CACHE_SYNC_ALWAYS ? dcache_sync(store)
+                                           : msync(store->map, store->map_len, MS_ASYNC);
+        if (rc != 0) r.error = errno;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    r.write_ms = (int)elapsed_ms(&t0, &t1);
+    trace_span_args(&span, "%d of %d written", r.written, submitted);
+    return r;
+}
+
+/* Swap pending and batch buffers; caller holds the lock */
+static int take_pending(void)
+{
+    unsigned char *t = pending; pending = batch; batch = t;
+    t = pending_set; pending_set = batch_set; batch_set = t;
+    int n = npending;
+    npending = 0;
+    return n;
+}
+
+static void *writer_main(void *arg)
+{
+    (void)arg;
+    trace_thread_name("cache writer");
+    pthread_mutex_lock(&lock);
+    while (running) {
+        if (npending == 0) {
+            pthread_cond_wait(&wake, &lock);
+            continue;
+        }
+        /* Let the window run out so later submissions join this batch */
+        struct timespec deadline = first_submit;
+        deadline.tv_sec += window / 1000;
+        deadline.tv_nsec += (long)(window % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) { deadline.tv_sec++; deadline.tv_nsec -= 1000000000L; }
+        if (pthread_cond_timedwait(&wake, &lock, &deadline) != ETIMEDOUT && running) continue;
+        if (!running) break;
+
+        int n = take_pending();
+        cache_sync_t sync = policy;
+        pthread_mutex_unlock(&lock);
+        cache_persist_batch_t r = write_batch(n, sync);
+        pthread_mutex_lock(&lock);
+        result_slot = r;
+        has_result = 1;
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+int cache_persist_start(dcache_t *cache, int window_ms, cache_sync_t sync)
+{
+    if (running || !cache || !cache->map) return -1;
+    size_t bytes = (size_t)cache->capacity * cache->record_size;
+    pending = malloc(bytes);
+    batch = malloc(bytes);
+    pending_set = calloc(cache->capacity, 1);
+    batch_set = calloc(cache->capacity, 1);
+    if (!pending || !batch || !pending_set || !batch_set) goto fail;
+
+    /* Deadlines are computed on the monotonic clock */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    store = cache;
+    window = window_ms > 0 ? window_ms : 0;
+    policy = sync;
+    npending = 0;
+    has_result = 0;
+    running = 1;
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0) {
+        running = 0;
+        pthread_cond_destroy(&wake);
+        goto fail;
+    }
+    return 0;
+
+fail:
+    free(pending); free(batch); free(pending_set); free(batch_set);
+    pending = batch = pending_set = batch_set = NULL;
+    store = NULL;
+    return -1;
+}
+
+int cache_persist_submit(uint32_t slot, const void *record)
+{
+    pthread_mutex_lock(&lock);
+    if (!running || slot >= store->capacity) {
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+    memcpy(pending + (size_t)slot * store->record_size, record, store->record_size);
+    if (!pending_set[slot]) {
+        pending_set[slot] = 1;
+        if (npending++ == 0) {
+            clock_gettime(CLOCK_MONOTONIC, &first_submit);
+            pthread_cond_signal(&wake);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+int cache_persist_poll(cache_persist_batch_t *out)
+{
+    pthread_mutex_lock(&lock);
+    int got = has_result;
+    if (got) {
+        *out = result_slot;
+        has_result = 0;
+    }
+    pthread_mutex_unlock(&lock);
+    return got;
+}
+
+void cache_persist_stop(void)
+{
+    pthread_mutex_lock(&lock);
+    if (!running) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    running = 0;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writer, NULL);
+
+    /* The writer has exited; flush what it did not get to */
+    int n = take_pending();
+    if (n > 0) write_batch(n, CACHE_SYNC_ALWAYS);
+    pthread_cond_destroy(&wake);
+    free(pending); free(batch); free(pending_set); free(batch_set);
+    pending = batch = pending_set = batch_set = NULL;
+    store = NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+int cache_sync_from_name(const char *name, cache_sync_t *out)
+{
+    for (int i = 0; name && i < (int)(sizeof(SYNC_NAMES) / sizeof(SYNC_NAMES[0])); ++i) {
+        if (strcmp(name, SYNC_NAMES[i]) == 0) {
+            *out = (cache_sync_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *cache_sync_name(cache_sync_t sync)
+{
+    int s = (int)sync;
+    return (s >= 0 && s < (int)(sizeof(SYNC_NAMES) / sizeof(SYNC_NAMES[0]))) ? SYNC_NAMES[s] : "unknown";
+}
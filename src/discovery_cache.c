@@ -0,0 +1,200 @@
+/*
+ * discovery_cache.c
+ * --------------------------------------------
+ * Double-buffered fixed-size records in a shared file mapping.
+ *
+ * File layout (little-endian, native alignment):
+ *
+ *   header  64 bytes: magic, version, record_size, capacity, crc
+ *   slot[i] 2 x { generation, crc, payload[record_size] }
+ *
+ * A copy with generation 0 is empty. The CRC covers the generation and
+ * the payload, so a half-written copy is never mistaken for a valid one.
+ */
+
+#include "discovery_cache.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DCACHE_MAGIC       "ROCDCACH"
+#define DCACHE_HEADER_SIZE 64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint32_t crc;           /* Over the fields above */
+} dcache_header_t;
+
+typedef struct {
+    uint64_t generation;
+    uint32_t crc;           /* Over generation and payload */
+    uint32_t reserved;
+} dcache_copy_t;
+
+/* -------------------------------------------------------------------------- */
+static uint32_t crc32_update(uint32_t crc, const void *data, size_t len)
+{
+    static uint32_t table[256];
+    static int ready = 0;
+    if (!ready) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        ready = 1;
+    }
+    const unsigned char *p = data;
+    crc = ~crc;
+    while (len--) crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static size_t copy_size(uint32_t record_size)
+{
+    size_t sz = sizeof(dcache_copy_t) + record_size;
+    return (sz + 7) & ~(size_t)7;
+}
+
+static dcache_copy_t *copy_at(const dcache_t *c, uint32_t slot, int which)
+{
+    size_t off = DCACHE_HEADER_SIZE + ((size_t)slot * 2 + (size_t)which) * copy_size(c->record_size);
+    return (dcache_copy_t *)(c->map + off);
+}
+
+static uint32_t copy_crc(const dcache_t *c, const dcache_copy_t *cp)
+{
+    uint32_t crc = crc32_update(0, &cp->generation, sizeof(cp->generation));
+    return crc32_update(crc, cp + 1, c->record_size);
+}
+
+/**
+ * @brief Index of the newest valid copy of a slot, or -1 if none.
+ */
+static int active_copy(const dcache_t *c, uint32_t slot)
+{
+    int best = -1;
+    uint64_t gen = 0;
+    for (int w = 0; w < 2; ++w) {
+        const dcache_copy_t *cp = copy_at(c, slot, w);
+        if (cp->generation == 0 || cp->generation <= gen) continue;
+        if (copy_crc(c, cp) != cp->crc) continue;
+        best = w;
+        gen = cp->generation;
+    }
+    return best;
+}
+
+static void header_fill(dcache_header_t *h, uint32_t version, uint32_t record_size, uint32_t capacity)
+{
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, DCACHE_MAGIC, sizeof(h->magic));
+    h->version = version;
+    h->record_size = record_size;
+    h->capacity = capacity;
+    h->crc = crc32_update(0, h, offsetof(dcache_header_t, crc));
+}
+
+/* -------------------------------------------------------------------------- */
+int dcache_open(dcache_t *c, const char *path, uint32_t version, uint32_t record_size, uint32_t capacity)
+{
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    if (!path || record_size == 0 || capacity == 0) return -1;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    size_t len = DCACHE_HEADER_SIZE + (size_t)capacity * 2 * copy_size(record_size);
+    dcache_header_t want;
+    header_fill(&want, version, record_size, capacity);
+
+    struct stat st;
+    int fresh = 1;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == len) {
+        dcache_header_t have;
+        if (pread(fd, &have, sizeof(have), 0) == (ssize_t)sizeof(have) && memcmp(&have, &want, sizeof(have)) == 0)
+            fresh = 0;
+    }
+    if (fresh) {
+        /* Incompatible or new: start from a zeroed file of the right size */
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)len) != 0 ||
+            pwrite(fd, &want, sizeof(want), 0) != (ssize_t)sizeof(want)) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    c->fd = fd;
+    c->map = map;
+    c->map_len = len;
+    c->record_size = record_size;
+    c->capacity = capacity;
+    return fresh;
+}
+
+int dcache_get(const dcache_t *c, uint32_t slot, void *out)
+{
+    if (!c->map || slot >= c->capacity) return -1;
+    int w = active_copy(c, slot);
+    if (w < 0) return -1;
+    memcpy(out, copy_at(c, slot, w) + 1, c->record_size);
+    return 0;
+}
+
+int dcache_put(dcache_t *c, uint32_t slot, const void *record)
+{
+    if (!c->map || slot >= c->capacity) return -1;
+    int w = active_copy(c, slot);
+    uint64_t gen = 0;
+    if (w >= 0) {
+        const dcache_copy_t *cur = copy_at(c, slot, w);
+        if (memcmp(cur + 1, record, c->record_size) == 0) return 0;
+        gen = cur->generation;
+    }
+
+    /* Fill the inactive copy; it only becomes current once its CRC matches */
+    dcache_copy_t *cp = copy_at(c, slot, w == 0 ? 1 : 0);
+    cp->generation = 0;
+    memcpy(cp + 1, record, c->record_size);
+    cp->generation = gen + 1;
+    cp->crc = copy_crc(c, cp);
+    return 1;
+}
+
+int dcache_clear(dcache_t *c, uint32_t slot)
+{
+    if (!c->map || slot >= c->capacity) return 0;
+    int had = active_copy(c, slot) >= 0;
+    for (int w = 0; w < 2; ++w) {
+        dcache_copy_t *cp = copy_at(c, slot, w);
+        if (cp->generation != 0) cp->generation = 0;
+    }
+    return had;
+}
+
+int dcache_sync(dcache_t *c)
+{
+    if (!c->map) return -1;
+    return msync(c->map, c->map_len, MS_SYNC);
+}
+
+void dcache_close(dcache_t *c)
+{
+    if (c->map) munmap(c->map, c->map_len);
+    if (c->fd >= 0) close(c->fd);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
@@ -0,0 +1,247 @@
+/*
+ * event_journal.c
+ * --------------------------------------------
+ * Memory-mapped ring of fixed-size event records.
+ *
+ * The header's head counter is the number of records ever written. A
+ * writer claims slot head % capacity with an atomic increment. It clears
+ * the slot's seq, fills in the fields and then stores seq = index + 1,
+ * with a release fence before each store of seq. A reader accepts a slot
+ * only if its seq matches the index it expects.
+ */
+
+#define _GNU_SOURCE
+#include "event_journal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define EJ_MAGIC      "ROCJRNL1"
+#define EJ_ANCHOR_NS  (60ULL * 1000000000ULL)  /* Longest gap between anchors */
+
+struct ej_header {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t capacity;
+    _Atomic uint64_t head;  /* Records ever written */
+    uint8_t pad[40];
+};
+
+_Static_assert(sizeof(ej_record_t) == 32, "journal records are 32 bytes");
+_Static_assert(sizeof(struct ej_header) == 64, "journal header is 64 bytes");
+
+static const char *TYPE_NAMES[EJ_TYPE_MAX] = {
+    "?", "anchor", "spawn", "exit", "probe", "switch", "stall", "reach", "start", "stop"
+};
+
+static const char *STALL_NAMES[] = {
+    "?", "no_connection", "no_data", "error_burst", "unreachable", "link_down"
+};
+
+static struct ej_header *hdr = NULL;
+static ej_record_t *ring = NULL;
+static size_t map_len = 0;
+static uint32_t ring_cap = 0;
+static uint8_t src = 0;
+static _Atomic uint64_t last_anchor_ns;
+
+/* -------------------------------------------------------------------------- */
+static uint64_t mono_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void put(uint64_t mono_ns, int type, int cam, int stream, int pid, int32_t value, int32_t extra)
+{
+    uint64_t idx = atomic_fetch_add_explicit(&hdr->head, 1, memory_order_relaxed);
+    volatile ej_record_t *r = &ring[idx % ring_cap];
+    r->seq = 0;
+    atomic_thread_fence(memory_order_release);
+    r->mono_ns = mono_ns;
+    r->type = (uint16_t)type;
+    r->source = src;
+    r->stream = (int8_t)stream;
+    r->cam = (int16_t)cam;
+    r->reserved = 0;
+    r->pid = pid;
+    r->value = value;
+    r->extra = extra;
+    atomic_thread_fence(memory_order_release);
+    r->seq = (uint32_t)(idx + 1);
+}
+
+static void put_anchor(void)
+{
+    struct timespec real;
+    uint64_t mono = mono_now();
+    clock_gettime(CLOCK_REALTIME, &real);
+    uint64_t us = (uint64_t)real.tv_sec * 1000000ULL + (uint64_t)real.tv_nsec / 1000ULL;
+    put(mono, EJ_ANCHOR, EJ_NONE, EJ_NONE, 0, (int32_t)(uint32_t)us, (int32_t)(uint32_t)(us >> 32));
+}
+
+static int make_dirs(const char *path)
+{
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *p = dir + 1; *p; ++p) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+        *p = '/';
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+int ej_open(const char *path, int source, uint32_t capacity)
+{
+    if (hdr || capacity == 0) {
+        errno = hdr ? EBUSY : EINVAL;
+        return -1;
+    }
+    if (make_dirs(path) != 0) return -1;
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    size_t len = sizeof(struct ej_header) + (size_t)capacity * sizeof(ej_record_t);
+    struct ej_header old;
+    struct stat st;
+    int reuse = fstat(fd, &st) == 0 && (size_t)st.st_size == len &&
+                pread(fd, &old, sizeof(old), 0) == (ssize_t)sizeof(old) &&
+                memcmp(old.magic, EJ_MAGIC, 8) == 0 && old.record_size == sizeof(ej_record_t) &&
+                old.capacity == capacity;
+    if (!reuse && (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)len) != 0)) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        errno = err;
+        return -1;
+    }
+
+    hdr = map;
+    ring = (ej_record_t *)((char *)map + sizeof(struct ej_header));
+    map_len = len;
+    ring_cap = capacity;
+    src = (uint8_t)source;
+    if (!reuse) {
+        hdr->record_size = sizeof(ej_record_t);
+        hdr->capacity = capacity;
+        atomic_store(&hdr->head, 0);
+        memcpy(hdr->magic, EJ_MAGIC, 8);
+    }
+    uint64_t now = mono_now();
+    atomic_store(&last_anchor_ns, now);
+    put_anchor();
+    put(now, EJ_START, EJ_NONE, EJ_NONE, (int)getpid(), 0, 0);
+    return 0;
+}
+
+void ej_emit(int type, int cam, int stream, int pid, int32_t value, int32_t extra)
+{
+    if (!hdr) return;
+    uint64_t now = mono_now();
+    uint64_t last = atomic_load_explicit(&last_anchor_ns, memory_order_relaxed);
+    if (now - last >= EJ_ANCHOR_NS &&
+        atomic_compare_exchange_strong_explicit(&last_anchor_ns, &last, now,
+                                                memory_order_relaxed, memory_order_relaxed))
+        put_anchor();
+    put(now, type, cam, stream, pid, value, extra);
+}
+
+void ej_close(void)
+{
+    if (!hdr) return;
+    put(mono_now(), EJ_STOP, EJ_NONE, EJ_NONE, (int)getpid(), 0, 0);
+    munmap(hdr, map_len);
+    hdr = NULL;
+    ring = NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+int ej_read(const char *path, ej_event_t **out, size_t *n)
+{
+    *out = NULL;
+    *n = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct ej_header h;
+    struct stat st;
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(h.magic, EJ_MAGIC, 8) != 0 ||
+        h.record_size != sizeof(ej_record_t) || h.capacity == 0 || fstat(fd, &st) != 0 ||
+        (size_t)st.st_size < sizeof(h) + (size_t)h.capacity * sizeof(ej_record_t)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    size_t ring_bytes = (size_t)h.capacity * sizeof(ej_record_t);
+    ej_record_t *recs = malloc(ring_bytes);
+    ej_event_t *ev = recs ? malloc((size_t)h.capacity * sizeof(*ev)) : NULL;
+    if (!ev || pread(fd, recs, ring_bytes, sizeof(h)) != (ssize_t)ring_bytes) {
+        free(recs);
+        free(ev);
+        close(fd);
+        errno = ev ? EIO : ENOMEM;
+        return -1;
+    }
+    close(fd);
+
+    uint64_t head = atomic_load(&h.head);
+    uint64_t start = head > h.capacity ? head - h.capacity : 0;
+    size_t count = 0;
+    for (uint64_t idx = start; idx < head; ++idx) {
+        const ej_record_t *r = &recs[idx % h.capacity];
+        if (r->seq != (uint32_t)(idx + 1)) continue;
+        ev[count].rec = *r;
+        ev[count].wall_us = 0;
+        count++;
+    }
+    free(recs);
+
+    /* Each record takes the last anchor before it; records ahead of the
+     * first surviving anchor take that one if they are not later than it */
+    int have = 0;
+    uint64_t a_mono = 0;
+    int64_t a_wall = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const ej_record_t *r = &ev[i].rec;
+        if (r->type == EJ_ANCHOR) {
+            a_mono = r->mono_ns;
+            a_wall = (int64_t)(((uint64_t)(uint32_t)r->extra << 32) | (uint32_t)r->value);
+            if (!have)
+                for (size_t k = 0; k < i; ++k)
+                    if (ev[k].rec.mono_ns <= a_mono)
+                        ev[k].wall_us = a_wall - (int64_t)((a_mono - ev[k].rec.mono_ns) / 1000);
+            have = 1;
+        }
+        if (have) ev[i].wall_us = a_wall + ((int64_t)r->mono_ns - (int64_t)a_mono) / 1000;
+    }
+    *out = ev;
+    *n = count;
+    return 0;
+}
+
+const char *ej_type_name(int type)
+{
+    return type > 0 && type < EJ_TYPE_MAX ? TYPE_NAMES[type] : "?";
+}
+
+const char *ej_stall_name(int reason)
+{
+    return reason > 0 && reason < (int)(sizeof(STALL_NAMES) / sizeof(STALL_NAMES[0])) ? STALL_NAMES[reason] : "?";
+}
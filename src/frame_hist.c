@@ -0,0 +1,331 @@
+/*
+ * frame_hist.c
+ * --------------------------------------------
+ * V4L2 frame reader and log-linear interval histograms.
+ *
+ * Bucket layout: values below SUB_COUNT have a bucket each. Above that,
+ * each power of two is split into HALF equal sub-buckets, so a bucket
+ * is never wider than 1/HALF of its lower bound. Values past the top
+ * bucket are clamped into it; max_us keeps the exact largest value.
+ *
+ * The watch table is under one lock, which the reader thread holds
+ * while it dequeues. The histograms and counters are atomics so the
+ * metrics thread can read them without it.
+ */
+
+#define _GNU_SOURCE
+#include "frame_hist.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <linux/videodev2.h>
+
+#define SUB_BITS       6
+#define SUB_COUNT      (1u << SUB_BITS)
+#define HALF           (SUB_COUNT / 2)
+#define MAX_SHIFT      21                                /* Top bucket ends at 64 << 21 us, about 134 s */
+#define NBUCKETS       (SUB_COUNT + MAX_SHIFT * HALF)
+#define TOP_VALUE      ((uint64_t)SUB_COUNT << MAX_SHIFT)
+
+#define REQ_BUFFERS    4
+#define RETRY_MS       1000
+#define DEVICE_MAX     32
+#define STOP_ID        FHIST_MAX_CAMERAS
+
+struct hist {
+    _Atomic uint64_t bucket[NBUCKETS];
+    _Atomic uint64_t intervals;
+    _Atomic uint64_t sum_us;
+    _Atomic uint64_t max_us;
+    _Atomic uint64_t nominal_us;
+    _Atomic uint64_t gaps;
+    _Atomic uint64_t skipped;
+    _Atomic int streaming;
+};
+
+struct watch {
+    int watched;
+    char device[DEVICE_MAX];
+    int fd;                 /* -1 until the device streams */
+    uint64_t next_try_ms;
+    uint64_t prev_ns;       /* Timestamp of the last frame; 0 after (re)opening */
+    uint32_t prev_seq;
+};
+
+static struct hist hists[FHIST_MAX_CAMERAS];
+static struct watch watches[FHIST_MAX_CAMERAS];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t reader_thread;
+static int epfd = -1;
+static int stop_pipe[2] = { -1, -1 };
+static int running = 0;
+
+/* -------------------------------------------------------------------------- */
+static uint64_t mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t bucket_of(uint64_t v)
+{
+    if (v >= TOP_VALUE) v = TOP_VALUE - 1;
+    if (v < SUB_COUNT) return (size_t)v;
+    unsigned shift = (unsigned)(63 - __builtin_clzll(v)) - (SUB_BITS - 1);
+    return SUB_COUNT + (shift - 1) * HALF + (size_t)(v >> shift) - HALF;
+}
+
+/* Highest value that falls in bucket b */
+static uint64_t bucket_top(size_t b)
+{
+    if (b < SUB_COUNT) return b;
+    unsigned shift = (unsigned)((b - SUB_COUNT) / HALF) + 1;
+    uint64_t sub = (uint64_t)((b - SUB_COUNT) % HALF) + HALF;
+    return ((sub + 1) << shift) - 1;
+}
+
+static void hist_record(struct hist *h, uint64_t us)
+{
+    atomic_fetch_add_explicit(&h->bucket[bucket_of(us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->intervals, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_us, us, memory_order_relaxed);
+    /* Only the reader thread records, so no compare-and-swap is needed */
+    if (us > atomic_load_explicit(&h->max_us, memory_order_relaxed))
+        atomic_store_explicit(&h->max_us, us, memory_order_relaxed);
+    uint64_t nominal = atomic_load_explicit(&h->nominal_us, memory_order_relaxed);
+    if (nominal > 0 && us > 2 * nominal) atomic_fetch_add_explicit(&h->gaps, 1, memory_order_relaxed);
+}
+
+static void hist_clear(struct hist *h)
+{
+    for (size_t b = 0; b < NBUCKETS; ++b) atomic_store_explicit(&h->bucket[b], 0, memory_order_relaxed);
+    atomic_store_explicit(&h->intervals, 0, memory_order_relaxed);
+    atomic_store_explicit(&h->sum_us, 0, memory_order_relaxed);
+    atomic_store_explicit(&h->max_us, 0, memory_order_relaxed);
+    atomic_store_explicit(&h->gaps, 0, memory_order_relaxed);
+    atomic_store_explicit(&h->skipped, 0, memory_order_relaxed);
+}
+
+/* -------------------------------------------------------------------------- */
+static void close_device(int cam, struct watch *w)
+{
+    if (w->fd < 0) return;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, w->fd, NULL);
+    close(w->fd);   /* Also stops streaming and frees the buffers */
+    w->fd = -1;
+    atomic_store_explicit(&hists[cam].streaming, 0, memory_order_relaxed);
+}
+
+/* Become a streaming reader of the device. Fails until FFmpeg has opened
+ * it and set a format; the caller retries. */
+static int open_device(int cam, struct watch *w)
+{
+    int fd = open(w->device, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    if (ioctl(fd, VIDIOC_QUERYCAP, &cap) != 0) goto fail;
+    uint32_t caps = cap.capabilities & V4L2_CAP_DEVICE_CAPS ? cap.device_caps : cap.capabilities;
+    if (!(caps & V4L2_CAP_VIDEO_CAPTURE) || !(caps & V4L2_CAP_STREAMING)) goto fail;
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = REQ_BUFFERS;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (ioctl(fd, VIDIOC_REQBUFS, &req) != 0 || req.count == 0) goto fail;
+    for (uint32_t i = 0; i < req.count; ++i) {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (ioctl(fd, VIDIOC_QBUF, &buf) != 0) goto fail;
+    }
+    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (ioctl(fd, VIDIOC_STREAMON, &type) != 0) goto fail;
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)cam };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) goto fail;
+    w->fd = fd;
+    w->prev_ns = 0;
+    atomic_store_explicit(&hists[cam].streaming, 1, memory_order_relaxed);
+    return 0;
+fail:
+    close(fd);
+    return -1;
+}
+
+/* Dequeue and requeue every ready frame; -1 when the device failed */
+static int read_frames(int cam, struct watch *w)
+{
+    struct hist *h = &hists[cam];
+    for (;;) {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        if (ioctl(w->fd, VIDIOC_DQBUF, &buf) != 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+        /* The driver stamps the frame when FFmpeg writes it; without a
+         * monotonic stamp, the time it is dequeued will do */
+        uint64_t ts = (buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC &&
+                      (buf.timestamp.tv_sec || buf.timestamp.tv_usec)
+                      ? (uint64_t)buf.timestamp.tv_sec * 1000000000ULL + (uint64_t)buf.timestamp.tv_usec * 1000ULL
+                      : mono_ns();
+        /* A jump in the sequence means the frames between went by
+         * unread; a step back means the writer started over. Neither
+         * interval says anything about delivery. */
+        int32_t advance = (int32_t)(buf.sequence - w->prev_seq);
+        if (w->prev_ns != 0 && advance > 1)
+            atomic_fetch_add_explicit(&h->skipped, (uint64_t)(advance - 1), memory_order_relaxed);
+        else if (w->prev_ns != 0 && advance >= 0 && ts > w->prev_ns)
+            hist_record(h, (ts - w->prev_ns) / 1000);
+        w->prev_ns = ts;
+        w->prev_seq = buf.sequence;
+        if (ioctl(w->fd, VIDIOC_QBUF, &buf) != 0) return -1;
+    }
+}
+
+static void *reader_main(void *arg)
+{
+    (void)arg;
+    struct epoll_event evs[16];
+    for (;;) {
+        int n = epoll_wait(epfd, evs, 16, RETRY_MS);
+        if (n < 0 && errno != EINTR) break;
+        pthread_mutex_lock(&lock);
+        int stop = 0;
+        for (int k = 0; k < n; ++k) {
+            uint32_t id = evs[k].data.u32;
+            if (id == STOP_ID) {
+                stop = 1;
+            } else if (id < FHIST_MAX_CAMERAS && watches[id].fd >= 0) {
+                struct watch *w = &watches[id];
+                if ((evs[k].events & (EPOLLERR | EPOLLHUP)) || read_frames((int)id, w) != 0) {
+                    close_device((int)id, w);
+                    w->next_try_ms = mono_ns() / 1000000 + RETRY_MS;
+                }
+            }
+        }
+        uint64_t now_ms = mono_ns() / 1000000;
+        for (int cam = 0; !stop && cam < FHIST_MAX_CAMERAS; ++cam) {
+            struct watch *w = &watches[cam];
+            if (!w->watched || w->fd >= 0 || now_ms < w->next_try_ms) continue;
+            if (open_device(cam, w) != 0) w->next_try_ms = now_ms + RETRY_MS;
+        }
+        pthread_mutex_unlock(&lock);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+int fhist_start(void)
+{
+    int err;
+    if (running) return 0;
+    for (int cam = 0; cam < FHIST_MAX_CAMERAS; ++cam) {
+        memset(&watches[cam], 0, sizeof(watches[cam]));
+        watches[cam].fd = -1;
+    }
+    if (pipe2(stop_pipe, O_CLOEXEC) != 0) return -1;
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = STOP_ID };
+    if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, stop_pipe[0], &ev) != 0) goto fail;
+    err = pthread_create(&reader_thread, NULL, reader_main, NULL);
+    if (err != 0) {
+        errno = err;
+        goto fail;
+    }
+    running = 1;
+    return 0;
+fail:
+    err = errno;
+    if (epfd >= 0) close(epfd);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    epfd = stop_pipe[0] = stop_pipe[1] = -1;
+    errno = err;
+    return -1;
+}
+
+void fhist_stop(void)
+{
+    if (!running) return;
+    ssize_t w = write(stop_pipe[1], "x", 1);
+    (void)w;
+    pthread_join(reader_thread, NULL);
+    running = 0;
+    for (int cam = 0; cam < FHIST_MAX_CAMERAS; ++cam) {
+        close_device(cam, &watches[cam]);
+        watches[cam].watched = 0;
+    }
+    close(epfd);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    epfd = stop_pipe[0] = stop_pipe[1] = -1;
+}
+
+void fhist_watch(int cam, const char *device, double fps)
+{
+    if (!running || cam < 0 || cam >= FHIST_MAX_CAMERAS) return;
+    pthread_mutex_lock(&lock);
+    struct watch *w = &watches[cam];
+    close_device(cam, w);
+    snprintf(w->device, sizeof(w->device), "%s", device);
+    w->watched = 1;
+    /* FFmpeg needs a moment to open the device and set its format */
+    w->next_try_ms = mono_ns() / 1000000 + RETRY_MS;
+    hist_clear(&hists[cam]);
+    atomic_store_explicit(&hists[cam].nominal_us, fps > 0.0 ? (uint64_t)(1e6 / fps) : 0, memory_order_relaxed);
+    pthread_mutex_unlock(&lock);
+}
+
+void fhist_unwatch(int cam)
+{
+    if (!running || cam < 0 || cam >= FHIST_MAX_CAMERAS) return;
+    pthread_mutex_lock(&lock);
+    close_device(cam, &watches[cam]);
+    watches[cam].watched = 0;
+    atomic_store_explicit(&hists[cam].nominal_us, 0, memory_order_relaxed);
+    pthread_mutex_unlock(&lock);
+}
+
+void fhist_summary(int cam, fhist_summary_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (cam < 0 || cam >= FHIST_MAX_CAMERAS) return;
+    const struct hist *h = &hists[cam];
+    out->intervals = atomic_load_explicit(&h->intervals, memory_order_relaxed);
+    out->sum_us = atomic_load_explicit(&h->sum_us, memory_order_relaxed);
+    out->max_us = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+    out->nominal_us = atomic_load_explicit(&h->nominal_us, memory_order_relaxed);
+    out->gaps = atomic_load_explicit(&h->gaps, memory_order_relaxed);
+    out->skipped = atomic_load_explicit(&h->skipped, memory_order_relaxed);
+    out->streaming = atomic_load_explicit(&h->streaming, memory_order_relaxed);
+    if (out->intervals == 0) return;
+    /* Ranks of the percentiles. Frames recorded during the scan can leave
+     * a rank unreached; max_us stands in then. */
+    uint64_t r50 = (out->intervals + 1) / 2, r99 = out->intervals - out->intervals / 100, seen = 0;
+    for (size_t b = 0; b < NBUCKETS && !out->p99_us; ++b) {
+        uint64_t c = atomic_load_explicit(&h->bucket[b], memory_order_relaxed);
+        if (c == 0) continue;
+        seen += c;
+        uint64_t top = bucket_top(b) < out->max_us ? bucket_top(b) : out->max_us;
+        if (!out->p50_us && seen >= r50) out->p50_us = top;
+        if (seen >= r99) out->p99_us = top;
+    }
+    if (!out->p50_us) out->p50_us = out->max_us;
+    if (!out->p99_us) out->p99_us = out->max_us;
+}
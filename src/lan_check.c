@@ -98,17 +98,18 @@ static int parse_default_gateway(char *iface_out, size_t iflen,
 
 /* -------------------------------------------------------------------------- */
 /**
- * @brief Get the IPv4 address assigned to a given interface.
+ * @brief Get the IPv4 address and netmask assigned to a given interface.
  *
  * Iterates through system interfaces (via getifaddrs) and returns the
  * first IPv4 address found for the requested interface.
  *
  * @param ifname    Interface name (e.g., "eth0").
  * @param addr_out  Buffer to hold dotted-quad IP.
- * @param outlen    Size of addr_out.
+ * @param mask_out  Buffer to hold dotted-quad netmask.
+ * @param outlen    Size of addr_out and mask_out.
  * @return 0 on success, -1 if no address is found.
  */
-static int get_iface_ipv4(const char *ifname, char *addr_out, size_t outlen)
+static int get_iface_ipv4(const char *ifname, char *addr_out, char *mask_out, size_t outlen)
 {
     struct ifaddrs *ifaddr, *ifa;
     if (getifaddrs(&ifaddr) == -1) return -1;
@@ -119,6 +120,9 @@ static int get_iface_ipv4(const char *ifname, char *addr_out, size_t outlen)
         if (ifa->ifa_addr->sa_family == AF_INET && strcmp(ifa->ifa_name, ifname) == 0) {
             struct sockaddr_in *sa = (struct sockaddr_in *)ifa->ifa_addr;
             if (inet_ntop(AF_INET, &sa->sin_addr, addr_out, outlen) != NULL) {
+                struct sockaddr_in *nm = (struct sockaddr_in *)ifa->ifa_netmask;
+                if (!nm || inet_ntop(AF_INET, &nm->sin_addr, mask_out, outlen) == NULL)
+                    snprintf(mask_out, outlen, "255.255.255.0");
                 rc = 0;
                 break;
             }
@@ -210,7 +214,7 @@ static int gateway_is_reachable(const char *gw_ip)
  * @brief Main entry point for LAN checking.
  *
  * Discovers the default gateway, the associated interface, and the local
- * IP address for that interface. Performs a basic reachability test by
+ * IP address and netmask for that interface. Performs a basic reachability test by
  * attempting TCP connections to the gateway. Results are returned in a
  * lan_info_t struct.
  *
@@ -227,9 +231,10 @@ int check_LAN(lan_info_t *info)
         return -1;
     }
 
-    if (get_iface_ipv4(info->ifname, info->local_addr,
+    if (get_iface_ipv4(info->ifname, info->local_addr, info->netmask,
                        sizeof(info->local_addr)) != 0) {
         strncpy(info->local_addr, "0.0.0.0", sizeof(info->local_addr));
+        strncpy(info->netmask, "0.0.0.0", sizeof(info->netmask));
     }
 
     info->reachable = gateway_is_reachable(info->gateway);
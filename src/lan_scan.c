@@ -0,0 +1,284 @@
+/*
+ * lan_scan.c
+ * --------------------------------------------
+ * Concurrent LAN sweep for RTMP cameras.
+ *
+ * Connects are issued in address order and all share the same timeout,
+ * so their deadlines expire in launch order. The sweep therefore tracks
+ * timeouts with a single cursor over the address list instead of a timer
+ * per socket. Completed sockets are closed as soon as epoll reports them,
+ * which frees the slot for the next address.
+ */
+
+#include "lan_scan.h"
+#include "rtmp_probe.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#define SCAN_MAX_INFLIGHT   4096    /* Concurrent connects per sweep      */
+#define SCAN_FD_RESERVE     64      /* Descriptors left for everything else */
+#define SCAN_EPOLL_BATCH    256
+#define CONFIRM_MAX_THREADS 32
+
+typedef struct {
+    int fd;             /* -1 once finished or not yet launched */
+    uint64_t started;
+} scan_slot_t;
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+}
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Raise RLIMIT_NOFILE so that up to want sockets can be open.
+ * @return Number of sockets the sweep may keep in flight.
+ */
+static size_t raise_fd_limit(size_t want)
+{
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return 256;
+
+    rlim_t need = (rlim_t)(want + SCAN_FD_RESERVE);
+    if (rl.rlim_cur < need) {
+        rl.rlim_cur = (rl.rlim_max == RLIM_INFINITY || rl.rlim_max >= need) ? need : rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+        getrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (rl.rlim_cur <= SCAN_FD_RESERVE * 2) return SCAN_FD_RESERVE;
+    size_t avail = (size_t)(rl.rlim_cur - SCAN_FD_RESERVE);
+    return avail < want ? avail : want;
+}
+
+/**
+ * @brief Start a non-blocking connect and register it with epoll.
+ * @return 1 if in flight, 0 if it finished immediately (refused or
+ *         connected), -1 if the system ran out of sockets for now.
+ */
+static int launch_connect(int ep, uint32_t addr, int port, uint32_t index, int *fd_out, int *connected)
+{
+    *connected = 0;
+    int s = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s < 0) return (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) ? -1 : 0;
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((uint16_t)port);
+    sa.sin_addr.s_addr = htonl(addr);
+
+    if (connect(s, (struct sockaddr *)&sa, sizeof(sa)) == 0) {
+        *connected = 1;
+        close(s);
+        return 0;
+    }
+    if (errno != EINPROGRESS) {
+        int retry = (errno == EAGAIN);
+        close(s);
+        return retry ? -1 : 0;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT | EPOLLERR | EPOLLHUP;
+    ev.data.u32 = index;
+    if (epoll_ctl(ep, EPOLL_CTL_ADD, s, &ev) != 0) {
+        close(s);
+        return -1;
+    }
+    *fd_out = s;
+    return 1;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* -------------------------------------------------------------------------- */
+int lan_scan_subnet(const lan_info_t *lan, int port, int timeout_ms,
+                    lan_scan_host_t *hosts, size_t max_hosts, size_t *found)
+{
+    if (!lan || !hosts || !found) return -1;
+    *found = 0;
+
+    struct in_addr local, mask;
+    if (inet_pton(AF_INET, lan->local_addr, &local) != 1 ||
+        inet_pton(AF_INET, lan->netmask, &mask) != 1)
+        return -1;
+
+    uint32_t self = ntohl(local.s_addr);
+    uint32_t m = ntohl(mask.s_addr);
+    uint32_t net = self & m;
+    uint64_t span = (uint64_t)(~m) + 1;      /* Addresses in the subnet */
+    if (self == 0 || span < 4 || span - 2 > LAN_SCAN_MAX_PREFIX_HOSTS) return -1;
+
+    /* Candidate addresses: everything but network, broadcast and ourselves */
+    size_t n = 0;
+    uint32_t *addrs = malloc((size_t)span * sizeof(*addrs));
+    scan_slot_t *slots = malloc((size_t)span * sizeof(*slots));
+    uint32_t *open_idx = malloc((size_t)span * sizeof(*open_idx));
+    int *open_ms = malloc((size_t)span * sizeof(*open_ms));
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (!addrs || !slots || !open_idx || !open_ms || ep < 0) {
+        free(addrs); free(slots); free(open_idx); free(open_ms);
+        if (ep >= 0) close(ep);
+        return -1;
+    }
+    for (uint64_t h = 1; h < span - 1; ++h) {
+        uint32_t a = net + (uint32_t)h;
+        if (a == self) continue;
+        slots[n].fd = -1;
+        slots[n].started = 0;
+        addrs[n++] = a;
+    }
+
+    size_t max_inflight = raise_fd_limit(n < SCAN_MAX_INFLIGHT ? n : SCAN_MAX_INFLIGHT);
+    size_t next = 0, head = 0, inflight = 0, nopen = 0;
+    uint64_t timeout = (uint64_t)(timeout_ms > 0 ? timeout_ms : 1);
+    struct epoll_event evs[SCAN_EPOLL_BATCH];
+
+    while (next < n || inflight > 0) {
+        /* Top up the in-flight window */
+        int starved = 0;
+        while (inflight < max_inflight && next < n) {
+            int fd = -1, connected = 0;
+            uint64_t t0 = now_ms();
+            int r = launch_connect(ep, addrs[next], port, (uint32_t)next, &fd, &connected);
+            if (r < 0) { starved = 1; break; }  /* Out of sockets: wait for some to finish */
+            slots[next].started = t0;
+            if (r > 0) {
+                slots[next].fd = fd;
+                inflight++;
+            } else if (connected) {
+                open_idx[nopen] = (uint32_t)next;
+                open_ms[next] = (int)(now_ms() - t0);
+                nopen++;
+            }
+            next++;
+        }
+
+        /* Expire timed-out connects; deadlines run in launch order */
+        uint64_t now = now_ms();
+        while (head < next && (slots[head].fd < 0 || slots[head].started + timeout <= now)) {
+            if (slots[head].fd >= 0) {
+                close(slots[head].fd);
+                slots[head].fd = -1;
+                inflight--;
+            }
+            head++;
+        }
+        if (inflight == 0) {
+            if (starved) break;                 /* Cannot open even one socket */
+            continue;
+        }
+
+        int wait = (int)(slots[head].started + timeout - now);
+        int nev = epoll_wait(ep, evs, SCAN_EPOLL_BATCH, wait);
+        if (nev < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int k = 0; k < nev; ++k) {
+            uint32_t i = evs[k].data.u32;
+            if (i >= n || slots[i].fd < 0) continue;
+            int soerr = 0;
+            socklen_t sl = sizeof(soerr);
+            if (getsockopt(slots[i].fd, SOL_SOCKET, SO_ERROR, &soerr, &sl) == 0 && soerr == 0) {
+                open_idx[nopen++] = i;
+                open_ms[i] = (int)(now_ms() - slots[i].started);
+            }
+            close(slots[i].fd);
+            slots[i].fd = -1;
+            inflight--;
+        }
+    }
+
+    /* Anything still open after an epoll failure */
+    for (size_t i = head; i < next; ++i)
+        if (slots[i].fd >= 0) close(slots[i].fd);
+    close(ep);
+
+    qsort(open_idx, nopen, sizeof(*open_idx), cmp_u32);
+    for (size_t k = 0; k < nopen && *found < max_hosts; ++k) {
+        lan_scan_host_t *h = &hosts[(*found)++];
+        memset(h, 0, sizeof(*h));
+        struct in_addr ia = { .s_addr = htonl(addrs[open_idx[k]]) };
+        inet_ntop(AF_INET, &ia, h->ip, sizeof(h->ip));
+        h->connect_ms = open_ms[open_idx[k]];
+    }
+
+    free(addrs);
+    free(slots);
+    free(open_idx);
+    free(open_ms);
+    return (int)n;
+}
+
+/* -------------------------------------------------------------------------- */
+typedef struct {
+    lan_scan_host_t *host;
+    int port;
+    const char *user;
+    const char *password;
+    int timeout_ms;
+} confirm_job_t;
+
+static void *confirm_worker(void *arg)
+{
+    confirm_job_t *job = arg;
+    rtmp_probe_result_t r;
+    int rc = rtmp_probe_stream(job->host->ip, job->port, "main", 0, job->user, job->password,
+                               job->timeout_ms, &r);
+    job->host->rtmp = r.handshake_ok;
+    if (rc == RTMP_PROBE_OK) {
+        job->host->stream_ok = 1;
+        job->host->width = r.width;
+        job->host->height = r.height;
+        job->host->fps = r.fps;
+    }
+    return NULL;
+}
+
+size_t lan_scan_confirm(lan_scan_host_t *hosts, size_t count, int port,
+                        const char *user, const char *password, int timeout_ms)
+{
+    size_t confirmed = 0;
+    for (size_t base = 0; base < count; base += CONFIRM_MAX_THREADS) {
+        pthread_t th[CONFIRM_MAX_THREADS];
+        confirm_job_t jobs[CONFIRM_MAX_THREADS];
+        int started[CONFIRM_MAX_THREADS];
+        size_t batch = count - base < CONFIRM_MAX_THREADS ? count - base : CONFIRM_MAX_THREADS;
+
+        for (size_t k = 0; k < batch; ++k) {
+            jobs[k].host = &hosts[base + k];
+            jobs[k].port = port;
+            jobs[k].user = user ? user : "admin";
+            jobs[k].password = password ? password : "";
+            jobs[k].timeout_ms = timeout_ms;
+            started[k] = pthread_create(&th[k], NULL, confirm_worker, &jobs[k]) == 0;
+            if (!started[k]) confirm_worker(&jobs[k]);
+        }
+        for (size_t k = 0; k < batch; ++k) {
+            if (started[k]) pthread_join(th[k], NULL);
+            if (hosts[base + k].rtmp) confirmed++;
+        }
+    }
+    return confirmed;
+}
@@ -0,0 +1,441 @@
+/*
+ * log_capture.c
+ * --------------------------------------------
+ * Pipe readers, per-camera rings and the rate-limited log writer.
+ *
+ * Each ring keeps the newest ring_bytes of a camera's output. head
+ * counts every byte ever read into it and flushed counts the bytes
+ * written to the log (or skipped as dropped), so head - flushed is the
+ * backlog. Every FLUSH_TICK_MS the thread writes what each camera's
+ * token bucket allows. All camera state is under one lock, which the
+ * thread holds while it reads and writes; the counters are atomics so
+ * the metrics thread can read them without it.
+ */
+
+#define _GNU_SOURCE
+#include "log_capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define FLUSH_TICK_MS  250
+#define PIPE_BYTES     (256 * 1024)   /* Requested pipe capacity; the default 64 KiB is kept if refused */
+#define MIN_RING       4096
+#define STOP_ID        LOGCAP_MAX_CAMERAS
+
+/* read_pipe() results */
+#define PIPE_EMPTY     0    /* Nothing more to read for now */
+#define PIPE_MORE      1    /* Stopped after one ring's worth */
+#define PIPE_CLOSED    2    /* End of file or error */
+
+struct capture {
+    int fd;                 /* Read end, -1 when none */
+    char *ring;             /* Allocated on first use, ring_bytes long */
+    uint64_t head;          /* Bytes read into the ring */
+    uint64_t flushed;       /* Bytes written to the log or dropped */
+    uint64_t unreported;    /* Dropped bytes not yet noted in the log */
+    int out;                /* camera<N>.log, -1 until first written */
+    off_t out_size;
+    double tokens;          /* Bytes the log may take now */
+    int dump_pending;       /* Exited; dump once the pipe is drained */
+    pid_t exit_pid;
+    int exit_status;
+};
+
+static struct {
+    _Atomic uint64_t captured;
+    _Atomic uint64_t dropped;
+    _Atomic uint64_t rotations;
+} counters[LOGCAP_MAX_CAMERAS];
+
+static struct capture caps[LOGCAP_MAX_CAMERAS];
+static logcap_cfg_t cfg;
+static char log_dir[256];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t capture_thread;
+static int epfd = -1;
+static int stop_pipe[2] = { -1, -1 };
+static int running = 0;
+static int suspended = 0;
+
+/* -------------------------------------------------------------------------- */
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+static void log_path(int cam, const char *suffix, char *buf, size_t len)
+{
+    snprintf(buf, len, "%s/camera%d.log%s", log_dir, cam, suffix);
+}
+
+static int write_all(int fd, const char *p, size_t n)
+{
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+/* Write n bytes of the ring starting at absolute position from */
+static void write_ring(int fd, const struct capture *c, uint64_t from, size_t n)
+{
+    size_t at = (size_t)(from % cfg.ring_bytes);
+    size_t first = n < cfg.ring_bytes - at ? n : cfg.ring_bytes - at;
+    if (write_all(fd, c->ring + at, first) == 0 && n > first) write_all(fd, c->ring, n - first);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Shift camera<N>.log.1.. up by one and start an empty camera<N>.log */
+static void rotate(int cam, struct capture *c)
+{
+    char from[512], to[512];
+    if (cfg.files <= 0) {
+        if (ftruncate(c->out, 0) == 0) c->out_size = 0;
+    } else {
+        for (int k = cfg.files - 1; k >= 1; --k) {
+            char sfrom[16], sto[16];
+            snprintf(sfrom, sizeof(sfrom), ".%d", k);
+            snprintf(sto, sizeof(sto), ".%d", k + 1);
+            log_path(cam, sfrom, from, sizeof(from));
+            log_path(cam, sto, to, sizeof(to));
+            rename(from, to);
+        }
+        log_path(cam, "", from, sizeof(from));
+        log_path(cam, ".1", to, sizeof(to));
+        rename(from, to);
+        close(c->out);
+        c->out = -1;
+    }
+    atomic_fetch_add_explicit(&counters[cam].rotations, 1, memory_order_relaxed);
+}
+
+static int open_log(int cam, struct capture *c)
+{
+    if (c->out >= 0) return 0;
+    char path[512];
+    log_path(cam, "", path, sizeof(path));
+    c->out = open(path, O_CREAT | O_WRONLY | O_APPEND | O_CLOEXEC, 0644);
+    if (c->out < 0) return -1;
+    struct stat st;
+    c->out_size = fstat(c->out, &st) == 0 ? st.st_size : 0;
+    return 0;
+}
+
+/* Write up to budget bytes of the backlog to the log */
+static void flush_cam(int cam, struct capture *c, size_t budget)
+{
+    size_t backlog = (size_t)(c->head - c->flushed);
+    if ((backlog == 0 && c->unreported == 0) || open_log(cam, c) != 0) return;
+    char note[96];
+    int nlen = 0;
+    if (c->unreported > 0)
+        nlen = snprintf(note, sizeof(note), "\n[videopipe: %llu bytes of FFmpeg output dropped]\n",
+                        (unsigned long long)c->unreported);
+    size_t n = backlog < budget ? backlog : budget;
+    if (n == 0 && nlen == 0) return;
+    if (cfg.file_max > 0 && c->out_size > 0 && (size_t)c->out_size + n + (size_t)nlen > cfg.file_max) {
+        rotate(cam, c);
+        if (open_log(cam, c) != 0) return;
+    }
+    if (nlen > 0 && write_all(c->out, note, (size_t)nlen) == 0) {
+        c->out_size += nlen;
+        c->unreported = 0;
+    }
+    if (n > 0) {
+        write_ring(c->out, c, c->flushed, n);
+        c->flushed += n;
+        c->out_size += (off_t)n;
+        c->tokens -= (double)n;
+    }
+}
+
+/* Output tail of the child that exited, with a line saying which it was */
+static void dump_exit(int cam, struct capture *c)
+{
+    c->dump_pending = 0;
+    if (cfg.exit_dump == 0 || !c->ring) return;
+    char path[512], when[32], how[48];
+    snprintf(path, sizeof(path), "%s/camera%d.exit.log", log_dir, cam);
+    int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+    uint64_t avail = c->head < cfg.ring_bytes ? c->head : cfg.ring_bytes;
+    size_t n = avail < cfg.exit_dump ? (size_t)avail : cfg.exit_dump;
+    time_t t = time(NULL);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+    if (c->exit_status < 0) snprintf(how, sizeof(how), "exited");
+    else if (WIFSIGNALED(c->exit_status)) snprintf(how, sizeof(how), "was killed by signal %d", WTERMSIG(c->exit_status));
+    else snprintf(how, sizeof(how), "exited with code %d", WEXITSTATUS(c->exit_status));
+    char head[160];
+    int hlen = snprintf(head, sizeof(head), "[videopipe: FFmpeg pid %d %s at %s; its last %zu bytes of output follow]\n",
+                        (int)c->exit_pid, how, when, n);
+    if (write_all(fd, head, (size_t)hlen) == 0) write_ring(fd, c, c->head - n, n);
+    close(fd);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Read what the pipe holds, at most one ring's worth */
+static int read_pipe(int cam, struct capture *c)
+{
+    size_t total = 0;
+    while (total < cfg.ring_bytes) {
+        size_t at = (size_t)(c->head % cfg.ring_bytes);
+        ssize_t n = read(c->fd, c->ring + at, cfg.ring_bytes - at);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK ? PIPE_EMPTY : PIPE_CLOSED;
+        if (n == 0) return PIPE_CLOSED;
+        c->head += (uint64_t)n;
+        total += (size_t)n;
+        atomic_fetch_add_explicit(&counters[cam].captured, (uint64_t)n, memory_order_relaxed);
+        if (c->head - c->flushed > cfg.ring_bytes) {
+            uint64_t lost = c->head - cfg.ring_bytes - c->flushed;
+            c->flushed += lost;
+            c->unreported += lost;
+            atomic_fetch_add_explicit(&counters[cam].dropped, lost, memory_order_relaxed);
+        }
+    }
+    return PIPE_MORE;
+}
+
+/* Drain and close cam's pipe, dumping the output tail if it exited */
+static void retire(int cam, struct capture *c)
+{
+    if (c->fd < 0) return;
+    if (!suspended) epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    while (read_pipe(cam, c) == PIPE_MORE) {}
+    close(c->fd);
+    c->fd = -1;
+    if (c->dump_pending) dump_exit(cam, c);
+}
+
+static int attach_locked(int cam, int fd)
+{
+    struct capture *c = &caps[cam];
+    if (!c->ring && !(c->ring = malloc(cfg.ring_bytes))) {
+        close(fd);
+        errno = ENOMEM;
+        return -1;
+    }
+    retire(cam, c);
+    c->dump_pending = 0;
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)cam };
+    if (!suspended && epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    c->fd = fd;
+    return 0;
+}
+
+static void *capture_main(void *arg)
+{
+    (void)arg;
+    struct epoll_event evs[16];
+    uint64_t last = now_ms();
+    for (;;) {
+        int n = epoll_wait(epfd, evs, 16, FLUSH_TICK_MS);
+        if (n < 0 && errno != EINTR) break;
+        pthread_mutex_lock(&lock);
+        int stop = 0;
+        for (int k = 0; k < n; ++k) {
+            uint32_t id = evs[k].data.u32;
+            if (id == STOP_ID) stop = 1;
+            else if (id < LOGCAP_MAX_CAMERAS && caps[id].fd >= 0 && !suspended &&
+                     read_pipe((int)id, &caps[id]) == PIPE_CLOSED)
+                retire((int)id, &caps[id]);
+        }
+        uint64_t now = now_ms();
+        if (!stop && now - last >= FLUSH_TICK_MS) {
+            double refill = (double)cfg.flush_rate * (double)(now - last) / 1000.0;
+            for (int cam = 0; cam < LOGCAP_MAX_CAMERAS; ++cam) {
+                struct capture *c = &caps[cam];
+                if (!c->ring) continue;
+                c->tokens += refill;
+                if (c->tokens > (double)cfg.flush_rate) c->tokens = (double)cfg.flush_rate;
+                if (c->tokens >= 1.0) flush_cam(cam, c, (size_t)c->tokens);
+            }
+            last = now;
+        }
+        pthread_mutex_unlock(&lock);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+int logcap_start(const char *dir, const logcap_cfg_t *config)
+{
+    int err;
+    if (running) return 0;
+    cfg = *config;
+    if (cfg.ring_bytes < MIN_RING) cfg.ring_bytes = MIN_RING;
+    if (cfg.exit_dump > cfg.ring_bytes) cfg.exit_dump = cfg.ring_bytes;
+    snprintf(log_dir, sizeof(log_dir), "%s", dir);
+    for (int cam = 0; cam < LOGCAP_MAX_CAMERAS; ++cam) {
+        memset(&caps[cam], 0, sizeof(caps[cam]));
+        caps[cam].fd = caps[cam].out = -1;
+    }
+    if (pipe2(stop_pipe, O_CLOEXEC) != 0) return -1;
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = STOP_ID };
+    if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, stop_pipe[0], &ev) != 0) goto fail;
+    suspended = 0;
+    err = pthread_create(&capture_thread, NULL, capture_main, NULL);
+    if (err != 0) {
+        errno = err;
+        goto fail;
+    }
+    running = 1;
+    return 0;
+fail:
+    err = errno;
+    if (epfd >= 0) close(epfd);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    epfd = stop_pipe[0] = stop_pipe[1] = -1;
+    errno = err;
+    return -1;
+}
+
+void logcap_stop(void)
+{
+    if (!running) return;
+    ssize_t w = write(stop_pipe[1], "x", 1);
+    (void)w;
+    pthread_join(capture_thread, NULL);
+    running = 0;
+    for (int cam = 0; cam < LOGCAP_MAX_CAMERAS; ++cam) {
+        struct capture *c = &caps[cam];
+        if (c->fd >= 0 && !suspended) read_pipe(cam, c);
+        if (c->fd >= 0) close(c->fd);
+        c->fd = -1;
+        /* The backlog is at most one ring, so it is written in full */
+        if (c->ring) flush_cam(cam, c, cfg.ring_bytes);
+        if (c->out >= 0) close(c->out);
+        free(c->ring);
+        memset(c, 0, sizeof(*c));
+        c->fd = c->out = -1;
+    }
+    close(epfd);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    epfd = stop_pipe[0] = stop_pipe[1] = -1;
+}
+
+int logcap_pipe(int cam)
+{
+    if (!running || cam < 0 || cam >= LOGCAP_MAX_CAMERAS) {
+        errno = EINVAL;
+        return -1;
+    }
+    int p[2];
+    if (pipe2(p, O_CLOEXEC | O_NONBLOCK) != 0) return -1;
+    fcntl(p[0], F_SETPIPE_SZ, PIPE_BYTES);
+    pthread_mutex_lock(&lock);
+    int rc = attach_locked(cam, p[0]);
+    pthread_mutex_unlock(&lock);
+    if (rc != 0) {
+        int err = errno;
+        close(p[1]);
+        errno = err;
+        return -1;
+    }
+    return p[1];
+}
+
+int logcap_attach(int cam, int fd)
+{
+    if (!running || cam < 0 || cam >= LOGCAP_MAX_CAMERAS) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_lock(&lock);
+    int rc = attach_locked(cam, fd);
+    pthread_mutex_unlock(&lock);
+    return rc;
+}
+
+int logcap_fd(int cam)
+{
+    if (!running || cam < 0 || cam >= LOGCAP_MAX_CAMERAS) return -1;
+    pthread_mutex_lock(&lock);
+    int fd = caps[cam].fd;
+    pthread_mutex_unlock(&lock);
+    return fd;
+}
+
+void logcap_exited(int cam, pid_t pid, int status)
+{
+    if (!running || cam < 0 || cam >= LOGCAP_MAX_CAMERAS) return;
+    pthread_mutex_lock(&lock);
+    struct capture *c = &caps[cam];
+    c->dump_pending = 1;
+    c->exit_pid = pid;
+    c->exit_status = status;
+    /* Already drained: dump now; otherwise the thread does at EOF */
+    if (c->fd < 0) dump_exit(cam, c);
+    pthread_mutex_unlock(&lock);
+}
+
+void logcap_suspend(void)
+{
+    if (!running) return;
+    pthread_mutex_lock(&lock);
+    if (!suspended) {
+        for (int cam = 0; cam < LOGCAP_MAX_CAMERAS; ++cam) {
+            struct capture *c = &caps[cam];
+            if (c->fd >= 0) {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+                read_pipe(cam, c);
+            }
+            if (c->ring) flush_cam(cam, c, cfg.ring_bytes);
+        }
+        suspended = 1;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void logcap_resume(void)
+{
+    if (!running) return;
+    pthread_mutex_lock(&lock);
+    if (suspended) {
+        for (int cam = 0; cam < LOGCAP_MAX_CAMERAS; ++cam) {
+            if (caps[cam].fd < 0) continue;
+            struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)cam };
+            epoll_ctl(epfd, EPOLL_CTL_ADD, caps[cam].fd, &ev);
+        }
+        suspended = 0;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void logcap_counts(int cam, logcap_counts_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (cam < 0 || cam >= LOGCAP_MAX_CAMERAS) return;
+    out->captured = atomic_load_explicit(&counters[cam].captured, memory_order_relaxed);
+    out->dropped = atomic_load_explicit(&counters[cam].dropped, memory_order_relaxed);
+    out->rotations = atomic_load_explicit(&counters[cam].rotations, memory_order_relaxed);
+}
@@ -0,0 +1,443 @@
+/*
+ * log_tail.c
+ * --------------------------------------------
+ * inotify tailer for the per-camera FFmpeg logs.
+ *
+ * A single watch on the log directory covers every camera log. One
+ * batch of inotify events marks the files that changed, and each marked
+ * file is then read once with pread() from its offset. A file that is
+ * deleted or renamed is read to its end and closed; the next camera<N>.log
+ * to appear is read from the start. Once a second every open file is
+ * checked as well, which covers a lost event or a queue overflow.
+ *
+ * The file table belongs to the tail thread. The counters are atomics
+ * that any thread may read.
+ */
+
+#define _GNU_SOURCE
+#include "log_tail.h"
+#include "multi_match.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#define OFFSETS_HEADER "log-tail 1"
+#define READ_CHUNK (64 * 1024)
+#define RESCAN_MS 1000
+#define FPS_WINDOW_MS 1000  /* Shortest span a frame rate is measured over */
+
+/* Patterns are grouped by class, most specific class first, so the lowest
+ * matching pattern decides a line's class */
+static const struct { const char *text; logt_class_t cls; } PATTERNS[] = {
+    { "connection refused",   LOGT_CONN_REFUSED },
+    { "timed out",            LOGT_TIMEOUT },
+    { "timeout",              LOGT_TIMEOUT },
+    { "input/output error",   LOGT_IO },
+    { "broken pipe",          LOGT_IO },
+    { "connection reset",     LOGT_IO },
+    { "end of file",          LOGT_EOF },
+    { "error while decoding", LOGT_DECODE },
+    { "corrupt",              LOGT_DECODE },
+    { "concealing",           LOGT_DECODE },
+    { "non-existing pps",     LOGT_DECODE },
+    { "missing picture",      LOGT_DECODE },
+    { "error",                LOGT_OTHER },
+    { "failed",               LOGT_OTHER },
+};
+#define PATTERN_COUNT (sizeof(PATTERNS) / sizeof(PATTERNS[0]))
+
+static const char *CLASS_NAMES[LOGT_CLASS_COUNT] = {
+    "conn_refused", "timeout", "io", "eof", "decode", "other"
+};
+
+struct tail_file {
+    int fd;                       /* -1 while the file is not open        */
+    ino_t ino;
+    off_t off;                    /* Next byte to read                    */
+    char partial[LOGT_LINE_MAX];  /* Start of a line not yet terminated   */
+    size_t plen;
+    int dirty;                    /* Changed since the last read          */
+};
+
+static struct {
+    _Atomic uint64_t count[LOGT_CLASS_COUNT];
+    _Atomic uint64_t lines;
+    _Atomic long long last_error;
+    _Atomic uint64_t frames;
+    _Atomic uint32_t fps_milli;
+    _Atomic long long last_progress;
+} counters[LOGT_MAX_CAMERAS];
+
+/* Start of the frame rate window of each camera; tail thread only */
+static struct { uint64_t frames, ms; } fps_base[LOGT_MAX_CAMERAS];
+
+static struct tail_file files[LOGT_MAX_CAMERAS];
+static mmatch_t *matcher = NULL;
+static char log_dir[256];
+static char offsets_file[256];
+static int errfd = -1;
+static int infd = -1;
+static int stop_pipe[2] = { -1, -1 };
+static pthread_t tail_thread;
+static int running = 0;
+
+/* -------------------------------------------------------------------------- */
+/* "camera<N>.log" -> N, or -1 */
+static int camera_of(const char *name)
+{
+    if (strncmp(name, "camera", 6) != 0 || name[6] < '0' || name[6] > '9') return -1;
+    char *end;
+    long n = strtol(name + 6, &end, 10);
+    if (strcmp(end, ".log") != 0 || n < 0 || n >= LOGT_MAX_CAMERAS) return -1;
+    return (int)n;
+}
+
+static void log_path(int cam, char *buf, size_t len)
+{
+    snprintf(buf, len, "%s/camera%d.log", log_dir, cam);
+}
+
+static uint64_t mono_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* "frame=  123 fps= 15 ..." progress line. The rate comes from the frame
+ * counter over at least FPS_WINDOW_MS; FFmpeg's own fps field averages
+ * over the whole run and hides a stream that has slowed down. */
+static void note_progress(int cam, const char *line, size_t len)
+{
+    size_t k = 6;
+    uint64_t frames = 0;
+    if (len <= k || memcmp(line, "frame=", k) != 0) return;
+    while (k < len && line[k] == ' ') k++;
+    if (k == len || line[k] < '0' || line[k] > '9') return;
+    while (k < len && line[k] >= '0' && line[k] <= '9') frames = frames * 10 + (uint64_t)(line[k++] - '0');
+
+    uint64_t now = mono_ms();
+    if (fps_base[cam].ms == 0 || frames < fps_base[cam].frames) {
+        /* First progress line, or a new FFmpeg counting from zero */
+        fps_base[cam].frames = frames;
+        fps_base[cam].ms = now;
+    } else if (now - fps_base[cam].ms >= FPS_WINDOW_MS) {
+        uint64_t milli = (frames - fps_base[cam].frames) * 1000000 / (now - fps_base[cam].ms);
+        atomic_store_explicit(&counters[cam].fps_milli, milli > UINT32_MAX ? UINT32_MAX : (uint32_t)milli,
+                              memory_order_relaxed);
+        fps_base[cam].frames = frames;
+        fps_base[cam].ms = now;
+    }
+    atomic_store_explicit(&counters[cam].frames, frames, memory_order_relaxed);
+    atomic_store_explicit(&counters[cam].last_progress, (long long)time(NULL), memory_order_relaxed);
+}
+
+static void classify_line(int cam, const char *line, size_t len)
+{
+    if (len == 0) return;
+    atomic_fetch_add_explicit(&counters[cam].lines, 1, memory_order_relaxed);
+    if (line[0] == 'f') note_progress(cam, line, len);
+    uint64_t found = mmatch_scan(matcher, line, len);
+    if (!found) return;
+    logt_class_t cls = PATTERNS[__builtin_ctzll(found)].cls;
+    atomic_fetch_add_explicit(&counters[cam].count[cls], 1, memory_order_relaxed);
+    atomic_store_explicit(&counters[cam].last_error, (long long)time(NULL), memory_order_relaxed);
+    if (errfd >= 0) {
+        char out[LOGT_LINE_MAX + 32];
+        int n = snprintf(out, sizeof(out), "camera%d: %.*s\n", cam, (int)len, line);
+        if (n >= (int)sizeof(out)) {
+            n = (int)sizeof(out) - 1;
+            out[n - 1] = '\n';
+        }
+        ssize_t w = write(errfd, out, (size_t)n);
+        (void)w;
+    }
+}
+
+/* Split appended bytes into lines; FFmpeg ends its progress lines with \r */
+static void feed(int cam, const char *data, size_t len)
+{
+    struct tail_file *f = &files[cam];
+    while (len > 0) {
+        size_t take = 0;
+        while (take < len && data[take] != '\n' && data[take] != '\r') take++;
+        if (take == len) {
+            size_t copy = len < sizeof(f->partial) - f->plen ? len : sizeof(f->partial) - f->plen;
+            memcpy(f->partial + f->plen, data, copy);
+            f->plen += copy;
+            return;
+        }
+        if (f->plen == 0) {
+            classify_line(cam, data, take < LOGT_LINE_MAX ? take : LOGT_LINE_MAX);
+        } else {
+            size_t copy = take < sizeof(f->partial) - f->plen ? take : sizeof(f->partial) - f->plen;
+            memcpy(f->partial + f->plen, data, copy);
+            classify_line(cam, f->partial, f->plen + copy);
+            f->plen = 0;
+        }
+        data += take + 1;
+        len -= take + 1;
+    }
+}
+
+static void drain(int cam)
+{
+    static char buf[READ_CHUNK];
+    struct tail_file *f = &files[cam];
+    for (;;) {
+        ssize_t n = pread(f->fd, buf, sizeof(buf), f->off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        f->off += n;
+        feed(cam, buf, (size_t)n);
+    }
+}
+
+static void close_file(int cam)
+{
+    struct tail_file *f = &files[cam];
+    if (f->fd < 0) return;
+    drain(cam);
+    close(f->fd);
+    f->fd = -1;
+    f->plen = 0;
+}
+
+/* Open cam's log. At start, resume from the saved offset if the file is
+ * the same one, else skip to its end; a file that appears later is read
+ * from its start. */
+static int open_file(int cam, off_t resume_off, ino_t resume_ino, int at_start)
+{
+    struct tail_file *f = &files[cam];
+    char path[512];
+    log_path(cam, path, sizeof(path));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    f->fd = fd;
+    f->ino = st.st_ino;
+    f->plen = 0;
+    if (!at_start) f->off = 0;
+    else if (resume_ino && resume_ino == st.st_ino && resume_off <= st.st_size) f->off = resume_off;
+    else f->off = st.st_size;
+    return 0;
+}
+
+static void read_file(int cam)
+{
+    struct tail_file *f = &files[cam];
+    f->dirty = 0;
+    char path[512];
+    struct stat st;
+    log_path(cam, path, sizeof(path));
+    if (f->fd >= 0 && (stat(path, &st) != 0 || st.st_ino != f->ino)) close_file(cam);
+    if (f->fd < 0 && open_file(cam, 0, 0, 0) != 0) return;
+    if (fstat(f->fd, &st) == 0 && st.st_size < f->off) {
+        /* Truncated: start over */
+        f->off = 0;
+        f->plen = 0;
+    }
+    drain(cam);
+}
+
+/* -------------------------------------------------------------------------- */
+static void save_offsets(void)
+{
+    if (!offsets_file[0]) return;
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", offsets_file);
+    FILE *out = fopen(tmp, "w");
+    if (!out) return;
+    fprintf(out, "%s\n", OFFSETS_HEADER);
+    for (int cam = 0; cam < LOGT_MAX_CAMERAS; ++cam)
+        if (files[cam].fd >= 0)
+            fprintf(out, "%d %llu %lld\n", cam, (unsigned long long)files[cam].ino,
+                    (long long)(files[cam].off - (off_t)files[cam].plen));
+    if (fclose(out) != 0 || rename(tmp, offsets_file) != 0) unlink(tmp);
+}
+
+static void open_existing(void)
+{
+    ino_t ino[LOGT_MAX_CAMERAS] = { 0 };
+    off_t off[LOGT_MAX_CAMERAS] = { 0 };
+    FILE *in = offsets_file[0] ? fopen(offsets_file, "r") : NULL;
+    if (in) {
+        char line[128];
+        if (fgets(line, sizeof(line), in) && strncmp(line, OFFSETS_HEADER, strlen(OFFSETS_HEADER)) == 0) {
+            int cam;
+            unsigned long long i;
+            long long o;
+            while (fgets(line, sizeof(line), in))
+                if (sscanf(line, "%d %llu %lld", &cam, &i, &o) == 3 && cam >= 0 && cam < LOGT_MAX_CAMERAS && o >= 0) {
+                    ino[cam] = (ino_t)i;
+                    off[cam] = (off_t)o;
+                }
+        }
+        fclose(in);
+    }
+    DIR *d = opendir(log_dir);
+    if (!d) return;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        int cam = camera_of(de->d_name);
+        if (cam >= 0 && files[cam].fd < 0) open_file(cam, off[cam], ino[cam], 1);
+    }
+    closedir(d);
+}
+
+static void *tail_main(void *arg)
+{
+    (void)arg;
+    char evbuf[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        for (int cam = 0; cam < LOGT_MAX_CAMERAS; ++cam)
+            if (files[cam].dirty) read_file(cam);
+
+        struct pollfd pfd[2] = {
+            { .fd = infd, .events = POLLIN },
+            { .fd = stop_pipe[0], .events = POLLIN },
+        };
+        int rc = poll(pfd, 2, RESCAN_MS);
+        if (rc < 0 && errno != EINTR) break;
+        if (pfd[1].revents) break;
+
+        int rescan = rc == 0;
+        if (pfd[0].revents & POLLIN) {
+            ssize_t n;
+            while ((n = read(infd, evbuf, sizeof(evbuf))) > 0) {
+                for (char *p = evbuf; p < evbuf + n; ) {
+                    const struct inotify_event *ev = (const struct inotify_event *)p;
+                    p += sizeof(*ev) + ev->len;
+                    if (ev->mask & IN_Q_OVERFLOW) {
+                        rescan = 1;
+                        continue;
+                    }
+                    int cam = ev->len ? camera_of(ev->name) : -1;
+                    if (cam < 0) continue;
+                    if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) close_file(cam);
+                    else files[cam].dirty = 1;
+                }
+            }
+        }
+        if (rescan) {
+            DIR *d = opendir(log_dir);
+            struct dirent *de;
+            while (d && (de = readdir(d)) != NULL) {
+                int cam = camera_of(de->d_name);
+                if (cam >= 0) files[cam].dirty = 1;
+            }
+            if (d) closedir(d);
+        }
+    }
+    for (int cam = 0; cam < LOGT_MAX_CAMERAS; ++cam)
+        if (files[cam].fd >= 0) drain(cam);
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+int log_tail_start(const char *dir, const char *error_log, const char *offsets_path)
+{
+    if (running) return 0;
+    const char *texts[PATTERN_COUNT];
+    for (size_t k = 0; k < PATTERN_COUNT; ++k) texts[k] = PATTERNS[k].text;
+    if (!matcher && !(matcher = mmatch_compile(texts, PATTERN_COUNT))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    snprintf(log_dir, sizeof(log_dir), "%s", dir);
+    snprintf(offsets_file, sizeof(offsets_file), "%s", offsets_path ? offsets_path : "");
+    for (int cam = 0; cam < LOGT_MAX_CAMERAS; ++cam) {
+        files[cam].fd = -1;
+        files[cam].dirty = 0;
+    }
+
+    infd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (infd < 0) return -1;
+    if (inotify_add_watch(infd, dir, IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO |
+                                     IN_DELETE | IN_MOVED_FROM) < 0 ||
+        pipe2(stop_pipe, O_CLOEXEC) != 0) {
+        int err = errno;
+        close(infd);
+        infd = -1;
+        errno = err;
+        return -1;
+    }
+    errfd = error_log ? open(error_log, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644) : -1;
+
+    /* Files are opened after the watch exists, so no append falls in between */
+    open_existing();
+    for (int cam = 0; cam < LOGT_MAX_CAMERAS; ++cam)
+        if (files[cam].fd >= 0) files[cam].dirty = 1;
+
+    int err = pthread_create(&tail_thread, NULL, tail_main, NULL);
+    if (err != 0) {
+        for (int cam = 0; cam < LOGT_MAX_CAMERAS; ++cam)
+            if (files[cam].fd >= 0) {
+                close(files[cam].fd);
+                files[cam].fd = -1;
+            }
+        close(infd);
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        if (errfd >= 0) close(errfd);
+        infd = errfd = stop_pipe[0] = stop_pipe[1] = -1;
+        errno = err;
+        return -1;
+    }
+    running = 1;
+    return 0;
+}
+
+void log_tail_stop(void)
+{
+    if (!running) return;
+    ssize_t w = write(stop_pipe[1], "x", 1);
+    (void)w;
+    pthread_join(tail_thread, NULL);
+    running = 0;
+    save_offsets();
+    for (int cam = 0; cam < LOGT_MAX_CAMERAS; ++cam)
+        if (files[cam].fd >= 0) {
+            close(files[cam].fd);
+            files[cam].fd = -1;
+        }
+    close(infd);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    if (errfd >= 0) close(errfd);
+    infd = errfd = stop_pipe[0] = stop_pipe[1] = -1;
+}
+
+void log_tail_counts(int cam, logt_counts_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (cam < 0 || cam >= LOGT_MAX_CAMERAS) return;
+    for (int c = 0; c < LOGT_CLASS_COUNT; ++c)
+        out->count[c] = atomic_load_explicit(&counters[cam].count[c], memory_order_relaxed);
+    out->lines = atomic_load_explicit(&counters[cam].lines, memory_order_relaxed);
+    out->last_error = (time_t)atomic_load_explicit(&counters[cam].last_error, memory_order_relaxed);
+    out->frames = atomic_load_explicit(&counters[cam].frames, memory_order_relaxed);
+    out->last_progress = (time_t)atomic_load_explicit(&counters[cam].last_progress, memory_order_relaxed);
+    if (out->last_progress != 0 && time(NULL) - out->last_progress <= LOGT_PROGRESS_STALE)
+        out->fps = atomic_load_explicit(&counters[cam].fps_milli, memory_order_relaxed) / 1000.0;
+}
+
+const char *log_tail_class_name(int cls)
+{
+    return cls >= 0 && cls < LOGT_CLASS_COUNT ? CLASS_NAMES[cls] : "?";
+}
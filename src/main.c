@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
@@ -9,12 +10,24 @@
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <ctype.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/syscall.h>
 
 // Include your module headers
 #include "lan_check.h"
+#include "lan_scan.h"
 #include "wlan_check.h"
 #include "python3_test.h"
 #include "cJSON.h"
+#include "roc_log.h"
+#include "event_journal.h"
+#include "metrics.h"
+#include "trace.h"
 
 // External function declarations for modules without headers
 extern int check_dependencies_from_json(const char *json_str);
@@ -31,9 +44,27 @@ bool create_camera_config_interactive(void); // to avoid errors for implicit dec
 #define MAX_DAEMONS 8
 #define PIPE_BUFFER_SIZE 4096
 #define MIN_V4L2_DEVICE 10
+#define MAX_CONFIG_CAMERAS 16
+
+// videopipe supervision
+#define VIDEOPIPE_HEARTBEAT_FD 3            // The from_daemon write end in videopipe (--heartbeat-fd)
+#define VIDEOPIPE_HEARTBEAT_TIMEOUT_SEC 30  // videopipe beats every 2 s from its monitor loop
+#define VIDEOPIPE_START_GRACE_SEC 300       // Startup probing of every camera before the first beat
+#define VIDEOPIPE_STOP_TIMEOUT_SEC 10       // SIGTERM until SIGKILL
+#define VIDEOPIPE_STABLE_SEC 60             // A run this long resets the crash-loop backoff
+#define VIDEOPIPE_BACKOFF_MIN_MS 500
+#define VIDEOPIPE_BACKOFF_MAX_MS 60000
+
+// LAN camera discovery
+#define DISCOVERY_PORT 1935
+#define DISCOVERY_PASSWORD_ENV "ROC_CAMERA_PASSWORD" // --discover reads the password here or from stdin
+#define DISCOVERY_CONNECT_TIMEOUT_MS 800
+#define DISCOVERY_PROBE_TIMEOUT_MS 3000
+#define DISCOVERY_MAX_HOSTS 256
 
 // Configuration files
 #define CAMERAS_CONFIG "/etc/roc/cameras.json"
+#define CAMERAS_DRAFT "/etc/roc/cameras.json.draft"
 #define DEPENDENCIES_CONFIG "/etc/roc/dependencies.json"
 #define MODULES_CONFIG "/etc/roc/modules.json"
 
@@ -106,13 +137,29 @@ typedef struct {
 
 static GlobalState g_state;
 
+// Mirror of the state above for the metrics endpoint. The owning threads
+// store into it and the metrics thread only loads, so a scrape never
+// takes g_state's mutexes.
+static struct {
+    _Atomic int phase;
+    _Atomic int daemon_running[MAX_DAEMONS];        // Indexed by DaemonType
+    _Atomic long long daemon_heartbeat[MAX_DAEMONS]; // Last loop pass, Unix time
+    _Atomic int gateway_reachable;                  // -1 until first checked
+    _Atomic int videopipe_running;                  // -1 until first checked
+    _Atomic long long videopipe_heartbeat;          // Last heartbeat, Unix time; 0 for none yet
+    _Atomic unsigned long long videopipe_restarts;
+    time_t start_time;
+} g_metrics;
+static volatile sig_atomic_t g_reload_log_levels = 0; // SIGUSR1: re-read LOG_LEVELS_FILE
+
 // ============================================================================
 // UTILITY FUNCTIONS
 // ============================================================================
 
 bool create_pipe_pair(Pipe* p) {
     int fds[2];
-    if (pipe(fds) != 0) {
+    // Close-on-exec, so videopipe and its FFmpegs inherit none of them
+    if (pipe2(fds, O_CLOEXEC) != 0) {
         perror("pipe creation failed");
         return false;
     }
@@ -150,6 +197,7 @@ void set_phase(ProgramPhase phase) {
     pthread_mutex_lock(&g_state.phase_mutex);
     g_state.phase = phase;
     pthread_mutex_unlock(&g_state.phase_mutex);
+    atomic_store(&g_metrics.phase, (int)phase);
 }
 
 // ============================================================================
@@ -161,60 +209,85 @@ void signal_handler(int signum) {
     request_shutdown();
 }
 
+void log_levels_handler(int signum) {
+    (void)signum;
+    g_reload_log_levels = 1;
+}
+
 void setup_signal_handlers() {
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
+    
+    // sigaction keeps the handler installed across repeated SIGUSR1s
+    struct sigaction usr1 = { .sa_handler = log_levels_handler, .sa_flags = SA_RESTART };
+    sigemptyset(&usr1.sa_mask);
+    sigaction(SIGUSR1, &usr1, NULL);
+}
+
+// Load per-subsystem log levels from LOG_LEVELS_FILE and $ROC_LOG
+void configure_log_levels() {
+    if (roc_log_configure(LOG_LEVELS_FILE) != 0) {
+        ROC_ERROR(RLOG_MAIN, "Invalid log levels in %s or $ROC_LOG (%s), keeping current levels",
+                  LOG_LEVELS_FILE, strerror(errno));
+    }
+    char desc[256];
+    roc_log_describe(desc, sizeof(desc));
+    ROC_INFO(RLOG_MAIN, "Log levels: %s", desc);
 }
 
 // ============================================================================
-// INITIALIZATION PHASE - Sequential Checks
+// INITIALIZATION PHASE - Checks
 // ============================================================================
 
 bool check_lan_connectivity(InitData* data) {
-    printf("[INIT] Checking LAN connectivity...\n");
+    TRACE_SPAN(span, "init", "check_lan_connectivity");
+    ROC_INFO(RLOG_INIT, "Checking LAN connectivity...");
     
     if (check_LAN(&data->lan_info) == 0) {
-        printf("  Interface: %s\n", data->lan_info.ifname);
-        printf("  Local IP: %s\n", data->lan_info.local_addr);
-        printf("  Gateway: %s\n", data->lan_info.gateway);
-        printf("  Reachable: %s\n", data->lan_info.reachable ? "YES" : "NO");
+        ROC_INFO(RLOG_INIT, "Interface: %s", data->lan_info.ifname);
+        ROC_INFO(RLOG_INIT, "Local IP: %s", data->lan_info.local_addr);
+        ROC_INFO(RLOG_INIT, "Gateway: %s", data->lan_info.gateway);
+        ROC_INFO(RLOG_INIT, "Reachable: %s", data->lan_info.reachable ? "YES" : "NO");
         return true;
     }
     
-    fprintf(stderr, "[ERROR] No default route found\n");
+    ROC_ERROR(RLOG_INIT, "No default route found");
     return false;
 }
 
 bool check_wlan_connectivity(InitData* data) {
-    printf("[INIT] Checking WLAN/Internet connectivity...\n");
+    TRACE_SPAN(span, "init", "check_wlan_connectivity");
+    ROC_INFO(RLOG_INIT, "Checking WLAN/Internet connectivity...");
     
     data->wlan_available = check_public_dns();
     
     if (data->wlan_available) {
-        printf("  Internet access: CONFIRMED\n");
+        ROC_INFO(RLOG_INIT, "Internet access: CONFIRMED");
         return true;
     }
     
-    fprintf(stderr, "[WARNING] No Internet access detected\n");
+    ROC_WARN(RLOG_INIT, "No Internet access detected");
     return true; // Non-fatal, continue anyway
 }
 
 bool check_python3_installation(InitData* data) {
-    printf("[INIT] Testing Python3 integration...\n");
+    TRACE_SPAN(span, "init", "check_python3_installation");
+    ROC_INFO(RLOG_INIT, "Testing Python3 integration...");
     
     data->python3_working = (test_python_integration() == 0);
     
     if (data->python3_working) {
-        printf("  Python3: WORKING\n");
+        ROC_INFO(RLOG_INIT, "Python3: WORKING");
         return true;
     }
     
-    fprintf(stderr, "[ERROR] Python3 test failed\n");
+    ROC_ERROR(RLOG_INIT, "Python3 test failed");
     return false;
 }
 
 bool check_system_dependencies(InitData* data) {
-    printf("[INIT] Checking system dependencies...\n");
+    TRACE_SPAN(span, "init", "check_system_dependencies");
+    ROC_INFO(RLOG_INIT, "Checking system dependencies...");
     
     // Build minimal dependencies JSON
     const char *deps_json = 
@@ -236,16 +309,17 @@ bool check_system_dependencies(InitData* data) {
     }
     
     if (data->all_deps_satisfied) {
-        printf("  All dependencies satisfied\n");
+        ROC_INFO(RLOG_INIT, "All dependencies satisfied");
         return true;
     }
     
-    fprintf(stderr, "[ERROR] Missing dependencies\n");
+    ROC_ERROR(RLOG_INIT, "Missing dependencies");
     return false;
 }
 
 bool check_kernel_modules(InitData* data) {
-    printf("[INIT] Checking kernel modules...\n");
+    TRACE_SPAN(span, "init", "check_kernel_modules");
+    ROC_INFO(RLOG_INIT, "Checking kernel modules...");
     
     const char *modules_json = 
         "{"
@@ -267,11 +341,11 @@ bool check_kernel_modules(InitData* data) {
     }
     
     if (data->all_modules_available) {
-        printf("  Kernel modules available\n");
+        ROC_INFO(RLOG_INIT, "Kernel modules available");
         return true;
     }
     
-    fprintf(stderr, "[WARNING] Some kernel modules unavailable\n");
+    ROC_WARN(RLOG_INIT, "Some kernel modules unavailable");
     return true; // Non-fatal
 }
 
@@ -301,7 +375,7 @@ bool is_v4l2loopback_device(int device_num) {
 bool count_v4l2loopback_devices(InitData* data) {
     data->v4l2_device_count = 0;
     
-    printf("  DEBUG: Scanning /dev/video* devices from %d onwards:\n", MIN_V4L2_DEVICE);
+    ROC_DEBUG(RLOG_DEVICE, "Scanning /dev/video* devices from %d onwards:", MIN_V4L2_DEVICE);
     
     for (int i = MIN_V4L2_DEVICE; i <= 255; i++) {
         char dev_path[64];
@@ -309,32 +383,33 @@ bool count_v4l2loopback_devices(InitData* data) {
         
         if (access(dev_path, F_OK) == 0) {
             data->v4l2_device_count++;
-            printf("  DEBUG:   Found /dev/video%d (count=%d)\n", i, data->v4l2_device_count);
+            ROC_DEBUG(RLOG_DEVICE, "Found /dev/video%d (count=%d)", i, data->v4l2_device_count);
         }
     }
     
-    printf("  DEBUG: Total count = %d\n", data->v4l2_device_count);
+    ROC_DEBUG(RLOG_DEVICE, "Total count = %d", data->v4l2_device_count);
     
     return (data->v4l2_device_count > 0);
 }
 
 bool install_v4l2loopback(InitData* data) {
-    printf("[INIT] Installing/verifying v4l2loopback...\n");
+    TRACE_SPAN(span, "init", "install_v4l2loopback");
+    ROC_INFO(RLOG_DEVICE, "Installing/verifying v4l2loopback...");
     
     // Check if module is loaded
     if (system("lsmod | grep -q v4l2loopback") == 0) {
-        printf("  v4l2loopback module is loaded\n");
+        ROC_INFO(RLOG_DEVICE, "v4l2loopback module is loaded");
         data->v4l2loopback_loaded = 1;
         
         // Count existing devices
         count_v4l2loopback_devices(data);
-        printf("  Found %d v4l2loopback devices\n", data->v4l2_device_count);
+        ROC_INFO(RLOG_DEVICE, "Found %d v4l2loopback devices", data->v4l2_device_count);
         
         if (data->v4l2_device_count >= 16) {
             return true;
         }
         
-        printf("  Insufficient devices, reloading...\n");
+        ROC_INFO(RLOG_DEVICE, "Insufficient devices, reloading...");
         system("modprobe -r v4l2loopback 2>/dev/null");
         usleep(500000);
     } else {
@@ -344,44 +419,45 @@ bool install_v4l2loopback(InitData* data) {
     
     // Check if installer exists in PATH
     if (system("which v4l2loopback_mod_install >/dev/null 2>&1") != 0) {
-        fprintf(stderr, "[ERROR] v4l2loopback_mod_install not found in PATH\n");
-        fprintf(stderr, "        Please compile and install: gcc -o v4l2loopback_mod_install v4l2loopback_mod_install.c\n");
-        fprintf(stderr, "        Then: sudo cp v4l2loopback_mod_install /usr/local/bin/\n");
+        ROC_ERROR(RLOG_DEVICE, "v4l2loopback_mod_install not found in PATH");
+        ROC_ERROR(RLOG_DEVICE, "Please compile and install: gcc -o v4l2loopback_mod_install v4l2loopback_mod_install.c");
+        ROC_ERROR(RLOG_DEVICE, "Then: sudo cp v4l2loopback_mod_install /usr/local/bin/");
         return false;
     }
     
-    printf("  Running v4l2loopback installer...\n");
+    ROC_INFO(RLOG_DEVICE, "Running v4l2loopback installer...");
     if (system("v4l2loopback_mod_install") != 0) {
-        fprintf(stderr, "[ERROR] v4l2loopback installation failed\n");
+        ROC_ERROR(RLOG_DEVICE, "v4l2loopback installation failed");
         return false;
     }
     
     usleep(1000000);
     
     if (system("lsmod | grep -q v4l2loopback") != 0) {
-        fprintf(stderr, "[ERROR] Module not loaded after installation\n");
+        ROC_ERROR(RLOG_DEVICE, "Module not loaded after installation");
         return false;
     }
     
     data->v4l2loopback_loaded = 1;
     count_v4l2loopback_devices(data);
     
-    printf("  Created %d v4l2loopback devices\n", data->v4l2_device_count);
+    ROC_INFO(RLOG_DEVICE, "Created %d v4l2loopback devices", data->v4l2_device_count);
     
     return (data->v4l2_device_count >= 16);
 }
 
 bool verify_camera_config(InitData* data) {
+    TRACE_SPAN(span, "init", "verify_camera_config");
     (void)data; // Suppress unused parameter warning
     
-    printf("[INIT] Verifying camera configuration...\n");
+    ROC_INFO(RLOG_CONFIG, "Verifying camera configuration...");
     
     if (access(CAMERAS_CONFIG, F_OK) != 0) {
-        printf("[INIT] Camera config not found: %s\n", CAMERAS_CONFIG);
+        ROC_INFO(RLOG_CONFIG, "Camera config not found: %s", CAMERAS_CONFIG);
         
         // Interactive config creation
         if (!create_camera_config_interactive()) {
-            fprintf(stderr, "[ERROR] Camera configuration failed\n");
+            ROC_ERROR(RLOG_CONFIG, "Camera configuration failed");
             return false;
         }
     }
@@ -389,7 +465,7 @@ bool verify_camera_config(InitData* data) {
     // Parse JSON to validate
     FILE *fp = fopen(CAMERAS_CONFIG, "r");
     if (!fp) {
-        fprintf(stderr, "[ERROR] Cannot open %s\n", CAMERAS_CONFIG);
+        ROC_ERROR(RLOG_CONFIG, "Cannot open %s", CAMERAS_CONFIG);
         return false;
     }
     
@@ -411,59 +487,270 @@ bool verify_camera_config(InitData* data) {
     free(json_str);
     
     if (!root || !cJSON_IsArray(root)) {
-        fprintf(stderr, "[ERROR] Invalid camera config format\n");
+        ROC_ERROR(RLOG_CONFIG, "Invalid camera config format");
         if (root) cJSON_Delete(root);
         return false;
     }
     
     int camera_count = cJSON_GetArraySize(root);
-    printf("  Found %d cameras in config\n", camera_count);
+    ROC_INFO(RLOG_CONFIG, "Found %d cameras in config", camera_count);
     
     cJSON_Delete(root);
     return true;
 }
 
+// ============================================================================
+// INITIALIZATION PHASE - Dependency Graph
+// ============================================================================
+
+// The checks above as a dependency graph, run on a small pool of threads. A
+// step starts once every step in its deps mask has finished, so the checks
+// that wait on network timeouts, shell-outs or the Python fork overlap, and
+// startup takes as long as the longest chain rather than the sum. A fatal
+// failure keeps any step that has not started from starting; steps already
+// running are waited for.
+typedef enum {
+    INIT_LAN,
+    INIT_DEPENDENCIES,
+    INIT_PYTHON,
+    INIT_WLAN,
+    INIT_MODULES,
+    INIT_V4L2LOOPBACK,
+    INIT_CAMERA_CONFIG,
+    INIT_STEP_COUNT
+} InitStepId;
+
+#define INIT_BIT(s) (1u << (s))
+#define INIT_ALL ((1u << INIT_STEP_COUNT) - 1)
+#define INIT_WORKERS 5 // Steps without dependencies, so all of them start at once
+
+typedef struct {
+    bool (*run)(InitData* data);
+    unsigned deps;          // INIT_BIT()s of the steps that must finish first
+    bool fatal;             // Failing ends initialization
+    const char* failure;    // Logged when a fatal step fails
+} InitStep;
+
+static const InitStep INIT_STEPS[INIT_STEP_COUNT] = {
+    // Critical checks - fail fast
+    [INIT_LAN]           = { check_lan_connectivity, 0, true, "LAN connectivity check failed" },
+    [INIT_DEPENDENCIES]  = { check_system_dependencies, 0, true, "System dependencies not satisfied" },
+    [INIT_PYTHON]        = { check_python3_installation, 0, true, "Python3 not working" },
+    // Non-critical checks - warn but continue
+    [INIT_WLAN]          = { check_wlan_connectivity, 0, false, NULL },
+    [INIT_MODULES]       = { check_kernel_modules, 0, false, NULL },
+    // Changes the system, so only once the critical checks have passed;
+    // it may also reload the module the modules check looks for
+    [INIT_V4L2LOOPBACK]  = { install_v4l2loopback,
+                             INIT_BIT(INIT_LAN) | INIT_BIT(INIT_DEPENDENCIES) | INIT_BIT(INIT_PYTHON) | INIT_BIT(INIT_MODULES),
+                             true, "v4l2loopback setup failed" },
+    // May prompt on the terminal, so it runs alone after everything else
+    [INIT_CAMERA_CONFIG] = { verify_camera_config, INIT_ALL & ~INIT_BIT(INIT_CAMERA_CONFIG),
+                             true, "Camera configuration invalid" },
+};
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;    // Broadcast when a step finishes
+    unsigned started;
+    unsigned finished;
+    int failed;             // First fatal step that failed, or -1
+} g_init = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, -1 };
+
+// Next step whose dependencies have all finished, or -1
+static int next_ready_step() {
+    for (int s = 0; s < INIT_STEP_COUNT; s++)
+        if (!(g_init.started & INIT_BIT(s)) && (INIT_STEPS[s].deps & ~g_init.finished) == 0) return s;
+    return -1;
+}
+
+// Take ready steps until none is left to start or initialization has failed
+static void run_init_steps(InitData* data) {
+    pthread_mutex_lock(&g_init.mutex);
+    while (g_init.failed < 0 && g_init.started != INIT_ALL && !is_shutdown_requested()) {
+        int s = next_ready_step();
+        if (s < 0) {
+            // What is left waits on a step another worker is running
+            pthread_cond_wait(&g_init.cond, &g_init.mutex);
+            continue;
+        }
+        g_init.started |= INIT_BIT(s);
+        pthread_mutex_unlock(&g_init.mutex);
+        bool ok = INIT_STEPS[s].run(data);
+        pthread_mutex_lock(&g_init.mutex);
+        g_init.finished |= INIT_BIT(s);
+        if (!ok && INIT_STEPS[s].fatal && g_init.failed < 0) g_init.failed = s;
+        pthread_cond_broadcast(&g_init.cond);
+    }
+    pthread_mutex_unlock(&g_init.mutex);
+}
+
+static void* init_worker(void* arg) {
+    trace_thread_name("init");
+    run_init_steps(arg);
+    return NULL;
+}
+
 bool run_initialization_phase() {
     printf("\n=== INITIALIZATION PHASE ===\n");
     set_phase(PHASE_INITIALIZATION);
+    TRACE_SPAN(span, "init", "run_initialization_phase");
+    uint64_t start_ns = trace_now_ns();
     
     InitData* data = &g_state.init_data;
     memset(data, 0, sizeof(InitData));
+    g_init.started = g_init.finished = 0;
+    g_init.failed = -1;
+    
+    pthread_t workers[INIT_WORKERS];
+    int worker_count = 0;
+    while (worker_count < INIT_WORKERS &&
+           pthread_create(&workers[worker_count], NULL, init_worker, data) == 0)
+        worker_count++;
+    if (worker_count == 0) {
+        ROC_WARN(RLOG_INIT, "Cannot start initialization workers; running the checks one by one");
+        run_init_steps(data);
+    }
+    for (int i = 0; i < worker_count; i++) pthread_join(workers[i], NULL);
     
-    // Critical checks - fail fast
-    if (!check_lan_connectivity(data)) {
-        fprintf(stderr, "[FATAL] LAN connectivity check failed\n");
+    if (g_init.failed >= 0) {
+        ROC_ERROR(RLOG_INIT, "%s", INIT_STEPS[g_init.failed].failure);
+        return false;
+    }
+    if (g_init.finished != INIT_ALL) {
+        ROC_WARN(RLOG_INIT, "Initialization interrupted");
         return false;
     }
     
-    if (!check_system_dependencies(data)) {
-        fprintf(stderr, "[FATAL] System dependencies not satisfied\n");
+    ROC_INFO(RLOG_INIT, "All initialization checks passed in %llu ms",
+             (unsigned long long)((trace_now_ns() - start_ns) / 1000000));
+    return true;
+}
+
+// ============================================================================
+// CAMERA DISCOVERY
+// ============================================================================
+
+bool ensure_config_dir() {
+    if (access("/etc/roc", F_OK) != 0) {
+        if (mkdir("/etc/roc", 0755) != 0) {
+            ROC_ERROR(RLOG_CONFIG, "Failed to create /etc/roc directory: %s", strerror(errno));
+            return false;
+        }
+        ROC_INFO(RLOG_CONFIG, "Created /etc/roc directory");
+    }
+    return true;
+}
+
+bool write_camera_config(cJSON* cameras, const char* path) {
+    char *json_str = cJSON_Print(cameras);
+    if (!json_str) {
+        ROC_ERROR(RLOG_CONFIG, "Failed to serialize JSON");
         return false;
     }
     
-    if (!check_python3_installation(data)) {
-        fprintf(stderr, "[FATAL] Python3 not working\n");
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        ROC_ERROR(RLOG_CONFIG, "Failed to create %s: %s", path, strerror(errno));
+        cJSON_free(json_str);
         return false;
     }
     
-    // Non-critical checks - warn but continue
-    check_wlan_connectivity(data);
-    check_kernel_modules(data);
+    fprintf(fp, "%s\n", json_str);
+    fclose(fp);
+    cJSON_free(json_str);
     
-    // Setup v4l2loopback
-    if (!install_v4l2loopback(data)) {
-        fprintf(stderr, "[FATAL] v4l2loopback setup failed\n");
-        return false;
+    // Set proper permissions (readable by owner and group)
+    chmod(path, 0640);
+    return true;
+}
+
+// Sweep the LAN for RTMP cameras and append the ones whose main stream plays
+// with the given credentials to `cameras`.
+// Returns the number of cameras added, or -1 if the subnet could not be swept.
+int discover_cameras(cJSON* cameras, const char* user, const char* password) {
+    lan_info_t lan;
+    if (check_LAN(&lan) != 0) {
+        ROC_ERROR(RLOG_NET, "No default route found");
+        return -1;
     }
     
-    // Verify camera config
-    if (!verify_camera_config(data)) {
-        fprintf(stderr, "[FATAL] Camera configuration invalid\n");
-        return false;
+    ROC_INFO(RLOG_NET, "Sweeping %s/%s on %s for port %d...",
+             lan.local_addr, lan.netmask, lan.ifname, DISCOVERY_PORT);
+    
+    lan_scan_host_t hosts[DISCOVERY_MAX_HOSTS];
+    size_t found = 0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int swept = lan_scan_subnet(&lan, DISCOVERY_PORT, DISCOVERY_CONNECT_TIMEOUT_MS,
+                                hosts, DISCOVERY_MAX_HOSTS, &found);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (swept < 0) {
+        ROC_ERROR(RLOG_NET, "Subnet %s/%s cannot be swept", lan.local_addr, lan.netmask);
+        return -1;
     }
+    long sweep_ms = (t1.tv_sec - t0.tv_sec) * 1000L + (t1.tv_nsec - t0.tv_nsec) / 1000000L;
+    ROC_INFO(RLOG_NET, "%d addresses swept in %ld ms, %zu with port %d open",
+             swept, sweep_ms, found, DISCOVERY_PORT);
     
-    printf("[INIT] All initialization checks passed!\n");
-    return true;
+    if (found == 0) return 0;
+    
+    size_t confirmed = lan_scan_confirm(hosts, found, DISCOVERY_PORT, user, password,
+                                        DISCOVERY_PROBE_TIMEOUT_MS);
+    ROC_INFO(RLOG_PROBE, "%zu RTMP device(s) confirmed", confirmed);
+    
+    int added = 0;
+    for (size_t i = 0; i < found; ++i) {
+        lan_scan_host_t *h = &hosts[i];
+        if (!h->rtmp) {
+            printf("  %-15s  port open, not RTMP\n", h->ip);
+            continue;
+        }
+        if (!h->stream_ok) {
+            // Cannot stream with these credentials; listed for information only
+            printf("  %-15s  RTMP server, credentials refused or no main stream (not added)\n", h->ip);
+            continue;
+        }
+        printf("  %-15s  camera, main stream %dx%d @ %.2ffps (%d ms connect)\n",
+               h->ip, h->width, h->height, h->fps, h->connect_ms);
+        if (cJSON_GetArraySize(cameras) >= MAX_CONFIG_CAMERAS) {
+            ROC_WARN(RLOG_CONFIG, "Camera limit (%d) reached, ignoring %s", MAX_CONFIG_CAMERAS, h->ip);
+            continue;
+        }
+        cJSON *camera = cJSON_CreateObject();
+        cJSON_AddStringToObject(camera, "ip", h->ip);
+        cJSON_AddStringToObject(camera, "user", user);
+        cJSON_AddStringToObject(camera, "password", password);
+        cJSON_AddItemToArray(cameras, camera);
+        added++;
+    }
+    return added;
+}
+
+// Non-interactive discovery: write a draft config for review
+int run_discovery_only(const char* user, const char* password) {
+    if (!ensure_config_dir()) return EXIT_FAILURE;
+    
+    cJSON *cameras = cJSON_CreateArray();
+    if (!cameras) {
+        ROC_ERROR(RLOG_CONFIG, "Failed to create JSON array");
+        return EXIT_FAILURE;
+    }
+    
+    int added = discover_cameras(cameras, user, password);
+    if (added <= 0) {
+        ROC_ERROR(RLOG_PROBE, "No cameras found, nothing written");
+        cJSON_Delete(cameras);
+        return EXIT_FAILURE;
+    }
+    
+    bool ok = write_camera_config(cameras, CAMERAS_DRAFT);
+    cJSON_Delete(cameras);
+    if (!ok) return EXIT_FAILURE;
+    
+    ROC_INFO(RLOG_CONFIG, "Draft with %d camera(s) written to %s", added, CAMERAS_DRAFT);
+    ROC_INFO(RLOG_CONFIG, "Review it, then move it to %s", CAMERAS_CONFIG);
+    return EXIT_SUCCESS;
 }
 
 bool create_camera_config_interactive() {
@@ -482,17 +769,13 @@ bool create_camera_config_interactive() {
     }
     
     // Create /etc/roc directory if it doesn't exist
-    if (access("/etc/roc", F_OK) != 0) {
-        if (mkdir("/etc/roc", 0755) != 0) {
-            fprintf(stderr, "[ERROR] Failed to create /etc/roc directory: %s\n", strerror(errno));
-            return false;
-        }
-        printf("[CONFIG] Created /etc/roc directory\n");
+    if (!ensure_config_dir()) {
+        return false;
     }
     
     cJSON *cameras = cJSON_CreateArray();
     if (!cameras) {
-        fprintf(stderr, "[ERROR] Failed to create JSON array\n");
+        ROC_ERROR(RLOG_CONFIG, "Failed to create JSON array");
         return false;
     }
     
@@ -500,10 +783,37 @@ bool create_camera_config_interactive() {
     printf("[CONFIG] ===============================\n");
     printf("[CONFIG] You have %d v4l2loopback devices available (video10-video25)\n", 
            g_state.init_data.v4l2_device_count);
-    printf("[CONFIG] Enter camera details (press Enter with empty IP to finish)\n\n");
     
     int camera_num = 0;
-    while (camera_num < 16) {
+    
+    // Offer a LAN sweep before manual entry
+    printf("[CONFIG] Scan the local network for cameras first? (y/n): ");
+    fflush(stdout);
+    if (fgets(response, sizeof(response), stdin) && (response[0] == 'y' || response[0] == 'Y')) {
+        char scan_user[64], scan_password[128];
+        printf("  Username for discovered cameras [admin]: ");
+        fflush(stdout);
+        if (!fgets(scan_user, sizeof(scan_user), stdin)) scan_user[0] = '\0';
+        scan_user[strcspn(scan_user, "\n")] = '\0';
+        if (strlen(scan_user) == 0) {
+            strcpy(scan_user, "admin");
+        }
+        printf("  Password for discovered cameras: ");
+        fflush(stdout);
+        if (!fgets(scan_password, sizeof(scan_password), stdin)) scan_password[0] = '\0';
+        scan_password[strcspn(scan_password, "\n")] = '\0';
+        
+        if (strlen(scan_password) == 0) {
+            fprintf(stderr, "  [ERROR] Password cannot be empty, skipping scan\n");
+        } else if (discover_cameras(cameras, scan_user, scan_password) > 0) {
+            camera_num = cJSON_GetArraySize(cameras);
+            printf("[CONFIG] %d camera(s) added from scan\n", camera_num);
+        }
+    }
+    
+    printf("[CONFIG] Enter camera details (press Enter with empty IP to finish)\n\n");
+    
+    while (camera_num < MAX_CONFIG_CAMERAS) {
         printf("[CONFIG] Camera %d:\n", camera_num + 1);
         
         char ip[128], user[64], password[128];
@@ -558,37 +868,20 @@ bool create_camera_config_interactive() {
     }
     
     if (camera_num == 0) {
-        fprintf(stderr, "[ERROR] No cameras configured\n");
+        ROC_ERROR(RLOG_CONFIG, "No cameras configured");
         cJSON_Delete(cameras);
         return false;
     }
     
     // Write to file
-    char *json_str = cJSON_Print(cameras);
-    if (!json_str) {
-        fprintf(stderr, "[ERROR] Failed to serialize JSON\n");
+    if (!write_camera_config(cameras, CAMERAS_CONFIG)) {
         cJSON_Delete(cameras);
         return false;
     }
     
-    FILE *fp = fopen(CAMERAS_CONFIG, "w");
-    if (!fp) {
-        fprintf(stderr, "[ERROR] Failed to create %s: %s\n", CAMERAS_CONFIG, strerror(errno));
-        cJSON_free(json_str);
-        cJSON_Delete(cameras);
-        return false;
-    }
-    
-    fprintf(fp, "%s\n", json_str);
-    fclose(fp);
-    
-    // Set proper permissions (readable by owner and group)
-    chmod(CAMERAS_CONFIG, 0640);
-    
     printf("\n[CONFIG] Configuration saved to %s\n", CAMERAS_CONFIG);
     printf("[CONFIG] %d camera(s) configured\n", camera_num);
     
-    cJSON_free(json_str);
     cJSON_Delete(cameras);
     
     return true;
@@ -600,62 +893,328 @@ bool create_camera_config_interactive() {
 
 void* network_monitor_daemon(void* arg) {
     Daemon* daemon = (Daemon*)arg;
-    printf("[DAEMON] Network monitor started\n");
+    ROC_INFO(RLOG_PROC, "Network monitor started");
+    int was_reachable = -1;
+    atomic_store(&g_metrics.daemon_running[DAEMON_NETWORK_MONITOR], 1);
     
     while (!is_shutdown_requested() && daemon->active) {
+        atomic_store(&g_metrics.daemon_heartbeat[DAEMON_NETWORK_MONITOR], (long long)time(NULL));
         // Periodically check network status
         lan_info_t lan_info;
         if (check_LAN(&lan_info) == 0) {
             if (!lan_info.reachable) {
-                printf("[WARN] LAN gateway not reachable\n");
+                ROC_WARN(RLOG_NET, "LAN gateway not reachable");
+            }
+            atomic_store(&g_metrics.gateway_reachable, lan_info.reachable != 0);
+            if (lan_info.reachable != was_reachable) {
+                ej_emit(EJ_REACH, EJ_NONE, EJ_NONE, 0, lan_info.reachable != 0, lan_info.reachable ? 0 : EHOSTUNREACH);
+                was_reachable = lan_info.reachable;
             }
         }
         
         sleep(30); // Check every 30 seconds
     }
     
-    printf("[DAEMON] Network monitor stopped\n");
+    atomic_store(&g_metrics.daemon_running[DAEMON_NETWORK_MONITOR], 0);
+    ROC_INFO(RLOG_PROC, "Network monitor stopped");
     return NULL;
 }
 
+// ============================================================================
+// VIDEOPIPE SUPERVISION
+// ============================================================================
+
+// The videopipe the camera health monitor looks after. Normally our child,
+// started with the write end of the daemon's from_daemon pipe, on which it
+// sends a byte every 2 s. A videopipe we did not start (one left running by
+// a previous main_controller, or a `videopipe --takeover` upgrade) is
+// watched through a pidfd instead of a second one being started.
+typedef struct {
+    pid_t pid;              // 0 when none is running
+    int pidfd;              // -1 without pidfd_open(); a child is then polled with waitpid()
+    bool adopted;           // Not our child: no exit status and no heartbeat
+    time_t started;
+    time_t last_beat;       // 0 until the first heartbeat
+    time_t term_sent;       // When it was sent SIGTERM, or 0
+    int short_runs;         // Runs in a row shorter than VIDEOPIPE_STABLE_SEC
+    long long next_start_ms;
+    unsigned long long starts;
+} VideopipeChild;
+
+static long long monotonic_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// videopipe next to our own executable, so the working directory does not
+// matter. False if our path cannot be read or videopipe's does not fit.
+static bool videopipe_path(char* buf, size_t len) {
+    char self[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (n <= 0) return false;
+    self[n] = '\0';
+    char* slash = strrchr(self, '/');
+    if (!slash) return false;
+    *slash = '\0';
+    int w = snprintf(buf, len, "%s/videopipe", self);
+    return w >= 0 && (size_t)w < len;
+}
+
+// A running videopipe other than `except`, or 0. Zombies, e.g. one
+// that exited under a parent that has not reaped it yet, do not count.
+static pid_t find_videopipe(pid_t except) {
+    DIR* dir = opendir("/proc");
+    if (!dir) return 0;
+    pid_t found = 0;
+    struct dirent* de;
+    while (!found && (de = readdir(dir)) != NULL) {
+        if (!isdigit((unsigned char)de->d_name[0])) continue;
+        pid_t pid = (pid_t)atoi(de->d_name);
+        if (pid == except || pid == getpid()) continue;
+        char path[64], line[128] = {0};
+        snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+        FILE* fp = fopen(path, "r");
+        if (!fp) continue;
+        // "<pid> (<comm>) <state> ..."
+        if (fgets(line, sizeof(line), fp) && strstr(line, " (videopipe) ") && !strstr(line, " (videopipe) Z"))
+            found = pid;
+        fclose(fp);
+    }
+    closedir(dir);
+    return found;
+}
+
+// Watch a videopipe someone else started; false if there is none
+static bool adopt_videopipe(VideopipeChild* vp, pid_t except) {
+    pid_t pid = find_videopipe(except);
+    if (pid <= 0) return false;
+    int fd = open_pidfd(pid);
+    if (fd < 0) {
+        ROC_WARN(RLOG_PROC, "videopipe pid=%d is running but cannot be watched: %s", (int)pid, strerror(errno));
+        return false;
+    }
+    vp->pid = pid;
+    vp->pidfd = fd;
+    vp->adopted = true;
+    vp->started = time(NULL);
+    vp->last_beat = 0;
+    vp->term_sent = 0;
+    atomic_store(&g_metrics.videopipe_running, 1);
+    atomic_store(&g_metrics.videopipe_heartbeat, 0);
+    ROC_INFO(RLOG_PROC, "Watching videopipe pid=%d, which main_controller did not start", (int)pid);
+    return true;
+}
+
+static bool start_videopipe(VideopipeChild* vp, Daemon* daemon, const char* path) {
+    TRACE_SPAN(span, "proc", "start_videopipe");
+    // Everything is prepared before fork: the child only redirects and execs
+    char fdarg[16];
+    snprintf(fdarg, sizeof(fdarg), "%d", VIDEOPIPE_HEARTBEAT_FD);
+    char* const argv[] = { (char*)path, "--heartbeat-fd", fdarg, NULL };
+    int beat_fd = daemon->from_daemon.write_fd;
+    pid_t pid = fork();
+    if (pid < 0) {
+        ROC_ERROR(RLOG_PROC, "Failed to start videopipe: fork: %s", strerror(errno));
+        return false;
+    }
+    if (pid == 0) {
+        // dup2() clears close-on-exec on the copy; a descriptor already in
+        // place keeps it and is cleared by hand
+        if (beat_fd == VIDEOPIPE_HEARTBEAT_FD) fcntl(beat_fd, F_SETFD, 0);
+        else dup2(beat_fd, VIDEOPIPE_HEARTBEAT_FD);
+        execv(path, argv);
+        static const char msg[] = "main_controller: exec videopipe failed\n";
+        ssize_t w = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+        (void)w;
+        _exit(127);
+    }
+    vp->pid = pid;
+    vp->pidfd = open_pidfd(pid);
+    vp->adopted = false;
+    vp->started = time(NULL);
+    vp->last_beat = 0;
+    vp->term_sent = 0;
+    if (vp->starts++ > 0) atomic_fetch_add(&g_metrics.videopipe_restarts, 1);
+    atomic_store(&g_metrics.videopipe_running, 1);
+    atomic_store(&g_metrics.videopipe_heartbeat, 0);
+    ej_emit(EJ_SPAWN, EJ_NONE, EJ_NONE, (int)pid, 0, 0);
+    ROC_INFO(RLOG_PROC, "Started videopipe pid=%d (%s)", (int)pid, path);
+    return true;
+}
+
+// Whether videopipe has exited; status is its wait status, or -1 if adopted
+static bool videopipe_exited(VideopipeChild* vp, int* status) {
+    *status = -1;
+    if (vp->adopted) {
+        struct pollfd pfd = { .fd = vp->pidfd, .events = POLLIN };
+        return poll(&pfd, 1, 0) > 0;
+    }
+    return waitpid(vp->pid, status, WNOHANG) == vp->pid;
+}
+
+static void handle_videopipe_exit(VideopipeChild* vp, int status) {
+    time_t ran = time(NULL) - vp->started;
+    pid_t pid = vp->pid;
+    if (vp->adopted)
+        ROC_WARN(RLOG_PROC, "videopipe pid=%d exited", (int)pid);
+    else if (WIFSIGNALED(status))
+        ROC_ERROR(RLOG_PROC, "videopipe pid=%d killed by signal %d after %lds", (int)pid, WTERMSIG(status), (long)ran);
+    else
+        ROC_WARN(RLOG_PROC, "videopipe pid=%d exited with status %d after %lds", (int)pid, WEXITSTATUS(status), (long)ran);
+    ej_emit(EJ_EXIT, EJ_NONE, EJ_NONE, (int)pid, status, (int32_t)ran);
+    if (vp->pidfd >= 0) close(vp->pidfd);
+    vp->pidfd = -1;
+    vp->pid = 0;
+    atomic_store(&g_metrics.videopipe_running, 0);
+    
+    bool clean = !vp->adopted && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    // A clean exit is a handover (--takeover) or a SIGHUP restart; the new
+    // videopipe, if there is one, carries on
+    if (clean && adopt_videopipe(vp, pid)) return;
+    if (clean || ran >= VIDEOPIPE_STABLE_SEC) vp->short_runs = 0;
+    else vp->short_runs++;
+    long long delay = 0;
+    if (vp->short_runs > 0) {
+        delay = VIDEOPIPE_BACKOFF_MIN_MS;
+        for (int i = 1; i < vp->short_runs && delay < VIDEOPIPE_BACKOFF_MAX_MS; i++) delay *= 2;
+        if (delay > VIDEOPIPE_BACKOFF_MAX_MS) delay = VIDEOPIPE_BACKOFF_MAX_MS;
+        ROC_WARN(RLOG_PROC, "Restarting videopipe in %lld ms (%d short runs in a row)", delay, vp->short_runs);
+    }
+    vp->next_start_ms = monotonic_ms() + delay;
+}
+
+// Restart a videopipe that has stopped beating: SIGTERM, then SIGKILL
+static void check_videopipe_heartbeat(VideopipeChild* vp, time_t now) {
+    if (vp->adopted) return;
+    if (vp->term_sent) {
+        if (now - vp->term_sent >= VIDEOPIPE_STOP_TIMEOUT_SEC) {
+            ROC_ERROR(RLOG_PROC, "videopipe pid=%d ignored SIGTERM; killing it", (int)vp->pid);
+            kill(vp->pid, SIGKILL);
+            vp->term_sent = now;
+        }
+        return;
+    }
+    time_t silent = now - (vp->last_beat ? vp->last_beat : vp->started);
+    if (silent < (vp->last_beat ? VIDEOPIPE_HEARTBEAT_TIMEOUT_SEC : VIDEOPIPE_START_GRACE_SEC)) return;
+    ROC_ERROR(RLOG_HEALTH, "videopipe pid=%d sent no heartbeat for %lds; restarting it", (int)vp->pid, (long)silent);
+    kill(vp->pid, SIGTERM);
+    vp->term_sent = now;
+}
+
+static void stop_videopipe(VideopipeChild* vp) {
+    if (vp->pid <= 0) return;
+    ROC_INFO(RLOG_PROC, "Terminating videopipe pid=%d", (int)vp->pid);
+    kill(vp->pid, SIGTERM);
+    int status;
+    bool exited = false;
+    for (int t = 0; t < VIDEOPIPE_STOP_TIMEOUT_SEC * 10 && !(exited = videopipe_exited(vp, &status)); t++)
+        usleep(100000);
+    if (!exited) {
+        ROC_WARN(RLOG_PROC, "videopipe pid=%d did not stop; killing it", (int)vp->pid);
+        kill(vp->pid, SIGKILL);
+        if (!vp->adopted) waitpid(vp->pid, &status, 0);
+    }
+    if (vp->pidfd >= 0) close(vp->pidfd);
+    vp->pidfd = -1;
+    vp->pid = 0;
+    atomic_store(&g_metrics.videopipe_running, 0);
+}
+
 void* camera_health_daemon(void* arg) {
     Daemon* daemon = (Daemon*)arg;
-    printf("[DAEMON] Camera health monitor started\n");
+    ROC_INFO(RLOG_PROC, "Camera health monitor started");
+    trace_thread_name("camera_health");
     
-    const char *videopipe_path = "./bin/videopipe";
+    char path[PATH_MAX];
+    if (!videopipe_path(path, sizeof(path))) {
+        ROC_WARN(RLOG_PROC, "Cannot locate videopipe next to main_controller, using ./bin/videopipe");
+        snprintf(path, sizeof(path), "./bin/videopipe");
+    }
+    int beat_fd = daemon->from_daemon.read_fd;
+    fcntl(beat_fd, F_SETFL, fcntl(beat_fd, F_GETFL) | O_NONBLOCK);
+    atomic_store(&g_metrics.daemon_running[DAEMON_CAMERA_STREAMER], 1);
     
+    VideopipeChild vp = { .pidfd = -1 };
     while (!is_shutdown_requested() && daemon->active) {
-        // Check if videopipe is running
-        if (system("pgrep -x videopipe >/dev/null 2>&1") != 0) {
-            printf("[WARN] videopipe not running, attempting restart\n");
-            char cmd[256];
-            snprintf(cmd, sizeof(cmd), "%s &", videopipe_path);
-            printf("[DEBUG] Executing: %s\n", cmd);
-            int ret = system(cmd);
-            if (ret != 0) {
-                printf("[ERROR] Failed to restart videopipe (return code %d)\n", ret);
-            } else {
-                printf("[INFO] Restarted videopipe\n");
+        atomic_store(&g_metrics.daemon_heartbeat[DAEMON_CAMERA_STREAMER], (long long)time(NULL));
+        if (vp.pid <= 0 && monotonic_ms() >= vp.next_start_ms && !adopt_videopipe(&vp, 0) &&
+            !start_videopipe(&vp, daemon, path))
+            vp.next_start_ms = monotonic_ms() + VIDEOPIPE_BACKOFF_MAX_MS;
+        
+        // Wake for a heartbeat, the exit, or once a second
+        struct pollfd pfd[2] = { { .fd = beat_fd, .events = POLLIN }, { .fd = vp.pidfd, .events = POLLIN } };
+        poll(pfd, vp.pid > 0 && vp.pidfd >= 0 ? 2 : 1, 1000);
+        time_t now = time(NULL);
+        if (pfd[0].revents & POLLIN) {
+            char buf[64];
+            while (read(beat_fd, buf, sizeof(buf)) > 0) {}
+            if (vp.pid > 0 && !vp.adopted) {
+                vp.last_beat = now;
+                atomic_store(&g_metrics.videopipe_heartbeat, (long long)now);
             }
-        } else {
-            printf("[INFO] videopipe is running\n");
-            // Check videopipe log for errors
-            char log_cmd[256];
-            snprintf(log_cmd, sizeof(log_cmd), "tail -n 5 /var/log/videopipe.log 2>/dev/null");
-            printf("[DEBUG] Checking videopipe log: %s\n", log_cmd);
-            system(log_cmd);
         }
-        
-        sleep(60); // Check every minute
+        if (vp.pid <= 0) continue;
+        int status;
+        if (videopipe_exited(&vp, &status)) handle_videopipe_exit(&vp, status);
+        else check_videopipe_heartbeat(&vp, now);
     }
     
-    printf("[DAEMON] Camera health monitor stopped\n");
-    // Ensure videopipe is terminated
-    printf("[DEBUG] Terminating videopipe\n");
-    system("pkill -x videopipe >/dev/null 2>&1");
+    atomic_store(&g_metrics.daemon_running[DAEMON_CAMERA_STREAMER], 0);
+    stop_videopipe(&vp);
+    ROC_INFO(RLOG_PROC, "Camera health monitor stopped");
     return NULL;
 }
 
+// ============================================================================
+// METRICS
+// ============================================================================
+
+static const char *PHASE_NAMES[] = { "initialization", "running", "cleanup", "error" };
+static const char *DAEMON_NAMES[] = { "network_monitor", "camera_streamer", "system_health" };
+
+// Runs on the metrics thread: loads g_metrics only
+void render_main_metrics(metrics_buf_t *out, void *arg) {
+    (void)arg;
+    time_t now = time(NULL);
+    int phase = atomic_load(&g_metrics.phase);
+    metrics_family(out, "roc_main_start_time_seconds", "gauge", "Unix time main_controller started");
+    metrics_printf(out, "roc_main_start_time_seconds %lld\n", (long long)g_metrics.start_time);
+    metrics_family(out, "roc_main_phase", "gauge", "1 for the phase main_controller is in");
+    for (int p = 0; p < (int)(sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0])); p++)
+        metrics_printf(out, "roc_main_phase{phase=\"%s\"} %d\n", PHASE_NAMES[p], phase == p);
+    metrics_family(out, "roc_daemon_up", "gauge", "1 while the daemon thread is running");
+    for (int d = 0; d < (int)(sizeof(DAEMON_NAMES) / sizeof(DAEMON_NAMES[0])); d++)
+        metrics_printf(out, "roc_daemon_up{daemon=\"%s\"} %d\n", DAEMON_NAMES[d], atomic_load(&g_metrics.daemon_running[d]));
+    metrics_family(out, "roc_daemon_heartbeat_age_seconds", "gauge", "Time since the daemon last went through its loop");
+    for (int d = 0; d < (int)(sizeof(DAEMON_NAMES) / sizeof(DAEMON_NAMES[0])); d++) {
+        long long beat = atomic_load(&g_metrics.daemon_heartbeat[d]);
+        if (beat > 0 && atomic_load(&g_metrics.daemon_running[d]))
+            metrics_printf(out, "roc_daemon_heartbeat_age_seconds{daemon=\"%s\"} %lld\n", DAEMON_NAMES[d], (long long)now - beat);
+    }
+    int gateway = atomic_load(&g_metrics.gateway_reachable);
+    metrics_family(out, "roc_gateway_reachable", "gauge", "Result of the last LAN gateway check");
+    if (gateway >= 0) metrics_printf(out, "roc_gateway_reachable %d\n", gateway);
+    int videopipe = atomic_load(&g_metrics.videopipe_running);
+    metrics_family(out, "roc_videopipe_up", "gauge", "1 while the supervised videopipe is running");
+    if (videopipe >= 0) metrics_printf(out, "roc_videopipe_up %d\n", videopipe);
+    long long beat = atomic_load(&g_metrics.videopipe_heartbeat);
+    metrics_family(out, "roc_videopipe_heartbeat_age_seconds", "gauge", "Time since videopipe last sent a heartbeat");
+    if (videopipe > 0 && beat > 0) metrics_printf(out, "roc_videopipe_heartbeat_age_seconds %lld\n", (long long)now - beat);
+    metrics_family(out, "roc_videopipe_restarts_total", "counter", "videopipe restarts by the camera health monitor");
+    metrics_printf(out, "roc_videopipe_restarts_total %llu\n", atomic_load(&g_metrics.videopipe_restarts));
+}
+
 // ============================================================================
 // DAEMON MANAGEMENT
 // ============================================================================
@@ -664,7 +1223,7 @@ bool spawn_daemon(DaemonType type, void* (*daemon_func)(void*)) {
     pthread_mutex_lock(&g_state.daemon_mutex);
     
     if (g_state.daemon_count >= MAX_DAEMONS) {
-        fprintf(stderr, "[ERROR] Maximum daemon count reached\n");
+        ROC_ERROR(RLOG_PROC, "Maximum daemon count reached");
         pthread_mutex_unlock(&g_state.daemon_mutex);
         return false;
     }
@@ -678,13 +1237,13 @@ bool spawn_daemon(DaemonType type, void* (*daemon_func)(void*)) {
     
     if (!create_pipe_pair(&daemon->to_daemon) || 
         !create_pipe_pair(&daemon->from_daemon)) {
-        fprintf(stderr, "[ERROR] Failed to create pipes for daemon\n");
+        ROC_ERROR(RLOG_PROC, "Failed to create pipes for daemon");
         pthread_mutex_unlock(&g_state.daemon_mutex);
         return false;
     }
     
     if (pthread_create(&daemon->thread, NULL, daemon_func, daemon) != 0) {
-        fprintf(stderr, "[ERROR] Failed to spawn daemon thread\n");
+        ROC_ERROR(RLOG_PROC, "Failed to spawn daemon thread");
         close_pipe_pair(&daemon->to_daemon);
         close_pipe_pair(&daemon->from_daemon);
         pthread_mutex_unlock(&g_state.daemon_mutex);
@@ -694,12 +1253,12 @@ bool spawn_daemon(DaemonType type, void* (*daemon_func)(void*)) {
     g_state.daemon_count++;
     pthread_mutex_unlock(&g_state.daemon_mutex);
     
-    printf("[MAIN] Spawned daemon type %d\n", type);
+    ROC_INFO(RLOG_PROC, "Spawned daemon type %d", type);
     return true;
 }
 
 void stop_all_daemons() {
-    printf("\n[MAIN] Stopping all daemons...\n");
+    ROC_INFO(RLOG_MAIN, "Stopping all daemons...");
     
     pthread_mutex_lock(&g_state.daemon_mutex);
     
@@ -714,7 +1273,7 @@ void stop_all_daemons() {
         close_pipe_pair(&g_state.daemons[i].to_daemon);
         close_pipe_pair(&g_state.daemons[i].from_daemon);
         pthread_mutex_destroy(&g_state.daemons[i].mutex);
-        printf("[MAIN] Daemon %d stopped and cleaned up\n", i);
+        ROC_INFO(RLOG_MAIN, "Daemon %d stopped and cleaned up", i);
     }
     
     g_state.daemon_count = 0;
@@ -725,7 +1284,8 @@ void stop_all_daemons() {
 // ============================================================================
 
 bool spawn_all_daemons() {
-    printf("\n[MAIN] Spawning daemons...\n");
+    ROC_INFO(RLOG_MAIN, "Spawning daemons...");
+    TRACE_SPAN(span, "main", "spawn_all_daemons");
     
     if (!spawn_daemon(DAEMON_NETWORK_MONITOR, network_monitor_daemon)) return false;
     if (!spawn_daemon(DAEMON_CAMERA_STREAMER, camera_health_daemon)) return false;
@@ -738,19 +1298,23 @@ bool run_main_loop() {
     set_phase(PHASE_RUNNING);
     
     if (!spawn_all_daemons()) {
-        fprintf(stderr, "[ERROR] Failed to spawn daemons\n");
+        ROC_ERROR(RLOG_MAIN, "Failed to spawn daemons");
         return false;
     }
     
-    printf("[MAIN] Entering main processing loop\n");
-    printf("[MAIN] System is running. Press Ctrl+C to shut down.\n");
+    ROC_INFO(RLOG_MAIN, "Entering main processing loop");
+    ROC_INFO(RLOG_MAIN, "System is running. Press Ctrl+C to shut down.");
     
     while (!is_shutdown_requested()) {
         // Main loop - monitor daemons and handle events
+        if (g_reload_log_levels) {
+            g_reload_log_levels = 0;
+            configure_log_levels();
+        }
         usleep(100000); // 100ms
     }
     
-    printf("[MAIN] Exiting main processing loop\n");
+    ROC_INFO(RLOG_MAIN, "Exiting main processing loop");
     return true;
 }
 
@@ -762,17 +1326,17 @@ void run_cleanup_phase() {
     printf("\n=== CLEANUP PHASE ===\n");
     set_phase(PHASE_CLEANUP);
     
+    // The camera health monitor stops the videopipe it supervises
     stop_all_daemons();
     
-    // Stop videopipe if running
-    printf("[CLEANUP] Stopping videopipe...\n");
-    system("pkill -TERM videopipe 2>/dev/null");
-    
     pthread_mutex_destroy(&g_state.phase_mutex);
     pthread_mutex_destroy(&g_state.shutdown_mutex);
     pthread_mutex_destroy(&g_state.daemon_mutex);
     
-    printf("[CLEANUP] All cleanup completed\n");
+    metrics_stop();
+    ROC_INFO(RLOG_MAIN, "All cleanup completed");
+    trace_close();
+    ej_close();
 }
 
 // ============================================================================
@@ -790,6 +1354,39 @@ int main(int argc, char* argv[]) {
         fprintf(stderr, "Please run with: sudo %s\n", argv[0]);
         return 1;
     }
+    configure_log_levels();
+    
+    // Command line: --discover writes a draft camera config and exits
+    bool discover_only = false;
+    const char *discover_user = "admin";
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--discover") == 0) {
+            discover_only = true;
+        } else if (strcmp(argv[i], "--user") == 0 && i + 1 < argc) {
+            discover_user = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--discover [--user NAME]]\n", argv[0]);
+            fprintf(stderr, "The camera password is read from $%s or, without it, from stdin\n",
+                    DISCOVERY_PASSWORD_ENV);
+            return 1;
+        }
+    }
+    if (discover_only) {
+        // Never from argv: the command line is readable by every local user
+        char discover_password[128] = "";
+        const char *env = getenv(DISCOVERY_PASSWORD_ENV);
+        if (env) {
+            snprintf(discover_password, sizeof(discover_password), "%s", env);
+        } else {
+            if (isatty(STDIN_FILENO)) {
+                printf("Password for discovered cameras: ");
+                fflush(stdout);
+            }
+            if (!fgets(discover_password, sizeof(discover_password), stdin)) discover_password[0] = '\0';
+            discover_password[strcspn(discover_password, "\n")] = '\0';
+        }
+        return run_discovery_only(discover_user, discover_password);
+    }
     
     // Initialize global state
     memset(&g_state, 0, sizeof(GlobalState));
@@ -802,12 +1399,21 @@ int main(int argc, char* argv[]) {
     pthread_mutex_init(&g_state.daemon_mutex, NULL);
     
     setup_signal_handlers();
+    if (ej_open(JOURNAL_DIR "/main_controller.ej", EJ_SRC_MAIN, EJ_DEFAULT_CAPACITY) != 0)
+        ROC_WARN(RLOG_MAIN, "Cannot open event journal in %s: %s", JOURNAL_DIR, strerror(errno));
+    if (trace_open("main_controller") != 0)
+        ROC_WARN(RLOG_MAIN, "Cannot write traces to %s: %s", getenv(TRACE_ENV), strerror(errno));
+    g_metrics.start_time = time(NULL);
+    atomic_store(&g_metrics.gateway_reachable, -1);
+    atomic_store(&g_metrics.videopipe_running, -1);
+    if (metrics_start(METRICS_ADDR, METRICS_PORT_MAIN, render_main_metrics, NULL) != 0)
+        ROC_WARN(RLOG_MAIN, "Cannot serve metrics on %s:%d: %s", METRICS_ADDR, METRICS_PORT_MAIN, strerror(errno));
     
     int exit_code = EXIT_SUCCESS;
     
     // PHASE 1: INITIALIZATION
     if (!run_initialization_phase()) {
-        fprintf(stderr, "\n[FATAL] Initialization failed\n");
+        ROC_ERROR(RLOG_MAIN, "Initialization failed");
         set_phase(PHASE_ERROR);
         exit_code = EXIT_FAILURE;
         goto cleanup;
@@ -815,7 +1421,7 @@ int main(int argc, char* argv[]) {
     
     // PHASE 2: RUNNING
     if (!run_main_loop()) {
-        fprintf(stderr, "\n[ERROR] Main loop encountered an error\n");
+        ROC_ERROR(RLOG_MAIN, "Main loop encountered an error");
         set_phase(PHASE_ERROR);
         exit_code = EXIT_FAILURE;
     }
@@ -0,0 +1,342 @@
+/*
+ * metrics.c
+ * --------------------------------------------
+ * Embedded HTTP endpoint for Prometheus scrapes.
+ *
+ * One thread owns an epoll instance with the listening socket, a stop
+ * pipe and up to METRICS_MAX_CLIENTS connections. All sockets are
+ * non-blocking. A connection is read until the end of its request
+ * headers, answered with one rendered response and closed, which is how
+ * Prometheus scrapes anyway. Connections that stall are dropped after
+ * CLIENT_TIMEOUT_MS, so a stuck client cannot hold a slot.
+ */
+
+#define _GNU_SOURCE
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#define METRICS_MAX_CLIENTS 8
+#define REQUEST_MAX         2048
+#define CLIENT_TIMEOUT_MS   5000
+#define TAG_LISTEN          0xffffffffu
+#define TAG_STOP            0xfffffffeu
+
+struct client {
+    int fd;                 /* -1 when the slot is free          */
+    char req[REQUEST_MAX];
+    size_t rlen;
+    char *resp;             /* NULL while the request is read    */
+    size_t rsize;
+    size_t sent;
+    uint64_t deadline;
+};
+
+static struct client clients[METRICS_MAX_CLIENTS];
+static metrics_render_fn render_fn = NULL;
+static void *render_arg = NULL;
+static int listen_fd = -1;
+static int epfd = -1;
+static int stop_pipe[2] = { -1, -1 };
+static pthread_t metrics_thread;
+static int running = 0;
+
+/* -------------------------------------------------------------------------- */
+static uint64_t mono_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void drop(struct client *c)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->resp);
+    c->fd = -1;
+    c->resp = NULL;
+}
+
+static void respond(struct client *c, const char *status, const char *extra_headers, const char *body, size_t blen)
+{
+    char head[256];
+    int hlen = snprintf(head, sizeof(head),
+                        "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                        "Content-Length: %zu\r\n%sConnection: close\r\n\r\n", status, blen, extra_headers);
+    c->resp = malloc((size_t)hlen + blen);
+    if (!c->resp) return;
+    memcpy(c->resp, head, (size_t)hlen);
+    if (blen) memcpy(c->resp + hlen, body, blen);
+    c->rsize = (size_t)hlen + blen;
+    c->sent = 0;
+}
+
+/* Request headers are complete: decide on the response */
+static void answer(struct client *c)
+{
+    char method[8], path[64];
+    c->req[c->rlen] = '\0';
+    if (sscanf(c->req, "%7s %63s", method, path) != 2) {
+        respond(c, "400 Bad Request", "", "bad request\n", 12);
+        return;
+    }
+    char *query = strchr(path, '?');
+    if (query) *query = '\0';
+    if (strcmp(method, "GET") != 0) {
+        respond(c, "405 Method Not Allowed", "Allow: GET\r\n", "method not allowed\n", 19);
+        return;
+    }
+    if (strcmp(path, "/metrics") != 0) {
+        respond(c, "404 Not Found", "", "try /metrics\n", 13);
+        return;
+    }
+    metrics_buf_t out = { 0 };
+    render_fn(&out, render_arg);
+    if (out.failed) respond(c, "500 Internal Server Error", "", "out of memory\n", 14);
+    else respond(c, "200 OK", "", out.data ? out.data : "", out.len);
+    free(out.data);
+}
+
+/* Returns 0 while the connection stays open */
+static int on_readable(struct client *c)
+{
+    for (;;) {
+        ssize_t n = read(c->fd, c->req + c->rlen, sizeof(c->req) - 1 - c->rlen);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        if (n <= 0) return -1;
+        c->rlen += (size_t)n;
+        c->req[c->rlen] = '\0';
+        if (strstr(c->req, "\r\n\r\n") || strstr(c->req, "\n\n")) break;
+        if (c->rlen == sizeof(c->req) - 1) {
+            respond(c, "431 Request Header Fields Too Large", "", "request too large\n", 18);
+            return c->resp ? 1 : -1;
+        }
+    }
+    answer(c);
+    return c->resp ? 1 : -1;
+}
+
+/* Returns 0 while output is pending, 1 when done, -1 on error */
+static int on_writable(struct client *c)
+{
+    while (c->sent < c->rsize) {
+        ssize_t n = send(c->fd, c->resp + c->sent, c->rsize - c->sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        if (n < 0) return -1;
+        c->sent += (size_t)n;
+    }
+    return 1;
+}
+
+static void on_client(struct client *c, uint32_t events)
+{
+    if (events & (EPOLLERR | EPOLLHUP) && !(events & EPOLLIN)) {
+        drop(c);
+        return;
+    }
+    if (!c->resp) {
+        int rc = on_readable(c);
+        if (rc < 0) {
+            drop(c);
+            return;
+        }
+        if (rc == 0) return;
+    }
+    int rc = on_writable(c);
+    if (rc != 0) {
+        drop(c);
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLOUT, .data.u32 = (uint32_t)(c - clients) };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void on_accept(void)
+{
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        size_t slot = 0;
+        while (slot < METRICS_MAX_CLIENTS && clients[slot].fd >= 0) slot++;
+        if (slot == METRICS_MAX_CLIENTS) {
+            close(fd);
+            continue;
+        }
+        struct client *c = &clients[slot];
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)slot };
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->rlen = 0;
+        c->resp = NULL;
+        c->deadline = mono_ms() + CLIENT_TIMEOUT_MS;
+    }
+}
+
+static void *metrics_main(void *arg)
+{
+    (void)arg;
+    struct epoll_event evs[METRICS_MAX_CLIENTS + 2];
+    for (;;) {
+        int n = epoll_wait(epfd, evs, (int)(sizeof(evs) / sizeof(evs[0])), 1000);
+        if (n < 0 && errno != EINTR) break;
+        for (int k = 0; k < n; ++k) {
+            uint32_t tag = evs[k].data.u32;
+            if (tag == TAG_STOP) return NULL;
+            if (tag == TAG_LISTEN) on_accept();
+            else if (tag < METRICS_MAX_CLIENTS && clients[tag].fd >= 0) on_client(&clients[tag], evs[k].events);
+        }
+        uint64_t now = mono_ms();
+        for (size_t i = 0; i < METRICS_MAX_CLIENTS; ++i)
+            if (clients[i].fd >= 0 && now > clients[i].deadline) drop(&clients[i]);
+    }
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+int metrics_start(const char *addr, int port, metrics_render_fn render, void *arg)
+{
+    if (running) return 0;
+    int err, one = 1;
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    if (!render || port <= 0 || port > 65535 || inet_pton(AF_INET, addr, &sa.sin_addr) != 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (size_t i = 0; i < METRICS_MAX_CLIENTS; ++i) {
+        clients[i].fd = -1;
+        clients[i].resp = NULL;
+    }
+    render_fn = render;
+    render_arg = arg;
+
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (listen_fd < 0 || epfd < 0 || pipe2(stop_pipe, O_CLOEXEC) != 0 ||
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        bind(listen_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(listen_fd, 16) != 0)
+        goto fail;
+    struct epoll_event lev = { .events = EPOLLIN, .data.u32 = TAG_LISTEN };
+    struct epoll_event sev = { .events = EPOLLIN, .data.u32 = TAG_STOP };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &lev) != 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, stop_pipe[0], &sev) != 0)
+        goto fail;
+    err = pthread_create(&metrics_thread, NULL, metrics_main, NULL);
+    if (err != 0) {
+        errno = err;
+        goto fail;
+    }
+    running = 1;
+    return 0;
+
+fail:
+    err = errno;
+    if (listen_fd >= 0) close(listen_fd);
+    if (epfd >= 0) close(epfd);
+    if (stop_pipe[0] >= 0) close(stop_pipe[0]);
+    if (stop_pipe[1] >= 0) close(stop_pipe[1]);
+    listen_fd = epfd = stop_pipe[0] = stop_pipe[1] = -1;
+    errno = err;
+    return -1;
+}
+
+void metrics_stop(void)
+{
+    if (!running) return;
+    ssize_t w = write(stop_pipe[1], "x", 1);
+    (void)w;
+    pthread_join(metrics_thread, NULL);
+    running = 0;
+    for (size_t i = 0; i < METRICS_MAX_CLIENTS; ++i)
+        if (clients[i].fd >= 0) drop(&clients[i]);
+    close(listen_fd);
+    close(epfd);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    listen_fd = epfd = stop_pipe[0] = stop_pipe[1] = -1;
+}
+
+/* -------------------------------------------------------------------------- */
+void metrics_hist_init(metrics_hist_t *h, const uint64_t *bounds, size_t n)
+{
+    memset(h, 0, sizeof(*h));
+    h->nbounds = n < METRICS_HIST_BUCKETS ? n : METRICS_HIST_BUCKETS;
+    memcpy(h->bound, bounds, h->nbounds * sizeof(bounds[0]));
+}
+
+void metrics_hist_observe(metrics_hist_t *h, uint64_t value)
+{
+    size_t b = 0;
+    while (b < h->nbounds && value > h->bound[b]) b++;
+    atomic_fetch_add_explicit(&h->bucket[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, value, memory_order_relaxed);
+}
+
+void metrics_printf(metrics_buf_t *out, const char *fmt, ...)
+{
+    if (out->failed) return;
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(out->data ? out->data + out->len : NULL, out->cap - out->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) {
+            out->failed = 1;
+            return;
+        }
+        if ((size_t)n < out->cap - out->len) {
+            out->len += (size_t)n;
+            return;
+        }
+        size_t cap = out->cap ? out->cap * 2 : 16 * 1024;
+        while (cap - out->len <= (size_t)n) cap *= 2;
+        char *grown = realloc(out->data, cap);
+        if (!grown) {
+            out->failed = 1;
+            return;
+        }
+        out->data = grown;
+        out->cap = cap;
+    }
+}
+
+void metrics_family(metrics_buf_t *out, const char *name, const char *type, const char *help)
+{
+    metrics_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metrics_hist(metrics_buf_t *out, const char *name, const char *labels, const metrics_hist_t *h, double scale)
+{
+    const char *sep = labels[0] ? "," : "";
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b <= h->nbounds; ++b) {
+        cumulative += atomic_load_explicit(&h->bucket[b], memory_order_relaxed);
+        if (b < h->nbounds)
+            metrics_printf(out, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, sep, h->bound[b] / scale,
+                           (unsigned long long)cumulative);
+        else
+            metrics_printf(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long)cumulative);
+    }
+    /* Buckets, sum and count are read separately; a scrape racing an
+     * observation may be off by one, which Prometheus tolerates */
+    uint64_t sum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+    metrics_printf(out, "%s_sum%s%s%s %.9g\n", name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "", sum / scale);
+    metrics_printf(out, "%s_count%s%s%s %llu\n", name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "",
+                   (unsigned long long)cumulative);
+}
@@ -0,0 +1,121 @@
+/*
+ * multi_match.c
+ * --------------------------------------------
+ * Aho-Corasick automaton over case-folded character classes.
+ *
+ * Class 0 stands for every byte that occurs in no pattern. The other
+ * classes are the distinct lower-case bytes of the patterns. The trie is
+ * built first. A breadth-first pass then fills every missing transition
+ * from the failure state and merges each state's output mask with that of
+ * its failure state.
+ */
+
+#include "multi_match.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+struct mmatch {
+    uint8_t cls[256];      /* Byte -> character class                    */
+    size_t nclass;         /* Number of classes, including class 0       */
+    size_t nstates;
+    int32_t *next;         /* nstates x nclass transitions               */
+    uint64_t *out;         /* Patterns that end in (or below) each state */
+};
+
+/* -------------------------------------------------------------------------- */
+mmatch_t *mmatch_compile(const char *const *patterns, size_t count)
+{
+    if (!patterns || count == 0 || count > MMATCH_MAX_PATTERNS) return NULL;
+    mmatch_t *m = calloc(1, sizeof(*m));
+    if (!m) return NULL;
+
+    size_t total = 1;
+    m->nclass = 1;
+    for (size_t k = 0; k < count; ++k) {
+        if (!patterns[k] || !patterns[k][0]) {
+            free(m);
+            return NULL;
+        }
+        for (const unsigned char *p = (const unsigned char *)patterns[k]; *p; ++p, ++total) {
+            unsigned char c = (unsigned char)tolower(*p);
+            if (!m->cls[c]) m->cls[c] = (uint8_t)m->nclass++;
+        }
+    }
+    for (int c = 0; c < 256; ++c)
+        m->cls[c] = m->cls[(unsigned char)tolower(c)];
+
+    m->next = malloc(total * m->nclass * sizeof(*m->next));
+    m->out = calloc(total, sizeof(*m->out));
+    int32_t *fail = calloc(total, sizeof(*fail));
+    int32_t *queue = malloc(total * sizeof(*queue));
+    if (!m->next || !m->out || !fail || !queue) {
+        free(fail);
+        free(queue);
+        mmatch_free(m);
+        return NULL;
+    }
+    for (size_t i = 0; i < total * m->nclass; ++i) m->next[i] = -1;
+
+    /* Trie */
+    m->nstates = 1;
+    for (size_t k = 0; k < count; ++k) {
+        int32_t s = 0;
+        for (const unsigned char *p = (const unsigned char *)patterns[k]; *p; ++p) {
+            int32_t *t = &m->next[(size_t)s * m->nclass + m->cls[*p]];
+            if (*t < 0) *t = (int32_t)m->nstates++;
+            s = *t;
+        }
+        m->out[s] |= (uint64_t)1 << k;
+    }
+
+    /* Failure links, breadth first; missing edges borrow the failure state's */
+    size_t head = 0, tail = 0;
+    for (size_t c = 0; c < m->nclass; ++c) {
+        int32_t *t = &m->next[c];
+        if (*t < 0) {
+            *t = 0;
+        } else {
+            fail[*t] = 0;
+            queue[tail++] = *t;
+        }
+    }
+    while (head < tail) {
+        int32_t s = queue[head++];
+        m->out[s] |= m->out[fail[s]];
+        for (size_t c = 0; c < m->nclass; ++c) {
+            int32_t *t = &m->next[(size_t)s * m->nclass + c];
+            int32_t via_fail = m->next[(size_t)fail[s] * m->nclass + c];
+            if (*t < 0) {
+                *t = via_fail;
+            } else {
+                fail[*t] = via_fail;
+                queue[tail++] = *t;
+            }
+        }
+    }
+    free(fail);
+    free(queue);
+    return m;
+}
+
+uint64_t mmatch_scan(const mmatch_t *m, const char *text, size_t len)
+{
+    uint64_t found = 0;
+    int32_t s = 0;
+    const unsigned char *p = (const unsigned char *)text;
+    for (size_t i = 0; i < len; ++i) {
+        s = m->next[(size_t)s * m->nclass + m->cls[p[i]]];
+        found |= m->out[s];
+    }
+    return found;
+}
+
+void mmatch_free(mmatch_t *m)
+{
+    if (!m) return;
+    free(m->next);
+    free(m->out);
+    free(m);
+}
@@ -0,0 +1,172 @@
+/*
+ * netlink_monitor.c
+ * --------------------------------------------
+ * rtnetlink subscription for link and neighbour state changes.
+ *
+ * The kernel sends RTM_NEWLINK for every attribute change (statistics,
+ * MTU, promiscuous mode, ...), so the last running state of each
+ * interface is remembered here and only transitions are reported.
+ * Interfaces never seen before are assumed to be up.
+ */
+
+#define _DEFAULT_SOURCE
+#include "netlink_monitor.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ifaddrs.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/neighbour.h>
+
+#define NLMON_MAX_LINKS 64
+#define NLMON_RECV_BUF  16384
+
+static struct {
+    int ifindex;
+    int running;
+} links[NLMON_MAX_LINKS];
+static size_t link_count = 0;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Record an interface's running state.
+ * @return 1 if it changed since the last message, 0 otherwise.
+ */
+static int link_transition(int ifindex, int running)
+{
+    for (size_t i = 0; i < link_count; ++i) {
+        if (links[i].ifindex != ifindex) continue;
+        int changed = links[i].running != running;
+        links[i].running = running;
+        return changed;
+    }
+    if (link_count < NLMON_MAX_LINKS) {
+        links[link_count].ifindex = ifindex;
+        links[link_count].running = running;
+        link_count++;
+    }
+    return !running;
+}
+
+static int decode_link(const struct nlmsghdr *h, nlmon_event_t *ev)
+{
+    const struct ifinfomsg *ifi = NLMSG_DATA(h);
+    int running = (ifi->ifi_flags & IFF_UP) && (ifi->ifi_flags & IFF_RUNNING) && h->nlmsg_type != RTM_DELLINK;
+    if (!link_transition(ifi->ifi_index, running)) return 0;
+
+    memset(ev, 0, sizeof(*ev));
+    ev->type = running ? NLMON_LINK_UP : NLMON_LINK_DOWN;
+    ev->ifindex = ifi->ifi_index;
+    int len = (int)IFLA_PAYLOAD(h);
+    for (struct rtattr *a = IFLA_RTA(ifi); RTA_OK(a, len); a = RTA_NEXT(a, len)) {
+        if (a->rta_type == IFLA_IFNAME)
+            snprintf(ev->ifname, sizeof(ev->ifname), "%s", (const char *)RTA_DATA(a));
+    }
+    return 1;
+}
+
+static int decode_neigh(const struct nlmsghdr *h, nlmon_event_t *ev)
+{
+    const struct ndmsg *nd = NLMSG_DATA(h);
+    if (nd->ndm_family != AF_INET || h->nlmsg_type != RTM_NEWNEIGH) return 0;
+
+    nlmon_event_type_t type;
+    if (nd->ndm_state & NUD_FAILED) type = NLMON_NEIGH_DOWN;
+    else if (nd->ndm_state & NUD_REACHABLE) type = NLMON_NEIGH_UP;
+    else return 0;
+
+    memset(ev, 0, sizeof(*ev));
+    ev->type = type;
+    ev->ifindex = nd->ndm_ifindex;
+    int len = (int)RTM_PAYLOAD(h);
+    for (struct rtattr *a = RTM_RTA(nd); RTA_OK(a, len); a = RTA_NEXT(a, len)) {
+        if (a->rta_type == NDA_DST && RTA_PAYLOAD(a) == sizeof(struct in_addr))
+            inet_ntop(AF_INET, RTA_DATA(a), ev->ip, sizeof(ev->ip));
+    }
+    return ev->ip[0] != '\0';
+}
+
+/* -------------------------------------------------------------------------- */
+int nlmon_open(void)
+{
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) return -1;
+
+    struct sockaddr_nl sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = RTMGRP_LINK | RTMGRP_NEIGH;
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int nlmon_read(int fd, nlmon_event_t *events, size_t max)
+{
+    char buf[NLMON_RECV_BUF] __attribute__((aligned(NLMSG_ALIGNTO)));
+    size_t n = 0;
+    for (;;) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len < 0) {
+            if (errno == EINTR) continue;
+            /* ENOBUFS means events were lost to an overrun; keep going */
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) break;
+            return -1;
+        }
+        if (len == 0) break;
+        for (struct nlmsghdr *h = (struct nlmsghdr *)buf; NLMSG_OK(h, (unsigned)len); h = NLMSG_NEXT(h, len)) {
+            if (n >= max) continue;
+            switch (h->nlmsg_type) {
+            case RTM_NEWLINK:
+            case RTM_DELLINK:
+                n += (size_t)decode_link(h, &events[n]);
+                break;
+            case RTM_NEWNEIGH:
+                n += (size_t)decode_neigh(h, &events[n]);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    return (int)n;
+}
+
+/* -------------------------------------------------------------------------- */
+int nlmon_route_ifindex(const char *ip)
+{
+    struct sockaddr_in dst;
+    memset(&dst, 0, sizeof(dst));
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(9);
+    if (!ip || inet_pton(AF_INET, ip, &dst.sin_addr) != 1) return 0;
+
+    /* connect() on a UDP socket only selects a route and source address */
+    int s = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (s < 0) return 0;
+    struct sockaddr_in src;
+    socklen_t sl = sizeof(src);
+    int ok = connect(s, (struct sockaddr *)&dst, sizeof(dst)) == 0 &&
+             getsockname(s, (struct sockaddr *)&src, &sl) == 0;
+    close(s);
+    if (!ok) return 0;
+
+    struct ifaddrs *ifa_list = NULL;
+    if (getifaddrs(&ifa_list) != 0) return 0;
+    int ifindex = 0;
+    for (struct ifaddrs *ifa = ifa_list; ifa && !ifindex; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET) continue;
+        const struct sockaddr_in *a = (const struct sockaddr_in *)ifa->ifa_addr;
+        if (a->sin_addr.s_addr == src.sin_addr.s_addr)
+            ifindex = (int)if_nametoindex(ifa->ifa_name);
+    }
+    freeifaddrs(ifa_list);
+    return ifindex;
+}
@@ -0,0 +1,160 @@
+/*
+ * proc_state.c
+ * --------------------------------------------
+ * State file and /proc identity checks for adopting ffmpeg processes.
+ *
+ * The state file is plain text: a version line, then one line per
+ * process with "pid camera stream start_ticks device ip".
+ */
+
+#define _GNU_SOURCE
+#include "proc_state.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/syscall.h>
+
+#define STATE_HEADER "videopipe-state 1"
+
+/* -------------------------------------------------------------------------- */
+int proc_state_save(const char *path, const proc_state_entry_t *entries, size_t count)
+{
+    char tmp[512];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    FILE *f = fopen(tmp, "w");
+    if (!f) return -1;
+    fprintf(f, "%s\n", STATE_HEADER);
+    for (size_t i = 0; i < count; ++i) {
+        const proc_state_entry_t *e = &entries[i];
+        fprintf(f, "%d %d %d %llu %s %s\n", (int)e->pid, e->cam_index, e->stream_index,
+                e->start_ticks, e->device, e->ip);
+    }
+    int err = ferror(f) ? EIO : 0;
+    if (fclose(f) != 0 && !err) err = errno;
+    if (err || rename(tmp, path) != 0) {
+        if (!err) err = errno;
+        unlink(tmp);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+int proc_state_load(const char *path, proc_state_entry_t *entries, size_t max)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return errno == ENOENT ? 0 : -1;
+    char line[512];
+    if (!fgets(line, sizeof(line), f) || strncmp(line, STATE_HEADER, strlen(STATE_HEADER)) != 0) {
+        fclose(f);
+        errno = EINVAL;
+        return -1;
+    }
+    size_t n = 0;
+    while (n < max && fgets(line, sizeof(line), f)) {
+        proc_state_entry_t *e = &entries[n];
+        int pid;
+        memset(e, 0, sizeof(*e));
+        if (sscanf(line, "%d %d %d %llu %63s %127s", &pid, &e->cam_index, &e->stream_index,
+                   &e->start_ticks, e->device, e->ip) != 6 || pid <= 0)
+            continue;
+        e->pid = (pid_t)pid;
+        n++;
+    }
+    fclose(f);
+    return (int)n;
+}
+
+/* -------------------------------------------------------------------------- */
+int proc_start_ticks(pid_t pid, unsigned long long *ticks)
+{
+    char path[64], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+
+    /* comm may contain spaces and parentheses; fields resume after the last ')' */
+    char *p = strrchr(buf, ')');
+    if (!p) return -1;
+    char state;
+    unsigned long long start;
+    /* Fields 3 (state) .. 22 (starttime) */
+    if (sscanf(p + 1, " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+               &state, &start) != 2)
+        return -1;
+    if (state == 'Z' || state == 'X') return -1;
+    *ticks = start;
+    return 0;
+}
+
+int proc_is_same(pid_t pid, unsigned long long start_ticks)
+{
+    unsigned long long now;
+    return pid > 0 && proc_start_ticks(pid, &now) == 0 && now == start_ticks;
+}
+
+time_t proc_start_time(unsigned long long start_ticks)
+{
+    FILE *f = fopen("/proc/stat", "r");
+    if (!f) return (time_t)-1;
+    char line[256];
+    long long btime = -1;
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "btime %lld", &btime) == 1) break;
+    fclose(f);
+    long hz = sysconf(_SC_CLK_TCK);
+    if (btime < 0 || hz <= 0) return (time_t)-1;
+    return (time_t)(btime + (long long)(start_ticks / (unsigned long long)hz));
+}
+
+int proc_cmdline_matches(pid_t pid, const char *exe, const char *const *needles, size_t count)
+{
+    char path[64], buf[4096];
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", (int)pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    if (len == 0) return 0;
+    buf[len] = '\0';
+
+    const char *base = strrchr(buf, '/');
+    if (strcmp(base ? base + 1 : buf, exe) != 0) return 0;
+    for (size_t k = 0; k < count; ++k) {
+        int found = 0;
+        for (size_t off = 0; off < len && !found; off += strlen(buf + off) + 1)
+            found = strcmp(buf + off, needles[k]) == 0;
+        if (!found) return 0;
+    }
+    return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+int proc_pidfd_open(pid_t pid, unsigned long long start_ticks)
+{
+    int fd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (fd < 0) return -1;
+    /* The pid may have been reused before the open; the start time tells */
+    if (!proc_is_same(pid, start_ticks)) {
+        close(fd);
+        errno = ESRCH;
+        return -1;
+    }
+    return fd;
+}
+
+int proc_pidfd_exited(int pidfd)
+{
+    struct pollfd pfd = { .fd = pidfd, .events = POLLIN };
+    return poll(&pfd, 1, 0) > 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * proc_stats.c
+ * --------------------------------------------
+ * pread()-based sampling of /proc/<pid>/{stat,status,io}.
+ */
+
+#define _GNU_SOURCE
+#include "proc_stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+
+#define PROC_READ_MAX 4096
+
+static long clock_ticks = 0;
+
+/* -------------------------------------------------------------------------- */
+static uint64_t mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Whole file from offset 0, NUL-terminated; length or -1 */
+static ssize_t read_at_zero(int fd, char *buf, size_t len)
+{
+    ssize_t n;
+    do n = pread(fd, buf, len - 1, 0);
+    while (n < 0 && errno == EINTR);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+/* Value after "key" at the start of a line in status or io text, or 0 */
+static uint64_t field_after(const char *text, const char *key)
+{
+    size_t klen = strlen(key);
+    for (const char *p = text; p; ) {
+        if (strncmp(p, key, klen) == 0) return strtoull(p + klen, NULL, 10);
+        p = strchr(p, '\n');
+        if (p) p++;
+    }
+    return 0;
+}
+
+static int open_proc_file(pid_t pid, const char *name)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/%s", (int)pid, name);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/* -------------------------------------------------------------------------- */
+int pstat_open(pstat_proc_t *p, pid_t pid)
+{
+    if (clock_ticks == 0) clock_ticks = sysconf(_SC_CLK_TCK);
+    memset(p, 0, sizeof(*p));
+    p->fd_stat = open_proc_file(pid, "stat");
+    p->fd_status = p->fd_stat >= 0 ? open_proc_file(pid, "status") : -1;
+    if (p->fd_stat < 0 || p->fd_status < 0) {
+        int err = errno;
+        if (p->fd_stat >= 0) close(p->fd_stat);
+        p->fd_stat = p->fd_status = p->fd_io = -1;
+        errno = err;
+        return -1;
+    }
+    /* io needs ptrace access to the process; the rest works without it */
+    p->fd_io = open_proc_file(pid, "io");
+    p->pid = pid;
+    return 0;
+}
+
+int pstat_sample(pstat_proc_t *p, pstat_sample_t *out)
+{
+    char buf[PROC_READ_MAX];
+    memset(out, 0, sizeof(*out));
+    if (p->pid <= 0) {
+        errno = ESRCH;
+        return -1;
+    }
+    uint64_t now = mono_ns();
+
+    /* stat: fields after the ")" that ends the command name, which may
+     * itself contain spaces and parentheses. utime and stime are fields
+     * 14 and 15, num_threads 20. */
+    if (read_at_zero(p->fd_stat, buf, sizeof(buf)) < 0) return -1;
+    const char *s = strrchr(buf, ')');
+    if (!s) {
+        errno = EINVAL;
+        return -1;
+    }
+    unsigned long long utime = 0, stime = 0;
+    long threads = 0;
+    if (sscanf(s + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %ld",
+               &utime, &stime, &threads) != 3) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint64_t ticks = utime + stime;
+    out->threads = (int)threads;
+
+    if (read_at_zero(p->fd_status, buf, sizeof(buf)) < 0) return -1;
+    out->rss_bytes = field_after(buf, "VmRSS:") * 1024;
+    out->vol_ctxt = field_after(buf, "voluntary_ctxt_switches:");
+    out->nonvol_ctxt = field_after(buf, "nonvoluntary_ctxt_switches:");
+
+    if (p->fd_io >= 0 && read_at_zero(p->fd_io, buf, sizeof(buf)) >= 0) {
+        out->read_bytes = field_after(buf, "rchar:");
+        out->write_bytes = field_after(buf, "wchar:");
+    }
+
+    if (p->prev_ns != 0 && now > p->prev_ns) {
+        double secs = (double)(now - p->prev_ns) / 1e9;
+        const pstat_sample_t *q = &p->prev;
+        out->cpu_pct = ticks >= p->prev_ticks ? (double)(ticks - p->prev_ticks) / (double)clock_ticks / secs * 100.0 : 0.0;
+        out->vol_ctxt_rate = out->vol_ctxt >= q->vol_ctxt ? (double)(out->vol_ctxt - q->vol_ctxt) / secs : 0.0;
+        out->nonvol_ctxt_rate = out->nonvol_ctxt >= q->nonvol_ctxt ? (double)(out->nonvol_ctxt - q->nonvol_ctxt) / secs : 0.0;
+        out->read_rate = out->read_bytes >= q->read_bytes ? (double)(out->read_bytes - q->read_bytes) / secs : 0.0;
+        out->write_rate = out->write_bytes >= q->write_bytes ? (double)(out->write_bytes - q->write_bytes) / secs : 0.0;
+        out->valid_rates = 1;
+    }
+    p->prev_ns = now;
+    p->prev_ticks = ticks;
+    p->prev = *out;
+    return 0;
+}
+
+void pstat_close(pstat_proc_t *p)
+{
+    if (p->pid > 0) {
+        close(p->fd_stat);
+        close(p->fd_status);
+        if (p->fd_io >= 0) close(p->fd_io);
+    }
+    memset(p, 0, sizeof(*p));
+    p->fd_stat = p->fd_status = p->fd_io = -1;
+}
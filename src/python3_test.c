@@ -108,11 +108,13 @@
  *    - Error handling is basic; consider adding logging for production use.
  */
 
+#define _GNU_SOURCE
 #include "python3_test.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/wait.h>
 #include <signal.h>
 #include <sys/resource.h>
@@ -142,8 +144,11 @@ int test_python_integration(void)
         "        print('error')\n";
 
     // Set up pipes for bidirectional communication between parent and child.
+    // Close-on-exec, so that programs other threads start meanwhile do not
+    // inherit them and hold off the end of file we wait for; dup2() clears
+    // the flag on the child's stdin and stdout.
     int to_child[2], from_child[2]; // to_child: parent writes, child reads; from_child: child writes, parent reads.
-    if (pipe(to_child) == -1 || pipe(from_child) == -1) {
+    if (pipe2(to_child, O_CLOEXEC) == -1 || pipe2(from_child, O_CLOEXEC) == -1) {
         perror("pipe"); // Print error if pipe creation fails.
         return -1;
     }
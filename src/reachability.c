@@ -0,0 +1,148 @@
+/*
+ * reachability.c
+ * --------------------------------------------
+ * One-shot epoll sweep of TCP connects for videopipe's health check.
+ *
+ * Sweeps are small (one socket per camera), so the earliest pending
+ * deadline is found with a linear scan each time round the loop rather
+ * than with a timer heap.
+ */
+
+#include "reachability.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#define REACH_EPOLL_BATCH 32
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+}
+
+static void finish(reach_target_t *t, int err, uint64_t started)
+{
+    t->error = err;
+    t->reachable = err == 0;
+    t->connect_ms = err == 0 ? (int)(now_ms() - started) : -1;
+}
+
+/* -------------------------------------------------------------------------- */
+int reach_sweep(reach_target_t *targets, size_t count, int timeout_ms)
+{
+    if (!targets) return -1;
+    if (count == 0) return 0;
+
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    int *fds = malloc(count * sizeof(*fds));
+    uint64_t *started = malloc(count * sizeof(*started));
+    if (ep < 0 || !fds || !started) {
+        if (ep >= 0) close(ep);
+        free(fds);
+        free(started);
+        return -1;
+    }
+    uint64_t timeout = (uint64_t)(timeout_ms > 0 ? timeout_ms : 1);
+    size_t pending = 0;
+    int up = 0;
+
+    /* Start every connect before waiting on any of them */
+    for (size_t i = 0; i < count; ++i) {
+        reach_target_t *t = &targets[i];
+        fds[i] = -1;
+        started[i] = now_ms();
+
+        struct sockaddr_in sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons((uint16_t)t->port);
+        if (!t->ip || inet_pton(AF_INET, t->ip, &sa.sin_addr) != 1) {
+            finish(t, EINVAL, started[i]);
+            continue;
+        }
+        int s = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (s < 0) {
+            finish(t, errno, started[i]);
+            continue;
+        }
+        if (connect(s, (struct sockaddr *)&sa, sizeof(sa)) == 0) {
+            close(s);
+            finish(t, 0, started[i]);
+            up++;
+            continue;
+        }
+        if (errno != EINPROGRESS) {
+            finish(t, errno, started[i]);
+            close(s);
+            continue;
+        }
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLOUT | EPOLLERR | EPOLLHUP;
+        ev.data.u64 = i;
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, s, &ev) != 0) {
+            finish(t, errno, started[i]);
+            close(s);
+            continue;
+        }
+        fds[i] = s;
+        pending++;
+    }
+
+    struct epoll_event evs[REACH_EPOLL_BATCH];
+    while (pending > 0) {
+        /* Expire overdue sockets and find the next deadline */
+        uint64_t now = now_ms(), next = UINT64_MAX;
+        for (size_t i = 0; i < count; ++i) {
+            if (fds[i] < 0) continue;
+            uint64_t deadline = started[i] + timeout;
+            if (deadline <= now) {
+                close(fds[i]);
+                fds[i] = -1;
+                finish(&targets[i], ETIMEDOUT, started[i]);
+                pending--;
+            } else if (deadline < next) {
+                next = deadline;
+            }
+        }
+        if (pending == 0) break;
+
+        int nev = epoll_wait(ep, evs, REACH_EPOLL_BATCH, (int)(next - now));
+        if (nev < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int k = 0; k < nev; ++k) {
+            size_t i = (size_t)evs[k].data.u64;
+            if (i >= count || fds[i] < 0) continue;
+            int soerr = 0;
+            socklen_t sl = sizeof(soerr);
+            if (getsockopt(fds[i], SOL_SOCKET, SO_ERROR, &soerr, &sl) != 0) soerr = errno;
+            finish(&targets[i], soerr, started[i]);
+            if (soerr == 0) up++;
+            close(fds[i]);
+            fds[i] = -1;
+            pending--;
+        }
+    }
+
+    /* Only reached with sockets left open if epoll_wait failed */
+    for (size_t i = 0; i < count; ++i) {
+        if (fds[i] < 0) continue;
+        close(fds[i]);
+        finish(&targets[i], EIO, started[i]);
+    }
+    close(ep);
+    free(fds);
+    free(started);
+    return up;
+}
@@ -0,0 +1,151 @@
+/*
+ * reprobe.c
+ * --------------------------------------------
+ * Low-priority worker thread for background stream re-probing.
+ *
+ * The worker owns a single job slot and a single result slot guarded by
+ * one mutex. It lowers its own scheduling class to SCHED_IDLE (falling
+ * back to nice 19) so re-probing never competes with the supervisor or
+ * the ffmpeg children for CPU.
+ */
+
+#define _GNU_SOURCE
+
+#include "reprobe.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+static pthread_t worker;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static reprobe_fn probe_fn = NULL;
+static int running = 0;
+static int has_job = 0;
+static int in_flight = 0;
+static int has_result = 0;
+static reprobe_job_t job_slot;
+static reprobe_result_t result_slot;
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Drop the calling thread to the lowest scheduling priority.
+ */
+static void lower_thread_priority(void)
+{
+    struct sched_param sp;
+    memset(&sp, 0, sizeof(sp));
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp) != 0) {
+        /* Linux applies nice values per thread when addressed by tid */
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+    }
+}
+
+static void *reprobe_worker(void *arg)
+{
+    (void)arg;
+    lower_thread_priority();
+    trace_thread_name("reprobe");
+
+    pthread_mutex_lock(&lock);
+    while (running) {
+        if (!has_job) {
+            pthread_cond_wait(&wake, &lock);
+            continue;
+        }
+        reprobe_job_t job = job_slot;
+        has_job = 0;
+        in_flight = 1;
+        pthread_mutex_unlock(&lock);
+
+        reprobe_result_t res;
+        memset(&res, 0, sizeof(res));
+        res.cam_index = job.cam_index;
+        res.stream_index = job.stream_index;
+        res.ok = probe_fn(&job, &res.info);
+        res.when = time(NULL);
+
+        pthread_mutex_lock(&lock);
+        result_slot = res;
+        has_result = 1;
+        in_flight = 0;
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+int reprobe_start(reprobe_fn fn)
+{
+    if (!fn) return -1;
+    pthread_mutex_lock(&lock);
+    if (running) {
+        pthread_mutex_unlock(&lock);
+        return 0;
+    }
+    probe_fn = fn;
+    running = 1;
+    has_job = has_result = in_flight = 0;
+    pthread_mutex_unlock(&lock);
+
+    if (pthread_create(&worker, NULL, reprobe_worker, NULL) != 0) {
+        pthread_mutex_lock(&lock);
+        running = 0;
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+    return 0;
+}
+
+void reprobe_stop(void)
+{
+    pthread_mutex_lock(&lock);
+    if (!running) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    running = 0;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(worker, NULL);
+}
+
+int reprobe_submit(const reprobe_job_t *job)
+{
+    int rc = -1;
+    pthread_mutex_lock(&lock);
+    if (running && !has_job && !in_flight && !has_result) {
+        job_slot = *job;
+        has_job = 1;
+        pthread_cond_signal(&wake);
+        rc = 0;
+    }
+    pthread_mutex_unlock(&lock);
+    return rc;
+}
+
+int reprobe_poll(reprobe_result_t *out)
+{
+    int got = 0;
+    pthread_mutex_lock(&lock);
+    if (has_result) {
+        *out = result_slot;
+        has_result = 0;
+        got = 1;
+    }
+    pthread_mutex_unlock(&lock);
+    return got;
+}
+
+int reprobe_busy(void)
+{
+    pthread_mutex_lock(&lock);
+    int busy = has_job || in_flight || has_result;
+    pthread_mutex_unlock(&lock);
+    return busy;
+}
@@ -0,0 +1,140 @@
+/*
+ * roc_history.c
+ * --------------------------------------------
+ * Reader for videopipe's per-camera stream history.
+ *
+ * Usage: roc_history [-d days] [-v] [ip ...]
+ *
+ * Without addresses, every camera in the history directory is listed.
+ * For each camera it prints per-stream probe success, outages, recoveries
+ * with their mean downtime, and the reliability factor videopipe uses
+ * when ranking streams. It also prints outages by hour of day, to spot
+ * cameras that flap at particular times. With -v every event is printed.
+ */
+
+#include "stream_history.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#define HISTORY_DIR "/var/lib/roc/history"
+
+static const char *STREAM_NAMES[HIST_MAX_STREAMS] = {"main", "ext", "sub"};
+
+static const char *stream_name(int st)
+{
+    return (st >= 0 && st < HIST_MAX_STREAMS) ? STREAM_NAMES[st] : "?";
+}
+
+static void print_events(const hist_record_t *recs, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        const hist_record_t *r = &recs[i];
+        time_t t = (time_t)r->time;
+        struct tm tm;
+        char when[32];
+        localtime_r(&t, &tm);
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+        switch (r->kind) {
+        case HIST_PROBE:
+            printf("  %s  probe     %-4s %s score=%.2f\n", when, stream_name(r->stream),
+                   r->ok ? "ok  " : "fail", r->value / 100.0);
+            break;
+        case HIST_SWITCH:
+            printf("  %s  switch    %s -> %s\n", when, stream_name(r->prev), stream_name(r->stream));
+            break;
+        case HIST_OUTAGE:
+            printf("  %s  outage    %s\n", when, stream_name(r->stream));
+            break;
+        case HIST_RECOVERY:
+            printf("  %s  recovery  %s after %.1fs\n", when, stream_name(r->stream), r->value / 1000.0);
+            break;
+        default:
+            printf("  %s  %s\n", when, hist_kind_name(r->kind));
+            break;
+        }
+    }
+}
+
+static int show_camera(const char *ip, int days, int verbose)
+{
+    time_t since = days > 0 ? time(NULL) - (time_t)days * 86400 : 0;
+    hist_record_t *recs = NULL;
+    size_t n = 0;
+    if (hist_read(HISTORY_DIR, ip, since, &recs, &n) != 0) {
+        fprintf(stderr, "%s: not a readable history file\n", ip);
+        return -1;
+    }
+    long window = days > 0 ? (long)days * 86400 : (n > 0 ? (long)(time(NULL) - (time_t)recs[0].time) : 0);
+
+    hist_stats_t stats[HIST_MAX_STREAMS];
+    hist_summarise(recs, n, window, stats);
+    int by_hour[24] = {0};
+    int switches = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (recs[i].kind == HIST_SWITCH) switches++;
+        if (recs[i].kind != HIST_OUTAGE) continue;
+        time_t t = (time_t)recs[i].time;
+        struct tm tm;
+        localtime_r(&t, &tm);
+        by_hour[tm.tm_hour]++;
+    }
+
+    printf("%s: %zu event(s), %d stream switch(es)\n", ip, n, switches);
+    printf("  %-5s %8s %8s %8s %10s %12s\n", "type", "probes", "ok%", "outages", "recovered", "reliability");
+    for (int st = 0; st < HIST_MAX_STREAMS; ++st) {
+        const hist_stats_t *s = &stats[st];
+        char mean[16] = "-";
+        if (s->recoveries > 0)
+            snprintf(mean, sizeof(mean), "%.1fs", (double)s->down_ms_total / s->recoveries / 1000.0);
+        printf("  %-5s %8d %7.0f%% %8d %4d/%-5s %12.2f\n", STREAM_NAMES[st], s->probes,
+               s->probes ? 100.0 * s->probe_ok / s->probes : 0.0, s->outages, s->recoveries, mean, s->reliability);
+    }
+    printf("  outages by hour:");
+    for (int h = 0; h < 24; ++h) printf(" %d", by_hour[h]);
+    printf("\n");
+    if (verbose) print_events(recs, n);
+    free(recs);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int days = 0, verbose = 0, opt;
+    while ((opt = getopt(argc, argv, "d:vh")) != -1) {
+        switch (opt) {
+        case 'd': days = atoi(optarg); break;
+        case 'v': verbose = 1; break;
+        default:
+            fprintf(stderr, "Usage: %s [-d days] [-v] [ip ...]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    int rc = 0;
+    if (optind < argc) {
+        for (int i = optind; i < argc; ++i)
+            if (show_camera(argv[i], days, verbose) != 0) rc = 1;
+        return rc;
+    }
+
+    DIR *d = opendir(HISTORY_DIR);
+    if (!d) {
+        fprintf(stderr, "No history in %s\n", HISTORY_DIR);
+        return 1;
+    }
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        size_t len = strlen(de->d_name);
+        if (len <= 5 || strcmp(de->d_name + len - 5, ".hist") != 0) continue;
+        char ip[64];
+        snprintf(ip, sizeof(ip), "%.*s", (int)(len - 5), de->d_name);
+        if (show_camera(ip, days, verbose) != 0) rc = 1;
+    }
+    closedir(d);
+    return rc;
+}
@@ -0,0 +1,283 @@
+/*
+ * roc_journal.c
+ * --------------------------------------------
+ * Decoder for the binary event journals of videopipe and main_controller.
+ *
+ * Usage: roc_journal [-c camera]... [-t type[,type...]] [-s since] [-u until]
+ *                    [-f text|csv|json] [-a] [journal ...]
+ *
+ * Without files, the journals in the journal directory are read. Events
+ * from several files are merged by wall-clock time. -c keeps the given
+ * camera indexes, and -t keeps the listed event types (spawn, exit,
+ * probe, switch, stall, reach, start, stop, anchor). -s and -u bound the
+ * time range. They take a local time "YYYY-MM-DD HH:MM[:SS]", a Unix
+ * time "@seconds", or an age such as "90m", "12h" or "2d". Anchor
+ * records are hidden unless -a is given.
+ */
+
+#define _GNU_SOURCE
+#include "event_journal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define MAX_FILTER_CAMS 64
+
+static const char *DEFAULT_JOURNALS[] = {
+    JOURNAL_DIR "/videopipe.ej",
+    JOURNAL_DIR "/main_controller.ej",
+};
+
+static const char *STREAM_NAMES[] = {"main", "ext", "sub"};
+
+enum { OUT_TEXT, OUT_CSV, OUT_JSON };
+
+struct item {
+    ej_event_t ev;
+    size_t order;   /* Position across all inputs, to keep the sort stable */
+};
+
+static const char *stream_name(int st)
+{
+    return st >= 0 && st < (int)(sizeof(STREAM_NAMES) / sizeof(STREAM_NAMES[0])) ? STREAM_NAMES[st] : "";
+}
+
+static const char *source_name(int src)
+{
+    return src == EJ_SRC_VIDEOPIPE ? "videopipe" : src == EJ_SRC_MAIN ? "main_controller" : "?";
+}
+
+static int by_time(const void *a, const void *b)
+{
+    const struct item *x = a, *y = b;
+    if (x->ev.wall_us != y->ev.wall_us) return x->ev.wall_us < y->ev.wall_us ? -1 : 1;
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+/* Local time, "@epoch" or an age like "12h"; microseconds since the epoch, or -1 */
+static int64_t parse_time(const char *s)
+{
+    char *end;
+    if (s[0] == '@') {
+        long long t = strtoll(s + 1, &end, 10);
+        return *end ? -1 : (int64_t)t * 1000000;
+    }
+    long long n = strtoll(s, &end, 10);
+    if (end != s && end[0] && !end[1]) {
+        long unit = end[0] == 's' ? 1 : end[0] == 'm' ? 60 : end[0] == 'h' ? 3600 : end[0] == 'd' ? 86400 : 0;
+        if (unit) return ((int64_t)time(NULL) - (int64_t)n * unit) * 1000000;
+    }
+    static const char *FORMATS[] = { "%Y-%m-%d %H:%M:%S", "%Y-%m-%dT%H:%M:%S", "%Y-%m-%d %H:%M", "%Y-%m-%d" };
+    for (size_t k = 0; k < sizeof(FORMATS) / sizeof(FORMATS[0]); ++k) {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        const char *rest = strptime(s, FORMATS[k], &tm);
+        if (!rest || *rest) continue;
+        tm.tm_isdst = -1;
+        return (int64_t)mktime(&tm) * 1000000;
+    }
+    return -1;
+}
+
+static int parse_types(char *list, unsigned *mask)
+{
+    *mask = 0;
+    for (char *save = NULL, *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        int found = 0;
+        for (int t = 1; t < EJ_TYPE_MAX && !found; ++t)
+            if (strcasecmp(tok, ej_type_name(t)) == 0) {
+                *mask |= 1u << t;
+                found = 1;
+            }
+        if (!found) return -1;
+    }
+    return 0;
+}
+
+static void format_time(int64_t us, char *buf, size_t len)
+{
+    if (us == 0) {
+        snprintf(buf, len, "?");
+        return;
+    }
+    time_t t = (time_t)(us / 1000000);
+    struct tm tm;
+    char when[32];
+    localtime_r(&t, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+    snprintf(buf, len, "%s.%06lld", when, (long long)(us % 1000000));
+}
+
+/* Human-readable summary of the type-specific fields */
+static void describe(const ej_record_t *r, char *buf, size_t len)
+{
+    switch (r->type) {
+    case EJ_SPAWN:
+        snprintf(buf, len, "pid %d", r->pid);
+        break;
+    case EJ_EXIT:
+        if (r->value < 0) snprintf(buf, len, "pid %d after %ds", r->pid, r->extra);
+        else if (WIFSIGNALED(r->value)) snprintf(buf, len, "pid %d killed by signal %d after %ds", r->pid, WTERMSIG(r->value), r->extra);
+        else snprintf(buf, len, "pid %d exit code %d after %ds", r->pid, WEXITSTATUS(r->value), r->extra);
+        break;
+    case EJ_PROBE:
+        snprintf(buf, len, "%s score %.2f", r->value ? "ok" : "failed", r->extra / 100.0);
+        break;
+    case EJ_SWITCH:
+        snprintf(buf, len, "from %s", stream_name(r->value));
+        break;
+    case EJ_STALL:
+        snprintf(buf, len, "%s (%d) pid %d", ej_stall_name(r->value), r->extra, r->pid);
+        break;
+    case EJ_REACH:
+        if (r->value) snprintf(buf, len, "up (%dms)", r->extra);
+        else snprintf(buf, len, "down (errno %d)", r->extra);
+        break;
+    case EJ_START:
+    case EJ_STOP:
+        snprintf(buf, len, "pid %d", r->pid);
+        break;
+    default:
+        buf[0] = '\0';
+        break;
+    }
+}
+
+static void print_event(const ej_event_t *e, int format, int first)
+{
+    const ej_record_t *r = &e->rec;
+    char when[48], detail[96], cam[16];
+    format_time(e->wall_us, when, sizeof(when));
+    describe(r, detail, sizeof(detail));
+    if (r->cam >= 0) snprintf(cam, sizeof(cam), "%d", r->cam);
+    else cam[0] = '\0';
+
+    switch (format) {
+    case OUT_CSV:
+        printf("%s,%lld,%llu,%s,%s,%s,%s,%d,%d,%d,\"%s\"\n", when, (long long)e->wall_us,
+               (unsigned long long)r->mono_ns, source_name(r->source), ej_type_name(r->type), cam,
+               stream_name(r->stream), r->pid, r->value, r->extra, detail);
+        break;
+    case OUT_JSON:
+        printf("%s  {\"time\": \"%s\", \"wall_us\": %lld, \"mono_ns\": %llu, \"source\": \"%s\", \"type\": \"%s\", "
+               "\"camera\": %s, \"stream\": ", first ? "" : ",\n", when, (long long)e->wall_us,
+               (unsigned long long)r->mono_ns, source_name(r->source), ej_type_name(r->type), cam[0] ? cam : "null");
+        if (r->stream >= 0) printf("\"%s\"", stream_name(r->stream));
+        else printf("null");
+        printf(", \"pid\": %d, \"value\": %d, \"extra\": %d, \"detail\": \"%s\"}", r->pid, r->value, r->extra, detail);
+        break;
+    default:
+        printf("%s  %-15s %-6s %-4s %-4s %s\n", when, source_name(r->source), ej_type_name(r->type),
+               cam, stream_name(r->stream), detail);
+        break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int cams[MAX_FILTER_CAMS], ncams = 0, format = OUT_TEXT, anchors = 0, opt;
+    unsigned types = 0;
+    int64_t since = -1, until = -1;
+    while ((opt = getopt(argc, argv, "c:t:s:u:f:ah")) != -1) {
+        switch (opt) {
+        case 'c':
+            if (ncams < MAX_FILTER_CAMS) cams[ncams++] = atoi(optarg);
+            break;
+        case 't':
+            if (parse_types(optarg, &types) != 0) {
+                fprintf(stderr, "Unknown event type in %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 's':
+        case 'u': {
+            int64_t t = parse_time(optarg);
+            if (t < 0) {
+                fprintf(stderr, "Cannot parse time %s\n", optarg);
+                return 1;
+            }
+            if (opt == 's') since = t;
+            else until = t;
+            break;
+        }
+        case 'f':
+            if (strcmp(optarg, "text") == 0) format = OUT_TEXT;
+            else if (strcmp(optarg, "csv") == 0) format = OUT_CSV;
+            else if (strcmp(optarg, "json") == 0) format = OUT_JSON;
+            else {
+                fprintf(stderr, "Unknown format %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'a': anchors = 1; break;
+        default:
+            fprintf(stderr, "Usage: %s [-c camera]... [-t type[,type...]] [-s since] [-u until] "
+                            "[-f text|csv|json] [-a] [journal ...]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    const char **paths = (const char **)argv + optind;
+    int npaths = argc - optind, rc = 0;
+    if (npaths == 0) {
+        paths = DEFAULT_JOURNALS;
+        npaths = (int)(sizeof(DEFAULT_JOURNALS) / sizeof(DEFAULT_JOURNALS[0]));
+    }
+
+    struct item *items = NULL;
+    size_t count = 0, readable = 0;
+    for (int f = 0; f < npaths; ++f) {
+        ej_event_t *ev;
+        size_t n;
+        if (ej_read(paths[f], &ev, &n) != 0) {
+            /* Missing default journals are normal: that program never ran */
+            if (argc - optind > 0) {
+                fprintf(stderr, "%s: not a readable journal\n", paths[f]);
+                rc = 1;
+            }
+            continue;
+        }
+        readable++;
+        struct item *grown = realloc(items, (count + n) * sizeof(*items));
+        if (!grown && count + n > 0) {
+            free(ev);
+            fprintf(stderr, "Out of memory\n");
+            free(items);
+            return 1;
+        }
+        items = grown;
+        for (size_t i = 0; i < n; ++i) {
+            const ej_record_t *r = &ev[i].rec;
+            if (r->type == EJ_ANCHOR && !anchors) continue;
+            if (types && !(types & (1u << r->type))) continue;
+            if (since >= 0 && ev[i].wall_us < since) continue;
+            if (until >= 0 && ev[i].wall_us > until) continue;
+            if (ncams > 0) {
+                int keep = 0;
+                for (int k = 0; k < ncams && !keep; ++k) keep = r->cam == cams[k];
+                if (!keep) continue;
+            }
+            items[count].ev = ev[i];
+            items[count].order = count;
+            count++;
+        }
+        free(ev);
+    }
+    if (readable == 0 && argc - optind == 0) {
+        fprintf(stderr, "No journals in %s\n", JOURNAL_DIR);
+        return 1;
+    }
+    if (count > 1) qsort(items, count, sizeof(*items), by_time);
+
+    if (format == OUT_CSV) printf("time,wall_us,mono_ns,source,type,camera,stream,pid,value,extra,detail\n");
+    if (format == OUT_JSON) printf("[\n");
+    for (size_t i = 0; i < count; ++i) print_event(&items[i].ev, format, i == 0);
+    if (format == OUT_JSON) printf("%s]\n", count ? "\n" : "");
+    free(items);
+    return rc;
+}
@@ -0,0 +1,191 @@
+/*
+ * roc_log.c
+ * --------------------------------------------
+ * Runtime thresholds, level specs and the console sink behind roc_log.h.
+ */
+
+#include "roc_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+
+#define SPEC_MAX 1024
+
+_Atomic int roc_log_threshold[RLOG_SUBSYS_COUNT] = {
+    [RLOG_MAIN]     = ROC_LOG_INFO,
+    [RLOG_INIT]     = ROC_LOG_INFO,
+    [RLOG_CONFIG]   = ROC_LOG_INFO,
+    [RLOG_DEVICE]   = ROC_LOG_INFO,
+    [RLOG_CACHE]    = ROC_LOG_INFO,
+    [RLOG_PROBE]    = ROC_LOG_INFO,
+    [RLOG_PROC]     = ROC_LOG_INFO,
+    [RLOG_RECOVERY] = ROC_LOG_INFO,
+    [RLOG_HEALTH]   = ROC_LOG_INFO,
+    [RLOG_NET]      = ROC_LOG_INFO,
+};
+
+static const char *const level_names[] = { "DEBUG", "INFO", "WARNING", "ERROR", "OFF" };
+
+static const char *const subsys_names[RLOG_SUBSYS_COUNT] = {
+    [RLOG_MAIN]     = "main",
+    [RLOG_INIT]     = "init",
+    [RLOG_CONFIG]   = "config",
+    [RLOG_DEVICE]   = "device",
+    [RLOG_CACHE]    = "cache",
+    [RLOG_PROBE]    = "probe",
+    [RLOG_PROC]     = "proc",
+    [RLOG_RECOVERY] = "recovery",
+    [RLOG_HEALTH]   = "health",
+    [RLOG_NET]      = "net",
+};
+
+static void console_sink(int level, int sub, const char *fmt, va_list ap)
+{
+    char msg[2048], tag[16];
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    size_t k = 0;
+    for (const char *s = subsys_names[sub]; *s && k < sizeof(tag) - 1; ++s)
+        tag[k++] = (char)toupper((unsigned char)*s);
+    tag[k] = '\0';
+    FILE *out = level >= ROC_LOG_WARNING ? stderr : stdout;
+    if (level == ROC_LOG_INFO) fprintf(out, "[%s] %s\n", tag, msg);
+    else fprintf(out, "[%s] %s: %s\n", tag, level_names[level], msg);
+}
+
+static _Atomic(roc_log_sink_fn) log_sink = console_sink;
+
+/* -------------------------------------------------------------------------- */
+void roc_log_write(int level, int sub, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    atomic_load_explicit(&log_sink, memory_order_acquire)(level, sub, fmt, ap);
+    va_end(ap);
+}
+
+void roc_log_set_sink(roc_log_sink_fn sink)
+{
+    atomic_store_explicit(&log_sink, sink ? sink : console_sink, memory_order_release);
+}
+
+const char *roc_log_level_name(int level)
+{
+    return level >= ROC_LOG_DEBUG && level <= ROC_LOG_OFF ? level_names[level] : "?";
+}
+
+const char *roc_log_subsys_name(int sub)
+{
+    return sub >= 0 && sub < RLOG_SUBSYS_COUNT ? subsys_names[sub] : "?";
+}
+
+/* -------------------------------------------------------------------------- */
+static int parse_level(const char *s)
+{
+    if (strcasecmp(s, "warn") == 0) return ROC_LOG_WARNING;
+    for (int l = ROC_LOG_DEBUG; l <= ROC_LOG_OFF; ++l)
+        if (strcasecmp(s, level_names[l]) == 0) return l;
+    return -1;
+}
+
+/* Apply spec to levels[]; levels[] is left half-updated on error */
+static int parse_spec(const char *spec, int *levels)
+{
+    char buf[SPEC_MAX], *save = NULL;
+    if (strlen(spec) >= sizeof(buf)) return -1;
+    strcpy(buf, spec);
+    for (char *tok = strtok_r(buf, ", \t\r\n", &save); tok; tok = strtok_r(NULL, ", \t\r\n", &save)) {
+        char *eq = strchr(tok, '=');
+        if (!eq) {
+            int l = parse_level(tok);
+            if (l < 0) return -1;
+            for (int s = 0; s < RLOG_SUBSYS_COUNT; ++s) levels[s] = l;
+            continue;
+        }
+        *eq = '\0';
+        int l = parse_level(eq + 1), sub = -1;
+        for (int s = 0; s < RLOG_SUBSYS_COUNT && sub < 0; ++s)
+            if (strcmp(tok, subsys_names[s]) == 0) sub = s;
+        if (l < 0 || sub < 0) return -1;
+        levels[sub] = l;
+    }
+    return 0;
+}
+
+static void store_levels(const int *levels)
+{
+    for (int s = 0; s < RLOG_SUBSYS_COUNT; ++s)
+        atomic_store_explicit(&roc_log_threshold[s], levels[s], memory_order_relaxed);
+}
+
+int roc_log_apply(const char *spec)
+{
+    int levels[RLOG_SUBSYS_COUNT];
+    for (int s = 0; s < RLOG_SUBSYS_COUNT; ++s)
+        levels[s] = atomic_load_explicit(&roc_log_threshold[s], memory_order_relaxed);
+    if (parse_spec(spec, levels) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    store_levels(levels);
+    return 0;
+}
+
+int roc_log_configure(const char *path)
+{
+    int levels[RLOG_SUBSYS_COUNT];
+    for (int s = 0; s < RLOG_SUBSYS_COUNT; ++s) levels[s] = ROC_LOG_INFO;
+
+    FILE *f = path ? fopen(path, "r") : NULL;
+    if (path && !f && errno != ENOENT) return -1;
+    if (f) {
+        char line[SPEC_MAX];
+        int bad = 0;
+        while (!bad && fgets(line, sizeof(line), f)) {
+            char *p = line;
+            while (isspace((unsigned char)*p)) p++;
+            if (*p != '#') bad = parse_spec(p, levels) != 0;
+        }
+        fclose(f);
+        if (bad) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    const char *env = getenv("ROC_LOG");
+    if (env && parse_spec(env, levels) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    store_levels(levels);
+    return 0;
+}
+
+void roc_log_describe(char *buf, size_t len)
+{
+    int levels[RLOG_SUBSYS_COUNT], votes[ROC_LOG_OFF + 1] = { 0 }, common = ROC_LOG_INFO;
+    for (int s = 0; s < RLOG_SUBSYS_COUNT; ++s) {
+        levels[s] = atomic_load_explicit(&roc_log_threshold[s], memory_order_relaxed);
+        votes[levels[s]]++;
+    }
+    for (int l = ROC_LOG_DEBUG; l <= ROC_LOG_OFF; ++l)
+        if (votes[l] > votes[common]) common = l;
+
+    size_t off = 0;
+    char name[16];
+    for (int s = -1; s < RLOG_SUBSYS_COUNT && off < len; ++s) {
+        int l = s < 0 ? common : levels[s];
+        if (s >= 0 && l == common) continue;
+        size_t k = 0;
+        for (const char *c = level_names[l]; *c && k < sizeof(name) - 1; ++c)
+            name[k++] = (char)tolower((unsigned char)*c);
+        name[k] = '\0';
+        int n = s < 0 ? snprintf(buf + off, len - off, "%s", name)
+                      : snprintf(buf + off, len - off, " %s=%s", subsys_names[s], name);
+        if (n < 0) break;
+        off += (size_t)n;
+    }
+}
@@ -0,0 +1,1063 @@
+/*
+ * rtmp_probe.c
+ * --------------------------------------------
+ * Minimal native RTMP client used to validate camera streams without
+ * spawning ffmpeg.
+ *
+ * The probe speaks just enough RTMP to get a camera to start sending:
+ *   1. Plain (unencrypted) C0/C1/C2 handshake.
+ *   2. AMF0 "connect" to the bcs application.
+ *   3. "createStream" followed by "play" of channel0_<type>.bcs.
+ *   4. Chunk stream demultiplexing until onMetaData and the first video
+ *      packets have been seen.
+ *
+ * Resolution and frame rate come from onMetaData when the camera sends
+ * it, otherwise from the H.264 SPS in the AVC sequence header, and as a
+ * last resort the frame rate is derived from the timestamps of the first
+ * few video packets. Every socket operation shares one deadline so the
+ * probe never takes longer than the caller allows.
+ */
+
+#include "rtmp_probe.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#define RTMP_HANDSHAKE_SIZE 1536
+#define RTMP_DEFAULT_CHUNK  128
+#define RTMP_MAX_CSID       64          /* Chunk streams tracked; higher ids fold */
+#define RTMP_MAX_MSG        (1024 * 1024)
+#define RTMP_FPS_SAMPLES    6           /* Video frames used for timestamp fps */
+#define AMF_MAX_DEPTH       8
+
+/* Message type ids (RTMP specification, sections 5.4 and 7.1) */
+#define MSG_SET_CHUNK_SIZE  1
+#define MSG_ACK             3
+#define MSG_USER_CONTROL    4
+#define MSG_WINDOW_ACK      5
+#define MSG_VIDEO           9
+#define MSG_DATA_AMF0       18
+#define MSG_CMD_AMF0        20
+#define MSG_AGGREGATE       22
+
+/* Chunk stream ids used for outgoing messages (same layout as ffmpeg) */
+#define CSID_CONTROL        2
+#define CSID_COMMAND        3
+#define CSID_PLAY           8
+
+/* Transaction ids for the commands we issue */
+#define TXN_CONNECT         1
+#define TXN_CREATE_STREAM   2
+
+typedef struct {
+    uint32_t timestamp;
+    uint32_t ts_delta;
+    uint32_t length;
+    uint8_t  type;
+    uint32_t stream_id;
+    int      ext_ts;
+    uint8_t *buf;
+    uint32_t cap;
+    uint32_t have;
+} chunk_stream_t;
+
+typedef struct {
+    int fd;
+    uint64_t deadline_ms;
+    uint32_t in_chunk;
+    uint32_t window_ack;
+    uint64_t bytes_in;
+    uint64_t last_ack;
+    chunk_stream_t cs[RTMP_MAX_CSID];
+} rtmp_conn_t;
+
+typedef enum {
+    STAGE_CONNECT,
+    STAGE_CREATE_STREAM,
+    STAGE_PLAY
+} probe_stage_t;
+
+typedef struct {
+    rtmp_probe_result_t *out;
+    probe_stage_t stage;
+    int rejected;
+    int stream_ended;
+    uint64_t start_ms;
+    int fps_frames;
+    uint32_t fps_first_ts;
+    uint32_t fps_last_ts;
+} probe_state_t;
+
+/* -------------------------------------------------------------------------- */
+/* Time and socket helpers                                                    */
+/* -------------------------------------------------------------------------- */
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+}
+
+/**
+ * @brief Wait for a socket to become ready, bounded by an absolute deadline.
+ * @return 0 when ready, -1 on timeout or error.
+ */
+static int wait_fd(int fd, short events, uint64_t deadline)
+{
+    for (;;) {
+        uint64_t now = now_ms();
+        if (now >= deadline) return -1;
+        struct pollfd p = { .fd = fd, .events = events, .revents = 0 };
+        int r = poll(&p, 1, (int)(deadline - now));
+        if (r > 0) return 0;
+        if (r == 0) return -1;
+        if (errno != EINTR) return -1;
+    }
+}
+
+static int io_write(rtmp_conn_t *c, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = send(c->fd, p, len, MSG_NOSIGNAL);
+        if (n > 0) { p += n; len -= (size_t)n; continue; }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (wait_fd(c->fd, POLLOUT, c->deadline_ms) != 0) return -1;
+            continue;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+static int io_read(rtmp_conn_t *c, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = recv(c->fd, p, len, 0);
+        if (n > 0) {
+            p += n;
+            len -= (size_t)n;
+            c->bytes_in += (uint64_t)n;
+            continue;
+        }
+        if (n == 0) return -1; /* Peer closed */
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (wait_fd(c->fd, POLLIN, c->deadline_ms) != 0) return -1;
+            continue;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Non-blocking TCP connect to ip:port, bounded by the deadline.
+ * @return Connected (non-blocking) socket, or -1 on failure.
+ */
+static int tcp_connect(const char *ip, int port, uint64_t deadline)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) return -1;
+
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0) return -1;
+
+    int flags = fcntl(s, F_GETFL, 0);
+    if (flags == -1 || fcntl(s, F_SETFL, flags | O_NONBLOCK) == -1) {
+        close(s);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(s, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        if (errno != EINPROGRESS || wait_fd(s, POLLOUT, deadline) != 0) {
+            close(s);
+            return -1;
+        }
+        int soerr = 0;
+        socklen_t sl = sizeof(soerr);
+        if (getsockopt(s, SOL_SOCKET, SO_ERROR, &soerr, &sl) != 0 || soerr != 0) {
+            close(s);
+            return -1;
+        }
+    }
+    return s;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Byte order helpers                                                         */
+/* -------------------------------------------------------------------------- */
+
+static uint32_t rd_be16(const uint8_t *p) { return ((uint32_t)p[0] << 8) | p[1]; }
+static uint32_t rd_be24(const uint8_t *p) { return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2]; }
+static uint32_t rd_be32(const uint8_t *p) { return ((uint32_t)p[0] << 24) | rd_be24(p + 1); }
+static uint32_t rd_le32(const uint8_t *p) { return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+static void wr_be16(uint8_t *p, uint32_t v) { p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v; }
+static void wr_be24(uint8_t *p, uint32_t v) { p[0] = (uint8_t)(v >> 16); p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)v; }
+static void wr_be32(uint8_t *p, uint32_t v) { p[0] = (uint8_t)(v >> 24); wr_be24(p + 1, v); }
+
+/* -------------------------------------------------------------------------- */
+/* AMF0 encoding                                                              */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    uint8_t buf[1024];
+    size_t len;
+    int overflow;
+} amf_buf_t;
+
+static void amf_put(amf_buf_t *b, const void *data, size_t n)
+{
+    if (b->len + n > sizeof(b->buf)) { b->overflow = 1; return; }
+    memcpy(b->buf + b->len, data, n);
+    b->len += n;
+}
+
+static void amf_put_u8(amf_buf_t *b, uint8_t v) { amf_put(b, &v, 1); }
+
+static void amf_number(amf_buf_t *b, double v)
+{
+    uint64_t bits;
+    uint8_t be[8];
+    memcpy(&bits, &v, sizeof(bits));
+    for (int i = 0; i < 8; i++) be[i] = (uint8_t)(bits >> (56 - 8 * i));
+    amf_put_u8(b, 0x00);
+    amf_put(b, be, sizeof(be));
+}
+
+static void amf_bool(amf_buf_t *b, int v)
+{
+    amf_put_u8(b, 0x01);
+    amf_put_u8(b, v ? 1 : 0);
+}
+
+static void amf_raw_string(amf_buf_t *b, const char *s)
+{
+    size_t n = strlen(s);
+    uint8_t l[2];
+    if (n > 0xFFFF) { b->overflow = 1; return; }
+    wr_be16(l, (uint32_t)n);
+    amf_put(b, l, 2);
+    amf_put(b, s, n);
+}
+
+static void amf_string(amf_buf_t *b, const char *s)
+{
+    amf_put_u8(b, 0x02);
+    amf_raw_string(b, s);
+}
+
+static void amf_null(amf_buf_t *b) { amf_put_u8(b, 0x05); }
+static void amf_object_begin(amf_buf_t *b) { amf_put_u8(b, 0x03); }
+
+static void amf_object_end(amf_buf_t *b)
+{
+    static const uint8_t end[3] = { 0x00, 0x00, 0x09 };
+    amf_put(b, end, sizeof(end));
+}
+
+/* -------------------------------------------------------------------------- */
+/* AMF0 decoding                                                              */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} amf_rd_t;
+
+static int amf_need(const amf_rd_t *r, size_t n) { return (size_t)(r->end - r->p) >= n; }
+
+static int amf_read_raw_string(amf_rd_t *r, char *out, size_t outlen)
+{
+    if (!amf_need(r, 2)) return -1;
+    size_t n = rd_be16(r->p);
+    r->p += 2;
+    if (!amf_need(r, n)) return -1;
+    if (out && outlen) {
+        size_t c = n < outlen - 1 ? n : outlen - 1;
+        memcpy(out, r->p, c);
+        out[c] = '\0';
+    }
+    r->p += n;
+    return 0;
+}
+
+static int amf_read_string(amf_rd_t *r, char *out, size_t outlen)
+{
+    if (!amf_need(r, 1) || r->p[0] != 0x02) return -1;
+    r->p++;
+    return amf_read_raw_string(r, out, outlen);
+}
+
+static int amf_read_number(amf_rd_t *r, double *out)
+{
+    if (!amf_need(r, 9) || r->p[0] != 0x00) return -1;
+    uint64_t bits = 0;
+    for (int i = 1; i <= 8; i++) bits = (bits << 8) | r->p[i];
+    memcpy(out, &bits, sizeof(*out));
+    r->p += 9;
+    return 0;
+}
+
+static int amf_skip_value(amf_rd_t *r, int depth);
+
+/* Skip the name/value pairs of an object or ECMA array body. */
+static int amf_skip_props(amf_rd_t *r, int depth)
+{
+    for (;;) {
+        if (!amf_need(r, 3)) return -1;
+        if (r->p[0] == 0 && r->p[1] == 0 && r->p[2] == 0x09) {
+            r->p += 3;
+            return 0;
+        }
+        if (amf_read_raw_string(r, NULL, 0) != 0) return -1;
+        if (amf_skip_value(r, depth + 1) != 0) return -1;
+    }
+}
+
+static int amf_skip_value(amf_rd_t *r, int depth)
+{
+    if (depth > AMF_MAX_DEPTH || !amf_need(r, 1)) return -1;
+    uint8_t marker = *r->p++;
+    switch (marker) {
+    case 0x00: /* number */
+        if (!amf_need(r, 8)) return -1;
+        r->p += 8;
+        return 0;
+    case 0x01: /* boolean */
+        if (!amf_need(r, 1)) return -1;
+        r->p += 1;
+        return 0;
+    case 0x02: /* string */
+        return amf_read_raw_string(r, NULL, 0);
+    case 0x03: /* object */
+        return amf_skip_props(r, depth);
+    case 0x05: /* null */
+    case 0x06: /* undefined */
+        return 0;
+    case 0x07: /* reference */
+        if (!amf_need(r, 2)) return -1;
+        r->p += 2;
+        return 0;
+    case 0x08: /* ECMA array: count is advisory, terminated like an object */
+        if (!amf_need(r, 4)) return -1;
+        r->p += 4;
+        return amf_skip_props(r, depth);
+    case 0x0A: { /* strict array */
+        if (!amf_need(r, 4)) return -1;
+        uint32_t n = rd_be32(r->p);
+        r->p += 4;
+        for (uint32_t i = 0; i < n; i++)
+            if (amf_skip_value(r, depth + 1) != 0) return -1;
+        return 0;
+    }
+    case 0x0B: /* date */
+        if (!amf_need(r, 10)) return -1;
+        r->p += 10;
+        return 0;
+    case 0x0C: /* long string */
+    case 0x0F: { /* XML document */
+        if (!amf_need(r, 4)) return -1;
+        uint32_t n = rd_be32(r->p);
+        r->p += 4;
+        if (!amf_need(r, n)) return -1;
+        r->p += n;
+        return 0;
+    }
+    case 0x10: /* typed object */
+        if (amf_read_raw_string(r, NULL, 0) != 0) return -1;
+        return amf_skip_props(r, depth);
+    default:
+        return -1;
+    }
+}
+
+/**
+ * @brief Look up a string property of an AMF0 object at the reader position.
+ *
+ * Consumes the whole object. out is left empty if the key is missing.
+ */
+static int amf_find_string_prop(amf_rd_t *r, const char *key, char *out, size_t outlen)
+{
+    if (outlen) out[0] = '\0';
+    if (!amf_need(r, 1)) return -1;
+    if (r->p[0] == 0x08) {
+        if (!amf_need(r, 5)) return -1;
+        r->p += 5;
+    } else if (r->p[0] == 0x03) {
+        r->p++;
+    } else {
+        return amf_skip_value(r, 0);
+    }
+    for (;;) {
+        char name[64];
+        if (!amf_need(r, 3)) return -1;
+        if (r->p[0] == 0 && r->p[1] == 0 && r->p[2] == 0x09) {
+            r->p += 3;
+            return 0;
+        }
+        if (amf_read_raw_string(r, name, sizeof(name)) != 0) return -1;
+        if (strcmp(name, key) == 0 && amf_need(r, 1) && r->p[0] == 0x02) {
+            if (amf_read_string(r, out, outlen) != 0) return -1;
+        } else if (amf_skip_value(r, 1) != 0) {
+            return -1;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* H.264 SPS parsing (resolution, profile and VUI timing)                     */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+    const uint8_t *p;
+    size_t len;
+    size_t bit;
+    int err;
+} bitrd_t;
+
+static uint32_t br_bits(bitrd_t *b, int n)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < n; i++) {
+        if (b->bit >= b->len * 8) { b->err = 1; return 0; }
+        v = (v << 1) | ((b->p[b->bit >> 3] >> (7 - (b->bit & 7))) & 1u);
+        b->bit++;
+    }
+    return v;
+}
+
+static uint32_t br_ue(bitrd_t *b)
+{
+    int zeros = 0;
+    while (!b->err && br_bits(b, 1) == 0) {
+        if (++zeros > 31) { b->err = 1; return 0; }
+    }
+    if (zeros == 0) return 0;
+    return ((1u << zeros) - 1u) + br_bits(b, zeros);
+}
+
+static int32_t br_se(bitrd_t *b)
+{
+    uint32_t v = br_ue(b);
+    return (v & 1u) ? (int32_t)((v + 1) / 2) : -(int32_t)(v / 2);
+}
+
+static const char *h264_profile_name(uint32_t profile_idc)
+{
+    switch (profile_idc) {
+    case 66:  return "Baseline";
+    case 77:  return "Main";
+    case 88:  return "Extended";
+    case 100: return "High";
+    case 110: return "High 10";
+    case 122: return "High 4:2:2";
+    case 244: return "High 4:4:4 Predictive";
+    default:  return "";
+    }
+}
+
+/**
+ * @brief Parse an H.264 SPS NAL unit (including its header byte).
+ * @return 0 if the picture size could be decoded, -1 otherwise.
+ */
+static int parse_h264_sps(const uint8_t *nal, size_t nal_len, rtmp_probe_result_t *out, double *fps_out)
+{
+    /* Strip emulation prevention bytes (00 00 03) */
+    uint8_t rbsp[512];
+    size_t n = 0;
+    int zeros = 0;
+    for (size_t i = 1; i < nal_len && n < sizeof(rbsp); i++) {
+        if (zeros >= 2 && nal[i] == 0x03) { zeros = 0; continue; }
+        rbsp[n++] = nal[i];
+        zeros = (nal[i] == 0) ? zeros + 1 : 0;
+    }
+
+    bitrd_t b = { rbsp, n, 0, 0 };
+    uint32_t profile_idc = br_bits(&b, 8);
+    br_bits(&b, 16);           /* constraint flags + level_idc */
+    br_ue(&b);                 /* seq_parameter_set_id */
+
+    uint32_t chroma_format_idc = 1;
+    if (profile_idc == 100 || profile_idc == 110 || profile_idc == 122 ||
+        profile_idc == 244 || profile_idc == 44 || profile_idc == 83 ||
+        profile_idc == 86 || profile_idc == 118 || profile_idc == 128 ||
+        profile_idc == 138 || profile_idc == 139 || profile_idc == 134 ||
+        profile_idc == 135) {
+        chroma_format_idc = br_ue(&b);
+        if (chroma_format_idc == 3) br_bits(&b, 1);
+        br_ue(&b);             /* bit_depth_luma_minus8 */
+        br_ue(&b);             /* bit_depth_chroma_minus8 */
+        br_bits(&b, 1);        /* qpprime_y_zero_transform_bypass_flag */
+        if (br_bits(&b, 1)) {  /* seq_scaling_matrix_present_flag */
+            int lists = (chroma_format_idc != 3) ? 8 : 12;
+            for (int i = 0; i < lists && !b.err; i++) {
+                if (!br_bits(&b, 1)) continue;
+                int size = (i < 6) ? 16 : 64;
+                int last = 8, next = 8;
+                for (int j = 0; j < size && !b.err; j++) {
+                    if (next != 0) next = (last + br_se(&b) + 256) % 256;
+                    last = (next == 0) ? last : next;
+                }
+            }
+        }
+    }
+
+    br_ue(&b);                 /* log2_max_frame_num_minus4 */
+    uint32_t poc_type = br_ue(&b);
+    if (poc_type == 0) {
+        br_ue(&b);
+    } else if (poc_type == 1) {
+        br_bits(&b, 1);
+        br_se(&b);
+        br_se(&b);
+        uint32_t cycle = br_ue(&b);
+        for (uint32_t i = 0; i < cycle && i < 256 && !b.err; i++) br_se(&b);
+    }
+    br_ue(&b);                 /* max_num_ref_frames */
+    br_bits(&b, 1);            /* gaps_in_frame_num_value_allowed_flag */
+
+    uint32_t width_mbs = br_ue(&b) + 1;
+    uint32_t height_units = br_ue(&b) + 1;
+    uint32_t frame_mbs_only = br_bits(&b, 1);
+    if (!frame_mbs_only) br_bits(&b, 1);
+    br_bits(&b, 1);            /* direct_8x8_inference_flag */
+
+    uint32_t crop_l = 0, crop_r = 0, crop_t = 0, crop_b = 0;
+    if (br_bits(&b, 1)) {
+        crop_l = br_ue(&b);
+        crop_r = br_ue(&b);
+        crop_t = br_ue(&b);
+        crop_b = br_ue(&b);
+    }
+    if (b.err) return -1;
+
+    uint32_t crop_x = (chroma_format_idc == 0 || chroma_format_idc == 3) ? 1 : 2;
+    uint32_t crop_y = ((chroma_format_idc == 1) ? 2 : 1) * (2 - frame_mbs_only);
+    int width = (int)(width_mbs * 16 - crop_x * (crop_l + crop_r));
+    int height = (int)((2 - frame_mbs_only) * height_units * 16 - crop_y * (crop_t + crop_b));
+    if (width <= 0 || height <= 0) return -1;
+
+    out->width = width;
+    out->height = height;
+    snprintf(out->profile, sizeof(out->profile), "%s", h264_profile_name(profile_idc));
+
+    /* VUI: only the timing info is of interest */
+    if (br_bits(&b, 1)) {
+        if (br_bits(&b, 1)) {                      /* aspect_ratio_info */
+            if (br_bits(&b, 8) == 255) br_bits(&b, 32);
+        }
+        if (br_bits(&b, 1)) br_bits(&b, 1);        /* overscan */
+        if (br_bits(&b, 1)) {                      /* video_signal_type */
+            br_bits(&b, 4);
+            if (br_bits(&b, 1)) br_bits(&b, 24);
+        }
+        if (br_bits(&b, 1)) { br_ue(&b); br_ue(&b); } /* chroma_loc_info */
+        if (br_bits(&b, 1)) {                      /* timing_info */
+            uint32_t units = br_bits(&b, 32);
+            uint32_t scale = br_bits(&b, 32);
+            if (!b.err && units > 0 && scale > 0)
+                *fps_out = (double)scale / (2.0 * (double)units);
+        }
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Outgoing messages                                                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Send one RTMP message, split into chunks of the default size.
+ */
+static int send_msg(rtmp_conn_t *c, int csid, uint8_t type, uint32_t stream_id,
+                    const uint8_t *payload, size_t len)
+{
+    uint8_t hdr[12];
+    hdr[0] = (uint8_t)(csid & 0x3f);          /* fmt 0 */
+    wr_be24(hdr + 1, 0);                       /* timestamp */
+    wr_be24(hdr + 4, (uint32_t)len);
+    hdr[7] = type;
+    hdr[8] = (uint8_t)stream_id;               /* stream id is little-endian */
+    hdr[9] = (uint8_t)(stream_id >> 8);
+    hdr[10] = (uint8_t)(stream_id >> 16);
+    hdr[11] = (uint8_t)(stream_id >> 24);
+    if (io_write(c, hdr, sizeof(hdr)) != 0) return -1;
+
+    size_t off = 0;
+    while (off < len) {
+        size_t n = len - off;
+        if (n > RTMP_DEFAULT_CHUNK) n = RTMP_DEFAULT_CHUNK;
+        if (off > 0) {
+            uint8_t cont = (uint8_t)(0xC0 | (csid & 0x3f)); /* fmt 3 */
+            if (io_write(c, &cont, 1) != 0) return -1;
+        }
+        if (io_write(c, payload + off, n) != 0) return -1;
+        off += n;
+    }
+    return 0;
+}
+
+static int send_connect(rtmp_conn_t *c, const char *ip, int port)
+{
+    char tc_url[128];
+    snprintf(tc_url, sizeof(tc_url), "rtmp://%s:%d/bcs", ip, port);
+
+    amf_buf_t b = { .len = 0, .overflow = 0 };
+    amf_string(&b, "connect");
+    amf_number(&b, TXN_CONNECT);
+    amf_object_begin(&b);
+    amf_raw_string(&b, "app");          amf_string(&b, "bcs");
+    amf_raw_string(&b, "flashVer");     amf_string(&b, "LNX 9,0,124,2");
+    amf_raw_string(&b, "tcUrl");        amf_string(&b, tc_url);
+    amf_raw_string(&b, "fpad");         amf_bool(&b, 0);
+    amf_raw_string(&b, "capabilities"); amf_number(&b, 15.0);
+    amf_raw_string(&b, "audioCodecs");  amf_number(&b, 4071.0);
+    amf_raw_string(&b, "videoCodecs");  amf_number(&b, 252.0);
+    amf_raw_string(&b, "videoFunction");amf_number(&b, 1.0);
+    amf_object_end(&b);
+    if (b.overflow) return -1;
+    return send_msg(c, CSID_COMMAND, MSG_CMD_AMF0, 0, b.buf, b.len);
+}
+
+static int send_create_stream(rtmp_conn_t *c)
+{
+    amf_buf_t b = { .len = 0, .overflow = 0 };
+    amf_string(&b, "createStream");
+    amf_number(&b, TXN_CREATE_STREAM);
+    amf_null(&b);
+    return send_msg(c, CSID_COMMAND, MSG_CMD_AMF0, 0, b.buf, b.len);
+}
+
+static int send_play(rtmp_conn_t *c, uint32_t stream_id, const char *play_path)
+{
+    /* Set Buffer Length (user control event 3) before play, 3000 ms */
+    uint8_t ctl[10];
+    wr_be16(ctl, 3);
+    wr_be32(ctl + 2, stream_id);
+    wr_be32(ctl + 6, 3000);
+    if (send_msg(c, CSID_CONTROL, MSG_USER_CONTROL, 0, ctl, sizeof(ctl)) != 0) return -1;
+
+    amf_buf_t b = { .len = 0, .overflow = 0 };
+    amf_string(&b, "play");
+    amf_number(&b, 0.0);
+    amf_null(&b);
+    amf_string(&b, play_path);
+    amf_number(&b, -1000.0);                   /* live only, as ffmpeg -rtmp_live live */
+    if (b.overflow) return -1;
+    return send_msg(c, CSID_PLAY, MSG_CMD_AMF0, stream_id, b.buf, b.len);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Incoming chunk stream                                                      */
+/* -------------------------------------------------------------------------- */
+
+static int maybe_send_ack(rtmp_conn_t *c)
+{
+    if (c->window_ack == 0 || c->bytes_in - c->last_ack < c->window_ack) return 0;
+    uint8_t seq[4];
+    wr_be32(seq, (uint32_t)c->bytes_in);
+    c->last_ack = c->bytes_in;
+    return send_msg(c, CSID_CONTROL, MSG_ACK, 0, seq, sizeof(seq));
+}
+
+/**
+ * @brief Read chunks until one complete message has been reassembled.
+ * @return The chunk stream holding the message, or NULL on error/timeout.
+ */
+static chunk_stream_t *read_message(rtmp_conn_t *c)
+{
+    static const int hdr_len[4] = { 11, 7, 3, 0 };
+    for (;;) {
+        uint8_t b0;
+        if (io_read(c, &b0, 1) != 0) return NULL;
+        int fmt = b0 >> 6;
+        uint32_t csid = b0 & 0x3f;
+        if (csid == 0) {
+            uint8_t x;
+            if (io_read(c, &x, 1) != 0) return NULL;
+            csid = 64u + x;
+        } else if (csid == 1) {
+            uint8_t x[2];
+            if (io_read(c, x, 2) != 0) return NULL;
+            csid = 64u + x[0] + ((uint32_t)x[1] << 8);
+        }
+        chunk_stream_t *cs = &c->cs[csid % RTMP_MAX_CSID];
+
+        uint8_t h[11];
+        if (hdr_len[fmt] > 0 && io_read(c, h, (size_t)hdr_len[fmt]) != 0) return NULL;
+
+        uint32_t ts_field = 0;
+        if (fmt <= 2) {
+            ts_field = rd_be24(h);
+            cs->ext_ts = (ts_field == 0xFFFFFF);
+        }
+        if (fmt <= 1) {
+            cs->length = rd_be24(h + 3);
+            cs->type = h[6];
+        }
+        if (fmt == 0) cs->stream_id = rd_le32(h + 7);
+        if (cs->ext_ts) {
+            uint8_t e[4];
+            if (io_read(c, e, 4) != 0) return NULL;
+            if (fmt <= 2) ts_field = rd_be32(e);
+        }
+
+        if (fmt <= 2) cs->have = 0;            /* New message always restarts */
+        if (cs->have == 0) {
+            if (fmt == 0) {
+                cs->timestamp = ts_field;
+                cs->ts_delta = 0;
+            } else if (fmt <= 2) {
+                cs->ts_delta = ts_field;
+                cs->timestamp += ts_field;
+            } else {
+                cs->timestamp += cs->ts_delta;
+            }
+            if (cs->length > RTMP_MAX_MSG) return NULL;
+            if (cs->length > cs->cap) {
+                uint8_t *nb = realloc(cs->buf, cs->length);
+                if (!nb) return NULL;
+                cs->buf = nb;
+                cs->cap = cs->length;
+            }
+        }
+
+        uint32_t n = cs->length - cs->have;
+        if (n > c->in_chunk) n = c->in_chunk;
+        if (n > 0 && io_read(c, cs->buf + cs->have, n) != 0) return NULL;
+        cs->have += n;
+        if (maybe_send_ack(c) != 0) return NULL;
+
+        if (cs->have >= cs->length) {
+            cs->have = 0;
+            return cs;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Message handlers                                                           */
+/* -------------------------------------------------------------------------- */
+
+static void set_codec_from_id(rtmp_probe_result_t *out, unsigned id)
+{
+    const char *name = NULL;
+    switch (id) {
+    case 2:  name = "flv1"; break;
+    case 4:  name = "vp6f"; break;
+    case 7:  name = "h264"; break;
+    case 12: name = "hevc"; break;   /* Common (non-standard) id used by IP cameras */
+    default: break;
+    }
+    if (name) snprintf(out->codec, sizeof(out->codec), "%s", name);
+}
+
+static void handle_metadata(probe_state_t *st, const uint8_t *p, size_t len)
+{
+    amf_rd_t r = { p, p + len };
+    char name[32];
+    if (amf_read_string(&r, name, sizeof(name)) != 0) return;
+    if (strcmp(name, "@setDataFrame") == 0 && amf_read_string(&r, name, sizeof(name)) != 0) return;
+    if (strcmp(name, "onMetaData") != 0) return;
+
+    if (!amf_need(&r, 1)) return;
+    if (r.p[0] == 0x08) {
+        if (!amf_need(&r, 5)) return;
+        r.p += 5;
+    } else if (r.p[0] == 0x03) {
+        r.p++;
+    } else {
+        return;
+    }
+
+    rtmp_probe_result_t *out = st->out;
+    out->got_metadata = 1;
+    for (;;) {
+        char key[64];
+        if (!amf_need(&r, 3)) return;
+        if (r.p[0] == 0 && r.p[1] == 0 && r.p[2] == 0x09) return;
+        if (amf_read_raw_string(&r, key, sizeof(key)) != 0) return;
+        if (amf_need(&r, 1) && r.p[0] == 0x00) {
+            double v = 0.0;
+            if (amf_read_number(&r, &v) != 0) return;
+            if (strcmp(key, "width") == 0 && v > 0) out->width = (int)v;
+            else if (strcmp(key, "height") == 0 && v > 0) out->height = (int)v;
+            else if ((strcmp(key, "framerate") == 0 || strcmp(key, "videoframerate") == 0) && v > 0) out->fps = v;
+            else if (strcmp(key, "videodatarate") == 0 && v > 0) out->video_kbps = v;
+            else if (strcmp(key, "videocodecid") == 0) set_codec_from_id(out, (unsigned)v);
+        } else if (amf_need(&r, 1) && r.p[0] == 0x02 && strcmp(key, "videocodecid") == 0) {
+            char codec[16];
+            if (amf_read_string(&r, codec, sizeof(codec)) != 0) return;
+            if (strcmp(codec, "avc1") == 0 || strcmp(codec, "H264") == 0)
+                snprintf(out->codec, sizeof(out->codec), "h264");
+            else if (strcmp(codec, "hvc1") == 0 || strcmp(codec, "hev1") == 0 || strcmp(codec, "H265") == 0)
+                snprintf(out->codec, sizeof(out->codec), "hevc");
+        } else if (amf_skip_value(&r, 1) != 0) {
+            return;
+        }
+    }
+}
+
+static void handle_video(probe_state_t *st, const uint8_t *p, size_t len, uint32_t timestamp)
+{
+    rtmp_probe_result_t *out = st->out;
+    if (len < 2) return;
+
+    int is_config = 0;
+    if (p[0] & 0x80) {
+        /* Enhanced RTMP: FourCC follows the packet type nibble */
+        if (len < 5) return;
+        if (memcmp(p + 1, "hvc1", 4) == 0) snprintf(out->codec, sizeof(out->codec), "hevc");
+        else if (memcmp(p + 1, "av01", 4) == 0) snprintf(out->codec, sizeof(out->codec), "av1");
+        else if (memcmp(p + 1, "vp09", 4) == 0) snprintf(out->codec, sizeof(out->codec), "vp9");
+        is_config = ((p[0] & 0x0f) == 0);
+    } else {
+        unsigned codec_id = p[0] & 0x0f;
+        set_codec_from_id(out, codec_id);
+        if (codec_id == 7 || codec_id == 12) is_config = (p[1] == 0);
+
+        /* AVCDecoderConfigurationRecord: pick up the first SPS */
+        if (codec_id == 7 && is_config && len >= 13) {
+            const uint8_t *rec = p + 5;
+            size_t rec_len = len - 5;
+            if ((rec[5] & 0x1f) > 0) {
+                size_t sps_len = rd_be16(rec + 6);
+                if (8 + sps_len <= rec_len) {
+                    double sps_fps = 0.0;
+                    rtmp_probe_result_t sps = *out;
+                    if (parse_h264_sps(rec + 8, sps_len, &sps, &sps_fps) == 0) {
+                        if (out->width <= 0 || out->height <= 0) {
+                            out->width = sps.width;
+                            out->height = sps.height;
+                        }
+                        snprintf(out->profile, sizeof(out->profile), "%s", sps.profile);
+                        if (out->fps <= 0.0 && sps_fps > 0.0 && sps_fps < 240.0) out->fps = sps_fps;
+                    }
+                }
+            }
+        }
+    }
+
+    if (!out->got_video) {
+        out->got_video = 1;
+        out->first_frame_ms = (int)(now_ms() - st->start_ms);
+    }
+    if (is_config) return;
+
+    /* Timestamp based frame rate as a fallback when nothing else advertised it */
+    if (st->fps_frames == 0) st->fps_first_ts = timestamp;
+    st->fps_last_ts = timestamp;
+    st->fps_frames++;
+}
+
+static int handle_command(rtmp_conn_t *c, probe_state_t *st, const uint8_t *p, size_t len,
+                          const char *play_path)
+{
+    amf_rd_t r = { p, p + len };
+    char name[64];
+    double txn = 0.0;
+    if (amf_read_string(&r, name, sizeof(name)) != 0) return 0;
+    if (amf_read_number(&r, &txn) != 0) return 0;
+
+    if (strcmp(name, "_result") == 0) {
+        if ((int)txn == TXN_CONNECT && st->stage == STAGE_CONNECT) {
+            st->stage = STAGE_CREATE_STREAM;
+            return send_create_stream(c);
+        }
+        if ((int)txn == TXN_CREATE_STREAM && st->stage == STAGE_CREATE_STREAM) {
+            double sid = 0.0;
+            if (amf_skip_value(&r, 0) != 0 || amf_read_number(&r, &sid) != 0) sid = 1.0;
+            st->stage = STAGE_PLAY;
+            return send_play(c, (uint32_t)sid, play_path);
+        }
+        return 0;
+    }
+    if (strcmp(name, "_error") == 0) {
+        st->rejected = 1;
+        return 0;
+    }
+    if (strcmp(name, "onStatus") == 0) {
+        char code[96];
+        if (amf_skip_value(&r, 0) != 0) return 0;
+        if (amf_find_string_prop(&r, "code", code, sizeof(code)) != 0) return 0;
+        if (strstr(code, "Failed") || strstr(code, "NotFound") ||
+            strstr(code, "Rejected") || strstr(code, "BadName"))
+            st->rejected = 1;
+        else if (strstr(code, "Play.Stop") || strstr(code, "UnpublishNotify"))
+            st->stream_ended = 1;
+    }
+    return 0;
+}
+
+static int handle_control(rtmp_conn_t *c, probe_state_t *st, const chunk_stream_t *cs)
+{
+    const uint8_t *p = cs->buf;
+    switch (cs->type) {
+    case MSG_SET_CHUNK_SIZE:
+        if (cs->length >= 4) {
+            uint32_t sz = rd_be32(p) & 0x7fffffffu;
+            if (sz == 0 || sz > 0xFFFFFF) return -1;
+            c->in_chunk = sz;
+        }
+        return 0;
+    case MSG_WINDOW_ACK:
+        if (cs->length >= 4) c->window_ack = rd_be32(p);
+        return 0;
+    case MSG_USER_CONTROL:
+        if (cs->length >= 6) {
+            uint32_t event = rd_be16(p);
+            if (event == 6) {              /* PingRequest -> PingResponse */
+                uint8_t pong[6];
+                wr_be16(pong, 7);
+                memcpy(pong + 2, p + 2, 4);
+                return send_msg(c, CSID_CONTROL, MSG_USER_CONTROL, 0, pong, sizeof(pong));
+            }
+            if (event == 1) st->stream_ended = 1; /* StreamEOF */
+        }
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Walk the FLV tags carried inside an aggregate message.
+ */
+static void handle_aggregate(probe_state_t *st, const uint8_t *p, size_t len)
+{
+    size_t off = 0;
+    while (off + 11 <= len) {
+        uint8_t type = p[off];
+        uint32_t size = rd_be24(p + off + 1);
+        uint32_t ts = rd_be24(p + off + 4) | ((uint32_t)p[off + 7] << 24);
+        if (off + 11 + size > len) return;
+        if (type == MSG_VIDEO) handle_video(st, p + off + 11, size, ts);
+        else if (type == MSG_DATA_AMF0) handle_metadata(st, p + off + 11, size);
+        off += 11 + size + 4;                 /* tag header, body, PreviousTagSize */
+    }
+}
+
+static int probe_complete(const probe_state_t *st)
+{
+    const rtmp_probe_result_t *out = st->out;
+    return out->got_video && out->width > 0 && out->height > 0 && out->fps > 0.0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Public entry point                                                         */
+/* -------------------------------------------------------------------------- */
+
+int rtmp_probe_stream(const char *ip, int port, const char *stream_type,
+                      int stream_num, const char *user, const char *password,
+                      int timeout_ms, rtmp_probe_result_t *out)
+{
+    if (!out) return RTMP_PROBE_EPROTO;
+    memset(out, 0, sizeof(*out));
+    if (!ip || !stream_type) return RTMP_PROBE_EPROTO;
+
+    char play_path[512];
+    snprintf(play_path, sizeof(play_path), "channel0_%s.bcs?channel=0&stream=%d&user=%s&password=%s",
+             stream_type, stream_num, user ? user : "admin", password ? password : "");
+
+    probe_state_t st;
+    memset(&st, 0, sizeof(st));
+    st.out = out;
+    st.stage = STAGE_CONNECT;
+    st.start_ms = now_ms();
+
+    rtmp_conn_t c;
+    memset(&c, 0, sizeof(c));
+    c.deadline_ms = st.start_ms + (uint64_t)(timeout_ms > 0 ? timeout_ms : 1);
+    c.in_chunk = RTMP_DEFAULT_CHUNK;
+    c.fd = tcp_connect(ip, port, c.deadline_ms);
+    if (c.fd < 0) return RTMP_PROBE_ENET;
+
+    int rc = RTMP_PROBE_ENET;
+
+    /* Handshake: C0+C1, read S0+S1, echo S1 as C2, read S2 */
+    uint8_t c0c1[1 + RTMP_HANDSHAKE_SIZE];
+    uint8_t s0s1[1 + RTMP_HANDSHAKE_SIZE];
+    uint32_t seed = (uint32_t)st.start_ms ^ ((uint32_t)getpid() << 16);
+    c0c1[0] = 0x03;
+    memset(c0c1 + 1, 0, 8);                    /* time + zero */
+    for (size_t i = 9; i < sizeof(c0c1); i++) {
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+        c0c1[i] = (uint8_t)seed;
+    }
+    if (io_write(&c, c0c1, sizeof(c0c1)) != 0 || io_read(&c, s0s1, sizeof(s0s1)) != 0)
+        goto done;
+    if (s0s1[0] != 0x03) { rc = RTMP_PROBE_EPROTO; goto done; }
+    if (io_write(&c, s0s1 + 1, RTMP_HANDSHAKE_SIZE) != 0 ||
+        io_read(&c, c0c1 + 1, RTMP_HANDSHAKE_SIZE) != 0)  /* S2, contents unused */
+        goto done;
+    out->connect_ms = (int)(now_ms() - st.start_ms);
+    out->handshake_ok = 1;
+
+    if (send_connect(&c, ip, port) != 0) goto done;
+
+    while (!probe_complete(&st)) {
+        chunk_stream_t *cs = read_message(&c);
+        if (!cs) break;
+        switch (cs->type) {
+        case MSG_CMD_AMF0:
+            if (handle_command(&c, &st, cs->buf, cs->length, play_path) != 0) goto evaluate;
+            break;
+        case MSG_DATA_AMF0:
+            handle_metadata(&st, cs->buf, cs->length);
+            break;
+        case MSG_VIDEO:
+            handle_video(&st, cs->buf, cs->length, cs->timestamp);
+            break;
+        case MSG_AGGREGATE:
+            handle_aggregate(&st, cs->buf, cs->length);
+            break;
+        default:
+            if (handle_control(&c, &st, cs) != 0) { rc = RTMP_PROBE_EPROTO; goto done; }
+            break;
+        }
+        if (st.rejected || st.stream_ended) break;
+
+        /* Fall back to packet timestamps once enough frames have arrived */
+        if (out->fps <= 0.0 && st.fps_frames >= RTMP_FPS_SAMPLES && st.fps_last_ts > st.fps_first_ts)
+            out->fps = (double)(st.fps_frames - 1) * 1000.0 / (double)(st.fps_last_ts - st.fps_first_ts);
+    }
+
+evaluate:
+    if (out->fps <= 0.0 && st.fps_frames >= 2 && st.fps_last_ts > st.fps_first_ts)
+        out->fps = (double)(st.fps_frames - 1) * 1000.0 / (double)(st.fps_last_ts - st.fps_first_ts);
+
+    if (st.rejected) {
+        rc = RTMP_PROBE_EREJECT;
+    } else if (probe_complete(&st)) {
+        rc = RTMP_PROBE_OK;
+    } else if (out->got_video || out->got_metadata) {
+        rc = RTMP_PROBE_EPROTO;                /* Stream plays but details are incomplete */
+    }
+
+done:
+    for (int i = 0; i < RTMP_MAX_CSID; i++) free(c.cs[i].buf);
+    close(c.fd);
+    return rc;
+}
@@ -0,0 +1,220 @@
+/*
+ * stream_history.c
+ * --------------------------------------------
+ * Append-only per-camera history files.
+ *
+ * File layout: a 16-byte header (magic, version, record size) followed
+ * by hist_record_t records. A partial record at the end of the file, left
+ * by a crash mid-append, is ignored by readers and cut off by the next
+ * append so later records stay aligned.
+ */
+
+#include "stream_history.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define HIST_MAGIC   "ROCHIST"
+#define HIST_VERSION 1
+#define OUTAGE_DAY_WEIGHT 0.25
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+} hist_header_t;
+
+static void header_fill(hist_header_t *h)
+{
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, HIST_MAGIC, sizeof(HIST_MAGIC));
+    h->version = HIST_VERSION;
+    h->record_size = sizeof(hist_record_t);
+}
+
+static int header_ok(const hist_header_t *h)
+{
+    hist_header_t want;
+    header_fill(&want);
+    return memcmp(h, &want, sizeof(want)) == 0;
+}
+
+/* -------------------------------------------------------------------------- */
+int hist_path(const char *dir, const char *ip, char *buf, size_t len)
+{
+    if (!dir || !ip || !ip[0] || strchr(ip, '/')) return -1;
+    int n = snprintf(buf, len, "%s/%s.hist", dir, ip);
+    return (n < 0 || (size_t)n >= len) ? -1 : 0;
+}
+
+static int read_all(int fd, hist_record_t **out, size_t *count, time_t since)
+{
+    *out = NULL;
+    *count = 0;
+    struct stat st;
+    hist_header_t h;
+    if (fstat(fd, &st) != 0) return -1;
+    if (st.st_size == 0) return 0;
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || !header_ok(&h)) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t n = ((size_t)st.st_size - sizeof(h)) / sizeof(hist_record_t);
+    if (n == 0) return 0;
+    hist_record_t *recs = malloc(n * sizeof(*recs));
+    if (!recs) return -1;
+    ssize_t got = pread(fd, recs, n * sizeof(*recs), sizeof(h));
+    if (got < 0) {
+        free(recs);
+        return -1;
+    }
+    n = (size_t)got / sizeof(*recs);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < n; ++i)
+        if (since == 0 || (time_t)recs[i].time >= since) recs[kept++] = recs[i];
+    *out = recs;
+    *count = kept;
+    return 0;
+}
+
+/**
+ * @brief Rewrite a history file with only recent records.
+ */
+static int compact(const char *path, int fd)
+{
+    hist_record_t *recs = NULL;
+    size_t n = 0;
+    time_t cutoff = time(NULL) - HIST_RETENTION_SEC;
+    if (read_all(fd, &recs, &n, cutoff > 0 ? cutoff : 0) != 0) return -1;
+
+    size_t keep = n > HIST_MAX_RECORDS / 2 ? HIST_MAX_RECORDS / 2 : n;
+    char tmp[512];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        free(recs);
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int out = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        free(recs);
+        return -1;
+    }
+    hist_header_t h;
+    header_fill(&h);
+    size_t bytes = keep * sizeof(*recs);
+    int ok = write(out, &h, sizeof(h)) == (ssize_t)sizeof(h) &&
+             (bytes == 0 || write(out, recs + (n - keep), bytes) == (ssize_t)bytes) &&
+             fsync(out) == 0;
+    close(out);
+    free(recs);
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int hist_append(const char *dir, const char *ip, const hist_record_t *rec)
+{
+    char path[512];
+    if (hist_path(dir, ip, path, sizeof(path)) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(hist_header_t)) {
+        hist_header_t h;
+        header_fill(&h);
+        if (ftruncate(fd, 0) != 0 || write(fd, &h, sizeof(h)) != (ssize_t)sizeof(h)) {
+            close(fd);
+            return -1;
+        }
+        st.st_size = sizeof(h);
+    } else if (((size_t)st.st_size - sizeof(hist_header_t)) % sizeof(*rec) != 0) {
+        st.st_size -= (off_t)(((size_t)st.st_size - sizeof(hist_header_t)) % sizeof(*rec));
+        if (ftruncate(fd, st.st_size) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    if (write(fd, rec, sizeof(*rec)) != (ssize_t)sizeof(*rec)) {
+        close(fd);
+        return -1;
+    }
+
+    size_t records = ((size_t)st.st_size - sizeof(hist_header_t)) / sizeof(*rec) + 1;
+    int rc = records > HIST_MAX_RECORDS ? compact(path, fd) : 0;
+    close(fd);
+    return rc;
+}
+
+int hist_read(const char *dir, const char *ip, time_t since, hist_record_t **out, size_t *count)
+{
+    *out = NULL;
+    *count = 0;
+    char path[512];
+    if (hist_path(dir, ip, path, sizeof(path)) != 0) return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno == ENOENT ? 0 : -1;
+    int rc = read_all(fd, out, count, since);
+    close(fd);
+    return rc;
+}
+
+/* -------------------------------------------------------------------------- */
+void hist_summarise(const hist_record_t *recs, size_t count, long window_sec, hist_stats_t *stats)
+{
+    memset(stats, 0, HIST_MAX_STREAMS * sizeof(*stats));
+    for (size_t i = 0; i < count; ++i) {
+        const hist_record_t *r = &recs[i];
+        if (r->stream >= HIST_MAX_STREAMS) continue;
+        hist_stats_t *s = &stats[r->stream];
+        switch (r->kind) {
+        case HIST_PROBE:
+            s->probes++;
+            if (r->ok) s->probe_ok++;
+            break;
+        case HIST_OUTAGE:
+            s->outages++;
+            break;
+        case HIST_RECOVERY:
+            s->recoveries++;
+            s->down_ms_total += r->value;
+            break;
+        default:
+            break;
+        }
+    }
+    double days = window_sec > 0 ? (double)window_sec / 86400.0 : 1.0;
+    if (days < 1.0) days = 1.0;
+    for (int st = 0; st < HIST_MAX_STREAMS; ++st) {
+        hist_stats_t *s = &stats[st];
+        double success = (double)(s->probe_ok + 1) / (double)(s->probes + 1);
+        s->reliability = success / (1.0 + OUTAGE_DAY_WEIGHT * (double)s->outages / days);
+    }
+}
+
+const char *hist_kind_name(int kind)
+{
+    switch (kind) {
+    case HIST_PROBE:    return "probe";
+    case HIST_SWITCH:   return "switch";
+    case HIST_OUTAGE:   return "outage";
+    case HIST_RECOVERY: return "recovery";
+    default:            return "unknown";
+    }
+}
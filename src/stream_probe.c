@@ -0,0 +1,260 @@
+/*
+ * stream_probe.c
+ * --------------------------------------------
+ * Structured stream probing for videopipe.
+ *
+ * ffprobe is run with its JSON writer on the first video stream and a
+ * few seconds of packets. The stream section gives codec, profile, size,
+ * frame rate and time base; the packet list gives keyframe spacing (GOP)
+ * and, when the container does not advertise one, the bitrate. Packets
+ * flagged corrupt are counted as decode errors, and the time until ffprobe
+ * first writes anything approximates startup latency. The JSON
+ * is parsed with cJSON rather than scraping console text, so unrelated
+ * numbers in log lines can no longer be mistaken for stream properties.
+ */
+
+#include "stream_probe.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+#include <cjson/cJSON.h>
+
+#define FFPROBE_READ_SECONDS "%+5"
+#define FFPROBE_MAX_OUTPUT   (4 * 1024 * 1024)
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Parse an ffprobe rational ("30000/1001") into a double.
+ * @return The value, or 0.0 if the string is missing or degenerate.
+ */
+static double parse_rational(const char *s)
+{
+    long num = 0, den = 0;
+    if (!s || sscanf(s, "%ld/%ld", &num, &den) != 2 || num <= 0 || den <= 0)
+        return 0.0;
+    return (double)num / (double)den;
+}
+
+static const char *json_string(const cJSON *obj, const char *key)
+{
+    const cJSON *it = cJSON_GetObjectItemCaseSensitive(obj, key);
+    return cJSON_IsString(it) ? it->valuestring : NULL;
+}
+
+/* ffprobe prints most numeric fields as strings; accept both forms. */
+static double json_number(const cJSON *obj, const char *key)
+{
+    const cJSON *it = cJSON_GetObjectItemCaseSensitive(obj, key);
+    if (cJSON_IsNumber(it)) return it->valuedouble;
+    if (cJSON_IsString(it) && it->valuestring) return atof(it->valuestring);
+    return 0.0;
+}
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Run ffprobe and collect its stdout, bounded by a deadline.
+ *
+ * @param url          Stream URL.
+ * @param timeout_sec  Child is killed after this many seconds.
+ * @param out_len      Receives the number of bytes collected.
+ * @param first_ms     Receives the time until the first output arrived.
+ * @return malloc'd NUL-terminated output, or NULL on failure.
+ */
+static char *run_ffprobe(const char *url, int timeout_sec, size_t *out_len, int *first_ms)
+{
+    int fds[2];
+    if (pipe(fds) != 0) return NULL;
+
+    pid_t parent = getpid();
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return NULL;
+    }
+    if (pid == 0) {
+        /* Never outlive the probing thread, e.g. when videopipe exits after a
+         * handover with a probe still running */
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != parent) _exit(127);
+        int devnull = open("/dev/null", O_RDWR);
+        if (devnull >= 0) {
+            dup2(devnull, STDIN_FILENO);
+            dup2(devnull, STDERR_FILENO);
+            if (devnull > STDERR_FILENO) close(devnull);
+        }
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        char *argv[] = {
+            "ffprobe", "-v", "error", "-hide_banner",
+            "-rtmp_live", "live",
+            "-select_streams", "v:0",
+            "-show_entries",
+            "stream=codec_name,profile,width,height,avg_frame_rate,r_frame_rate,bit_rate,time_base"
+            ":packet=pts_time,size,flags",
+            "-show_packets",
+            "-read_intervals", FFPROBE_READ_SECONDS,
+            "-of", "json",
+            (char *)url,
+            NULL
+        };
+        execvp("ffprobe", argv);
+        _exit(127);
+    }
+    close(fds[1]);
+
+    size_t cap = 64 * 1024, len = 0;
+    char *buf = malloc(cap);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int timed_out = 0;
+    *first_ms = 0;
+
+    while (buf) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed_ms = (now.tv_sec - start.tv_sec) * 1000L + (now.tv_nsec - start.tv_nsec) / 1000000L;
+        long left_ms = (long)timeout_sec * 1000L - elapsed_ms;
+        if (left_ms <= 0) { timed_out = 1; break; }
+
+        struct pollfd p = { .fd = fds[0], .events = POLLIN, .revents = 0 };
+        int r = poll(&p, 1, (int)left_ms);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) { timed_out = (r == 0); break; }
+
+        if (len + 4096 + 1 > cap) {
+            if (cap >= FFPROBE_MAX_OUTPUT) break;
+            char *nb = realloc(buf, cap * 2);
+            if (!nb) { free(buf); buf = NULL; break; }
+            buf = nb;
+            cap *= 2;
+        }
+        ssize_t n = read(fds[0], buf + len, cap - len - 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        if (len == 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long first = (now.tv_sec - start.tv_sec) * 1000L + (now.tv_nsec - start.tv_nsec) / 1000000L;
+            *first_ms = (int)(first > 0 ? first : 1);
+        }
+        len += (size_t)n;
+    }
+    close(fds[0]);
+
+    if (timed_out) kill(pid, SIGKILL);
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+
+    if (!buf) return NULL;
+    buf[len] = '\0';
+    /* A killed ffprobe never closes its JSON document; treat as failure */
+    if (timed_out || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        free(buf);
+        return NULL;
+    }
+    *out_len = len;
+    return buf;
+}
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Derive GOP length, bitrate, corrupt packets and fallback fps from
+ *        the packet list.
+ */
+static void analyze_packets(const cJSON *packets, stream_info_t *out, int have_bitrate)
+{
+    int count = 0, key_first = -1, key_second = -1;
+    double first_pts = -1.0, last_pts = -1.0, bytes = 0.0;
+    const cJSON *pkt = NULL;
+
+    cJSON_ArrayForEach(pkt, packets) {
+        const char *flags = json_string(pkt, "flags");
+        const char *pts = json_string(pkt, "pts_time");
+        if (flags && flags[0] == 'K') {
+            if (key_first < 0) key_first = count;
+            else if (key_second < 0) key_second = count;
+        }
+        if (flags && strchr(flags, 'C')) out->decode_errors++;
+        if (pts && strcmp(pts, "N/A") != 0) {
+            double t = atof(pts);
+            if (first_pts < 0.0) first_pts = t;
+            last_pts = t;
+        }
+        bytes += json_number(pkt, "size");
+        count++;
+    }
+
+    if (key_first >= 0 && key_second > key_first) out->gop = key_second - key_first;
+
+    double span = last_pts - first_pts;
+    if (count > 1 && span > 0.0) {
+        if (!have_bitrate) out->bitrate_kbps = (int)(bytes * 8.0 / span / 1000.0 + 0.5);
+        if (out->fps <= 0.0) out->fps = (double)(count - 1) / span;
+    }
+}
+
+int ffprobe_stream_info(const char *url, int timeout_sec, stream_info_t *out)
+{
+    if (!url || !out) return -1;
+    memset(out, 0, sizeof(*out));
+
+    size_t len = 0;
+    int first_ms = 0;
+    char *json = run_ffprobe(url, timeout_sec, &len, &first_ms);
+    if (!json) return -1;
+
+    cJSON *root = cJSON_Parse(json);
+    free(json);
+    if (!root) return -1;
+
+    const cJSON *streams = cJSON_GetObjectItemCaseSensitive(root, "streams");
+    const cJSON *stream = cJSON_IsArray(streams) ? cJSON_GetArrayItem(streams, 0) : NULL;
+    if (!cJSON_IsObject(stream)) {
+        cJSON_Delete(root);
+        return -1;
+    }
+
+    out->width = (int)json_number(stream, "width");
+    out->height = (int)json_number(stream, "height");
+    snprintf(out->codec, sizeof(out->codec), "%s", json_string(stream, "codec_name") ? json_string(stream, "codec_name") : "");
+    snprintf(out->profile, sizeof(out->profile), "%s", json_string(stream, "profile") ? json_string(stream, "profile") : "");
+    snprintf(out->time_base, sizeof(out->time_base), "%s", json_string(stream, "time_base") ? json_string(stream, "time_base") : "");
+
+    out->fps = parse_rational(json_string(stream, "avg_frame_rate"));
+    if (out->fps <= 0.0 || out->fps > 240.0) out->fps = parse_rational(json_string(stream, "r_frame_rate"));
+    if (out->fps > 240.0) out->fps = 0.0;    /* r_frame_rate of 1000/1 is the RTMP timebase, not a rate */
+
+    double bit_rate = json_number(stream, "bit_rate");
+    if (bit_rate > 0.0) out->bitrate_kbps = (int)(bit_rate / 1000.0 + 0.5);
+
+    out->startup_ms = first_ms;
+    analyze_packets(cJSON_GetObjectItemCaseSensitive(root, "packets"), out, bit_rate > 0.0);
+    cJSON_Delete(root);
+
+    return (out->width > 0 && out->height > 0) ? 0 : -1;
+}
+
+void stream_info_from_rtmp(const rtmp_probe_result_t *in, stream_info_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->width = in->width;
+    out->height = in->height;
+    out->fps = in->fps;
+    snprintf(out->codec, sizeof(out->codec), "%s", in->codec);
+    snprintf(out->profile, sizeof(out->profile), "%s", in->profile);
+    out->bitrate_kbps = (int)(in->video_kbps + 0.5);
+    snprintf(out->time_base, sizeof(out->time_base), "1/1000");
+    out->startup_ms = in->first_frame_ms;
+}
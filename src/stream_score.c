@@ -0,0 +1,179 @@
+/*
+ * stream_score.c
+ * --------------------------------------------
+ * Stream quality model for videopipe.
+ *
+ * Every term maps a raw metric onto 0..1 with a saturating curve around
+ * a reference value, so no single metric can dominate the weighted mean
+ * no matter how large it gets. Models are kept in a small table; adding
+ * one means adding a scoring function and a name.
+ */
+
+#include "stream_score.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define REF_PIXELS      (1920.0 * 1080.0)   /* Resolution term is 0.5 at 1080p       */
+#define REF_FPS         30.0                /* Frame rate term saturates at 30fps    */
+#define REF_BPP         0.1                 /* Bits per pixel for a clean H.264 feed */
+#define REF_GOP_SEC     1.0                 /* Keyframe at least once a second       */
+#define REF_LATENCY_MS  1000.0              /* Latency term is 0.5 at 1s to frame    */
+#define TERM_UNKNOWN    0.5
+
+static const char *TERM_NAMES[SCORE_TERM_COUNT] = {
+    "resolution", "fps", "bitrate", "gop", "latency", "errors"
+};
+
+static const double DEFAULT_WEIGHTS[SCORE_TERM_COUNT] = {
+    1.0,    /* resolution */
+    1.0,    /* fps        */
+    0.5,    /* bitrate    */
+    0.5,    /* gop        */
+    0.5,    /* latency    */
+    1.0     /* errors     */
+};
+
+typedef double (*score_model_fn)(const score_profile_t *p, const stream_info_t *info, const score_vector_t *v);
+
+static double model_weighted(const score_profile_t *p, const stream_info_t *info, const score_vector_t *v);
+static double model_pixel_rate(const score_profile_t *p, const stream_info_t *info, const score_vector_t *v);
+
+static const struct {
+    const char *name;
+    score_model_fn fn;
+} MODELS[SCORE_MODEL_COUNT] = {
+    [SCORE_MODEL_WEIGHTED]   = { "weighted",   model_weighted },
+    [SCORE_MODEL_PIXEL_RATE] = { "pixel_rate", model_pixel_rate },
+};
+
+static double clamp01(double x)
+{
+    return x < 0.0 ? 0.0 : (x > 1.0 ? 1.0 : x);
+}
+
+/* -------------------------------------------------------------------------- */
+/**
+ * @brief Compute the normalised term vector for a probed stream.
+ */
+static void compute_terms(const stream_info_t *info, score_vector_t *v)
+{
+    double pixels = (double)info->width * (double)info->height;
+
+    v->term[SCORE_TERM_RESOLUTION] = pixels > 0.0 ? pixels / (pixels + REF_PIXELS) : 0.0;
+    v->term[SCORE_TERM_FPS] = clamp01(info->fps / REF_FPS);
+
+    if (info->bitrate_kbps > 0 && pixels > 0.0 && info->fps > 0.0) {
+        double bpp = (double)info->bitrate_kbps * 1000.0 / (pixels * info->fps);
+        v->term[SCORE_TERM_BITRATE] = clamp01(bpp / REF_BPP);
+    } else {
+        v->term[SCORE_TERM_BITRATE] = TERM_UNKNOWN;
+    }
+
+    /* Shorter GOPs let a freshly (re)started feed show a picture sooner */
+    if (info->gop > 0 && info->fps > 0.0) {
+        double gop_sec = (double)info->gop / info->fps;
+        v->term[SCORE_TERM_GOP] = gop_sec <= REF_GOP_SEC ? 1.0 : REF_GOP_SEC / gop_sec;
+    } else {
+        v->term[SCORE_TERM_GOP] = TERM_UNKNOWN;
+    }
+
+    v->term[SCORE_TERM_LATENCY] = info->startup_ms > 0
+        ? REF_LATENCY_MS / (REF_LATENCY_MS + (double)info->startup_ms)
+        : TERM_UNKNOWN;
+
+    v->term[SCORE_TERM_ERRORS] = 1.0 / (1.0 + (double)(info->decode_errors > 0 ? info->decode_errors : 0));
+}
+
+static double model_weighted(const score_profile_t *p, const stream_info_t *info, const score_vector_t *v)
+{
+    (void)info;
+    double sum = 0.0, wsum = 0.0;
+    for (int t = 0; t < SCORE_TERM_COUNT; ++t) {
+        sum += p->weight[t] * v->term[t];
+        wsum += p->weight[t];
+    }
+    return wsum > 0.0 ? 100.0 * sum / wsum : 0.0;
+}
+
+static double model_pixel_rate(const score_profile_t *p, const stream_info_t *info, const score_vector_t *v)
+{
+    (void)p;
+    (void)v;
+    return (double)info->width * (double)info->height * info->fps;
+}
+
+/* -------------------------------------------------------------------------- */
+void score_profile_default(score_profile_t *p)
+{
+    memset(p, 0, sizeof(*p));
+    snprintf(p->name, sizeof(p->name), "default");
+    p->model = SCORE_MODEL_WEIGHTED;
+    memcpy(p->weight, DEFAULT_WEIGHTS, sizeof(p->weight));
+}
+
+int score_profile_from_json(const cJSON *obj, const score_profile_t *base, const char *name,
+                            score_profile_t *out)
+{
+    score_profile_t p = *base;
+    snprintf(p.name, sizeof(p.name), "%s", name ? name : base->name);
+
+    const cJSON *model = cJSON_GetObjectItemCaseSensitive(obj, "model");
+    if (cJSON_IsString(model)) {
+        int found = -1;
+        for (int m = 0; m < SCORE_MODEL_COUNT; ++m)
+            if (strcmp(model->valuestring, MODELS[m].name) == 0) found = m;
+        if (found < 0) return -1;
+        p.model = (score_model_t)found;
+    }
+
+    const cJSON *weights = cJSON_GetObjectItemCaseSensitive(obj, "weights");
+    for (int t = 0; cJSON_IsObject(weights) && t < SCORE_TERM_COUNT; ++t) {
+        const cJSON *w = cJSON_GetObjectItemCaseSensitive(weights, TERM_NAMES[t]);
+        if (!cJSON_IsNumber(w)) continue;
+        if (w->valuedouble < 0.0) return -1;
+        p.weight[t] = w->valuedouble;
+    }
+
+    *out = p;
+    return 0;
+}
+
+double stream_score(const score_profile_t *p, const stream_info_t *info, score_vector_t *terms)
+{
+    score_vector_t v;
+    compute_terms(info, &v);
+    if (terms) *terms = v;
+    int m = (int)p->model;
+    if (m < 0 || m >= SCORE_MODEL_COUNT) m = SCORE_MODEL_WEIGHTED;
+    return MODELS[m].fn(p, info, &v);
+}
+
+const char *score_term_name(int term)
+{
+    return (term >= 0 && term < SCORE_TERM_COUNT) ? TERM_NAMES[term] : "unknown";
+}
+
+const char *score_model_name(score_model_t model)
+{
+    int m = (int)model;
+    return (m >= 0 && m < SCORE_MODEL_COUNT) ? MODELS[m].name : "unknown";
+}
+
+/* -------------------------------------------------------------------------- */
+cJSON *score_vector_to_json(const score_vector_t *v)
+{
+    cJSON *o = cJSON_CreateObject();
+    for (int t = 0; o && t < SCORE_TERM_COUNT; ++t)
+        cJSON_AddNumberToObject(o, TERM_NAMES[t], v->term[t]);
+    return o;
+}
+
+void score_vector_from_json(const cJSON *obj, score_vector_t *v)
+{
+    memset(v, 0, sizeof(*v));
+    for (int t = 0; cJSON_IsObject(obj) && t < SCORE_TERM_COUNT; ++t) {
+        const cJSON *it = cJSON_GetObjectItemCaseSensitive(obj, TERM_NAMES[t]);
+        if (cJSON_IsNumber(it)) v->term[t] = it->valuedouble;
+    }
+}
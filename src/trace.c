@@ -0,0 +1,229 @@
+/*
+ * trace.c
+ * --------------------------------------------
+ * Per-thread span buffers and the Chrome trace writer.
+ */
+
+#define _GNU_SOURCE
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define CHUNK_EVENTS    64      /* Events per buffer; a thread takes another when it fills */
+#define NAME_MAX_LEN    32
+#define MAX_TRACKS      64
+#define TRACK_TID_BASE  1000000 /* Track rows use tids no thread has */
+
+struct trace_event {
+    uint64_t start_ns;
+    uint64_t end_ns;
+    const char *cat;
+    const char *name;
+    int track;                  /* -1: the thread that owns the chunk */
+    char args[TRACE_ARGS_MAX];
+};
+
+/* Written only by its thread; used is published with release so the
+ * writer in trace_close() sees complete events */
+struct chunk {
+    struct chunk *next;
+    int tid;
+    char name[NAME_MAX_LEN];
+    _Atomic size_t used;
+    struct trace_event ev[CHUNK_EVENTS];
+};
+
+_Atomic int trace_enabled = 0;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct chunk *chunks = NULL;         /* Every chunk handed out, under lock */
+static _Atomic long budget = 0;             /* Events that may still get a chunk slot */
+static _Atomic uint64_t dropped = 0;
+static char out_path[512];
+static char program_name[NAME_MAX_LEN];
+static char track_names[MAX_TRACKS][NAME_MAX_LEN];
+
+static _Thread_local struct chunk *local = NULL;
+static _Thread_local char local_name[NAME_MAX_LEN];
+
+/* -------------------------------------------------------------------------- */
+uint64_t trace_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Next free event of the calling thread, or NULL once the budget is spent */
+static struct trace_event *next_event(void)
+{
+    struct chunk *c = local;
+    if (c && atomic_load_explicit(&c->used, memory_order_relaxed) < CHUNK_EVENTS)
+        return &c->ev[atomic_load_explicit(&c->used, memory_order_relaxed)];
+    if (atomic_fetch_sub(&budget, CHUNK_EVENTS) < CHUNK_EVENTS) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+    c = calloc(1, sizeof(*c));
+    if (!c) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+    c->tid = (int)syscall(SYS_gettid);
+    memcpy(c->name, local_name, sizeof(c->name));
+    pthread_mutex_lock(&lock);
+    c->next = chunks;
+    chunks = c;
+    pthread_mutex_unlock(&lock);
+    local = c;
+    return &c->ev[0];
+}
+
+static void commit_event(void)
+{
+    atomic_fetch_add_explicit(&local->used, 1, memory_order_release);
+}
+
+void trace_span_record(const trace_span_t *s, uint64_t end_ns)
+{
+    if (!atomic_load_explicit(&trace_enabled, memory_order_relaxed)) return;
+    struct trace_event *e = next_event();
+    if (!e) return;
+    e->start_ns = s->start_ns;
+    e->end_ns = end_ns;
+    e->cat = s->cat;
+    e->name = s->name;
+    e->track = -1;
+    memcpy(e->args, s->args, sizeof(e->args));
+    commit_event();
+}
+
+void trace_complete(int track, const char *cat, const char *name, uint64_t start_ns, uint64_t end_ns,
+                    const char *fmt, ...)
+{
+    if (!trace_on()) return;
+    struct trace_event *e = next_event();
+    if (!e) return;
+    e->start_ns = start_ns;
+    e->end_ns = end_ns >= start_ns ? end_ns : start_ns;
+    e->cat = cat;
+    e->name = name;
+    e->track = track >= 0 && track < MAX_TRACKS ? track : -1;
+    e->args[0] = '\0';
+    if (fmt) {
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(e->args, sizeof(e->args), fmt, ap);
+        va_end(ap);
+    }
+    commit_event();
+}
+
+void trace_span_args_(trace_span_t *s, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(s->args, sizeof(s->args), fmt, ap);
+    va_end(ap);
+}
+
+void trace_thread_name(const char *name)
+{
+    if (!trace_on()) return;
+    snprintf(local_name, sizeof(local_name), "%s", name);
+    if (local) memcpy(local->name, local_name, sizeof(local->name));
+}
+
+void trace_track_name(int track, const char *name)
+{
+    if (!trace_on() || track < 0 || track >= MAX_TRACKS) return;
+    pthread_mutex_lock(&lock);
+    snprintf(track_names[track], sizeof(track_names[track]), "%s", name);
+    pthread_mutex_unlock(&lock);
+}
+
+/* -------------------------------------------------------------------------- */
+int trace_open(const char *program)
+{
+    const char *dir = getenv(TRACE_ENV);
+    if (!ROC_TRACE_SPANS || !dir || !dir[0]) return 0;
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+    if (access(dir, W_OK) != 0) return -1;
+    snprintf(out_path, sizeof(out_path), "%s/%s-%d.json", dir, program, (int)getpid());
+    snprintf(program_name, sizeof(program_name), "%s", program);
+    snprintf(local_name, sizeof(local_name), "main");
+    atomic_store(&budget, TRACE_MAX_EVENTS);
+    atomic_store(&trace_enabled, 1);
+    return 0;
+}
+
+/* JSON string contents, escaped */
+static void put_escaped(FILE *f, const char *s)
+{
+    for (; *s; ++s) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch == '"' || ch == '\\') fprintf(f, "\\%c", ch);
+        else if (ch < 0x20) fprintf(f, "\\u%04x", ch);
+        else fputc(ch, f);
+    }
+}
+
+static void put_meta(FILE *f, const char *what, int pid, int tid, const char *name, int *first)
+{
+    fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"", *first ? "" : ",", what, pid, tid);
+    put_escaped(f, name);
+    fprintf(f, "\"}}");
+    *first = 0;
+}
+
+void trace_close(void)
+{
+    if (!atomic_exchange(&trace_enabled, 0)) return;
+    char tmp[sizeof(out_path) + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", out_path);
+    FILE *f = fopen(tmp, "w");
+    int pid = (int)getpid(), first = 1;
+    pthread_mutex_lock(&lock);
+    if (f) {
+        fprintf(f, "{\"traceEvents\":[");
+        put_meta(f, "process_name", pid, 0, program_name, &first);
+        for (const struct chunk *c = chunks; c; c = c->next)
+            if (c->name[0]) put_meta(f, "thread_name", pid, c->tid, c->name, &first);
+        for (int t = 0; t < MAX_TRACKS; ++t)
+            if (track_names[t][0]) put_meta(f, "thread_name", pid, TRACK_TID_BASE + t, track_names[t], &first);
+        for (const struct chunk *c = chunks; c; c = c->next) {
+            size_t n = atomic_load_explicit(&c->used, memory_order_acquire);
+            for (size_t i = 0; i < n; ++i) {
+                const struct trace_event *e = &c->ev[i];
+                fprintf(f, ",\n{\"name\":\"");
+                put_escaped(f, e->name);
+                fprintf(f, "\",\"cat\":\"");
+                put_escaped(f, e->cat);
+                fprintf(f, "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d",
+                        e->start_ns / 1000.0, (e->end_ns - e->start_ns) / 1000.0, pid,
+                        e->track >= 0 ? TRACK_TID_BASE + e->track : c->tid);
+                if (e->args[0]) {
+                    fprintf(f, ",\"args\":{\"detail\":\"");
+                    put_escaped(f, e->args);
+                    fprintf(f, "\"}");
+                }
+                fputc('}', f);
+            }
+        }
+        fprintf(f, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%llu}}\n",
+                (unsigned long long)atomic_load(&dropped));
+    }
+    /* Threads may outlive this call; their chunks are left allocated */
+    pthread_mutex_unlock(&lock);
+    if (f && fclose(f) == 0) rename(tmp, out_path);
+    else if (f) unlink(tmp);
+}
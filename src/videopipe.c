@@ -16,68 +16,126 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
-#include <sys/select.h>
-#include <sys/time.h>
-#include <ctype.h>
+#include <pthread.h>
+#include <poll.h>
 
 #include <cjson/cJSON.h>
 
+#include "rtmp_probe.h"
+#include "stream_probe.h"
+#include "reprobe.h"
+#include "stream_score.h"
+#include "admission.h"
+#include "reachability.h"
+#include "conn_diag.h"
+#include "netlink_monitor.h"
+#include "discovery_cache.h"
+#include "cache_persist.h"
+#include "stream_history.h"
+#include "proc_state.h"
+#include "handoff.h"
+#include "async_log.h"
+#include "roc_log.h"
+#include "log_tail.h"
+#include "event_journal.h"
+#include "metrics.h"
+#include "proc_stats.h"
+#include "trace.h"
+#include "log_capture.h"
+#include "frame_hist.h"
+
 /* Explicit declaration of environ */
 extern char **environ;
 
 /* Configuration */
 static const char *CAMERAS_CONFIG = "/etc/roc/cameras.json";
-static const char *DISCOVERY_CACHE = "/var/lib/roc/camera_discovery.json";
+static const char *VIDEOPIPE_CONFIG = "/etc/roc/videopipe.json";
+static const char *DISCOVERY_CACHE = "/var/lib/roc/camera_discovery.json"; // Human-readable import/export
+static const char *DISCOVERY_CACHE_BIN = "/var/lib/roc/camera_discovery.bin";
+static const char *HISTORY_DIR = "/var/lib/roc/history";
+static const char *PROC_STATE_FILE = "/run/roc/videopipe.state"; // Running ffmpeg table for adoption after a restart
+static const char *HANDOFF_SOCKET = "/run/roc/videopipe.sock"; // A new videopipe --takeover connects here
 static const char *LOG_DIR = "/var/log/cameras";
 static const char *ERROR_LOG = "/var/log/ffmpeg_errors.log";
+static const char *LOG_TAIL_OFFSETS = "/var/lib/roc/log_tail.offsets"; // Read position in each camera log
 static const char *LOG_FILE = "/var/log/videopipe.log";
 static const char *STREAM_TYPES[] = {"main", "ext", "sub"};
 static const size_t STREAM_TYPES_COUNT = 3;
 static const int CACHE_TTL_SECONDS = 14 * 24 * 60 * 60;
 static const int TEST_TIMEOUT = 15;
-static const int MAX_CAMERAS = 16; // Match Python's 16 camera limit
+static const int NATIVE_PROBE_TIMEOUT_MS = 3000; // Native RTMP probe budget per stream
+enum { MAX_CAMERAS = 16 }; // Match Python's 16 camera limit; a constant expression, so it can size static arrays
 static const int VIDEO_DEVICE_OFFSET = 10; // Start from /dev/video10
+static const int REPROBE_INTERVAL = 30; // At most one background re-probe per 30 seconds
+static const int REPROBE_ALT_MAX_AGE = 15 * 60; // Re-score each alternative every 15 minutes
+static const int REPROBE_MIN_UPTIME = 60; // Only re-probe cameras that have been streaming a while
+static const int RECOVERY_WARN_ATTEMPTS = 12; // Log once when a camera is still down after this many attempts
+static const int HISTORY_WINDOW = 7 * 24 * 60 * 60; // History considered when ranking streams
+static const int TAKEOVER_TIMEOUT_MS = 30000; // Wait for the old videopipe to hand over and exit
+static const int HANDOVER_ATTEMPT_WAIT_MS = 5000; // After a handover, wait this long for recovery attempts to stop
+static const int HEARTBEAT_INTERVAL_MS = 2000; // main_controller restarts videopipe after 30 s without one
 static volatile sig_atomic_t exit_flag = 0;
+static volatile sig_atomic_t detach_children = 0; /* SIGHUP: exit but leave ffmpeg running for the next videopipe */
+static volatile sig_atomic_t reload_log_levels = 0; /* SIGUSR1: re-read LOG_LEVELS_FILE */
+static _Atomic int handed_over = 0; /* A successor took over; recovery attempts stop after their current probe */
+static int heartbeat_fd = -1; /* --heartbeat-fd: pipe to the main_controller supervising us */
 
 /* Logging */
-static FILE *logf = NULL;
+static int log_opened = 0;
+
+/* roc_log sink: lines that pass the level filters are queued for the log writer */
+static void log_sink(int level, int sub, const char *fmt, va_list ap) {
+    (void)sub;
+    alog_vwrite(roc_log_level_name(level), fmt, ap);
+}
 
 static void log_open(void) {
-    if (logf) {
-        fprintf(stderr, "[DEBUG] Log file already open\n");
+    if (log_opened) {
+        ROC_DEBUG(RLOG_MAIN, "Log file already open");
         return;
     }
-    fprintf(stderr, "[DEBUG] Attempting to open log file %s\n", LOG_FILE);
+    ROC_DEBUG(RLOG_MAIN, "Attempting to open log file %s", LOG_FILE);
     if (access(LOG_DIR, F_OK) != 0) {
-        fprintf(stderr, "[DEBUG] Creating log directory %s\n", LOG_DIR);
+        ROC_DEBUG(RLOG_MAIN, "Creating log directory %s", LOG_DIR);
         if (mkdir(LOG_DIR, 0755) != 0) {
-            fprintf(stderr, "[ERROR] Failed to create %s: %s\n", LOG_DIR, strerror(errno));
+            ROC_ERROR(RLOG_MAIN, "Failed to create %s: %s", LOG_DIR, strerror(errno));
         }
     }
-    logf = fopen(LOG_FILE, "a");
-    if (!logf) {
-        fprintf(stderr, "[ERROR] Failed to open %s: %s, using stderr\n", LOG_FILE, strerror(errno));
-        logf = stderr;
+    /* Lines are queued on per-thread rings and written by a background thread */
+    log_opened = 1;
+    int rc = alog_open(LOG_FILE);
+    roc_log_set_sink(log_sink);
+    if (rc != 0) {
+        ROC_ERROR(RLOG_MAIN, "Failed to open %s: %s, using stderr", LOG_FILE, strerror(errno));
+        return;
     }
-    setvbuf(logf, NULL, _IOLBF, 0);
-    fprintf(stderr, "[DEBUG] Log file opened successfully\n");
+    ROC_DEBUG(RLOG_MAIN, "Log file opened successfully");
 }
 
-static void log_msg(const char *lvl, const char *fmt, ...) {
-    FILE *out = logf ? logf : stderr;
-    va_list ap; va_start(ap, fmt);
-    char tbuf[64]; time_t now = time(NULL); struct tm tm; localtime_r(&now, &tm);
-    strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", &tm);
-    fprintf(out, "%s - %s - ", tbuf, lvl);
-    vfprintf(out, fmt, ap);
-    fprintf(out, "\n");
-    if (out != stderr) fflush(out);
-    va_end(ap);
+/* Flush queued lines and stop the log writer; later lines go to stderr */
+static void log_close(void) {
+    alog_close();
+    log_opened = 0;
+}
+
+/* Load per-subsystem levels from LOG_LEVELS_FILE and $ROC_LOG */
+static void log_configure(void) {
+    char desc[256];
+    if (roc_log_configure(LOG_LEVELS_FILE) != 0)
+        ROC_ERROR(RLOG_MAIN, "Invalid log levels in %s or $ROC_LOG (%s), keeping current levels",
+                  LOG_LEVELS_FILE, strerror(errno));
+    roc_log_describe(desc, sizeof(desc));
+    ROC_INFO(RLOG_MAIN, "Log levels: %s", desc);
 }
 
 static void handle_signal(int sig) { 
-    log_msg("INFO", "Signal %d received, setting exit_flag", sig); 
-    exit_flag = 1; 
+    /* No logging here: the interrupted thread may be mid-way through a log line */
+    if (sig == SIGUSR1) {
+        reload_log_levels = 1;
+        return;
+    }
+    if (sig == SIGHUP) detach_children = 1;
+    exit_flag = sig; 
 }
 
 /* Camera structures */
@@ -85,19 +143,49 @@ static void handle_signal(int sig) {
 #define USER_MAX 64
 #define PASS_MAX 128
 #define RES_MAX 64
+#define STREAM_ALT_MAX 3 /* One slot per entry in STREAM_TYPES */
+#define SCORE_PROFILES_MAX 8
+
+struct camera_cfg {
+    char ip[IP_MAX]; char user[USER_MAX]; char password[PASS_MAX];
+    int profile; /* Index into score_profiles */
+    int program; /* Program (on-air) camera: recovered before the others */
+};
 
-struct camera_cfg { char ip[IP_MAX]; char user[USER_MAX]; char password[PASS_MAX]; };
+/* Last probe outcome for one stream type of a camera (main/ext/sub) */
+struct stream_alt { int ok; stream_info_t info; double score; score_vector_t terms; time_t last_probe; };
 
-struct discovery_entry { char ip[IP_MAX]; char best_stream[32]; char resolution[RES_MAX]; double fps; double score; time_t last_success; };
+struct discovery_entry {
+    char ip[IP_MAX]; char best_stream[32]; char resolution[RES_MAX]; double fps; double score; time_t last_success;
+    /* Structured stream details from the last successful probe */
+    char codec[16]; char profile[32]; int bitrate_kbps; int gop; char time_base[24];
+    int startup_ms; int decode_errors;
+    /* Scoring profile and per-term breakdown behind the score */
+    char score_profile[SCORE_PROFILE_NAME_MAX]; score_vector_t terms;
+    /* Rolling re-probe results for every stream type, indexed like STREAM_TYPES */
+    struct stream_alt alts[STREAM_ALT_MAX];
+};
 
-struct running_proc { pid_t pid; int cam_index; int stream_index; int alive; };
+struct running_proc { 
+    pid_t pid; 
+    int cam_index; 
+    int stream_index; 
+    int alive; 
+    time_t started; 
+    int degraded;               /* Last passive check flagged high RTT or retransmits */
+    int adopted;                /* Started by a previous videopipe; not our child */
+    unsigned long long start_ticks; /* From /proc/<pid>/stat, to tell a reused pid apart */
+    int pidfd;                  /* Adopted only: reports the exit of a process we cannot wait for, or -1 */
+    pid_t err_pid;              /* Process that err_base was taken for */
+    uint64_t err_base;          /* Decode and I/O errors in the camera log at the last error check */
+};
 
-/* Safe strncpy */
+/* Safe strncpy: copies at most n-1 bytes and always terminates */
 static void safe_strncpy(char *dst, const char *src, size_t n) { 
-    if (!dst) return; 
-    if (!src) { if (n) dst[0] = '\0'; return; } 
-    strncpy(dst, src, n-1); 
-    dst[n-1] = '\0'; 
+    if (!dst || !n) return; 
+    size_t len = src ? strnlen(src, n - 1) : 0;
+    if (len) memcpy(dst, src, len);
+    dst[len] = '\0'; 
 }
 
 /* Check if a specific video device exists */
@@ -105,16 +193,16 @@ static int device_exists(int index) {
     char name[64]; 
     snprintf(name, sizeof(name), "/dev/video%d", index + VIDEO_DEVICE_OFFSET); 
     int exists = access(name, F_OK) == 0;
-    log_msg("DEBUG", "Checking device %s: %s", name, exists ? "exists" : "missing");
+    ROC_DEBUG(RLOG_DEVICE, "Checking device %s: %s", name, exists ? "exists" : "missing");
     return exists; 
 }
 
 /* List available video devices in /dev */
 static int list_video_devices(int *video_indices, size_t *count) {
-    log_msg("DEBUG", "Listing video devices in /dev");
+    ROC_DEBUG(RLOG_DEVICE, "Listing video devices in /dev");
     DIR *dir = opendir("/dev");
     if (!dir) {
-        log_msg("ERROR", "Failed to open /dev: %s", strerror(errno));
+        ROC_ERROR(RLOG_DEVICE, "Failed to open /dev: %s", strerror(errno));
         return -1;
     }
     size_t idx = 0;
@@ -124,51 +212,286 @@ static int list_video_devices(int *video_indices, size_t *count) {
             int num = atoi(entry->d_name + 5);
             if (num >= VIDEO_DEVICE_OFFSET && num <= VIDEO_DEVICE_OFFSET + MAX_CAMERAS - 1) {
                 video_indices[idx++] = num;
-                log_msg("DEBUG", "Found video device /dev/video%d", num);
+                ROC_DEBUG(RLOG_DEVICE, "Found video device /dev/video%d", num);
             }
         }
     }
     closedir(dir);
     *count = idx;
-    log_msg("INFO", "Found %zu video devices", *count);
+    ROC_INFO(RLOG_DEVICE, "Found %zu video devices", *count);
+    return 0;
+}
+
+/* Recovery admission limits, overridable under "recovery" in videopipe.json */
+static struct {
+    int max_concurrent_probes; /* Recovery attempts probing at the same time */
+    double probe_rate;         /* Attempts admitted per second */
+    double probe_burst;
+    double spawn_rate;         /* ffmpeg starts admitted per second */
+    double spawn_burst;
+    int backoff_base_ms;       /* First retry delay, doubled per failure */
+    int backoff_max_ms;
+} recovery_cfg = { 4, 4.0, 4.0, 2.0, 2.0, 1000, 30000 };
+
+/* Health check of live cameras, overridable under "health" in videopipe.json.
+ * The passive sock_diag check is preferred; connect sweeps are the fallback
+ * when the kernel does not offer inet_diag. */
+static struct {
+    int interval_sec;          /* Seconds between reachability sweeps (>= 1) */
+    int timeout_ms;            /* Connect deadline per camera within a sweep */
+    int passive_interval_sec;  /* Seconds between sock_diag reads of the ffmpeg sockets */
+    int stall_ms;              /* No data received for this long means the stream is dead */
+    int rtt_warn_ms;           /* Smoothed RTT above this is reported as degraded */
+    int connect_grace_sec;     /* Time ffmpeg gets to open its RTMP connection */
+    int error_burst;           /* Decode or I/O errors logged within one passive interval that force a restart */
+} health_cfg = { 60, 2000, 5, 10000, 500, 20, 50 };
+
+/* Cache persistence, overridable under "cache" in videopipe.json */
+static struct {
+    int write_window_ms;       /* Changes within this window are written together */
+    cache_sync_t sync;         /* msync policy applied to each batch */
+} cache_cfg = { 2000, CACHE_SYNC_ALWAYS };
+
+/* Metrics endpoint, overridable under "metrics" in videopipe.json */
+static struct {
+    char address[64];          /* Listen address; keep it on loopback */
+    int port;                  /* 0 turns the endpoint off */
+} metrics_cfg = { METRICS_ADDR, METRICS_PORT_VIDEOPIPE };
+
+/* Resource accounting of the FFmpeg children, overridable under "resources" in videopipe.json */
+static struct {
+    int sample_interval_sec;   /* Seconds between /proc samples; 0 turns sampling off */
+    int reprobe_cpu_limit_pct; /* Background re-probes wait while the children use more than
+                                  this share of all CPUs; 0 never holds them back */
+} resources_cfg = { 5, 80 };
+
+/* Capture of FFmpeg's output, overridable under "capture" in videopipe.json */
+static struct {
+    int ring_kb;               /* Output held per camera; 0 lets FFmpeg append to its log directly */
+    int flush_kb_per_sec;      /* Write rate of each camera<N>.log */
+    int file_max_kb;           /* Size at which camera<N>.log is rotated */
+    int files;                 /* Rotated logs kept; 0 truncates instead */
+    int exit_dump_kb;          /* Output tail written to camera<N>.exit.log when FFmpeg exits */
+} capture_cfg = { 256, 64, 4096, 3, 64 };
+static int capture_on = 0;     /* The capture thread runs; children write into its pipes */
+
+/* Frame-interval histograms, overridable under "frames" in videopipe.json */
+static struct {
+    int enabled;               /* Read every /dev/videoN alongside the viewers */
+} frames_cfg = { 1 };
+static int frames_on = 0;      /* The frame reader runs */
+
+/* Scoring profiles: index 0 is the default, the rest are named in videopipe.json */
+static score_profile_t score_profiles[SCORE_PROFILES_MAX];
+static size_t score_profile_count = 0;
+
+static int find_score_profile(const char *name) {
+    for (size_t i = 0; i < score_profile_count; ++i)
+        if (strcmp(score_profiles[i].name, name) == 0) return (int)i;
+    return -1;
+}
+
+/* Optional videopipe settings: {"scoring": {"default": {...}, "profiles": {"name": {...}}},
+ * "recovery": {...}, "health": {...}, "cache": {...}, "metrics": {...}, "resources": {...},
+ * "capture": {...}, "frames": {...}}.
+ * A missing file keeps the built-in defaults. */
+static int load_videopipe_json(void) {
+    score_profile_default(&score_profiles[0]);
+    score_profile_count = 1;
+    ROC_DEBUG(RLOG_CONFIG, "Loading videopipe config from %s", VIDEOPIPE_CONFIG);
+    FILE *f = fopen(VIDEOPIPE_CONFIG, "r");
+    if (!f) {
+        ROC_INFO(RLOG_CONFIG, "%s not found, using default scoring", VIDEOPIPE_CONFIG);
+        return 0;
+    }
+    fseek(f, 0, SEEK_END); long len = ftell(f); fseek(f, 0, SEEK_SET);
+    if (len <= 0 || len > 1024 * 1024) {
+        fclose(f);
+        ROC_ERROR(RLOG_CONFIG, "Invalid videopipe config length %ld", len);
+        return -1;
+    }
+    char *buf = malloc((size_t)len + 1);
+    if (!buf) {
+        fclose(f);
+        ROC_ERROR(RLOG_CONFIG, "malloc failed for videopipe config buffer");
+        return -1;
+    }
+    fread(buf, 1, (size_t)len, f); buf[len] = '\0'; fclose(f);
+    cJSON *root = cJSON_Parse(buf); free(buf);
+    if (!root || !cJSON_IsObject(root)) {
+        ROC_ERROR(RLOG_CONFIG, "%s root not object", VIDEOPIPE_CONFIG);
+        if (root) cJSON_Delete(root);
+        return -1;
+    }
+    cJSON *scoring = cJSON_GetObjectItemCaseSensitive(root, "scoring");
+    cJSON *def = cJSON_GetObjectItemCaseSensitive(scoring, "default");
+    if (cJSON_IsObject(def) && score_profile_from_json(def, &score_profiles[0], "default", &score_profiles[0]) != 0)
+        ROC_WARN(RLOG_CONFIG, "Invalid default scoring profile, using built-in weights");
+    cJSON *profiles = cJSON_GetObjectItemCaseSensitive(scoring, "profiles");
+    if (!cJSON_IsObject(profiles)) profiles = NULL;
+    cJSON *it = NULL;
+    cJSON_ArrayForEach(it, profiles) {
+        if (!cJSON_IsObject(it) || !it->string || find_score_profile(it->string) >= 0) {
+            ROC_WARN(RLOG_CONFIG, "Skipping invalid or duplicate scoring profile");
+            continue;
+        }
+        if (score_profile_count >= SCORE_PROFILES_MAX) {
+            ROC_WARN(RLOG_CONFIG, "Reached SCORE_PROFILES_MAX limit (%d)", SCORE_PROFILES_MAX);
+            break;
+        }
+        /* Named profiles inherit anything they do not override from the default */
+        if (score_profile_from_json(it, &score_profiles[0], it->string, &score_profiles[score_profile_count]) != 0) {
+            ROC_WARN(RLOG_CONFIG, "Scoring profile %s has an unknown model or negative weight, skipping", it->string);
+            continue;
+        }
+        score_profile_count++;
+    }
+    cJSON *recovery = cJSON_GetObjectItemCaseSensitive(root, "recovery");
+    if (cJSON_IsObject(recovery)) {
+        cJSON *v;
+        if ((v = cJSON_GetObjectItemCaseSensitive(recovery, "max_concurrent_probes")) && cJSON_IsNumber(v) && v->valueint > 0)
+            recovery_cfg.max_concurrent_probes = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(recovery, "probe_rate")) && cJSON_IsNumber(v) && v->valuedouble > 0)
+            recovery_cfg.probe_rate = v->valuedouble;
+        if ((v = cJSON_GetObjectItemCaseSensitive(recovery, "probe_burst")) && cJSON_IsNumber(v) && v->valuedouble >= 1)
+            recovery_cfg.probe_burst = v->valuedouble;
+        if ((v = cJSON_GetObjectItemCaseSensitive(recovery, "spawn_rate")) && cJSON_IsNumber(v) && v->valuedouble > 0)
+            recovery_cfg.spawn_rate = v->valuedouble;
+        if ((v = cJSON_GetObjectItemCaseSensitive(recovery, "spawn_burst")) && cJSON_IsNumber(v) && v->valuedouble >= 1)
+            recovery_cfg.spawn_burst = v->valuedouble;
+        if ((v = cJSON_GetObjectItemCaseSensitive(recovery, "backoff_base_ms")) && cJSON_IsNumber(v) && v->valueint > 0)
+            recovery_cfg.backoff_base_ms = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(recovery, "backoff_max_ms")) && cJSON_IsNumber(v) && v->valueint > 0)
+            recovery_cfg.backoff_max_ms = v->valueint;
+    }
+    cJSON *health = cJSON_GetObjectItemCaseSensitive(root, "health");
+    if (cJSON_IsObject(health)) {
+        cJSON *v;
+        if ((v = cJSON_GetObjectItemCaseSensitive(health, "interval_sec")) && cJSON_IsNumber(v) && v->valueint >= 1)
+            health_cfg.interval_sec = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(health, "timeout_ms")) && cJSON_IsNumber(v) && v->valueint > 0)
+            health_cfg.timeout_ms = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(health, "passive_interval_sec")) && cJSON_IsNumber(v) && v->valueint >= 1)
+            health_cfg.passive_interval_sec = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(health, "stall_ms")) && cJSON_IsNumber(v) && v->valueint > 0)
+            health_cfg.stall_ms = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(health, "rtt_warn_ms")) && cJSON_IsNumber(v) && v->valueint > 0)
+            health_cfg.rtt_warn_ms = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(health, "connect_grace_sec")) && cJSON_IsNumber(v) && v->valueint >= 0)
+            health_cfg.connect_grace_sec = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(health, "error_burst")) && cJSON_IsNumber(v) && v->valueint >= 0)
+            health_cfg.error_burst = v->valueint;
+    }
+    cJSON *cache = cJSON_GetObjectItemCaseSensitive(root, "cache");
+    if (cJSON_IsObject(cache)) {
+        cJSON *v;
+        if ((v = cJSON_GetObjectItemCaseSensitive(cache, "write_window_ms")) && cJSON_IsNumber(v) && v->valueint >= 0)
+            cache_cfg.write_window_ms = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(cache, "sync")) && cJSON_IsString(v) &&
+            cache_sync_from_name(v->valuestring, &cache_cfg.sync) != 0)
+            ROC_WARN(RLOG_CONFIG, "Unknown cache sync policy %s, keeping %s", v->valuestring, cache_sync_name(cache_cfg.sync));
+    }
+    cJSON *metrics = cJSON_GetObjectItemCaseSensitive(root, "metrics");
+    if (cJSON_IsObject(metrics)) {
+        cJSON *v;
+        if ((v = cJSON_GetObjectItemCaseSensitive(metrics, "port")) && cJSON_IsNumber(v) && v->valueint >= 0 && v->valueint <= 65535)
+            metrics_cfg.port = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(metrics, "address")) && cJSON_IsString(v))
+            safe_strncpy(metrics_cfg.address, v->valuestring, sizeof(metrics_cfg.address));
+    }
+    cJSON *resources = cJSON_GetObjectItemCaseSensitive(root, "resources");
+    if (cJSON_IsObject(resources)) {
+        cJSON *v;
+        if ((v = cJSON_GetObjectItemCaseSensitive(resources, "sample_interval_sec")) && cJSON_IsNumber(v) && v->valueint >= 0)
+            resources_cfg.sample_interval_sec = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(resources, "reprobe_cpu_limit_pct")) && cJSON_IsNumber(v) &&
+            v->valueint >= 0 && v->valueint <= 100)
+            resources_cfg.reprobe_cpu_limit_pct = v->valueint;
+    }
+    cJSON *capture = cJSON_GetObjectItemCaseSensitive(root, "capture");
+    if (cJSON_IsObject(capture)) {
+        cJSON *v;
+        if ((v = cJSON_GetObjectItemCaseSensitive(capture, "ring_kb")) && cJSON_IsNumber(v) && v->valueint >= 0 &&
+            v->valueint <= 65536)
+            capture_cfg.ring_kb = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(capture, "flush_kb_per_sec")) && cJSON_IsNumber(v) && v->valueint > 0)
+            capture_cfg.flush_kb_per_sec = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(capture, "file_max_kb")) && cJSON_IsNumber(v) && v->valueint > 0)
+            capture_cfg.file_max_kb = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(capture, "files")) && cJSON_IsNumber(v) && v->valueint >= 0 &&
+            v->valueint <= 99)
+            capture_cfg.files = v->valueint;
+        if ((v = cJSON_GetObjectItemCaseSensitive(capture, "exit_dump_kb")) && cJSON_IsNumber(v) && v->valueint >= 0)
+            capture_cfg.exit_dump_kb = v->valueint;
+    }
+    cJSON *frames = cJSON_GetObjectItemCaseSensitive(root, "frames");
+    if (cJSON_IsObject(frames)) {
+        cJSON *v;
+        if ((v = cJSON_GetObjectItemCaseSensitive(frames, "enabled")) && cJSON_IsBool(v))
+            frames_cfg.enabled = cJSON_IsTrue(v);
+    }
+    cJSON_Delete(root);
+    ROC_INFO(RLOG_CONFIG, "Cache writes: %dms coalescing window, sync=%s", cache_cfg.write_window_ms, cache_sync_name(cache_cfg.sync));
+    ROC_INFO(RLOG_CONFIG, "Health check: passive every %ds (stall %dms, rtt warn %dms, grace %ds, error burst %d), fallback sweep every %ds with %dms deadline",
+            health_cfg.passive_interval_sec, health_cfg.stall_ms, health_cfg.rtt_warn_ms, health_cfg.connect_grace_sec,
+            health_cfg.error_burst, health_cfg.interval_sec, health_cfg.timeout_ms);
+    ROC_INFO(RLOG_CONFIG, "Recovery admission: %d concurrent probes, %.1f probes/s (burst %.0f), %.1f spawns/s (burst %.0f), backoff %d-%dms",
+            recovery_cfg.max_concurrent_probes, recovery_cfg.probe_rate, recovery_cfg.probe_burst,
+            recovery_cfg.spawn_rate, recovery_cfg.spawn_burst, recovery_cfg.backoff_base_ms, recovery_cfg.backoff_max_ms);
+    ROC_INFO(RLOG_CONFIG, "Resource accounting: FFmpeg samples every %ds, re-probes held above %d%% CPU",
+            resources_cfg.sample_interval_sec, resources_cfg.reprobe_cpu_limit_pct);
+    if (capture_cfg.ring_kb > 0)
+        ROC_INFO(RLOG_CONFIG, "FFmpeg output: %dKB ring, %dKB/s to logs of %dKB x%d, %dKB exit dump",
+                capture_cfg.ring_kb, capture_cfg.flush_kb_per_sec, capture_cfg.file_max_kb, capture_cfg.files,
+                capture_cfg.exit_dump_kb);
+    else
+        ROC_INFO(RLOG_CONFIG, "FFmpeg output: appended to the camera logs directly");
+    ROC_INFO(RLOG_CONFIG, "Frame intervals: %s", frames_cfg.enabled ? "measured on every device" : "not measured");
+    for (size_t i = 0; i < score_profile_count; ++i) {
+        const score_profile_t *sp = &score_profiles[i];
+        ROC_INFO(RLOG_CONFIG, "Scoring profile %s: model=%s weights resolution=%.2f fps=%.2f bitrate=%.2f gop=%.2f latency=%.2f errors=%.2f",
+                sp->name, score_model_name(sp->model), sp->weight[SCORE_TERM_RESOLUTION], sp->weight[SCORE_TERM_FPS],
+                sp->weight[SCORE_TERM_BITRATE], sp->weight[SCORE_TERM_GOP], sp->weight[SCORE_TERM_LATENCY],
+                sp->weight[SCORE_TERM_ERRORS]);
+    }
     return 0;
 }
 
 /* JSON-based config loader (cJSON) */
 static int load_cameras_json(struct camera_cfg *cams, size_t *count) {
-    log_msg("DEBUG", "Loading camera config from %s", CAMERAS_CONFIG);
+    ROC_DEBUG(RLOG_CONFIG, "Loading camera config from %s", CAMERAS_CONFIG);
     if (!cams || !count) {
-        log_msg("ERROR", "Invalid arguments to load_cameras_json");
+        ROC_ERROR(RLOG_CONFIG, "Invalid arguments to load_cameras_json");
         return -1;
     }
     FILE *f = fopen(CAMERAS_CONFIG, "r"); 
     if (!f) { 
-        log_msg("ERROR", "open %s: %s", CAMERAS_CONFIG, strerror(errno)); 
+        ROC_ERROR(RLOG_CONFIG, "open %s: %s", CAMERAS_CONFIG, strerror(errno)); 
         return -1; 
     }
     fseek(f, 0, SEEK_END); long len = ftell(f); fseek(f, 0, SEEK_SET);
     if (len <= 0 || len > 10 * 1024 * 1024) { 
         fclose(f); 
-        log_msg("ERROR", "Invalid config length %ld", len); 
+        ROC_ERROR(RLOG_CONFIG, "Invalid config length %ld", len); 
         return -1; 
     }
     char *buf = malloc((size_t)len + 1); 
     if (!buf) { 
         fclose(f); 
-        log_msg("ERROR", "malloc failed for config buffer"); 
+        ROC_ERROR(RLOG_CONFIG, "malloc failed for config buffer"); 
         return -1; 
     }
     fread(buf, 1, (size_t)len, f); buf[len] = '\0'; fclose(f);
-    log_msg("DEBUG", "Read %ld bytes from %s", len, CAMERAS_CONFIG);
+    ROC_DEBUG(RLOG_CONFIG, "Read %ld bytes from %s", len, CAMERAS_CONFIG);
     // Strip UTF-8 BOM if present
     if (len >= 3 && (unsigned char)buf[0] == 0xEF && (unsigned char)buf[1] == 0xBB && (unsigned char)buf[2] == 0xBF) {
-        log_msg("DEBUG", "Stripping UTF-8 BOM from config");
+        ROC_DEBUG(RLOG_CONFIG, "Stripping UTF-8 BOM from config");
         memmove(buf, buf + 3, len - 3 + 1);
         len -= 3;
     }
     cJSON *root = cJSON_Parse(buf); free(buf);
     if (!root || !cJSON_IsArray(root)) { 
-        log_msg("ERROR", "cameras.json root not array"); 
+        ROC_ERROR(RLOG_CONFIG, "cameras.json root not array"); 
         if (root) cJSON_Delete(root); 
         return -1; 
     }
@@ -176,13 +499,13 @@ static int load_cameras_json(struct camera_cfg *cams, size_t *count) {
     cJSON *item = NULL; 
     cJSON_ArrayForEach(item, root) {
         if (!cJSON_IsObject(item)) {
-            log_msg("WARNING", "Skipping non-object entry in cameras.json");
+            ROC_WARN(RLOG_CONFIG, "Skipping non-object entry in cameras.json");
             continue;
         }
         cJSON *cip = cJSON_GetObjectItemCaseSensitive(item, "ip");
         cJSON *cpass = cJSON_GetObjectItemCaseSensitive(item, "password");
         if (!cJSON_IsString(cip) || !cJSON_IsString(cpass)) { 
-            log_msg("WARNING", "Camera entry missing ip/password, skipping"); 
+            ROC_WARN(RLOG_CONFIG, "Camera entry missing ip/password, skipping"); 
             continue; 
         }
         cJSON *cuser = cJSON_GetObjectItemCaseSensitive(item, "user");
@@ -192,55 +515,84 @@ static int load_cameras_json(struct camera_cfg *cams, size_t *count) {
             safe_strncpy(cams[idx].user, cuser->valuestring, USER_MAX); 
         else 
             safe_strncpy(cams[idx].user, "admin", USER_MAX);
-        log_msg("DEBUG", "Parsed camera %zu: ip=%s, user=%s", idx, cams[idx].ip, cams[idx].user);
+        cams[idx].profile = 0;
+        cams[idx].program = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(item, "program"));
+        cJSON *cscore = cJSON_GetObjectItemCaseSensitive(item, "scoring");
+        if (cJSON_IsString(cscore)) {
+            int pi = find_score_profile(cscore->valuestring);
+            if (pi < 0)
+                ROC_WARN(RLOG_CONFIG, "Camera %s: unknown scoring profile %s, using default", cams[idx].ip, cscore->valuestring);
+            else
+                cams[idx].profile = pi;
+        }
+        ROC_DEBUG(RLOG_CONFIG, "Parsed camera %zu: ip=%s, user=%s, scoring=%s%s", idx, cams[idx].ip, cams[idx].user,
+                score_profiles[cams[idx].profile].name, cams[idx].program ? ", program" : "");
         idx++; 
         if (idx >= MAX_CAMERAS) {
-            log_msg("WARNING", "Reached MAX_CAMERAS limit (%d)", MAX_CAMERAS);
+            ROC_WARN(RLOG_CONFIG, "Reached MAX_CAMERAS limit (%d)", MAX_CAMERAS);
             break;
         }
     }
     cJSON_Delete(root); 
     if (idx == 0) { 
-        log_msg("ERROR", "No cameras parsed from config"); 
+        ROC_ERROR(RLOG_CONFIG, "No cameras parsed from config"); 
         return -1; 
     }
     *count = idx; 
-    log_msg("INFO", "Loaded %zu cameras", *count);
+    ROC_INFO(RLOG_CONFIG, "Loaded %zu cameras", *count);
+    return 0;
+}
+
+/* Ensure /var/lib/roc exists */
+static int ensure_cache_dir(void) {
+    char cache_dir[256];
+    snprintf(cache_dir, sizeof(cache_dir), "%s", DISCOVERY_CACHE_BIN);
+    char *last_slash = strrchr(cache_dir, '/');
+    if (last_slash) {
+        *last_slash = '\0';
+        if (access(cache_dir, F_OK) != 0) {
+            ROC_DEBUG(RLOG_CACHE, "Creating cache directory %s", cache_dir);
+            if (mkdir(cache_dir, 0755) != 0) {
+                ROC_ERROR(RLOG_CACHE, "Failed to create %s: %s", cache_dir, strerror(errno));
+                return -1;
+            }
+        }
+    }
     return 0;
 }
 
 /* JSON cache loader/saver */
 static int load_cache_json(struct discovery_entry *entries, size_t *cnt) {
-    log_msg("DEBUG", "Loading cache from %s", DISCOVERY_CACHE);
+    ROC_DEBUG(RLOG_CACHE, "Loading cache from %s", DISCOVERY_CACHE);
     *cnt = 0; 
     FILE *f = fopen(DISCOVERY_CACHE, "r"); 
     if (!f) {
-        log_msg("INFO", "Cache file %s not found, starting fresh", DISCOVERY_CACHE); 
+        ROC_INFO(RLOG_CACHE, "Cache file %s not found, starting fresh", DISCOVERY_CACHE); 
         return 0; 
     }
     fseek(f, 0, SEEK_END); long len = ftell(f); fseek(f, 0, SEEK_SET);
     if (len <= 0 || len > 20 * 1024 * 1024) { 
         fclose(f); 
-        log_msg("ERROR", "Invalid cache length %ld", len); 
+        ROC_ERROR(RLOG_CACHE, "Invalid cache length %ld", len); 
         return 0; 
     }
     char *buf = malloc((size_t)len + 1); 
     if (!buf) { 
         fclose(f); 
-        log_msg("ERROR", "malloc failed for cache buffer"); 
+        ROC_ERROR(RLOG_CACHE, "malloc failed for cache buffer"); 
         return 0; 
     }
     fread(buf, 1, (size_t)len, f); buf[len] = '\0'; fclose(f);
-    log_msg("DEBUG", "Read %ld bytes from %s", len, DISCOVERY_CACHE);
+    ROC_DEBUG(RLOG_CACHE, "Read %ld bytes from %s", len, DISCOVERY_CACHE);
     // Strip UTF-8 BOM if present
     if (len >= 3 && (unsigned char)buf[0] == 0xEF && (unsigned char)buf[1] == 0xBB && (unsigned char)buf[2] == 0xBF) {
-        log_msg("DEBUG", "Stripping UTF-8 BOM from cache");
+        ROC_DEBUG(RLOG_CACHE, "Stripping UTF-8 BOM from cache");
         memmove(buf, buf + 3, len - 3 + 1);
         len -= 3;
     }
     cJSON *root = cJSON_Parse(buf); free(buf);
     if (!root || !cJSON_IsArray(root)) { 
-        log_msg("WARNING", "Cache root not array, ignoring"); 
+        ROC_WARN(RLOG_CACHE, "Cache root not array, ignoring"); 
         if (root) cJSON_Delete(root); 
         return 0; 
     }
@@ -248,14 +600,15 @@ static int load_cache_json(struct discovery_entry *entries, size_t *cnt) {
     cJSON *it = NULL; 
     cJSON_ArrayForEach(it, root) {
         if (!cJSON_IsObject(it)) {
-            log_msg("WARNING", "Skipping non-object entry in cache");
+            ROC_WARN(RLOG_CACHE, "Skipping non-object entry in cache");
             continue;
         }
         cJSON *cip = cJSON_GetObjectItemCaseSensitive(it, "ip"); 
         if (!cJSON_IsString(cip)) {
-            log_msg("WARNING", "Cache entry missing ip, skipping");
+            ROC_WARN(RLOG_CACHE, "Cache entry missing ip, skipping");
             continue;
         }
+        memset(&entries[idx], 0, sizeof(entries[idx]));
         safe_strncpy(entries[idx].ip, cip->valuestring, IP_MAX);
         cJSON *cstream = cJSON_GetObjectItemCaseSensitive(it, "stream"); 
         if (cstream && cJSON_IsString(cstream)) 
@@ -273,51 +626,81 @@ static int load_cache_json(struct discovery_entry *entries, size_t *cnt) {
             entries[idx].score = cscore->valuedouble; 
         else 
             entries[idx].score = 0.0;
+        cJSON *ccodec = cJSON_GetObjectItemCaseSensitive(it, "codec");
+        if (ccodec && cJSON_IsString(ccodec))
+            safe_strncpy(entries[idx].codec, ccodec->valuestring, sizeof(entries[idx].codec));
+        cJSON *cprof = cJSON_GetObjectItemCaseSensitive(it, "profile");
+        if (cprof && cJSON_IsString(cprof))
+            safe_strncpy(entries[idx].profile, cprof->valuestring, sizeof(entries[idx].profile));
+        cJSON *cbr = cJSON_GetObjectItemCaseSensitive(it, "bitrate_kbps");
+        entries[idx].bitrate_kbps = (cbr && cJSON_IsNumber(cbr)) ? cbr->valueint : 0;
+        cJSON *cgop = cJSON_GetObjectItemCaseSensitive(it, "gop");
+        entries[idx].gop = (cgop && cJSON_IsNumber(cgop)) ? cgop->valueint : 0;
+        cJSON *ctb = cJSON_GetObjectItemCaseSensitive(it, "time_base");
+        if (ctb && cJSON_IsString(ctb))
+            safe_strncpy(entries[idx].time_base, ctb->valuestring, sizeof(entries[idx].time_base));
+        cJSON *csu = cJSON_GetObjectItemCaseSensitive(it, "startup_ms");
+        entries[idx].startup_ms = (csu && cJSON_IsNumber(csu)) ? csu->valueint : 0;
+        cJSON *cde = cJSON_GetObjectItemCaseSensitive(it, "decode_errors");
+        entries[idx].decode_errors = (cde && cJSON_IsNumber(cde)) ? cde->valueint : 0;
+        cJSON *csc = cJSON_GetObjectItemCaseSensitive(it, "scoring");
+        if (cJSON_IsObject(csc)) {
+            cJSON *cpn = cJSON_GetObjectItemCaseSensitive(csc, "profile");
+            if (cJSON_IsString(cpn))
+                safe_strncpy(entries[idx].score_profile, cpn->valuestring, sizeof(entries[idx].score_profile));
+            score_vector_from_json(cJSON_GetObjectItemCaseSensitive(csc, "terms"), &entries[idx].terms);
+        }
+        cJSON *calts = cJSON_GetObjectItemCaseSensitive(it, "alternatives");
+        for (size_t st = 0; cJSON_IsObject(calts) && st < STREAM_TYPES_COUNT; ++st) {
+            cJSON *a = cJSON_GetObjectItemCaseSensitive(calts, STREAM_TYPES[st]);
+            if (!cJSON_IsObject(a)) continue;
+            cJSON *v;
+            struct stream_alt *sa = &entries[idx].alts[st];
+            sa->ok = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(a, "ok"));
+            if ((v = cJSON_GetObjectItemCaseSensitive(a, "width")) && cJSON_IsNumber(v)) sa->info.width = v->valueint;
+            if ((v = cJSON_GetObjectItemCaseSensitive(a, "height")) && cJSON_IsNumber(v)) sa->info.height = v->valueint;
+            if ((v = cJSON_GetObjectItemCaseSensitive(a, "fps")) && cJSON_IsNumber(v)) sa->info.fps = v->valuedouble;
+            if ((v = cJSON_GetObjectItemCaseSensitive(a, "bitrate_kbps")) && cJSON_IsNumber(v)) sa->info.bitrate_kbps = v->valueint;
+            if ((v = cJSON_GetObjectItemCaseSensitive(a, "gop")) && cJSON_IsNumber(v)) sa->info.gop = v->valueint;
+            if ((v = cJSON_GetObjectItemCaseSensitive(a, "startup_ms")) && cJSON_IsNumber(v)) sa->info.startup_ms = v->valueint;
+            if ((v = cJSON_GetObjectItemCaseSensitive(a, "decode_errors")) && cJSON_IsNumber(v)) sa->info.decode_errors = v->valueint;
+            if ((v = cJSON_GetObjectItemCaseSensitive(a, "score")) && cJSON_IsNumber(v)) sa->score = v->valuedouble;
+            score_vector_from_json(cJSON_GetObjectItemCaseSensitive(a, "terms"), &sa->terms);
+            if ((v = cJSON_GetObjectItemCaseSensitive(a, "last")) && cJSON_IsNumber(v)) sa->last_probe = (time_t)v->valuedouble;
+        }
         cJSON *cl = cJSON_GetObjectItemCaseSensitive(it, "last"); 
         if (cl && cJSON_IsNumber(cl)) 
             entries[idx].last_success = (time_t)cl->valuedouble; 
         else 
             entries[idx].last_success = 0;
-        log_msg("DEBUG", "Parsed cache entry %zu: ip=%s, stream=%s, resolution=%s, fps=%.2f, score=%.2f, last=%ld",
+        ROC_DEBUG(RLOG_CACHE, "Parsed cache entry %zu: ip=%s, stream=%s, resolution=%s, fps=%.2f, score=%.2f, last=%ld",
                 idx, entries[idx].ip, entries[idx].best_stream, entries[idx].resolution, 
                 entries[idx].fps, entries[idx].score, entries[idx].last_success);
         idx++; 
         if (idx >= MAX_CAMERAS) {
-            log_msg("WARNING", "Reached MAX_CAMERAS limit (%d) for cache", MAX_CAMERAS);
+            ROC_WARN(RLOG_CACHE, "Reached MAX_CAMERAS limit (%d) for cache", MAX_CAMERAS);
             break;
         }
     }
     cJSON_Delete(root); 
     *cnt = idx; 
-    log_msg("INFO", "Loaded %zu cache entries", *cnt);
+    ROC_INFO(RLOG_CACHE, "Loaded %zu cache entries", *cnt);
     return 0;
 }
 
 static int save_cache_json(struct discovery_entry *entries, size_t cnt) {
-    log_msg("DEBUG", "Saving cache to %s", DISCOVERY_CACHE);
-    // Ensure /var/lib/roc exists
-    char cache_dir[256];
-    snprintf(cache_dir, sizeof(cache_dir), "%s", DISCOVERY_CACHE);
-    char *last_slash = strrchr(cache_dir, '/');
-    if (last_slash) {
-        *last_slash = '\0';
-        if (access(cache_dir, F_OK) != 0) {
-            log_msg("DEBUG", "Creating cache directory %s", cache_dir);
-            if (mkdir(cache_dir, 0755) != 0) {
-                log_msg("ERROR", "Failed to create %s: %s", cache_dir, strerror(errno));
-                return -1;
-            }
-        }
-    }
+    ROC_DEBUG(RLOG_CACHE, "Saving cache to %s", DISCOVERY_CACHE);
+    TRACE_SPAN(span, "cache", "save_cache_json");
+    if (ensure_cache_dir() != 0) return -1;
     cJSON *root = cJSON_CreateArray(); 
     if (!root) {
-        log_msg("ERROR", "Failed to create JSON array for cache");
+        ROC_ERROR(RLOG_CACHE, "Failed to create JSON array for cache");
         return -1;
     }
     for (size_t i = 0; i < cnt; ++i) {
         cJSON *o = cJSON_CreateObject(); 
         if (!o) { 
-            log_msg("ERROR", "Failed to create JSON object for cache entry %zu", i);
+            ROC_ERROR(RLOG_CACHE, "Failed to create JSON object for cache entry %zu", i);
             cJSON_Delete(root); 
             return -1; 
         }
@@ -327,11 +710,43 @@ static int save_cache_json(struct discovery_entry *entries, size_t cnt) {
         cJSON_AddNumberToObject(o, "fps", entries[i].fps);
         cJSON_AddNumberToObject(o, "score", entries[i].score);
         cJSON_AddNumberToObject(o, "last", (double)entries[i].last_success);
+        cJSON_AddStringToObject(o, "codec", entries[i].codec);
+        cJSON_AddStringToObject(o, "profile", entries[i].profile);
+        cJSON_AddNumberToObject(o, "bitrate_kbps", entries[i].bitrate_kbps);
+        cJSON_AddNumberToObject(o, "gop", entries[i].gop);
+        cJSON_AddStringToObject(o, "time_base", entries[i].time_base);
+        cJSON_AddNumberToObject(o, "startup_ms", entries[i].startup_ms);
+        cJSON_AddNumberToObject(o, "decode_errors", entries[i].decode_errors);
+        cJSON *sc = cJSON_AddObjectToObject(o, "scoring");
+        if (sc) {
+            int pi = find_score_profile(entries[i].score_profile);
+            cJSON_AddStringToObject(sc, "profile", entries[i].score_profile);
+            cJSON_AddStringToObject(sc, "model", score_model_name(score_profiles[pi >= 0 ? pi : 0].model));
+            cJSON_AddItemToObject(sc, "terms", score_vector_to_json(&entries[i].terms));
+        }
+        cJSON *alts = cJSON_AddObjectToObject(o, "alternatives");
+        for (size_t st = 0; alts && st < STREAM_TYPES_COUNT; ++st) {
+            const struct stream_alt *sa = &entries[i].alts[st];
+            if (sa->last_probe == 0) continue;
+            cJSON *a = cJSON_AddObjectToObject(alts, STREAM_TYPES[st]);
+            if (!a) continue;
+            cJSON_AddBoolToObject(a, "ok", sa->ok);
+            cJSON_AddNumberToObject(a, "width", sa->info.width);
+            cJSON_AddNumberToObject(a, "height", sa->info.height);
+            cJSON_AddNumberToObject(a, "fps", sa->info.fps);
+            cJSON_AddNumberToObject(a, "bitrate_kbps", sa->info.bitrate_kbps);
+            cJSON_AddNumberToObject(a, "gop", sa->info.gop);
+            cJSON_AddNumberToObject(a, "startup_ms", sa->info.startup_ms);
+            cJSON_AddNumberToObject(a, "decode_errors", sa->info.decode_errors);
+            cJSON_AddNumberToObject(a, "score", sa->score);
+            if (sa->ok) cJSON_AddItemToObject(a, "terms", score_vector_to_json(&sa->terms));
+            cJSON_AddNumberToObject(a, "last", (double)sa->last_probe);
+        }
         cJSON_AddItemToArray(root, o);
     }
     char *s = cJSON_PrintUnformatted(root);
     if (!s) { 
-        log_msg("ERROR", "Failed to serialize cache JSON");
+        ROC_ERROR(RLOG_CACHE, "Failed to serialize cache JSON");
         cJSON_Delete(root); 
         return -1; 
     }
@@ -339,7 +754,7 @@ static int save_cache_json(struct discovery_entry *entries, size_t cnt) {
     snprintf(tmp, sizeof(tmp), "%s.tmp", DISCOVERY_CACHE);
     FILE *f = fopen(tmp, "w"); 
     if (!f) { 
-        log_msg("ERROR", "open %s: %s", tmp, strerror(errno)); 
+        ROC_ERROR(RLOG_CACHE, "open %s: %s", tmp, strerror(errno)); 
         cJSON_free(s); 
         cJSON_Delete(root); 
         return -1; 
@@ -348,545 +763,2053 @@ static int save_cache_json(struct discovery_entry *entries, size_t cnt) {
     fflush(f); 
     fsync(fileno(f)); 
     fclose(f);
-    log_msg("DEBUG", "Wrote cache to %s", tmp);
+    ROC_DEBUG(RLOG_CACHE, "Wrote cache to %s", tmp);
     if (rename(tmp, DISCOVERY_CACHE) != 0) { 
-        log_msg("ERROR", "rename %s to %s: %s", tmp, DISCOVERY_CACHE, strerror(errno)); 
+        ROC_ERROR(RLOG_CACHE, "rename %s to %s: %s", tmp, DISCOVERY_CACHE, strerror(errno)); 
         unlink(tmp); 
         cJSON_free(s); 
         cJSON_Delete(root); 
         return -1; 
     }
-    log_msg("DEBUG", "Renamed %s to %s", tmp, DISCOVERY_CACHE);
+    ROC_DEBUG(RLOG_CACHE, "Renamed %s to %s", tmp, DISCOVERY_CACHE);
     cJSON_free(s); 
     cJSON_Delete(root); 
-    log_msg("INFO", "Saved %zu cache entries", cnt);
+    ROC_INFO(RLOG_CACHE, "Saved %zu cache entries", cnt);
+    return 0;
+}
+
+/* Binary discovery cache: one fixed-size record per camera slot, mmap'd for
+ * the life of the process. Slot i always holds cache[i]. The JSON file is
+ * only read to seed a new binary cache and written on exit for humans. */
+#define CACHE_RECORD_VERSION 1
+
+/* On-disk layout: fixed-width fields only, so it does not depend on time_t */
+struct cache_alt_record {
+    int32_t ok, width, height, bitrate_kbps, gop, startup_ms, decode_errors, reserved;
+    double fps, score;
+    double terms[SCORE_TERM_COUNT];
+    int64_t last_probe;
+};
+
+struct cache_record {
+    char ip[IP_MAX]; char best_stream[32]; char resolution[RES_MAX];
+    char codec[16]; char profile[32]; char time_base[24];
+    char score_profile[SCORE_PROFILE_NAME_MAX];
+    double fps, score;
+    int64_t last_success;
+    int32_t bitrate_kbps, gop, startup_ms, decode_errors;
+    double terms[SCORE_TERM_COUNT];
+    struct cache_alt_record alts[STREAM_ALT_MAX];
+};
+
+static dcache_t cache_store = { .fd = -1 };
+static uint32_t cache_dirty = 0; /* Bit i set: cache[i] changed since it was last handed to the writer */
+
+static void cache_mark_dirty(int ci) {
+    if (ci >= 0 && ci < 32) cache_dirty |= 1u << ci;
+}
+
+static void cache_record_from_entry(struct cache_record *r, const struct discovery_entry *e) {
+    memset(r, 0, sizeof(*r)); /* Zero padding so unchanged entries compare equal */
+    safe_strncpy(r->ip, e->ip, sizeof(r->ip));
+    safe_strncpy(r->best_stream, e->best_stream, sizeof(r->best_stream));
+    safe_strncpy(r->resolution, e->resolution, sizeof(r->resolution));
+    safe_strncpy(r->codec, e->codec, sizeof(r->codec));
+    safe_strncpy(r->profile, e->profile, sizeof(r->profile));
+    safe_strncpy(r->time_base, e->time_base, sizeof(r->time_base));
+    safe_strncpy(r->score_profile, e->score_profile, sizeof(r->score_profile));
+    r->fps = e->fps;
+    r->score = e->score;
+    r->last_success = (int64_t)e->last_success;
+    r->bitrate_kbps = e->bitrate_kbps;
+    r->gop = e->gop;
+    r->startup_ms = e->startup_ms;
+    r->decode_errors = e->decode_errors;
+    memcpy(r->terms, e->terms.term, sizeof(r->terms));
+    for (size_t st = 0; st < STREAM_ALT_MAX; ++st) {
+        const struct stream_alt *sa = &e->alts[st];
+        struct cache_alt_record *ra = &r->alts[st];
+        ra->ok = sa->ok;
+        ra->width = sa->info.width;
+        ra->height = sa->info.height;
+        ra->bitrate_kbps = sa->info.bitrate_kbps;
+        ra->gop = sa->info.gop;
+        ra->startup_ms = sa->info.startup_ms;
+        ra->decode_errors = sa->info.decode_errors;
+        ra->fps = sa->info.fps;
+        ra->score = sa->score;
+        memcpy(ra->terms, sa->terms.term, sizeof(ra->terms));
+        ra->last_probe = (int64_t)sa->last_probe;
+    }
+}
+
+static void cache_entry_from_record(struct discovery_entry *e, const struct cache_record *r) {
+    memset(e, 0, sizeof(*e));
+    safe_strncpy(e->ip, r->ip, sizeof(e->ip));
+    safe_strncpy(e->best_stream, r->best_stream, sizeof(e->best_stream));
+    safe_strncpy(e->resolution, r->resolution, sizeof(e->resolution));
+    safe_strncpy(e->codec, r->codec, sizeof(e->codec));
+    safe_strncpy(e->profile, r->profile, sizeof(e->profile));
+    safe_strncpy(e->time_base, r->time_base, sizeof(e->time_base));
+    safe_strncpy(e->score_profile, r->score_profile, sizeof(e->score_profile));
+    e->fps = r->fps;
+    e->score = r->score;
+    e->last_success = (time_t)r->last_success;
+    e->bitrate_kbps = r->bitrate_kbps;
+    e->gop = r->gop;
+    e->startup_ms = r->startup_ms;
+    e->decode_errors = r->decode_errors;
+    memcpy(e->terms.term, r->terms, sizeof(r->terms));
+    for (size_t st = 0; st < STREAM_ALT_MAX; ++st) {
+        struct stream_alt *sa = &e->alts[st];
+        const struct cache_alt_record *ra = &r->alts[st];
+        sa->ok = ra->ok;
+        sa->info.width = ra->width;
+        sa->info.height = ra->height;
+        sa->info.bitrate_kbps = ra->bitrate_kbps;
+        sa->info.gop = ra->gop;
+        sa->info.startup_ms = ra->startup_ms;
+        sa->info.decode_errors = ra->decode_errors;
+        sa->info.fps = ra->fps;
+        sa->score = ra->score;
+        memcpy(sa->terms.term, ra->terms, sizeof(ra->terms));
+        sa->last_probe = (time_t)ra->last_probe;
+    }
+}
+
+/* Write changed entries into their slots and flush; unchanged records are not touched */
+static int save_cache(struct discovery_entry *entries, size_t cnt) {
+    if (!cache_store.map) return save_cache_json(entries, cnt);
+    TRACE_SPAN(span, "cache", "save_cache");
+    size_t written = 0;
+    for (size_t i = 0; i < cnt && i < cache_store.capacity; ++i) {
+        struct cache_record r;
+        cache_record_from_entry(&r, &entries[i]);
+        if (dcache_put(&cache_store, (uint32_t)i, &r) > 0) written++;
+    }
+    for (size_t i = cnt; i < cache_store.capacity; ++i)
+        if (dcache_clear(&cache_store, (uint32_t)i)) written++;
+    if (written == 0) {
+        ROC_DEBUG(RLOG_CACHE, "Cache unchanged, nothing to write");
+        return 0;
+    }
+    if (dcache_sync(&cache_store) != 0) {
+        ROC_ERROR(RLOG_CACHE, "msync %s: %s", DISCOVERY_CACHE_BIN, strerror(errno));
+        return -1;
+    }
+    ROC_INFO(RLOG_CACHE, "Updated %zu of %zu cache records", written, cnt);
+    return 0;
+}
+
+/* Map the binary cache, seeding it from the JSON cache when it is new or
+ * has an incompatible layout. Falls back to JSON only if mapping fails. */
+static int load_cache(struct discovery_entry *entries, size_t *cnt) {
+    TRACE_SPAN(span, "cache", "load_cache");
+    *cnt = 0;
+    if (ensure_cache_dir() != 0) return load_cache_json(entries, cnt);
+    int rc = dcache_open(&cache_store, DISCOVERY_CACHE_BIN, CACHE_RECORD_VERSION,
+                         sizeof(struct cache_record), (uint32_t)MAX_CAMERAS);
+    if (rc < 0) {
+        ROC_ERROR(RLOG_CACHE, "Failed to map %s: %s; using %s", DISCOVERY_CACHE_BIN, strerror(errno), DISCOVERY_CACHE);
+        return load_cache_json(entries, cnt);
+    }
+    if (rc > 0) {
+        ROC_INFO(RLOG_CACHE, "Created %s, importing %s", DISCOVERY_CACHE_BIN, DISCOVERY_CACHE);
+        load_cache_json(entries, cnt);
+        return save_cache(entries, *cnt);
+    }
+    for (uint32_t slot = 0; slot < cache_store.capacity; ++slot) {
+        struct cache_record r;
+        if (dcache_get(&cache_store, slot, &r) != 0) continue;
+        cache_entry_from_record(&entries[*cnt], &r);
+        (*cnt)++;
+    }
+    ROC_INFO(RLOG_CACHE, "Mapped %zu cache records from %s", *cnt, DISCOVERY_CACHE_BIN);
     return 0;
 }
 
+/* Hand dirty entries to the writer thread. Without a writer (no binary
+ * cache) the whole cache is saved here, still only when something changed. */
+static void cache_flush_dirty(struct discovery_entry *entries, size_t cnt) {
+    if (cache_dirty == 0) return;
+    TRACE_SPAN(span, "cache", "cache_flush_dirty");
+    int fallback = 0;
+    for (size_t i = 0; i < cnt; ++i) {
+        if (!(cache_dirty & (1u << i))) continue;
+        struct cache_record r;
+        cache_record_from_entry(&r, &entries[i]);
+        if (cache_persist_submit((uint32_t)i, &r) != 0) fallback = 1;
+    }
+    if (fallback) save_cache(entries, cnt);
+    cache_dirty = 0;
+}
+
+/* Per-camera figures for the metrics endpoint. The supervisor and probe
+ * threads store them with relaxed atomics and the metrics thread only
+ * loads them, so a scrape never waits on a lock the supervisor holds. */
+#define TRACE_TRACK_RIG MAX_CAMERAS /* Trace tracks 0..MAX_CAMERAS-1 are the cameras */
+struct cam_metrics {
+    char ip[IP_MAX];              /* Set before the metrics thread starts */
+    _Atomic int running;          /* FFmpeg alive */
+    _Atomic long long started;    /* Start time of the running FFmpeg */
+    _Atomic int stream;           /* Its stream type index, -1 when none */
+    _Atomic int recovering;
+    _Atomic int degraded;
+    _Atomic int reachable;        /* Last connect check: 1 up, 0 down, -1 not checked yet */
+    _Atomic int connect_ms;       /* Connect time of the last successful check, -1 if none */
+    _Atomic uint64_t restarts;    /* FFmpeg started again by recovery */
+    _Atomic uint64_t exits;
+    _Atomic uint64_t probes_ok;
+    _Atomic uint64_t probes_failed;
+    metrics_hist_t probe_ms;      /* Time to first frame of successful probes */
+    _Atomic int sampled;          /* The figures below belong to the running FFmpeg */
+    _Atomic int cpu_centi;        /* CPU over the last sample interval, hundredths of a percent of one core */
+    _Atomic uint64_t rss_bytes;
+    _Atomic int threads;
+    _Atomic uint64_t vol_ctxt;
+    _Atomic uint64_t nonvol_ctxt;
+    _Atomic uint64_t read_bytes;
+    _Atomic uint64_t write_bytes;
+};
+static struct cam_metrics cam_metrics[MAX_CAMERAS];
+static size_t cam_metrics_count = 0;
+static time_t metrics_start_time = 0;
+
+static void cam_metrics_init(const struct camera_cfg *cams, size_t cam_count) {
+    static const uint64_t probe_bounds[] = { 50, 100, 250, 500, 1000, 2000, 3000, 5000, 10000, 15000 };
+    cam_metrics_count = cam_count < MAX_CAMERAS ? cam_count : MAX_CAMERAS;
+    for (size_t i = 0; i < cam_metrics_count; ++i) {
+        struct cam_metrics *m = &cam_metrics[i];
+        safe_strncpy(m->ip, cams[i].ip, sizeof(m->ip));
+        atomic_store(&m->stream, -1);
+        atomic_store(&m->reachable, -1);
+        atomic_store(&m->connect_ms, -1);
+        metrics_hist_init(&m->probe_ms, probe_bounds, sizeof(probe_bounds) / sizeof(probe_bounds[0]));
+    }
+    metrics_start_time = time(NULL);
+}
+
+/* Probe and reachability helpers only know the camera's IP */
+static struct cam_metrics *cam_metrics_for(const char *ip) {
+    for (size_t i = 0; i < cam_metrics_count; ++i)
+        if (strcmp(cam_metrics[i].ip, ip) == 0) return &cam_metrics[i];
+    return NULL;
+}
+
+static void note_probe(const char *ip, int ok, int first_frame_ms) {
+    struct cam_metrics *m = cam_metrics_for(ip);
+    if (!m) return;
+    if (!ok) {
+        atomic_fetch_add_explicit(&m->probes_failed, 1, memory_order_relaxed);
+        return;
+    }
+    atomic_fetch_add_explicit(&m->probes_ok, 1, memory_order_relaxed);
+    if (first_frame_ms > 0) metrics_hist_observe(&m->probe_ms, (uint64_t)first_frame_ms);
+}
+
+static void note_reach(struct cam_metrics *m, int reachable, int connect_ms) {
+    if (!m) return;
+    atomic_store_explicit(&m->reachable, reachable, memory_order_relaxed);
+    if (reachable) atomic_store_explicit(&m->connect_ms, connect_ms, memory_order_relaxed);
+}
+
+/* Frame intervals of the cameras whose device has been read */
+static void render_frame_metrics(metrics_buf_t *out, size_t n) {
+    fhist_summary_t fs[MAX_CAMERAS];
+    for (size_t i = 0; i < n; ++i) fhist_summary((int)i, &fs[i]);
+    metrics_family(out, "roc_frame_interval_seconds", "summary", "Interval between frames written to the camera's device, since its FFmpeg started");
+    for (size_t i = 0; i < n; ++i) {
+        if (fs[i].intervals == 0) continue;
+        metrics_printf(out, "roc_frame_interval_seconds{camera=\"%zu\",quantile=\"0.5\"} %.6f\n", i, fs[i].p50_us / 1e6);
+        metrics_printf(out, "roc_frame_interval_seconds{camera=\"%zu\",quantile=\"0.99\"} %.6f\n", i, fs[i].p99_us / 1e6);
+        metrics_printf(out, "roc_frame_interval_seconds_sum{camera=\"%zu\"} %.6f\n", i, fs[i].sum_us / 1e6);
+        metrics_printf(out, "roc_frame_interval_seconds_count{camera=\"%zu\"} %llu\n", i, (unsigned long long)fs[i].intervals);
+    }
+    metrics_family(out, "roc_frame_interval_max_seconds", "gauge", "Longest interval between frames since the camera's FFmpeg started");
+    for (size_t i = 0; i < n; ++i)
+        if (fs[i].intervals > 0)
+            metrics_printf(out, "roc_frame_interval_max_seconds{camera=\"%zu\"} %.6f\n", i, fs[i].max_us / 1e6);
+    metrics_family(out, "roc_frame_interval_nominal_seconds", "gauge", "1/fps the camera's FFmpeg was started with");
+    for (size_t i = 0; i < n; ++i)
+        if (fs[i].nominal_us > 0)
+            metrics_printf(out, "roc_frame_interval_nominal_seconds{camera=\"%zu\"} %.6f\n", i, fs[i].nominal_us / 1e6);
+    metrics_family(out, "roc_frame_gaps", "gauge", "Intervals over twice the nominal one since the camera's FFmpeg started");
+    for (size_t i = 0; i < n; ++i)
+        if (fs[i].intervals > 0)
+            metrics_printf(out, "roc_frame_gaps{camera=\"%zu\"} %llu\n", i, (unsigned long long)fs[i].gaps);
+    metrics_family(out, "roc_frame_reader_skipped", "gauge", "Frames videopipe's reader missed, left out of the intervals");
+    for (size_t i = 0; i < n; ++i)
+        if (fs[i].intervals > 0 || fs[i].skipped > 0)
+            metrics_printf(out, "roc_frame_reader_skipped{camera=\"%zu\"} %llu\n", i, (unsigned long long)fs[i].skipped);
+    metrics_family(out, "roc_frame_device_streaming", "gauge", "Whether videopipe is reading frames from the camera's device");
+    for (size_t i = 0; i < n; ++i)
+        if (fs[i].nominal_us > 0)
+            metrics_printf(out, "roc_frame_device_streaming{camera=\"%zu\"} %d\n", i, fs[i].streaming);
+}
+
+/* Runs on the metrics thread: loads atomics only */
+static void render_metrics(metrics_buf_t *out, void *arg) {
+    (void)arg;
+    time_t now = time(NULL);
+    size_t n = cam_metrics_count;
+    char labels[32];
+    metrics_family(out, "roc_videopipe_start_time_seconds", "gauge", "Unix time videopipe started");
+    metrics_printf(out, "roc_videopipe_start_time_seconds %lld\n", (long long)metrics_start_time);
+    metrics_family(out, "roc_camera_info", "gauge", "Configured camera and its address");
+    for (size_t i = 0; i < n; ++i)
+        metrics_printf(out, "roc_camera_info{camera=\"%zu\",ip=\"%s\"} 1\n", i, cam_metrics[i].ip);
+    metrics_family(out, "roc_camera_up", "gauge", "1 while the camera's FFmpeg is running");
+    for (size_t i = 0; i < n; ++i)
+        metrics_printf(out, "roc_camera_up{camera=\"%zu\"} %d\n", i, atomic_load_explicit(&cam_metrics[i].running, memory_order_relaxed));
+    metrics_family(out, "roc_camera_uptime_seconds", "gauge", "Time the camera's FFmpeg has been running, 0 when down");
+    for (size_t i = 0; i < n; ++i) {
+        long long started = atomic_load_explicit(&cam_metrics[i].started, memory_order_relaxed);
+        int running = atomic_load_explicit(&cam_metrics[i].running, memory_order_relaxed);
+        metrics_printf(out, "roc_camera_uptime_seconds{camera=\"%zu\"} %lld\n", i,
+                       running && started > 0 && now > started ? (long long)now - started : 0LL);
+    }
+    metrics_family(out, "roc_camera_stream", "gauge", "1 for the stream type the camera is playing");
+    for (size_t i = 0; i < n; ++i) {
+        int stream = atomic_load_explicit(&cam_metrics[i].stream, memory_order_relaxed);
+        for (size_t st = 0; st < STREAM_TYPES_COUNT; ++st)
+            metrics_printf(out, "roc_camera_stream{camera=\"%zu\",stream=\"%s\"} %d\n", i, STREAM_TYPES[st], stream == (int)st);
+    }
+    metrics_family(out, "roc_camera_recovering", "gauge", "1 while the camera is down and being recovered");
+    for (size_t i = 0; i < n; ++i)
+        metrics_printf(out, "roc_camera_recovering{camera=\"%zu\"} %d\n", i, atomic_load_explicit(&cam_metrics[i].recovering, memory_order_relaxed));
+    metrics_family(out, "roc_camera_degraded", "gauge", "1 while the RTMP connection shows high RTT or retransmits");
+    for (size_t i = 0; i < n; ++i)
+        metrics_printf(out, "roc_camera_degraded{camera=\"%zu\"} %d\n", i, atomic_load_explicit(&cam_metrics[i].degraded, memory_order_relaxed));
+    metrics_family(out, "roc_camera_restarts_total", "counter", "FFmpeg restarts by recovery");
+    for (size_t i = 0; i < n; ++i)
+        metrics_printf(out, "roc_camera_restarts_total{camera=\"%zu\"} %llu\n", i,
+                       (unsigned long long)atomic_load_explicit(&cam_metrics[i].restarts, memory_order_relaxed));
+    metrics_family(out, "roc_ffmpeg_exits_total", "counter", "FFmpeg processes that ended");
+    for (size_t i = 0; i < n; ++i)
+        metrics_printf(out, "roc_ffmpeg_exits_total{camera=\"%zu\"} %llu\n", i,
+                       (unsigned long long)atomic_load_explicit(&cam_metrics[i].exits, memory_order_relaxed));
+    metrics_family(out, "roc_camera_reachable", "gauge", "Result of the last connect check on port 1935");
+    for (size_t i = 0; i < n; ++i) {
+        int reachable = atomic_load_explicit(&cam_metrics[i].reachable, memory_order_relaxed);
+        if (reachable >= 0) metrics_printf(out, "roc_camera_reachable{camera=\"%zu\"} %d\n", i, reachable);
+    }
+    metrics_family(out, "roc_camera_connect_seconds", "gauge", "Connect time of the last successful check");
+    for (size_t i = 0; i < n; ++i) {
+        int ms = atomic_load_explicit(&cam_metrics[i].connect_ms, memory_order_relaxed);
+        if (ms >= 0) metrics_printf(out, "roc_camera_connect_seconds{camera=\"%zu\"} %.3f\n", i, ms / 1000.0);
+    }
+    metrics_family(out, "roc_camera_fps", "gauge", "Frames per second FFmpeg delivers, from its progress lines");
+    for (size_t i = 0; i < n; ++i) {
+        logt_counts_t lc;
+        log_tail_counts((int)i, &lc);
+        metrics_printf(out, "roc_camera_fps{camera=\"%zu\"} %.2f\n", i, lc.fps);
+    }
+    metrics_family(out, "roc_ffmpeg_log_errors_total", "counter", "Error lines in the camera's FFmpeg log, by class");
+    for (size_t i = 0; i < n; ++i) {
+        logt_counts_t lc;
+        log_tail_counts((int)i, &lc);
+        for (int c = 0; c < LOGT_CLASS_COUNT; ++c)
+            metrics_printf(out, "roc_ffmpeg_log_errors_total{camera=\"%zu\",class=\"%s\"} %llu\n", i,
+                           log_tail_class_name(c), (unsigned long long)lc.count[c]);
+    }
+    metrics_family(out, "roc_probes_total", "counter", "Stream probes, by result");
+    for (size_t i = 0; i < n; ++i) {
+        metrics_printf(out, "roc_probes_total{camera=\"%zu\",result=\"ok\"} %llu\n", i,
+                       (unsigned long long)atomic_load_explicit(&cam_metrics[i].probes_ok, memory_order_relaxed));
+        metrics_printf(out, "roc_probes_total{camera=\"%zu\",result=\"failed\"} %llu\n", i,
+                       (unsigned long long)atomic_load_explicit(&cam_metrics[i].probes_failed, memory_order_relaxed));
+    }
+    metrics_family(out, "roc_probe_latency_seconds", "histogram", "Time to first frame of successful stream probes");
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(labels, sizeof(labels), "camera=\"%zu\"", i);
+        metrics_hist(out, "roc_probe_latency_seconds", labels, &cam_metrics[i].probe_ms, 1000.0);
+    }
+    metrics_family(out, "roc_ffmpeg_cpu_percent", "gauge", "CPU use of the camera's FFmpeg over the last sample, percent of one core");
+    for (size_t i = 0; i < n; ++i)
+        if (atomic_load_explicit(&cam_metrics[i].sampled, memory_order_relaxed))
+            metrics_printf(out, "roc_ffmpeg_cpu_percent{camera=\"%zu\"} %.2f\n", i,
+                           atomic_load_explicit(&cam_metrics[i].cpu_centi, memory_order_relaxed) / 100.0);
+    metrics_family(out, "roc_ffmpeg_resident_bytes", "gauge", "Resident set size of the camera's FFmpeg");
+    for (size_t i = 0; i < n; ++i)
+        if (atomic_load_explicit(&cam_metrics[i].sampled, memory_order_relaxed))
+            metrics_printf(out, "roc_ffmpeg_resident_bytes{camera=\"%zu\"} %llu\n", i,
+                           (unsigned long long)atomic_load_explicit(&cam_metrics[i].rss_bytes, memory_order_relaxed));
+    metrics_family(out, "roc_ffmpeg_threads", "gauge", "Threads of the camera's FFmpeg");
+    for (size_t i = 0; i < n; ++i)
+        if (atomic_load_explicit(&cam_metrics[i].sampled, memory_order_relaxed))
+            metrics_printf(out, "roc_ffmpeg_threads{camera=\"%zu\"} %d\n", i,
+                           atomic_load_explicit(&cam_metrics[i].threads, memory_order_relaxed));
+    metrics_family(out, "roc_ffmpeg_context_switches_total", "counter", "Context switches of the camera's FFmpeg, by kind");
+    for (size_t i = 0; i < n; ++i) {
+        if (!atomic_load_explicit(&cam_metrics[i].sampled, memory_order_relaxed)) continue;
+        metrics_printf(out, "roc_ffmpeg_context_switches_total{camera=\"%zu\",kind=\"voluntary\"} %llu\n", i,
+                       (unsigned long long)atomic_load_explicit(&cam_metrics[i].vol_ctxt, memory_order_relaxed));
+        metrics_printf(out, "roc_ffmpeg_context_switches_total{camera=\"%zu\",kind=\"involuntary\"} %llu\n", i,
+                       (unsigned long long)atomic_load_explicit(&cam_metrics[i].nonvol_ctxt, memory_order_relaxed));
+    }
+    metrics_family(out, "roc_ffmpeg_io_bytes_total", "counter", "Bytes the camera's FFmpeg read and wrote through system calls");
+    for (size_t i = 0; i < n; ++i) {
+        if (!atomic_load_explicit(&cam_metrics[i].sampled, memory_order_relaxed)) continue;
+        metrics_printf(out, "roc_ffmpeg_io_bytes_total{camera=\"%zu\",direction=\"read\"} %llu\n", i,
+                       (unsigned long long)atomic_load_explicit(&cam_metrics[i].read_bytes, memory_order_relaxed));
+        metrics_printf(out, "roc_ffmpeg_io_bytes_total{camera=\"%zu\",direction=\"write\"} %llu\n", i,
+                       (unsigned long long)atomic_load_explicit(&cam_metrics[i].write_bytes, memory_order_relaxed));
+    }
+    if (frames_on) render_frame_metrics(out, n);
+    if (!capture_on) return;
+    metrics_family(out, "roc_ffmpeg_output_bytes_total", "counter", "Output of the camera's FFmpeg, by whether it reached the log");
+    for (size_t i = 0; i < n; ++i) {
+        logcap_counts_t lc;
+        logcap_counts((int)i, &lc);
+        metrics_printf(out, "roc_ffmpeg_output_bytes_total{camera=\"%zu\",fate=\"logged\"} %llu\n", i,
+                       (unsigned long long)(lc.captured - lc.dropped));
+        metrics_printf(out, "roc_ffmpeg_output_bytes_total{camera=\"%zu\",fate=\"dropped\"} %llu\n", i,
+                       (unsigned long long)lc.dropped);
+    }
+    metrics_family(out, "roc_ffmpeg_log_rotations_total", "counter", "Rotations of the camera's FFmpeg log");
+    for (size_t i = 0; i < n; ++i) {
+        logcap_counts_t lc;
+        logcap_counts((int)i, &lc);
+        metrics_printf(out, "roc_ffmpeg_log_rotations_total{camera=\"%zu\"} %llu\n", i, (unsigned long long)lc.rotations);
+    }
+}
+
 /* Network helper - test TCP connection to port 1935 */
 static int test_tcp_connect(const char *ip, int port, int timeout_sec) {
-    log_msg("DEBUG", "Testing TCP connection to %s:%d with timeout %d sec", ip, port, timeout_sec);
+    ROC_DEBUG(RLOG_NET, "Testing TCP connection to %s:%d with timeout %d sec", ip, port, timeout_sec);
     if (!ip) {
-        log_msg("ERROR", "Null IP in test_tcp_connect");
+        ROC_ERROR(RLOG_NET, "Null IP in test_tcp_connect");
         return 0;
     }
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        log_msg("ERROR", "socket creation failed: %s", strerror(errno));
+    TRACE_SPAN(span, "net", "tcp_connect");
+    trace_span_args(&span, "%s:%d", ip, port);
+    reach_target_t t = { .ip = ip, .port = port };
+    if (reach_sweep(&t, 1, timeout_sec * 1000) < 0) {
+        ROC_ERROR(RLOG_NET, "epoll setup failed: %s", strerror(errno));
         return 0;
     }
-    struct sockaddr_in addr; 
-    memset(&addr, 0, sizeof(addr)); 
-    addr.sin_family = AF_INET; 
-    addr.sin_port = htons((uint16_t)port);
-    if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) { 
-        log_msg("ERROR", "Invalid IP address %s", ip);
-        close(sock); 
-        return 0; 
-    }
-    int flags = fcntl(sock, F_GETFL, 0); 
-    if (flags >= 0) fcntl(sock, F_SETFL, flags | O_NONBLOCK);
-    int r = connect(sock, (struct sockaddr *)&addr, sizeof(addr)); 
-    if (r == 0) { 
-        log_msg("DEBUG", "Immediate connection success to %s:%d", ip, port);
-        close(sock); 
-        return 1; 
-    }
-    if (errno != EINPROGRESS) { 
-        log_msg("ERROR", "connect to %s:%d failed: %s", ip, port, strerror(errno));
-        close(sock); 
-        return 0; 
-    }
-    fd_set wf; 
-    FD_ZERO(&wf); 
-    FD_SET(sock, &wf); 
-    struct timeval tv = { .tv_sec = timeout_sec, .tv_usec = 0 };
-    r = select(sock + 1, NULL, &wf, NULL, &tv);
-    if (r > 0 && FD_ISSET(sock, &wf)) { 
-        int so = 0; 
-        socklen_t sl = sizeof(so); 
-        getsockopt(sock, SOL_SOCKET, SO_ERROR, &so, &sl); 
-        close(sock); 
-        if (so == 0) {
-            log_msg("DEBUG", "Connection successful to %s:%d", ip, port);
-            return 1;
-        } else {
-            log_msg("ERROR", "Connection to %s:%d failed: %s", ip, port, strerror(so));
-            return 0;
-        }
+    note_reach(cam_metrics_for(ip), t.reachable, t.connect_ms);
+    if (t.reachable) {
+        ROC_DEBUG(RLOG_NET, "Connection successful to %s:%d in %dms", ip, port, t.connect_ms);
+        return 1;
     }
-    log_msg("ERROR", "Connection to %s:%d timed out", ip, port);
-    close(sock); 
+    if (t.error == ETIMEDOUT) ROC_ERROR(RLOG_NET, "Connection to %s:%d timed out", ip, port);
+    else ROC_ERROR(RLOG_NET, "Connection to %s:%d failed: %s", ip, port, strerror(t.error));
     return 0;
 }
 
-/* Probe stream using ffmpeg and parse output */
+/* A failed native probe settles the question only when the camera refused
+ * the stream or never completed a handshake. A camera that answered and then
+ * sent nothing in time, or something the probe does not understand, may
+ * still play for FFmpeg. */
+static int native_probe_failed(int rc, const rtmp_probe_result_t *np) {
+    return rc == RTMP_PROBE_EREJECT || (rc == RTMP_PROBE_ENET && !np->handshake_ok);
+}
+
+/* Probe stream: native RTMP first, ffprobe JSON as the fallback */
 static int probe_stream(const char *ip, const char *user, const char *password, const char *stream_type,
-                        int stream_num, int timeout_sec, char *out_res, size_t res_len, double *out_fps, double *out_score) {
-    log_msg("DEBUG", "Probing stream for %s, type=%s, stream_num=%d", ip, stream_type, stream_num);
-    if (!ip || !stream_type || !out_res || !out_fps || !out_score) {
-        log_msg("ERROR", "Invalid arguments to probe_stream");
+                        int stream_num, int timeout_sec, stream_info_t *out_info) {
+    ROC_DEBUG(RLOG_PROBE, "Probing stream for %s, type=%s, stream_num=%d", ip, stream_type, stream_num);
+    if (!ip || !stream_type || !out_info) {
+        ROC_ERROR(RLOG_PROBE, "Invalid arguments to probe_stream");
         return 0;
     }
+    TRACE_SPAN(span, "probe", "probe_stream");
+    trace_span_args(&span, "%s %s", ip, stream_type);
+    /* Native RTMP probe first: handshake + play, answers in milliseconds */
+    rtmp_probe_result_t np;
+    TRACE_SPAN(native, "probe", "rtmp_probe");
+    int nrc = rtmp_probe_stream(ip, RTMP_DEFAULT_PORT, stream_type, stream_num, user ? user : "admin",
+                                password ? password : "", NATIVE_PROBE_TIMEOUT_MS, &np);
+    TRACE_END(&native);
+    if (nrc == RTMP_PROBE_OK) {
+        stream_info_from_rtmp(&np, out_info);
+        ROC_INFO(RLOG_PROBE, "Probe %s %s -> %dx%d @ %.2ffps codec=%s profile=%s bitrate=%dkbps (native, %dms to first frame)",
+                ip, stream_type, out_info->width, out_info->height, out_info->fps,
+                out_info->codec[0] ? out_info->codec : "unknown", out_info->profile[0] ? out_info->profile : "unknown",
+                out_info->bitrate_kbps, np.first_frame_ms);
+        note_probe(ip, 1, np.first_frame_ms);
+        return 1;
+    }
+    if (native_probe_failed(nrc, &np)) {
+        ROC_WARN(RLOG_PROBE, "Native probe failed for %s %s (%s)", ip, stream_type,
+                nrc == RTMP_PROBE_EREJECT ? "rejected by camera" : "no response");
+        note_probe(ip, 0, 0);
+        return 0;
+    }
+    ROC_DEBUG(RLOG_PROBE, "Native probe inconclusive for %s %s, falling back to ffprobe", ip, stream_type);
     char rtmp[512]; 
     snprintf(rtmp, sizeof(rtmp), "rtmp://%s/bcs/channel0_%s.bcs?channel=0&stream=%d&user=%s&password=%s",
              ip, stream_type, stream_num, user ? user : "admin", password ? password : "");
-    log_msg("DEBUG", "RTMP URL: %s", rtmp);
-    char cmd[1024]; 
-    snprintf(cmd, sizeof(cmd), "ffmpeg -hide_banner -nostdin -rtmp_live live -fflags nobuffer -flags low_delay -re -i '%s' -t 5 -f null - 2>&1", rtmp);
-    log_msg("DEBUG", "Executing probe command: %s", cmd);
-    FILE *fp = popen(cmd, "r"); 
-    if (!fp) { 
-        log_msg("ERROR", "popen probe failed for %s: %s", ip, strerror(errno)); 
-        return 0; 
+    ROC_DEBUG(RLOG_PROBE, "RTMP URL: %s", rtmp);
+    TRACE_SPAN(ff, "probe", "ffprobe");
+    int frc = ffprobe_stream_info(rtmp, timeout_sec, out_info);
+    TRACE_END(&ff);
+    if (frc != 0) {
+        ROC_WARN(RLOG_PROBE, "Probe failed for %s %s (ffprobe returned no video stream)", ip, stream_type);
+        note_probe(ip, 0, 0);
+        return 0;
     }
-    char buf[4096]; 
-    char combined[128*1024]; 
-    size_t pos = 0; 
-    combined[0] = '\0'; 
-    time_t start = time(NULL);
-    while (fgets(buf, sizeof(buf), fp)) {
-        size_t bl = strlen(buf);
-        if (pos + bl < sizeof(combined) - 1) { 
-            memcpy(combined + pos, buf, bl); 
-            pos += bl; 
-            combined[pos] = '\0'; 
-        }
-        if ((int)(time(NULL) - start) > timeout_sec) {
-            log_msg("WARNING", "Probe for %s timed out after %d seconds", ip, timeout_sec);
-            break;
+    ROC_INFO(RLOG_PROBE, "Probe %s %s -> %dx%d @ %.2ffps codec=%s profile=%s bitrate=%dkbps gop=%d tb=%s startup=%dms corrupt=%d",
+            ip, stream_type, out_info->width, out_info->height, out_info->fps, out_info->codec,
+            out_info->profile, out_info->bitrate_kbps, out_info->gop, out_info->time_base,
+            out_info->startup_ms, out_info->decode_errors);
+    note_probe(ip, 1, out_info->startup_ms);
+    return 1;
+}
+
+/* Render a term vector as "resolution=0.50 fps=0.83 ..." for the log */
+static void format_terms(const score_vector_t *v, char *buf, size_t n) {
+    size_t off = 0;
+    buf[0] = '\0';
+    for (int t = 0; t < SCORE_TERM_COUNT && off < n; ++t) {
+        int w = snprintf(buf + off, n - off, "%s%s=%.2f", t ? " " : "", score_term_name(t), v->term[t]);
+        if (w < 0) break;
+        off += (size_t)w;
+    }
+}
+
+/* Record a probe result as the camera's best stream in the discovery cache */
+static void cache_store_result(struct discovery_entry *e, const char *ip, const char *stream,
+                               const struct stream_alt *best, const score_profile_t *profile) {
+    const stream_info_t *info = &best->info;
+    safe_strncpy(e->ip, ip, IP_MAX);
+    safe_strncpy(e->best_stream, stream, sizeof(e->best_stream));
+    snprintf(e->resolution, RES_MAX, "%dx%d", info->width, info->height);
+    e->fps = info->fps;
+    e->score = best->score;
+    safe_strncpy(e->codec, info->codec, sizeof(e->codec));
+    safe_strncpy(e->profile, info->profile, sizeof(e->profile));
+    e->bitrate_kbps = info->bitrate_kbps;
+    e->gop = info->gop;
+    safe_strncpy(e->time_base, info->time_base, sizeof(e->time_base));
+    e->startup_ms = info->startup_ms;
+    e->decode_errors = info->decode_errors;
+    safe_strncpy(e->score_profile, profile->name, sizeof(e->score_profile));
+    e->terms = best->terms;
+    e->last_success = time(NULL);
+    char terms[256];
+    format_terms(&best->terms, terms, sizeof(terms));
+    ROC_INFO(RLOG_CACHE, "Chose %s for %s: score=%.2f (profile %s, %s: %s)", stream, ip, best->score,
+            profile->name, score_model_name(profile->model), terms);
+}
+
+/* Fill an alternative slot from a probe outcome and score it under the
+ * camera's profile (failed probes are recorded too) */
+static void alt_from_probe(struct stream_alt *a, int ok, const stream_info_t *info, const score_profile_t *profile) {
+    memset(a, 0, sizeof(*a));
+    a->ok = ok;
+    if (ok) {
+        a->info = *info;
+        a->score = stream_score(profile, info, &a->terms);
+    }
+    a->last_probe = time(NULL);
+}
+
+/* Re-score cached results under the current profiles, so a weight change in
+ * videopipe.json takes effect without waiting for fresh probes */
+static void rescore_cache(const struct camera_cfg *cams, size_t cam_count,
+                          struct discovery_entry *cache, size_t cache_count) {
+    for (size_t i = 0; i < cam_count; ++i) {
+        const score_profile_t *profile = &score_profiles[cams[i].profile];
+        for (size_t ci = 0; ci < cache_count; ++ci) {
+            struct discovery_entry *e = &cache[ci];
+            if (strcmp(e->ip, cams[i].ip) != 0) continue;
+            for (size_t st = 0; st < STREAM_TYPES_COUNT; ++st)
+                if (e->alts[st].ok) e->alts[st].score = stream_score(profile, &e->alts[st].info, &e->alts[st].terms);
+            stream_info_t info;
+            memset(&info, 0, sizeof(info));
+            if (sscanf(e->resolution, "%dx%d", &info.width, &info.height) != 2) continue;
+            info.fps = e->fps;
+            info.bitrate_kbps = e->bitrate_kbps;
+            info.gop = e->gop;
+            info.startup_ms = e->startup_ms;
+            info.decode_errors = e->decode_errors;
+            e->score = stream_score(profile, &info, &e->terms);
+            safe_strncpy(e->score_profile, profile->name, sizeof(e->score_profile));
+            cache_mark_dirty((int)ci);
+            ROC_DEBUG(RLOG_CACHE, "Re-scored cache entry %s under profile %s: %.2f", e->ip, profile->name, e->score);
         }
     }
-    int rc = pclose(fp);
-    log_msg("DEBUG", "Probe command returned %d", rc);
-    char res[RES_MAX] = "0x0"; 
-    double fps = 0.0; 
-    int dup = 0;
-    /* Parse resolution, fps, dup= */
-    for (size_t i = 0; i + 4 < pos; ++i) {
-        if (isdigit((unsigned char)combined[i])) {
-            size_t j = i; 
-            while (j < pos && isdigit((unsigned char)combined[j])) j++;
-            if (j < pos && combined[j] == 'x') { 
-                size_t k = j + 1; 
-                if (k < pos && isdigit((unsigned char)combined[k])) {
-                    size_t m = i; 
-                    char tmp[RES_MAX]; 
-                    size_t ln = 0;
-                    while (m < pos && (isdigit((unsigned char)combined[m]) || combined[m] == 'x')) {
-                        if (ln + 1 < sizeof(tmp)) {
-                            tmp[ln++] = combined[m];
-                            m++;
-                        } else {
-                            log_msg("WARNING", "Resolution string too long");
-                            break;
-                        }
-                    }
-                    tmp[ln] = '\0'; 
-                    safe_strncpy(res, tmp, sizeof(res)); 
-                    log_msg("DEBUG", "Parsed resolution: %s", res);
-                    break; 
-                }
+}
+
+/* Copy the alternatives probed this round (last_probe set) into a cache entry */
+static void cache_merge_alts(struct discovery_entry *e, const struct stream_alt *alts) {
+    for (size_t st = 0; st < STREAM_TYPES_COUNT; ++st)
+        if (alts[st].last_probe != 0) e->alts[st] = alts[st];
+}
+
+/* Stream history: an append-only event log per camera, summarised into a
+ * reliability factor per stream type that scales scores when ranking */
+static void history_log(const char *ip, hist_kind_t kind, int stream, int ok, int prev, int32_t value) {
+    hist_record_t rec = { .time = (uint32_t)time(NULL), .kind = (uint8_t)kind, .stream = (uint8_t)stream,
+                          .ok = (uint8_t)(ok != 0), .prev = (uint8_t)(prev >= 0 ? prev : 0), .value = value };
+    if (hist_append(HISTORY_DIR, ip, &rec) != 0)
+        ROC_WARN(RLOG_MAIN, "Failed to append %s event to history of %s: %s", hist_kind_name(kind), ip, strerror(errno));
+}
+
+static void history_log_probes(int cam_index, const char *ip, const struct stream_alt *alts) {
+    for (size_t st = 0; st < STREAM_TYPES_COUNT; ++st) {
+        if (alts[st].last_probe == 0) continue;
+        history_log(ip, HIST_PROBE, (int)st, alts[st].ok, -1, (int32_t)(alts[st].score * 100.0));
+        ej_emit(EJ_PROBE, cam_index, (int)st, 0, alts[st].ok, (int32_t)(alts[st].score * 100.0));
+    }
+}
+
+static void refresh_reliability(double *reliability, const char *ip) {
+    hist_record_t *recs = NULL;
+    size_t n = 0;
+    hist_stats_t stats[HIST_MAX_STREAMS];
+    for (size_t st = 0; st < STREAM_ALT_MAX; ++st) reliability[st] = 1.0;
+    if (hist_read(HISTORY_DIR, ip, time(NULL) - HISTORY_WINDOW, &recs, &n) != 0) {
+        ROC_WARN(RLOG_RECOVERY, "Unreadable stream history for %s, ignoring it", ip);
+        return;
+    }
+    hist_summarise(recs, n, HISTORY_WINDOW, stats);
+    free(recs);
+    for (size_t st = 0; st < STREAM_ALT_MAX && st < HIST_MAX_STREAMS; ++st)
+        reliability[st] = stats[st].reliability;
+    ROC_DEBUG(RLOG_RECOVERY, "History for %s over %zu event(s): reliability main=%.2f ext=%.2f sub=%.2f", ip, n,
+            reliability[0], reliability[1], reliability[2]);
+}
+
+/* Order stream types for failover: fresh, pre-validated alternatives first
+ * (highest score first), then the rest in default order with the stream that
+ * just failed last. Returns how many leading entries are pre-validated. */
+static size_t failover_order(const struct discovery_entry *e, int failed_stream, const double *reliability, size_t *order) {
+    size_t n = 0, validated = 0;
+    time_t now = time(NULL);
+    int used[STREAM_ALT_MAX] = {0};
+    if (e) {
+        for (;;) {
+            int best = -1;
+            for (size_t st = 0; st < STREAM_TYPES_COUNT; ++st) {
+                const struct stream_alt *a = &e->alts[st];
+                if (used[st] || (int)st == failed_stream || !a->ok || now - a->last_probe > REPROBE_ALT_MAX_AGE * 2) continue;
+                if (best < 0 || a->score * reliability[st] > e->alts[best].score * reliability[best]) best = (int)st;
             }
+            if (best < 0) break;
+            used[best] = 1;
+            order[n++] = (size_t)best;
         }
+        validated = n;
     }
-    char *fps_p = strstr(combined, " fps"); 
-    if (fps_p) { 
-        const char *q = fps_p; 
-        while (q > combined && (isdigit((unsigned char)*(q-1)) || *(q-1) == '.')) q--; 
-        char tmp[32]; 
-        size_t l = (size_t)(fps_p - q); 
-        if (l < sizeof(tmp)) { 
-            memcpy(tmp, q, l); 
-            tmp[l] = '\0'; 
-            fps = atof(tmp); 
-            log_msg("DEBUG", "Parsed FPS: %.2f", fps);
-        } 
-    }
-    char *dup_p = strstr(combined, "dup="); 
-    if (dup_p) {
-        dup = atoi(dup_p + 4);
-        log_msg("DEBUG", "Parsed dup: %d", dup);
-    }
-    int w = 0, h = 0; 
-    if (res[0] != '0') { 
-        if (sscanf(res, "%dx%d", &w, &h) != 2) sscanf(res, "%d x %d", &w, &h); 
-        log_msg("DEBUG", "Resolution dimensions: %dx%d", w, h);
-    }
-    double score = (double)w * (double)h * fps * (1.0 - (double)dup / 1000.0);
-    if (rc == 0 && res[0] != '0') { 
-        safe_strncpy(out_res, res, res_len); 
-        *out_fps = fps; 
-        *out_score = score; 
-        log_msg("INFO", "Probe %s %s -> %s @ %.2ffps score=%.2f", ip, stream_type, out_res, *out_fps, *out_score); 
-        return 1; 
-    }
-    log_msg("WARNING", "Probe failed for %s %s (rc=%d)", ip, stream_type, rc); 
-    return 0;
+    for (size_t st = 0; st < STREAM_TYPES_COUNT; ++st)
+        if (!used[st] && (int)st != failed_stream) { used[st] = 1; order[n++] = st; }
+    if (failed_stream >= 0 && failed_stream < (int)STREAM_TYPES_COUNT && !used[failed_stream])
+        order[n++] = (size_t)failed_stream;
+    return validated;
+}
+
+/* RTMP input URL for a camera stream; also used to recognise adopted ffmpeg processes */
+static void ffmpeg_input_url(const struct camera_cfg *cam, const char *stream_type, char *buf, size_t n) {
+    snprintf(buf, n, "rtmp://%s/bcs/channel0_%s.bcs?channel=0&stream=%d&user=%s&password=%s",
+             cam->ip, stream_type, (strcmp(stream_type, "sub") == 0) ? 1 : 0, 
+             cam->user[0] ? cam->user : "admin", cam->password);
 }
 
 /* Spawn optimized ffmpeg process */
 static pid_t spawn_ffmpeg(int camera_index, const struct camera_cfg *cam, const char *stream_type, double fps) {
-    log_msg("DEBUG", "Spawning FFmpeg for camera %d, ip=%s, stream=%s, fps=%.2f", 
+    ROC_DEBUG(RLOG_PROC, "Spawning FFmpeg for camera %d, ip=%s, stream=%s, fps=%.2f", 
             camera_index, cam->ip, stream_type, fps);
     if (!cam || !stream_type) {
-        log_msg("ERROR", "Invalid arguments to spawn_ffmpeg");
+        ROC_ERROR(RLOG_PROC, "Invalid arguments to spawn_ffmpeg");
         return -1;
     }
+    TRACE_SPAN(span, "proc", "spawn_ffmpeg");
+    trace_span_args(&span, "camera %d %s", camera_index, stream_type);
     char rtmp[512]; 
-    snprintf(rtmp, sizeof(rtmp), "rtmp://%s/bcs/channel0_%s.bcs?channel=0&stream=%d&user=%s&password=%s",
-             cam->ip, stream_type, (strcmp(stream_type, "sub") == 0) ? 1 : 0, 
-             cam->user[0] ? cam->user : "admin", cam->password);
-    log_msg("DEBUG", "FFmpeg RTMP URL: %s", rtmp);
+    ffmpeg_input_url(cam, stream_type, rtmp, sizeof(rtmp));
+    ROC_DEBUG(RLOG_PROC, "FFmpeg RTMP URL: %s", rtmp);
     char devpath[64]; 
     snprintf(devpath, sizeof(devpath), "/dev/video%d", camera_index + VIDEO_DEVICE_OFFSET);
     char logfile[256]; 
     snprintf(logfile, sizeof(logfile), "%s/camera%d.log", LOG_DIR, camera_index);
-    log_msg("DEBUG", "FFmpeg output device: %s, log: %s", devpath, logfile);
+    ROC_DEBUG(RLOG_PROC, "FFmpeg output device: %s, log: %s", devpath, logfile);
+    /* Everything is prepared before fork: the child only redirects and execs,
+     * and must not log (the log rings belong to the parent's threads) */
+    int piped = 0, fd = -1;
+    if (capture_on) {
+        fd = logcap_pipe(camera_index);
+        if (fd >= 0) piped = 1;
+        else ROC_WARN(RLOG_PROC, "Cannot capture output of camera %d (%s); appending to %s", camera_index, strerror(errno), logfile);
+    }
+    if (fd < 0) fd = open(logfile, O_CREAT | O_WRONLY | O_APPEND | O_CLOEXEC, 0644); 
+    if (fd < 0) ROC_ERROR(RLOG_PROC, "Failed to open %s: %s", logfile, strerror(errno));
+    char fpsbuf[32]; 
+    snprintf(fpsbuf, sizeof(fpsbuf), "%.2f", fps > 0.0 ? fps : 15.0);
+    char vfbuf[64]; 
+    snprintf(vfbuf, sizeof(vfbuf), "fps=fps=%.2f", fps > 0.0 ? fps : 15.0);
+    ROC_DEBUG(RLOG_PROC, "FFmpeg args: fps=%s, vf=%s", fpsbuf, vfbuf);
+    /* Build argv: tuned for low-latency */
+    char *argv[32]; 
+    int ai = 0;
+    argv[ai++] = "ffmpeg";
+    argv[ai++] = "-hide_banner";
+    argv[ai++] = "-nostdin";
+    argv[ai++] = "-re";
+    argv[ai++] = "-rtmp_live"; argv[ai++] = "live";
+    argv[ai++] = "-fflags"; argv[ai++] = "nobuffer";
+    argv[ai++] = "-flags"; argv[ai++] = "low_delay";
+    argv[ai++] = "-probesize"; argv[ai++] = "32";
+    argv[ai++] = "-analyzeduration"; argv[ai++] = "0";
+    argv[ai++] = "-i"; argv[ai++] = rtmp;
+    argv[ai++] = "-vf"; argv[ai++] = vfbuf;
+    argv[ai++] = "-vsync"; argv[ai++] = "1";
+    argv[ai++] = "-r"; argv[ai++] = fpsbuf;
+    argv[ai++] = "-pix_fmt"; argv[ai++] = "yuv420p"; // Added pixel format
+    argv[ai++] = "-f"; argv[ai++] = "v4l2";
+    argv[ai++] = devpath;
+    argv[ai] = NULL;
     pid_t pid = fork();
     if (pid < 0) { 
-        log_msg("ERROR", "fork failed: %s", strerror(errno)); 
+        ROC_ERROR(RLOG_PROC, "fork failed: %s", strerror(errno)); 
+        if (fd >= 0) close(fd);
         return -1; 
     }
     if (pid == 0) {
         /* Child */
-        log_msg("DEBUG", "In FFmpeg child process");
-        int fd = open(logfile, O_CREAT | O_WRONLY | O_APPEND, 0644); 
         if (fd >= 0) { 
             dup2(fd, STDOUT_FILENO); 
             dup2(fd, STDERR_FILENO); 
-            if (fd > STDERR_FILENO) close(fd); 
-            log_msg("DEBUG", "Redirected FFmpeg output to %s", logfile);
-        } else {
-            log_msg("ERROR", "Failed to open %s: %s", logfile, strerror(errno));
         }
+        /* A write after the reader has gone (SIGHUP restart) then fails
+         * instead of killing the stream. videopipe itself ignores SIGPIPE,
+         * which exec would otherwise pass on to a file-logging FFmpeg */
+        signal(SIGPIPE, piped ? SIG_IGN : SIG_DFL);
         environ = NULL; /* Clear environment */
-        char fpsbuf[32]; 
-        snprintf(fpsbuf, sizeof(fpsbuf), "%.2f", fps > 0.0 ? fps : 15.0);
-        char vfbuf[64]; 
-        snprintf(vfbuf, sizeof(vfbuf), "fps=fps=%.2f", fps > 0.0 ? fps : 15.0);
-        log_msg("DEBUG", "FFmpeg args: fps=%s, vf=%s", fpsbuf, vfbuf);
-        /* Build argv: tuned for low-latency */
-        char *argv[32]; 
-        int ai = 0;
-        argv[ai++] = "ffmpeg";
-        argv[ai++] = "-hide_banner";
-        argv[ai++] = "-nostdin";
-        argv[ai++] = "-re";
-        argv[ai++] = "-rtmp_live"; argv[ai++] = "live";
-        argv[ai++] = "-fflags"; argv[ai++] = "nobuffer";
-        argv[ai++] = "-flags"; argv[ai++] = "low_delay";
-        argv[ai++] = "-probesize"; argv[ai++] = "32";
-        argv[ai++] = "-analyzeduration"; argv[ai++] = "0";
-        argv[ai++] = "-i"; argv[ai++] = rtmp;
-        argv[ai++] = "-vf"; argv[ai++] = vfbuf;
-        argv[ai++] = "-vsync"; argv[ai++] = "1";
-        argv[ai++] = "-r"; argv[ai++] = fpsbuf;
-        argv[ai++] = "-pix_fmt"; argv[ai++] = "yuv420p"; // Added pixel format
-        argv[ai++] = "-f"; argv[ai++] = "v4l2";
-        argv[ai++] = devpath;
-        argv[ai] = NULL;
-        log_msg("DEBUG", "Executing FFmpeg with args: %s", argv[0]);
         execvp("ffmpeg", argv);
-        log_msg("ERROR", "execvp ffmpeg failed: %s", strerror(errno));
+        static const char msg[] = "videopipe: execvp ffmpeg failed\n";
+        ssize_t w = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+        (void)w;
         _exit(127);
     }
-    log_msg("INFO", "Spawned FFmpeg pid=%d for camera %d (%s) -> %s", 
+    if (fd >= 0) close(fd);
+    if (frames_on) fhist_watch(camera_index, devpath, fps > 0.0 ? fps : 15.0);
+    ROC_INFO(RLOG_PROC, "Spawned FFmpeg pid=%d for camera %d (%s) -> %s", 
             (int)pid, camera_index, cam->ip, devpath);
+    int stream_index = EJ_NONE;
+    for (size_t st = 0; st < STREAM_TYPES_COUNT; ++st)
+        if (strcmp(STREAM_TYPES[st], stream_type) == 0) stream_index = (int)st;
+    ej_emit(EJ_SPAWN, camera_index, stream_index, (int)pid, 0, 0);
     return pid;
 }
 
-static int find_cache_entry(struct discovery_entry *entries, size_t cnt, const char *ip) { 
-    log_msg("DEBUG", "Searching cache for ip=%s", ip);
+/* Describe camera i's ffmpeg as a state entry; pid 0 when none is running */
+static void proc_entry_fill(proc_state_entry_t *e, const struct camera_cfg *cams, const struct running_proc *procs, size_t i) {
+    memset(e, 0, sizeof(*e));
+    int running = procs[i].alive && procs[i].pid > 0;
+    e->pid = running ? procs[i].pid : 0;
+    e->cam_index = (int)i;
+    e->stream_index = procs[i].stream_index;
+    e->start_ticks = running ? procs[i].start_ticks : 0;
+    snprintf(e->device, sizeof(e->device), "/dev/video%d", (int)i + VIDEO_DEVICE_OFFSET);
+    safe_strncpy(e->ip, cams[i].ip, sizeof(e->ip));
+}
+
+/* Is an adopted ffmpeg still running? Without a pidfd, fall back to /proc */
+static int adopted_alive(const struct running_proc *p) {
+    return p->pidfd >= 0 ? !proc_pidfd_exited(p->pidfd) : proc_is_same(p->pid, p->start_ticks);
+}
+
+/* Record every live ffmpeg so that a restarted videopipe can adopt it */
+static void save_proc_state(const struct camera_cfg *cams, size_t cam_count, const struct running_proc *procs) {
+    proc_state_entry_t *entries = calloc((size_t)MAX_CAMERAS, sizeof(*entries));
+    if (!entries) return;
+    size_t n = 0;
+    for (size_t i = 0; i < cam_count && i < (size_t)MAX_CAMERAS; ++i)
+        if (procs[i].alive && procs[i].pid > 0) proc_entry_fill(&entries[n++], cams, procs, i);
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s", PROC_STATE_FILE);
+    char *slash = strrchr(dir, '/');
+    if (slash) {
+        *slash = '\0';
+        if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+            ROC_ERROR(RLOG_PROC, "Failed to create %s: %s", dir, strerror(errno));
+    }
+    if (proc_state_save(PROC_STATE_FILE, entries, n) != 0)
+        ROC_WARN(RLOG_PROC, "Failed to save %s: %s", PROC_STATE_FILE, strerror(errno));
+    free(entries);
+}
+
+/* Adopt ffmpeg processes left running by a previous videopipe. A recorded pid
+ * counts as ours only while its start time matches and it is still ffmpeg
+ * writing to the recorded device. It is adopted if it reads exactly the URL
+ * we would use now; one left over from an older camera configuration is
+ * stopped so the camera is started afresh. pidfds, if given, are taken over
+ * (index-aligned with entries, -1 where missing); otherwise one is opened. */
+static size_t adopt_children(const struct camera_cfg *cams, size_t cam_count, struct running_proc *procs,
+                             const proc_state_entry_t *entries, size_t n, const int *pidfds) {
+    size_t adopted = 0;
+    for (size_t k = 0; k < n; ++k) {
+        const proc_state_entry_t *e = &entries[k];
+        int pidfd = pidfds ? pidfds[k] : -1;
+        const char *own[] = { e->device };
+        if (e->pid <= 0) continue;
+        if (!proc_is_same(e->pid, e->start_ticks) || !proc_cmdline_matches(e->pid, "ffmpeg", own, 1)) {
+            ROC_DEBUG(RLOG_PROC, "Recorded FFmpeg pid=%d for camera %d is gone", (int)e->pid, e->cam_index);
+            if (pidfd >= 0) close(pidfd);
+            continue;
+        }
+        size_t i = (size_t)e->cam_index;
+        char url[512], devpath[64];
+        int usable = e->cam_index >= 0 && i < cam_count && i < (size_t)MAX_CAMERAS && !procs[i].alive &&
+                     e->stream_index >= 0 && e->stream_index < (int)STREAM_TYPES_COUNT &&
+                     strcmp(cams[i].ip, e->ip) == 0;
+        if (usable) {
+            ffmpeg_input_url(&cams[i], STREAM_TYPES[e->stream_index], url, sizeof(url));
+            snprintf(devpath, sizeof(devpath), "/dev/video%d", (int)i + VIDEO_DEVICE_OFFSET);
+            const char *want[] = { url, devpath };
+            usable = proc_cmdline_matches(e->pid, "ffmpeg", want, 2);
+        }
+        if (!usable) {
+            ROC_INFO(RLOG_PROC, "Stopping FFmpeg pid=%d (%s -> %s): camera configuration changed",
+                    (int)e->pid, e->ip, e->device);
+            kill(e->pid, SIGTERM);
+            if (pidfd >= 0) close(pidfd);
+            continue;
+        }
+        time_t started = proc_start_time(e->start_ticks);
+        procs[i].pid = e->pid;
+        procs[i].cam_index = (int)i;
+        procs[i].stream_index = e->stream_index;
+        procs[i].alive = 1;
+        procs[i].degraded = 0;
+        procs[i].adopted = 1;
+        procs[i].start_ticks = e->start_ticks;
+        procs[i].pidfd = pidfd >= 0 ? pidfd : proc_pidfd_open(e->pid, e->start_ticks);
+        procs[i].started = started != (time_t)-1 ? started : time(NULL);
+        ROC_INFO(RLOG_PROC, "Adopted FFmpeg pid=%d for camera %zu (%s) streaming %s -> %s, running %lds",
+                (int)e->pid, i, cams[i].ip, STREAM_TYPES[e->stream_index], devpath,
+                (long)(time(NULL) - procs[i].started));
+        adopted++;
+    }
+    return adopted;
+}
+
+/* Adopt what the state file lists, after a restart or crash */
+static size_t adopt_from_state_file(const struct camera_cfg *cams, size_t cam_count, struct running_proc *procs) {
+    proc_state_entry_t *entries = calloc((size_t)MAX_CAMERAS, sizeof(*entries));
+    if (!entries) return 0;
+    int n = proc_state_load(PROC_STATE_FILE, entries, MAX_CAMERAS);
+    size_t adopted = 0;
+    if (n < 0)
+        ROC_WARN(RLOG_PROC, "Ignoring unreadable %s: %s", PROC_STATE_FILE, strerror(errno));
+    else
+        adopted = adopt_children(cams, cam_count, procs, entries, (size_t)n, NULL);
+    free(entries);
+    return adopted;
+}
+
+/* Verify a cached stream type still plays before trusting it. Falls back to a
+ * bare TCP check when the native probe is inconclusive (see native_probe_failed). */
+static int cached_stream_usable(const struct camera_cfg *cam, const char *stream_type) {
+    TRACE_SPAN(span, "probe", "cached_stream_usable");
+    trace_span_args(&span, "%s %s", cam->ip, stream_type);
+    rtmp_probe_result_t np;
+    int sn = (strcmp(stream_type, "sub") == 0) ? 1 : 0;
+    int rc = rtmp_probe_stream(cam->ip, RTMP_DEFAULT_PORT, stream_type, sn, cam->user[0] ? cam->user : "admin",
+                               cam->password, NATIVE_PROBE_TIMEOUT_MS, &np);
+    if (rc == RTMP_PROBE_OK) {
+        ROC_DEBUG(RLOG_CACHE, "Cached stream %s for %s verified natively (%dx%d @ %.2ffps, %dms)",
+                stream_type, cam->ip, np.width, np.height, np.fps, np.first_frame_ms);
+        note_probe(cam->ip, 1, np.first_frame_ms);
+        return 1;
+    }
+    if (!native_probe_failed(rc, &np)) return test_tcp_connect(cam->ip, 1935, 2);
+    note_probe(cam->ip, 0, 0);
+    return 0;
+}
+
+static int find_cache_entry(const struct discovery_entry *entries, size_t cnt, const char *ip) { 
+    ROC_DEBUG(RLOG_CACHE, "Searching cache for ip=%s", ip);
     for (size_t i = 0; i < cnt; ++i) 
         if (strcmp(entries[i].ip, ip) == 0) {
-            log_msg("DEBUG", "Found cache entry for %s at index %zu", ip, i);
+            ROC_DEBUG(RLOG_CACHE, "Found cache entry for %s at index %zu", ip, i);
             return (int)i; 
         }
-    log_msg("DEBUG", "No cache entry for %s", ip);
+    ROC_DEBUG(RLOG_CACHE, "No cache entry for %s", ip);
     return -1; 
 }
 
-int main(void) {
+/* Background re-probe callback, runs on the low-priority worker thread */
+static int reprobe_run(const reprobe_job_t *job, stream_info_t *info) {
+    return probe_stream(job->ip, job->user, job->password, job->stream_type, job->stream_num,
+                        TEST_TIMEOUT, info);
+}
+
+/* Passive health check: read each ffmpeg child's RTMP socket from the kernel
+ * with sock_diag instead of connecting to the camera. Kills children whose
+ * connection is gone or has stopped receiving data, so recovery takes over.
+ * Returns -1 if sock_diag is unavailable. */
+static int passive_health_check(const struct camera_cfg *cams, size_t cam_count, struct running_proc *procs) {
+    conn_diag_t conns[MAX_CAMERAS * 4];
+    int n = conn_diag_dump(1935, conns, sizeof(conns) / sizeof(conns[0]));
+    if (n < 0) return -1;
+    time_t now = time(NULL);
+    for (size_t i = 0; i < cam_count && i < (size_t)MAX_CAMERAS; ++i) {
+        struct running_proc *p = &procs[i];
+        if (!p->alive || p->pid <= 0) continue;
+        int k = conn_diag_find_pid(p->pid, conns, (size_t)n);
+        if (k < 0) {
+            if (now - p->started < health_cfg.connect_grace_sec) continue;
+            ROC_WARN(RLOG_HEALTH, "Camera %zu (%s): FFmpeg pid=%d holds no RTMP connection, killing to trigger recovery",
+                    i, cams[i].ip, (int)p->pid);
+            ej_emit(EJ_STALL, (int)i, p->stream_index, (int)p->pid, EJ_STALL_NO_CONNECTION, (int32_t)(now - p->started));
+            kill(p->pid, SIGTERM);
+            continue;
+        }
+        const conn_diag_t *c = &conns[k];
+        ROC_DEBUG(RLOG_HEALTH, "Camera %zu (%s): rtt=%.1fms rttvar=%.1fms retrans=%u/%u rx=%llu bytes, last data %ums ago",
+                i, cams[i].ip, c->rtt_us / 1000.0, c->rttvar_us / 1000.0, c->retransmits, c->total_retrans,
+                (unsigned long long)c->bytes_received, c->last_data_recv_ms);
+        if (c->last_data_recv_ms > (uint32_t)health_cfg.stall_ms) {
+            ROC_WARN(RLOG_HEALTH, "Camera %zu (%s): no data for %ums on the RTMP connection, killing FFmpeg pid=%d to trigger recovery",
+                    i, cams[i].ip, c->last_data_recv_ms, (int)p->pid);
+            ej_emit(EJ_STALL, (int)i, p->stream_index, (int)p->pid, EJ_STALL_NO_DATA, (int32_t)c->last_data_recv_ms);
+            kill(p->pid, SIGTERM);
+            continue;
+        }
+        int degraded = c->retransmits > 0 || c->rtt_us / 1000 > (uint32_t)health_cfg.rtt_warn_ms;
+        if (degraded && !p->degraded)
+            ROC_WARN(RLOG_HEALTH, "Camera %zu (%s): connection degraded (rtt=%.1fms, %u retransmission timeout(s), %u segments retransmitted)",
+                    i, cams[i].ip, c->rtt_us / 1000.0, c->retransmits, c->total_retrans);
+        else if (!degraded && p->degraded)
+            ROC_INFO(RLOG_HEALTH, "Camera %zu (%s): connection healthy again (rtt=%.1fms)", i, cams[i].ip, c->rtt_us / 1000.0);
+        p->degraded = degraded;
+    }
+    return 0;
+}
+
+/* Log error check: the tailer counts classified lines in each camera's
+ * FFmpeg log. A burst of decode or I/O errors means the stream is arriving
+ * but is unusable, which the socket checks cannot see; stopping FFmpeg
+ * lets recovery fail over, trying this stream type last. */
+static void log_error_check(const struct camera_cfg *cams, size_t cam_count, struct running_proc *procs) {
+    time_t now = time(NULL);
+    for (size_t i = 0; i < cam_count && i < (size_t)MAX_CAMERAS; ++i) {
+        struct running_proc *p = &procs[i];
+        if (!p->alive || p->pid <= 0) continue;
+        logt_counts_t lc;
+        log_tail_counts((int)i, &lc);
+        uint64_t errors = lc.count[LOGT_DECODE] + lc.count[LOGT_IO];
+        if (p->err_pid != p->pid) {
+            p->err_pid = p->pid;
+            p->err_base = errors;
+            continue;
+        }
+        uint64_t burst = errors - p->err_base;
+        p->err_base = errors;
+        if (health_cfg.error_burst <= 0 || burst < (uint64_t)health_cfg.error_burst ||
+            now - p->started < health_cfg.connect_grace_sec)
+            continue;
+        ROC_WARN(RLOG_HEALTH, "Camera %zu (%s): %llu decode/I/O error(s) logged since the last check, killing FFmpeg pid=%d to trigger recovery",
+                i, cams[i].ip, (unsigned long long)burst, (int)p->pid);
+        ej_emit(EJ_STALL, (int)i, p->stream_index, (int)p->pid, EJ_STALL_ERROR_BURST,
+                burst > INT32_MAX ? INT32_MAX : (int32_t)burst);
+        kill(p->pid, SIGTERM);
+    }
+}
+
+/* Hand the stalest alternative stream of the next healthy camera to the
+ * re-probe worker. Cameras are visited round-robin, one job at a time. */
+static void schedule_reprobe(const struct camera_cfg *cams, size_t cam_count, const struct running_proc *procs,
+                             const struct discovery_entry *cache, size_t cache_count, size_t *cursor) {
+    if (cam_count == 0 || reprobe_busy()) return;
+    time_t now = time(NULL);
+    for (size_t n = 0; n < cam_count; ++n) {
+        size_t i = (*cursor + n) % cam_count;
+        if (!procs[i].alive || now - procs[i].started < REPROBE_MIN_UPTIME) continue;
+        int ci = find_cache_entry(cache, cache_count, cams[i].ip);
+        if (ci < 0) continue;
+        int pick = -1;
+        for (size_t st = 0; st < STREAM_TYPES_COUNT; ++st) {
+            if ((int)st == procs[i].stream_index) continue;
+            time_t last = cache[ci].alts[st].last_probe;
+            if (now - last < REPROBE_ALT_MAX_AGE) continue;
+            if (pick < 0 || last < cache[ci].alts[pick].last_probe) pick = (int)st;
+        }
+        if (pick < 0) continue;
+        reprobe_job_t job;
+        memset(&job, 0, sizeof(job));
+        job.cam_index = (int)i;
+        job.stream_index = pick;
+        safe_strncpy(job.ip, cams[i].ip, sizeof(job.ip));
+        safe_strncpy(job.user, cams[i].user[0] ? cams[i].user : "admin", sizeof(job.user));
+        safe_strncpy(job.password, cams[i].password, sizeof(job.password));
+        safe_strncpy(job.stream_type, STREAM_TYPES[pick], sizeof(job.stream_type));
+        job.stream_num = (strcmp(STREAM_TYPES[pick], "sub") == 0) ? 1 : 0;
+        if (reprobe_submit(&job) == 0) {
+            ROC_DEBUG(RLOG_PROBE, "Background re-probe queued for camera %zu (%s) stream %s", i, cams[i].ip, STREAM_TYPES[pick]);
+            *cursor = i + 1;
+        }
+        return;
+    }
+}
+
+/* Per-camera recovery state. The supervisor decides when an attempt may run
+ * (admission gate, backoff, priority); the attempt itself - reachability
+ * check plus probes in failover order - runs on its own thread so one slow
+ * camera never holds up the others. Fields under "Attempt results" are
+ * written by that thread under recovery_lock. */
+struct recovery {
+    int active;          /* Camera is down and waiting for a stream */
+    int in_flight;       /* An attempt thread is running */
+    int ready;           /* Probe succeeded, waiting for a spawn slot */
+    int attempt;         /* Failed attempts so far */
+    int warned;
+    int failed_stream;   /* Stream type that died, -1 at startup */
+    uint64_t next_ms;    /* Earliest start of the next attempt */
+    uint64_t down_ms;    /* When the camera went down */
+    uint32_t seed;       /* Backoff jitter state */
+    pthread_t thread;
+    /* Attempt inputs, fixed while in flight */
+    struct camera_cfg cam;
+    const score_profile_t *profile;
+    size_t order[STREAM_ALT_MAX];
+    size_t validated;
+    double reliability[STREAM_ALT_MAX]; /* From stream history, 1.0 without history */
+    /* Attempt results */
+    int done;
+    int reachable;
+    int ok;
+    size_t chosen_st;
+    struct stream_alt probed[STREAM_ALT_MAX];
+};
+
+static pthread_mutex_t recovery_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* One recovery attempt: reachability check, then probes in failover order,
+ * stopping at the first pre-validated alternative that still plays */
+static void *recovery_attempt(void *arg) {
+    struct recovery *r = arg;
+    trace_thread_name("recovery");
+    TRACE_SPAN(span, "recovery", "recovery_attempt");
+    trace_span_args(&span, "%s attempt %d", r->cam.ip, r->attempt + 1);
+    struct stream_alt probed[STREAM_ALT_MAX];
+    memset(probed, 0, sizeof(probed));
+    int ok = 0;
+    size_t chosen = 0;
+    int reachable = test_tcp_connect(r->cam.ip, 1935, 2);
+    for (size_t k = 0; reachable && k < STREAM_TYPES_COUNT && !exit_flag && !atomic_load(&handed_over); ++k) {
+        size_t st = r->order[k];
+        stream_info_t info;
+        int sn = (strcmp(STREAM_TYPES[st], "sub") == 0) ? 1 : 0;
+        ROC_DEBUG(RLOG_RECOVERY, "Recovery probe for %s stream type %s", r->cam.ip, STREAM_TYPES[st]);
+        int pok = probe_stream(r->cam.ip, r->cam.user, r->cam.password, STREAM_TYPES[st], sn, TEST_TIMEOUT, &info);
+        alt_from_probe(&probed[st], pok, &info, r->profile);
+        if (!pok) continue;
+        if (!ok || probed[st].score * r->reliability[st] > probed[chosen].score * r->reliability[chosen]) {
+            ok = 1;
+            chosen = st;
+        }
+        /* Highest-ranked fresh alternative confirmed: no need to probe the rest */
+        if (k < r->validated) break;
+    }
+    pthread_mutex_lock(&recovery_lock);
+    memcpy(r->probed, probed, sizeof(probed));
+    r->reachable = reachable;
+    r->ok = ok;
+    r->chosen_st = chosen;
+    r->done = 1;
+    pthread_mutex_unlock(&recovery_lock);
+    return NULL;
+}
+
+/* Put a camera into recovery. Its first attempt is due immediately; the
+ * admission gate decides when it actually runs. Returns 1 if the camera
+ * was not already recovering. */
+static int recovery_begin(struct recovery *r, const struct camera_cfg *cam, int failed_stream, uint64_t now) {
+    if (r->active) return 0;
+    uint32_t seed = r->seed;
+    memset(r, 0, sizeof(*r));
+    r->active = 1;
+    r->failed_stream = failed_stream;
+    r->next_ms = now;
+    r->down_ms = now;
+    r->cam = *cam;
+    r->profile = &score_profiles[cam->profile];
+    /* Seed jitter per camera so cameras that failed together drift apart */
+    r->seed = seed ? seed : (uint32_t)now ^ ((uint32_t)getpid() << 16);
+    for (const char *p = cam->ip; *p; ++p) r->seed = r->seed * 31u + (uint8_t)*p;
+    return 1;
+}
+
+/* Schedule the next attempt after a failure */
+static void recovery_backoff(struct recovery *r, int cam_index, uint64_t now) {
+    r->attempt++;
+    int delay = backoff_jitter_ms(r->attempt, recovery_cfg.backoff_base_ms, recovery_cfg.backoff_max_ms, &r->seed);
+    r->next_ms = now + (uint64_t)delay;
+    ROC_WARN(RLOG_RECOVERY, "Camera %d (%s) recovery attempt %d failed, retrying in %dms",
+            cam_index, r->cam.ip, r->attempt, delay);
+    if (r->attempt >= RECOVERY_WARN_ATTEMPTS && !r->warned) {
+        ROC_ERROR(RLOG_RECOVERY, "Could not recover camera %d (%s) after %d attempts; still retrying",
+                cam_index, r->cam.ip, r->attempt);
+        r->warned = 1;
+    }
+}
+
+/* Camera indices in recovery priority order: program cameras first, then
+ * the longest-down. Returns how many were written. */
+static size_t recovery_priority(const struct recovery *rec, size_t cam_count, int want_ready, size_t *out) {
+    size_t n = 0;
+    for (size_t i = 0; i < cam_count; ++i) {
+        if (!rec[i].active || rec[i].in_flight || rec[i].ready != want_ready) continue;
+        size_t j = n++;
+        while (j > 0) {
+            const struct recovery *a = &rec[out[j - 1]], *b = &rec[i];
+            int before = b->cam.program > a->cam.program ||
+                         (b->cam.program == a->cam.program && b->down_ms < a->down_ms);
+            if (!before) break;
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = i;
+    }
+    return n;
+}
+
+/* Copy the state the supervisor owns into the metrics atomics; once per loop */
+static void publish_metrics(const struct running_proc *procs, const struct recovery *rec, size_t cam_count) {
+    for (size_t i = 0; i < cam_count && i < cam_metrics_count; ++i) {
+        struct cam_metrics *m = &cam_metrics[i];
+        int running = procs[i].alive && procs[i].pid > 0;
+        atomic_store_explicit(&m->started, running ? (long long)procs[i].started : 0, memory_order_relaxed);
+        atomic_store_explicit(&m->stream, running ? procs[i].stream_index : -1, memory_order_relaxed);
+        atomic_store_explicit(&m->running, running, memory_order_relaxed);
+        atomic_store_explicit(&m->recovering, rec[i].active, memory_order_relaxed);
+        atomic_store_explicit(&m->degraded, running && procs[i].degraded, memory_order_relaxed);
+    }
+}
+
+/* Open /proc files of each camera's FFmpeg; reopened when the pid changes */
+static pstat_proc_t child_stats[MAX_CAMERAS];
+static double children_cpu_pct = 0.0;   /* Sum over all children at the last sample, percent of one core */
+static long online_cpus = 1;
+
+/* Sample every running FFmpeg and publish the figures. Costs three pread()
+ * calls per child; a child that has exited drops out until it is respawned. */
+static void sample_children(const struct running_proc *procs, size_t cam_count) {
+    double total = 0.0;
+    for (size_t i = 0; i < cam_count && i < cam_metrics_count; ++i) {
+        pstat_proc_t *ps = &child_stats[i];
+        struct cam_metrics *m = &cam_metrics[i];
+        pid_t pid = procs[i].alive ? procs[i].pid : 0;
+        if (ps->pid != pid) {
+            pstat_close(ps);
+            atomic_store_explicit(&m->sampled, 0, memory_order_relaxed);
+            if (pid > 0 && pstat_open(ps, pid) != 0)
+                ROC_DEBUG(RLOG_PROC, "Cannot open /proc/%d of camera %zu: %s", (int)pid, i, strerror(errno));
+        }
+        if (ps->pid <= 0) continue;
+        pstat_sample_t s;
+        if (pstat_sample(ps, &s) != 0) {
+            atomic_store_explicit(&m->sampled, 0, memory_order_relaxed);
+            continue;
+        }
+        total += s.cpu_pct;
+        atomic_store_explicit(&m->cpu_centi, (int)(s.cpu_pct * 100.0 + 0.5), memory_order_relaxed);
+        atomic_store_explicit(&m->rss_bytes, s.rss_bytes, memory_order_relaxed);
+        atomic_store_explicit(&m->threads, s.threads, memory_order_relaxed);
+        atomic_store_explicit(&m->vol_ctxt, s.vol_ctxt, memory_order_relaxed);
+        atomic_store_explicit(&m->nonvol_ctxt, s.nonvol_ctxt, memory_order_relaxed);
+        atomic_store_explicit(&m->read_bytes, s.read_bytes, memory_order_relaxed);
+        atomic_store_explicit(&m->write_bytes, s.write_bytes, memory_order_relaxed);
+        atomic_store_explicit(&m->sampled, 1, memory_order_relaxed);
+        if (s.valid_rates)
+            ROC_DEBUG(RLOG_PROC, "Camera %zu pid %d: cpu %.1f%%, rss %lluKiB, %d threads, ctxt %.0f+%.0f/s, read %.0fB/s, write %.0fB/s",
+                    i, (int)pid, s.cpu_pct, (unsigned long long)(s.rss_bytes / 1024), s.threads,
+                    s.vol_ctxt_rate, s.nonvol_ctxt_rate, s.read_rate, s.write_rate);
+    }
+    children_cpu_pct = total;
+}
+
+/* The children already use more CPU than the re-probe budget allows */
+static int children_over_budget(void) {
+    if (resources_cfg.sample_interval_sec <= 0 || resources_cfg.reprobe_cpu_limit_pct <= 0) return 0;
+    return children_cpu_pct / (double)online_cpus > (double)resources_cfg.reprobe_cpu_limit_pct;
+}
+
+/* Link and neighbour events: stop streams on a dead link or an unanswered
+ * camera straight away, hold recovery while the link is down, and retry
+ * immediately once the link or the camera is back */
+static void handle_net_events(int nlfd, const struct camera_cfg *cams, size_t cam_count,
+                              const struct running_proc *procs, struct recovery *rec,
+                              int *cam_ifindex, int *link_down, uint64_t now_ms) {
+    nlmon_event_t evs[32];
+    int n = nlmon_read(nlfd, evs, sizeof(evs) / sizeof(evs[0]));
+    if (n < 0) {
+        ROC_ERROR(RLOG_NET, "Reading rtnetlink events failed: %s", strerror(errno));
+        return;
+    }
+    for (int e = 0; e < n; ++e) {
+        const nlmon_event_t *ev = &evs[e];
+        if (ev->type == NLMON_LINK_DOWN || ev->type == NLMON_LINK_UP) {
+            int up = ev->type == NLMON_LINK_UP;
+            ROC_LOG(up ? ROC_LOG_INFO : ROC_LOG_WARNING, RLOG_NET, "Link %s (ifindex %d) is %s", ev->ifname[0] ? ev->ifname : "?",
+                    ev->ifindex, up ? "up" : "down");
+            for (size_t i = 0; i < cam_count && i < (size_t)MAX_CAMERAS; ++i) {
+                if (up) {
+                    /* Only cameras on this link, before or after the routes
+                     * moved while it was down; another link coming up says
+                     * nothing about theirs */
+                    int route = nlmon_route_ifindex(cams[i].ip);
+                    if (cam_ifindex[i] != ev->ifindex && route != ev->ifindex) continue;
+                    int was_down = link_down[i];
+                    cam_ifindex[i] = route;
+                    link_down[i] = 0;
+                    if (was_down) ej_emit(EJ_REACH, (int)i, EJ_NONE, 0, 1, 0);
+                    if (was_down && rec[i].active && !rec[i].in_flight) {
+                        rec[i].next_ms = now_ms;
+                        ROC_INFO(RLOG_NET, "Camera %zu (%s): link back, resuming recovery now", i, cams[i].ip);
+                    }
+                    continue;
+                }
+                if (cam_ifindex[i] != ev->ifindex) continue;
+                link_down[i] = 1;
+                ej_emit(EJ_REACH, (int)i, EJ_NONE, 0, 0, ENETDOWN);
+                note_reach(i < cam_metrics_count ? &cam_metrics[i] : NULL, 0, 0);
+                if (procs[i].alive && procs[i].pid > 0) {
+                    ROC_WARN(RLOG_NET, "Camera %zu (%s): link down, stopping FFmpeg pid=%d", i, cams[i].ip, (int)procs[i].pid);
+                    ej_emit(EJ_STALL, (int)i, procs[i].stream_index, (int)procs[i].pid, EJ_STALL_LINK_DOWN, ENETDOWN);
+                    kill(procs[i].pid, SIGTERM);
+                }
+            }
+            continue;
+        }
+        for (size_t i = 0; i < cam_count && i < (size_t)MAX_CAMERAS; ++i) {
+            if (strcmp(cams[i].ip, ev->ip) != 0) continue;
+            if (ev->type == NLMON_NEIGH_DOWN) {
+                ej_emit(EJ_REACH, (int)i, EJ_NONE, 0, 0, EHOSTUNREACH);
+                note_reach(i < cam_metrics_count ? &cam_metrics[i] : NULL, 0, 0);
+            } else if (ev->type == NLMON_NEIGH_UP) ej_emit(EJ_REACH, (int)i, EJ_NONE, 0, 1, 0);
+            if (ev->type == NLMON_NEIGH_DOWN && procs[i].alive && procs[i].pid > 0) {
+                ROC_WARN(RLOG_NET, "Camera %zu (%s): no ARP reply, stopping FFmpeg pid=%d", i, cams[i].ip, (int)procs[i].pid);
+                ej_emit(EJ_STALL, (int)i, procs[i].stream_index, (int)procs[i].pid, EJ_STALL_LINK_DOWN, EHOSTUNREACH);
+                kill(procs[i].pid, SIGTERM);
+            } else if (ev->type == NLMON_NEIGH_UP && rec[i].active && !rec[i].in_flight && rec[i].next_ms > now_ms) {
+                ROC_INFO(RLOG_NET, "Camera %zu (%s): answering ARP again, retrying recovery now", i, cams[i].ip);
+                rec[i].next_ms = now_ms;
+            }
+        }
+    }
+}
+
+/* Takeover message: the old supervisor's per-camera state. Descriptors travel
+ * alongside as SCM_RIGHTS; the *_index fields point into them (-1: none). */
+#define HANDOFF_MAGIC "ROCHAND"
+#define HANDOFF_VERSION 2
+
+struct handoff_camera {
+    proc_state_entry_t proc;   /* pid 0 when no ffmpeg is running */
+    int32_t pidfd_index;
+    int32_t logfd_index;       /* Read end of the ffmpeg's output pipe */
+    int32_t degraded;
+    int32_t recovering;        /* Camera is down; the successor continues its recovery */
+    int32_t failed_stream;
+    int32_t attempt;
+    uint64_t down_ms;          /* CLOCK_MONOTONIC, comparable across processes */
+};
+
+struct handoff_msg {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;            /* Cameras in cams[]; 0 in a takeover request */
+    int32_t nlfd_index;
+    struct handoff_camera cams[MAX_CAMERAS];
+};
+
+/* Answer a pending takeover request: hand every camera's state, a pidfd per
+ * running ffmpeg and the rtnetlink socket to the new videopipe. Returns 1 once
+ * handed over, after which this process must exit without stopping ffmpeg. */
+static int serve_takeover(int lfd, const struct camera_cfg *cams, size_t cam_count,
+                          const struct running_proc *procs, struct recovery *rec, int nlfd) {
+    int conn = handoff_accept(lfd);
+    if (conn < 0) return 0;
+    struct handoff_msg *m = calloc(1, sizeof(*m));
+    int fds[HANDOFF_MAX_FDS], owned[HANDOFF_MAX_FDS];
+    size_t nfds = 0;
+    int handed = 0;
+    pid_t peer = -1;
+    uid_t peer_uid = 0;
+    if (!m) goto out;
+    if (handoff_peer(conn, &peer, &peer_uid) != 0 || peer_uid != geteuid()) {
+        ROC_WARN(RLOG_PROC, "Refusing takeover request from pid=%d uid=%d", (int)peer, (int)peer_uid);
+        goto out;
+    }
+    ssize_t len = handoff_recv(conn, m, sizeof(*m), fds, &nfds, 1000);
+    for (size_t k = 0; k < nfds; ++k) close(fds[k]);
+    nfds = 0;
+    if (len < (ssize_t)offsetof(struct handoff_msg, cams) || memcmp(m->magic, HANDOFF_MAGIC, sizeof(HANDOFF_MAGIC)) != 0 ||
+        m->version != HANDOFF_VERSION) {
+        ROC_WARN(RLOG_PROC, "Ignoring malformed takeover request on %s", HANDOFF_SOCKET);
+        goto out;
+    }
+    ROC_INFO(RLOG_PROC, "Handing over to videopipe pid=%d", (int)peer);
+
+    /* Attempts in flight are not waited for: one can take close to a minute,
+     * longer than the successor waits. Their cameras go over as recovering
+     * and the successor retries them; the threads stop after their current
+     * probe and get a bounded wait at shutdown. */
+    memset(m, 0, sizeof(*m));
+    memcpy(m->magic, HANDOFF_MAGIC, sizeof(HANDOFF_MAGIC));
+    m->version = HANDOFF_VERSION;
+    m->nlfd_index = -1;
+    for (size_t i = 0; i < cam_count && i < (size_t)MAX_CAMERAS; ++i) {
+        struct handoff_camera *hc = &m->cams[m->count++];
+        proc_entry_fill(&hc->proc, cams, procs, i);
+        hc->pidfd_index = -1;
+        hc->logfd_index = -1;
+        hc->degraded = procs[i].degraded;
+        hc->recovering = rec[i].active;
+        hc->failed_stream = rec[i].failed_stream;
+        hc->attempt = rec[i].attempt;
+        hc->down_ms = rec[i].down_ms;
+        if (hc->proc.pid <= 0 || nfds >= HANDOFF_MAX_FDS) continue;
+        /* Our own children have no pidfd yet; open one just for the handover */
+        int fd = procs[i].pidfd >= 0 ? procs[i].pidfd : proc_pidfd_open(procs[i].pid, procs[i].start_ticks);
+        if (fd < 0) continue;
+        owned[nfds] = procs[i].pidfd < 0;
+        hc->pidfd_index = (int32_t)nfds;
+        fds[nfds++] = fd;
+        int lfd = capture_on ? logcap_fd((int)i) : -1;
+        if (lfd < 0 || nfds >= HANDOFF_MAX_FDS) continue;
+        owned[nfds] = 0;
+        hc->logfd_index = (int32_t)nfds;
+        fds[nfds++] = lfd;
+    }
+    if (nlfd >= 0 && nfds < HANDOFF_MAX_FDS) {
+        owned[nfds] = 0;
+        m->nlfd_index = (int32_t)nfds;
+        fds[nfds++] = nlfd;
+    }
+    /* What the rings hold goes to the logs now; the successor reads on from the pipes */
+    if (capture_on) logcap_suspend();
+    if (handoff_send(conn, m, sizeof(*m), fds, nfds) != 0) {
+        ROC_ERROR(RLOG_PROC, "Takeover failed, still supervising: %s", strerror(errno));
+        if (capture_on) logcap_resume();
+    } else {
+        handed = 1;
+        atomic_store(&handed_over, 1);
+    }
+    for (size_t k = 0; k < nfds; ++k)
+        if (owned[k]) close(fds[k]);
+out:
+    free(m);
+    close(conn);
+    return handed;
+}
+
+/* Ask the running videopipe to hand over, then wait for it to exit so that it
+ * has finished writing the cache and state before we read them. On success m
+ * holds its state and fds the descriptors it passed. */
+static int request_takeover(struct handoff_msg *m, int *fds, size_t *nfds) {
+    *nfds = 0;
+    int conn = handoff_connect(HANDOFF_SOCKET);
+    if (conn < 0) {
+        ROC_ERROR(RLOG_PROC, "No running videopipe on %s: %s", HANDOFF_SOCKET, strerror(errno));
+        return -1;
+    }
+    pid_t old = -1;
+    uid_t old_uid;
+    unsigned long long old_ticks = 0;
+    int old_fd = handoff_peer(conn, &old, &old_uid) == 0 && proc_start_ticks(old, &old_ticks) == 0
+                 ? proc_pidfd_open(old, old_ticks) : -1;
+
+    memset(m, 0, sizeof(*m));
+    memcpy(m->magic, HANDOFF_MAGIC, sizeof(HANDOFF_MAGIC));
+    m->version = HANDOFF_VERSION;
+    m->nlfd_index = -1;
+    ssize_t len = -1;
+    if (handoff_send(conn, m, offsetof(struct handoff_msg, cams), NULL, 0) == 0)
+        len = handoff_recv(conn, m, sizeof(*m), fds, nfds, TAKEOVER_TIMEOUT_MS);
+    int err = errno;
+    close(conn);
+    if (len != (ssize_t)sizeof(*m) || memcmp(m->magic, HANDOFF_MAGIC, sizeof(HANDOFF_MAGIC)) != 0 ||
+        m->version != HANDOFF_VERSION || m->count > MAX_CAMERAS) {
+        ROC_ERROR(RLOG_PROC, "Takeover from videopipe pid=%d failed: %s", (int)old,
+                len < 0 ? strerror(err) : "unexpected reply");
+        for (size_t k = 0; k < *nfds; ++k) close(fds[k]);
+        *nfds = 0;
+        if (old_fd >= 0) close(old_fd);
+        return -1;
+    }
+    ROC_INFO(RLOG_PROC, "Received state of %u camera(s) and %zu descriptor(s) from videopipe pid=%d",
+            m->count, *nfds, (int)old);
+    if (old_fd >= 0) {
+        struct pollfd pfd = { .fd = old_fd, .events = POLLIN };
+        if (poll(&pfd, 1, TAKEOVER_TIMEOUT_MS) <= 0)
+            ROC_WARN(RLOG_PROC, "Previous videopipe pid=%d has not exited; continuing anyway", (int)old);
+        close(old_fd);
+    }
+    return 0;
+}
+
+/* Adopt the ffmpeg processes described in a takeover message */
+static size_t adopt_from_handoff(const struct camera_cfg *cams, size_t cam_count, struct running_proc *procs,
+                                 const struct handoff_msg *m, const int *fds, size_t nfds) {
+    proc_state_entry_t entries[MAX_CAMERAS];
+    int pidfds[MAX_CAMERAS];
+    for (uint32_t k = 0; k < m->count; ++k) {
+        const struct handoff_camera *hc = &m->cams[k];
+        entries[k] = hc->proc;
+        pidfds[k] = hc->pidfd_index >= 0 && (size_t)hc->pidfd_index < nfds ? fds[hc->pidfd_index] : -1;
+    }
+    size_t adopted = adopt_children(cams, cam_count, procs, entries, m->count, pidfds);
+    for (uint32_t k = 0; k < m->count; ++k) {
+        const struct handoff_camera *hc = &m->cams[k];
+        size_t i = (size_t)hc->proc.cam_index;
+        int lfd = hc->logfd_index >= 0 && (size_t)hc->logfd_index < nfds ? fds[hc->logfd_index] : -1;
+        if (i >= cam_count || !procs[i].alive || procs[i].pid != hc->proc.pid) {
+            if (lfd >= 0) close(lfd);
+            continue;
+        }
+        procs[i].degraded = hc->degraded;
+        if (lfd < 0) continue;
+        if (!capture_on) {
+            /* Without a reader the child's writes just fail */
+            close(lfd);
+            ROC_WARN(RLOG_PROC, "Output of adopted FFmpeg for camera %zu is lost until it is respawned", i);
+        } else if (logcap_attach((int)i, lfd) != 0) {
+            ROC_WARN(RLOG_PROC, "Cannot capture output of adopted FFmpeg for camera %zu: %s", i, strerror(errno));
+        }
+    }
+    return adopted;
+}
+
+/* One byte to main_controller per pass of the monitor loop, at most every
+ * HEARTBEAT_INTERVAL_MS. A full pipe already holds beats it has not read. */
+static void send_heartbeat(void) {
+    char beat = 1;
+    if (write(heartbeat_fd, &beat, 1) == 1 || errno == EAGAIN || errno == EINTR) return;
+    ROC_WARN(RLOG_MAIN, "Heartbeat to main_controller failed, no longer sending it: %s", strerror(errno));
+    close(heartbeat_fd);
+    heartbeat_fd = -1;
+}
+
+int main(int argc, char **argv) {
+    roc_log_configure(LOG_LEVELS_FILE);
     log_open(); // Open log file at start
-    log_msg("INFO", "Starting videopipe");
+    if (argc > 1 && strcmp(argv[1], "--export-cache") == 0) {
+        /* Dump the binary cache as JSON for inspection, without starting streams */
+        struct discovery_entry cache[MAX_CAMERAS];
+        size_t cache_count = 0;
+        load_videopipe_json();
+        int rc = load_cache(cache, &cache_count) == 0 && save_cache_json(cache, cache_count) == 0 ? 0 : 1;
+        dcache_close(&cache_store);
+        printf("%s %zu cache entries to %s\n", rc == 0 ? "Exported" : "Failed to export", cache_count, DISCOVERY_CACHE);
+        log_close();
+        return rc;
+    }
+    if (argc > 1 && strcmp(argv[1], "--import-cache") == 0) {
+        /* Replace the binary cache with the (possibly hand-edited) JSON cache */
+        struct discovery_entry cache[MAX_CAMERAS], old[MAX_CAMERAS];
+        size_t cache_count = 0, old_count = 0;
+        load_videopipe_json();
+        int rc = load_cache(old, &old_count) == 0 && load_cache_json(cache, &cache_count) == 0 &&
+                 save_cache(cache, cache_count) == 0 ? 0 : 1;
+        dcache_close(&cache_store);
+        printf("%s %zu cache entries from %s\n", rc == 0 ? "Imported" : "Failed to import", cache_count, DISCOVERY_CACHE);
+        log_close();
+        return rc;
+    }
+    int takeover = 0;
+    for (int a = 1; a < argc; ++a) {
+        if (strcmp(argv[a], "--takeover") == 0) takeover = 1;
+        else if (strcmp(argv[a], "--heartbeat-fd") == 0 && a + 1 < argc) heartbeat_fd = atoi(argv[++a]);
+    }
+    ROC_INFO(RLOG_MAIN, takeover ? "Starting videopipe, taking over from the running one" : "Starting videopipe");
+    if (heartbeat_fd >= 0 && (fcntl(heartbeat_fd, F_SETFD, FD_CLOEXEC) != 0 ||
+                              fcntl(heartbeat_fd, F_SETFL, fcntl(heartbeat_fd, F_GETFL) | O_NONBLOCK) != 0)) {
+        ROC_WARN(RLOG_MAIN, "Invalid heartbeat descriptor %d: %s", heartbeat_fd, strerror(errno));
+        heartbeat_fd = -1;
+    }
     signal(SIGINT, handle_signal); 
     signal(SIGTERM, handle_signal);
+    signal(SIGHUP, handle_signal);
+    /* A heartbeat to a main_controller that has gone fails with EPIPE */
+    signal(SIGPIPE, SIG_IGN);
+    /* sigaction keeps the handler installed; SIGUSR1 may be sent any number of times */
+    struct sigaction usr1 = { .sa_handler = handle_signal, .sa_flags = SA_RESTART };
+    sigemptyset(&usr1.sa_mask);
+    sigaction(SIGUSR1, &usr1, NULL);
+    log_configure();
+    if (ej_open(JOURNAL_DIR "/videopipe.ej", EJ_SRC_VIDEOPIPE, EJ_DEFAULT_CAPACITY) != 0)
+        ROC_WARN(RLOG_MAIN, "Cannot open event journal in %s: %s", JOURNAL_DIR, strerror(errno));
+    if (trace_open("videopipe") != 0)
+        ROC_WARN(RLOG_MAIN, "Cannot write traces to %s: %s", getenv(TRACE_ENV), strerror(errno));
+    uint64_t start_ns = trace_now_ns();
     
-    log_msg("DEBUG", "Creating error log %s", ERROR_LOG);
+    ROC_DEBUG(RLOG_MAIN, "Creating error log %s", ERROR_LOG);
     FILE *ef = fopen(ERROR_LOG, "w"); 
     if (ef) {
         fclose(ef);
-        log_msg("DEBUG", "Created error log %s", ERROR_LOG);
+        ROC_DEBUG(RLOG_MAIN, "Created error log %s", ERROR_LOG);
     } else {
-        log_msg("ERROR", "Failed to create %s: %s", ERROR_LOG, strerror(errno));
+        ROC_ERROR(RLOG_MAIN, "Failed to create %s: %s", ERROR_LOG, strerror(errno));
     }
 
     // Verify v4l2loopback devices
     int video_indices[MAX_CAMERAS];
     size_t video_count = 0;
     if (list_video_devices(video_indices, &video_count) != 0 || video_count == 0) {
-        log_msg("ERROR", "No v4l2loopback devices found in /dev. Check module loading.");
-        if (logf && logf != stderr) fclose(logf);
+        ROC_ERROR(RLOG_DEVICE, "No v4l2loopback devices found in /dev. Check module loading.");
+        trace_close();
+        ej_close();
+        log_close();
         return 1;
     }
 
+    if (load_videopipe_json() != 0)
+        ROC_WARN(RLOG_CONFIG, "Failed to load %s, using default scoring", VIDEOPIPE_CONFIG);
+
     struct camera_cfg cams[MAX_CAMERAS]; 
     size_t cam_count = 0;
-    log_msg("DEBUG", "Attempting to load camera configuration");
+    ROC_DEBUG(RLOG_CONFIG, "Attempting to load camera configuration");
     if (load_cameras_json(cams, &cam_count) != 0) { 
-        log_msg("ERROR", "Failed to load cameras config, exiting");
-        if (logf && logf != stderr) fclose(logf);
+        ROC_ERROR(RLOG_CONFIG, "Failed to load cameras config, exiting");
+        trace_close();
+        ej_close();
+        log_close();
         return 1; 
     }
+    cam_metrics_init(cams, cam_count);
+    for (size_t i = 0; i < cam_count && i < MAX_CAMERAS; ++i) {
+        char track[48];
+        snprintf(track, sizeof(track), "camera %zu (%.15s)", i, cams[i].ip);
+        trace_track_name((int)i, track);
+    }
+    trace_track_name(TRACE_TRACK_RIG, "rig");
+
+    /* The old videopipe writes its cache on the way out, so hand over first */
+    struct handoff_msg *handed = NULL;
+    int handed_fds[HANDOFF_MAX_FDS];
+    size_t handed_nfds = 0;
+    if (takeover) {
+        handed = calloc(1, sizeof(*handed));
+        if (!handed || request_takeover(handed, handed_fds, &handed_nfds) != 0) {
+            ROC_ERROR(RLOG_PROC, "Takeover failed, leaving the running videopipe in charge");
+            trace_close();
+            ej_close();
+            log_close();
+            return 1;
+        }
+    }
 
     struct discovery_entry cache[MAX_CAMERAS]; 
     size_t cache_count = 0; 
-    log_msg("DEBUG", "Loading discovery cache");
-    load_cache_json(cache, &cache_count);
+    ROC_DEBUG(RLOG_CACHE, "Loading discovery cache");
+    load_cache(cache, &cache_count);
+    rescore_cache(cams, cam_count, cache, cache_count);
+    if (cache_store.map && cache_persist_start(&cache_store, cache_cfg.write_window_ms, cache_cfg.sync) != 0)
+        ROC_WARN(RLOG_CACHE, "Failed to start cache writer; cache is saved from the monitor loop");
+    /* Started after any handover, so the read offsets the old videopipe saved are current */
+    if (log_tail_start(LOG_DIR, ERROR_LOG, LOG_TAIL_OFFSETS) != 0)
+        ROC_WARN(RLOG_HEALTH, "Cannot watch %s (%s); FFmpeg log errors are not counted", LOG_DIR, strerror(errno));
+    if (capture_cfg.ring_kb > 0) {
+        logcap_cfg_t lc = {
+            .ring_bytes = (size_t)capture_cfg.ring_kb * 1024,
+            .flush_rate = (size_t)capture_cfg.flush_kb_per_sec * 1024,
+            .file_max = (size_t)capture_cfg.file_max_kb * 1024,
+            .files = capture_cfg.files,
+            .exit_dump = (size_t)capture_cfg.exit_dump_kb * 1024,
+        };
+        if (logcap_start(LOG_DIR, &lc) != 0)
+            ROC_WARN(RLOG_PROC, "Cannot start output capture (%s); FFmpeg appends to its log directly", strerror(errno));
+        else
+            capture_on = 1;
+    }
+    if (frames_cfg.enabled) {
+        if (fhist_start() != 0)
+            ROC_WARN(RLOG_PROC, "Cannot start frame reader (%s); frame intervals are not measured", strerror(errno));
+        else
+            frames_on = 1;
+    }
+    if (metrics_cfg.port > 0) {
+        if (metrics_start(metrics_cfg.address, metrics_cfg.port, render_metrics, NULL) != 0)
+            ROC_WARN(RLOG_MAIN, "Cannot serve metrics on %s:%d: %s", metrics_cfg.address, metrics_cfg.port, strerror(errno));
+        else
+            ROC_INFO(RLOG_MAIN, "Serving metrics on http://%s:%d/metrics", metrics_cfg.address, metrics_cfg.port);
+    }
 
     struct running_proc procs[MAX_CAMERAS]; 
     memset(procs, 0, sizeof(procs));
-    log_msg("DEBUG", "Initialized %d process slots", MAX_CAMERAS);
+    for (size_t i = 0; i < (size_t)MAX_CAMERAS; ++i) procs[i].pidfd = -1;
+    ROC_DEBUG(RLOG_PROC, "Initialized %d process slots", MAX_CAMERAS);
+    size_t adopted = handed ? adopt_from_handoff(cams, cam_count, procs, handed, handed_fds, handed_nfds)
+                            : adopt_from_state_file(cams, cam_count, procs);
+    if (adopted > 0) ROC_INFO(RLOG_PROC, "Adopted %zu running FFmpeg process(es) from the previous videopipe", adopted);
+    for (size_t i = 0; frames_on && i < cam_count && i < (size_t)MAX_CAMERAS; ++i) {
+        if (!procs[i].alive) continue;
+        /* Adopted: the fps it was started with is the cached one */
+        char devpath[64];
+        snprintf(devpath, sizeof(devpath), "/dev/video%d", (int)i + VIDEO_DEVICE_OFFSET);
+        int ci = find_cache_entry(cache, cache_count, cams[i].ip);
+        fhist_watch((int)i, devpath, ci >= 0 && cache[ci].fps > 0 ? cache[ci].fps : 15.0);
+    }
+
+    /* Cameras without a usable cached stream go through the same admission-
+     * controlled recovery path as cameras that fail later */
+    /* Static: an attempt thread left running after a handover may still
+     * write its result while the process exits */
+    static struct recovery rec[MAX_CAMERAS];
+    memset(rec, 0, sizeof(rec));
+    uint64_t episode_start = 0;
+    int episode_cams = 0;
 
     /* Quick-start using cache when fresh */
-    log_msg("DEBUG", "Starting camera processing loop");
+    ROC_DEBUG(RLOG_MAIN, "Starting camera processing loop");
     for (size_t i = 0; i < cam_count && i < MAX_CAMERAS; ++i) {
         struct camera_cfg *c = &cams[i]; 
-        log_msg("DEBUG", "Processing camera %zu: ip=%s", i, c->ip);
+        ROC_DEBUG(RLOG_MAIN, "Processing camera %zu: ip=%s", i, c->ip);
+        if (procs[i].alive) continue; /* Adopted; already streaming */
+        TRACE_SPAN(span, "main", "start_camera");
+        trace_span_args(&span, "camera %zu %s", i, c->ip);
+        const struct handoff_camera *hc = handed && i < handed->count ? &handed->cams[i] : NULL;
+        if (hc && hc->recovering && strcmp(hc->proc.ip, c->ip) == 0) {
+            /* Carry on the old supervisor's recovery, keeping its downtime and backoff */
+            uint64_t now_ms = admission_now_ms();
+            if (recovery_begin(&rec[i], c, hc->failed_stream, now_ms)) {
+                rec[i].down_ms = hc->down_ms;
+                rec[i].attempt = hc->attempt;
+                if (episode_start == 0 || hc->down_ms < episode_start) episode_start = hc->down_ms;
+                episode_cams++;
+            }
+            continue;
+        }
         if (strlen(c->ip) == 0 || strlen(c->password) == 0) { 
-            log_msg("ERROR", "Camera %zu missing ip/password, skipping", i); 
+            ROC_ERROR(RLOG_CONFIG, "Camera %zu missing ip/password, skipping", i); 
             continue; 
         }
         if (!device_exists((int)i)) { 
-            log_msg("ERROR", "/dev/video%zu missing, skipping", i + VIDEO_DEVICE_OFFSET); 
+            ROC_ERROR(RLOG_DEVICE, "/dev/video%zu missing, skipping", i + VIDEO_DEVICE_OFFSET); 
             continue; 
         }
         int ci = find_cache_entry(cache, cache_count, c->ip);
         int used_cache = 0;
         if (ci >= 0) {
             time_t now = time(NULL);
-            log_msg("DEBUG", "Cache entry found for %s: stream=%s, age=%ld seconds", 
+            ROC_DEBUG(RLOG_CACHE, "Cache entry found for %s: stream=%s, age=%ld seconds", 
                     c->ip, cache[ci].best_stream, now - cache[ci].last_success);
             if ((now - cache[ci].last_success) < CACHE_TTL_SECONDS) {
-                log_msg("DEBUG", "Cache entry is fresh, testing connection");
-                if (test_tcp_connect(c->ip, 1935, 2)) {
-                    int sidx = 0; 
-                    for (; sidx < (int)STREAM_TYPES_COUNT; ++sidx) 
-                        if (strcmp(STREAM_TYPES[sidx], cache[ci].best_stream) == 0) break; 
-                    if (sidx >= (int)STREAM_TYPES_COUNT) {
-                        log_msg("WARNING", "Invalid cached stream type %s, defaulting to main", cache[ci].best_stream);
-                        sidx = 0;
-                    }
-                    log_msg("DEBUG", "Using cached stream type %s", STREAM_TYPES[sidx]);
+                ROC_DEBUG(RLOG_CACHE, "Cache entry is fresh, verifying cached stream");
+                int sidx = 0; 
+                for (; sidx < (int)STREAM_TYPES_COUNT; ++sidx) 
+                    if (strcmp(STREAM_TYPES[sidx], cache[ci].best_stream) == 0) break; 
+                if (sidx >= (int)STREAM_TYPES_COUNT) {
+                    ROC_WARN(RLOG_CACHE, "Invalid cached stream type %s, defaulting to main", cache[ci].best_stream);
+                    sidx = 0;
+                }
+                if (cached_stream_usable(c, STREAM_TYPES[sidx])) {
+                    ROC_DEBUG(RLOG_CACHE, "Using cached stream type %s", STREAM_TYPES[sidx]);
                     pid_t pid = spawn_ffmpeg((int)i, c, STREAM_TYPES[sidx], cache[ci].fps > 0 ? cache[ci].fps : 15.0);
                     if (pid > 0) { 
                         procs[i].pid = pid; 
                         procs[i].cam_index = (int)i; 
                         procs[i].stream_index = sidx; 
                         procs[i].alive = 1; 
+                        procs[i].degraded = 0; 
+                        procs[i].adopted = 0;
+                        procs[i].started = time(NULL);
+                        proc_start_ticks(pid, &procs[i].start_ticks);
                         used_cache = 1; 
-                        log_msg("DEBUG", "Started FFmpeg from cache for camera %zu", i);
+                        ROC_DEBUG(RLOG_PROC, "Started FFmpeg from cache for camera %zu", i);
                     } else {
-                        log_msg("ERROR", "Failed to start FFmpeg for camera %zu", i);
+                        ROC_ERROR(RLOG_PROC, "Failed to start FFmpeg for camera %zu", i);
                     }
                 } else { 
-                    log_msg("WARNING", "Cached camera %s not reachable; will probe", c->ip); 
+                    ROC_WARN(RLOG_CACHE, "Cached stream for %s not usable; will probe", c->ip); 
                 }
             } else {
-                log_msg("DEBUG", "Cache entry for %s is stale", c->ip);
+                ROC_DEBUG(RLOG_CACHE, "Cache entry for %s is stale", c->ip);
             }
         }
         if (!used_cache) {
-            log_msg("DEBUG", "No valid cache, probing camera %s", c->ip);
-            const char *best_stream = NULL; 
-            double best_score = 0.0; 
-            char best_res[RES_MAX] = {0}; 
-            double best_fps = 0.0;
-            if (!test_tcp_connect(c->ip, 1935, 2)) { 
-                log_msg("WARNING", "Camera %s unreachable on 1935; skipping probe", c->ip); 
-                continue; 
-            }
-            for (size_t st = 0; st < STREAM_TYPES_COUNT; ++st) {
-                int s_num = (strcmp(STREAM_TYPES[st], "sub") == 0) ? 1 : 0; 
-                char res[RES_MAX] = {0}; 
-                double fps = 0.0, score = 0.0;
-                log_msg("DEBUG", "Probing stream type %s (num=%d)", STREAM_TYPES[st], s_num);
-                if (probe_stream(c->ip, c->user, c->password, STREAM_TYPES[st], s_num, TEST_TIMEOUT, res, sizeof(res), &fps, &score)) { 
-                    if (score > best_score) { 
-                        best_score = score; 
-                        best_stream = STREAM_TYPES[st]; 
-                        safe_strncpy(best_res, res, sizeof(best_res)); 
-                        best_fps = fps; 
-                        log_msg("DEBUG", "New best stream: %s, score=%.2f", best_stream, best_score);
-                    } 
-                }
-            }
-            if (best_stream) {
-                log_msg("DEBUG", "Selected best stream %s for %s", best_stream, c->ip);
-                pid_t pid = spawn_ffmpeg((int)i, c, best_stream, best_fps);
-                if (pid > 0) {
-                    procs[i].pid = pid; 
-                    procs[i].cam_index = (int)i; 
-                    procs[i].alive = 1;
-                    for (size_t t = 0; t < STREAM_TYPES_COUNT; ++t) 
-                        if (strcmp(STREAM_TYPES[t], best_stream) == 0) procs[i].stream_index = (int)t;
-                    int idx = find_cache_entry(cache, cache_count, c->ip); 
-                    if (idx < 0 && cache_count < MAX_CAMERAS) idx = (int)(cache_count++);
-                    safe_strncpy(cache[idx].ip, c->ip, IP_MAX); 
-                    safe_strncpy(cache[idx].best_stream, best_stream, sizeof(cache[idx].best_stream)); 
-                    safe_strncpy(cache[idx].resolution, best_res, RES_MAX);
-                    cache[idx].fps = best_fps; 
-                    cache[idx].score = best_score; 
-                    cache[idx].last_success = time(NULL); 
-                    log_msg("DEBUG", "Updating cache for %s: stream=%s, resolution=%s, fps=%.2f, score=%.2f",
-                            c->ip, best_stream, best_res, best_fps, best_score);
-                    save_cache_json(cache, cache_count);
-                } else {
-                    log_msg("ERROR", "Failed to start FFmpeg for %s", c->ip);
-                }
-            } else { 
-                log_msg("ERROR", "No valid stream for camera %s", c->ip); 
+            ROC_DEBUG(RLOG_PROBE, "No valid cache, queueing camera %s for probing", c->ip);
+            uint64_t now_ms = admission_now_ms();
+            if (recovery_begin(&rec[i], c, -1, now_ms)) {
+                if (episode_start == 0) episode_start = now_ms;
+                episode_cams++;
             }
         }
     }
 
-    /* Start background tail -> error log */
-    log_msg("DEBUG", "Starting tail for error log");
-    char tail_cmd[1024]; 
-    snprintf(tail_cmd, sizeof(tail_cmd), "bash -c 'tail -n+1 -F %s/*.log 2>/dev/null | grep -iE \"error|failed|timeout|connection refused|input/output error|end of file\" >> %s &'", LOG_DIR, ERROR_LOG);
-    log_msg("DEBUG", "Executing tail command: %s", tail_cmd);
-    system(tail_cmd);
+    save_proc_state(cams, cam_count, procs);
+
+    if (reprobe_start(reprobe_run) != 0) {
+        ROC_WARN(RLOG_PROBE, "Failed to start background re-probe worker; alternatives refresh only on failure");
+    }
+
+    /* Probes hold a slot until their attempt thread is collected. Spawns are
+     * only rate-limited: spawn_ffmpeg() returns once FFmpeg has been forked,
+     * so there is no spawn in flight to cap, and a slot is returned at once */
+    admission_t probe_gate, spawn_limiter;
+    admission_init(&probe_gate, recovery_cfg.max_concurrent_probes, recovery_cfg.probe_rate, recovery_cfg.probe_burst);
+    admission_init(&spawn_limiter, 0, recovery_cfg.spawn_rate, recovery_cfg.spawn_burst);
+
+    /* Link and neighbour events for the interfaces carrying camera traffic */
+    int cam_ifindex[MAX_CAMERAS];
+    int link_down[MAX_CAMERAS];
+    memset(link_down, 0, sizeof(link_down));
+    for (size_t i = 0; i < cam_count && i < MAX_CAMERAS; ++i) {
+        cam_ifindex[i] = nlmon_route_ifindex(cams[i].ip);
+        ROC_DEBUG(RLOG_NET, "Camera %zu (%s) routed via ifindex %d", i, cams[i].ip, cam_ifindex[i]);
+    }
+    int nlfd = handed && handed->nlfd_index >= 0 && (size_t)handed->nlfd_index < handed_nfds
+               ? handed_fds[handed->nlfd_index] : nlmon_open();
+    if (nlfd < 0)
+        ROC_WARN(RLOG_NET, "rtnetlink monitor unavailable (%s); cable pulls are only noticed by health checks", strerror(errno));
+
+    free(handed);
+    handed = NULL;
+
+    /* A later videopipe --takeover connects here */
+    int hofd = handoff_listen(HANDOFF_SOCKET);
+    if (hofd < 0)
+        ROC_WARN(RLOG_PROC, "Cannot listen on %s (%s); upgrades will restart the streams", HANDOFF_SOCKET, strerror(errno));
+
+    trace_complete(-1, "main", "startup", start_ns, trace_now_ns(), "%zu camera(s), %zu adopted", cam_count, adopted);
 
     /* Monitor loop: react to child exits */
-    log_msg("DEBUG", "Entering monitor loop");
-    time_t last_save = time(NULL);
+    ROC_DEBUG(RLOG_MAIN, "Entering monitor loop");
     time_t last_probe_time = time(NULL);
-    int retry_delay = 5;
+    time_t last_passive = time(NULL);
+    int passive_ok = 1;
+    time_t last_reprobe = time(NULL);
+    size_t reprobe_cursor = 0;
+    time_t last_sample = 0;
+    online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online_cpus < 1) online_cpus = 1;
+    uint64_t last_beat_ms = 0;
     while (!exit_flag) {
-        int status; 
-        pid_t r = waitpid(-1, &status, WNOHANG);
-        if (r > 0) {
-            int which = -1; 
-            for (size_t i = 0; i < cam_count && i < MAX_CAMERAS; ++i) { 
-                if (procs[i].alive && procs[i].pid == r) { 
-                    which = (int)i; 
-                    break; 
-                } 
+        uint64_t now_ms = admission_now_ms();
+        if (heartbeat_fd >= 0 && now_ms - last_beat_ms >= (uint64_t)HEARTBEAT_INTERVAL_MS) {
+            send_heartbeat();
+            last_beat_ms = now_ms;
+        }
+        if (nlfd >= 0) handle_net_events(nlfd, cams, cam_count, procs, rec, cam_ifindex, link_down, now_ms);
+        if (hofd >= 0 && serve_takeover(hofd, cams, cam_count, procs, rec, nlfd)) {
+            detach_children = 1;
+            break;
+        }
+        /* Reap only our ffmpeg children; probe helpers are reaped by their callers */
+        int procs_changed = 0;
+        for (size_t i = 0; i < cam_count && i < MAX_CAMERAS; ++i) { 
+            int status = 0;
+            if (!procs[i].alive || procs[i].pid <= 0) continue;
+            if (procs[i].adopted) {
+                /* Not our child: its exit status goes to whoever reparented it */
+                if (adopted_alive(&procs[i])) continue;
+                procs[i].alive = 0;
+                if (procs[i].pidfd >= 0) close(procs[i].pidfd);
+                procs[i].pidfd = -1;
+                ROC_WARN(RLOG_PROC, "Adopted FFmpeg for camera %zu (%s) exited", i, cams[i].ip);
+                status = -1;
+            } else {
+                if (waitpid(procs[i].pid, &status, WNOHANG) != procs[i].pid) continue;
+                procs[i].alive = 0; 
+                ROC_WARN(RLOG_PROC, "FFmpeg for camera %zu (%s) exited with status=%d", 
+                        i, cams[i].ip, WEXITSTATUS(status));
             }
-            if (which >= 0) {
-                procs[which].alive = 0; 
-                log_msg("WARNING", "FFmpeg for camera %d (%s) exited with status=%d", 
-                        which, cams[which].ip, WEXITSTATUS(status));
-                /* Try to recover with fallback probes */
-                int retry = 0; 
-                const int max_retry = 12; 
-                const char *chosen = NULL; 
-                double chosen_fps = 0.0; 
-                char chosen_res[RES_MAX] = {0}; 
-                double chosen_score = 0.0;
-                log_msg("DEBUG", "Attempting recovery for camera %d", which);
-                while (!exit_flag && retry < max_retry) {
-                    if (!device_exists(which)) { 
-                        log_msg("ERROR", "/dev/video%d missing, aborting restart", which + VIDEO_DEVICE_OFFSET); 
-                        break; 
-                    }
-                    if (!test_tcp_connect(cams[which].ip, 1935, 2)) { 
-                        log_msg("WARNING", "Camera %s unreachable, retry %d/%d, delaying %ds", 
-                                cams[which].ip, retry + 1, max_retry, retry_delay); 
-                        sleep(retry_delay); 
-                        retry_delay = (int)(retry_delay * 1.5) > 30 ? 30 : (int)(retry_delay * 1.5);
-                        retry++; 
-                        continue; 
-                    }
-                    for (size_t st = 0; st < STREAM_TYPES_COUNT; ++st) {
-                        char res[RES_MAX] = {0}; 
-                        double fps = 0.0, score = 0.0; 
-                        int sn = (strcmp(STREAM_TYPES[st], "sub") == 0) ? 1 : 0;
-                        log_msg("DEBUG", "Retrying probe for %s stream type %s", 
-                                cams[which].ip, STREAM_TYPES[st]);
-                        if (probe_stream(cams[which].ip, cams[which].user, cams[which].password, 
-                                         STREAM_TYPES[st], sn, TEST_TIMEOUT, res, sizeof(res), &fps, &score)) {
-                            if (score > chosen_score) { 
-                                chosen_score = score; 
-                                chosen = STREAM_TYPES[st]; 
-                                chosen_fps = fps; 
-                                safe_strncpy(chosen_res, res, sizeof(chosen_res)); 
-                                log_msg("DEBUG", "New best recovery stream: %s, score=%.2f", 
-                                        chosen, chosen_score);
-                            }
-                        }
-                    }
-                    if (chosen) {
-                        log_msg("DEBUG", "Recovery selected stream %s", chosen);
-                        break;
-                    }
-                    retry++;
-                    retry_delay = (int)(retry_delay * 1.5) > 30 ? 30 : (int)(retry_delay * 1.5);
-                    sleep(retry_delay);
-                }
-                if (chosen) {
-                    log_msg("DEBUG", "Restarting FFmpeg with stream %s", chosen);
-                    pid_t pid = spawn_ffmpeg(which, &cams[which], chosen, chosen_fps);
-                    if (pid > 0) { 
-                        procs[which].pid = pid; 
-                        procs[which].alive = 1; 
-                        for (size_t t = 0; t < STREAM_TYPES_COUNT; ++t) 
-                            if (strcmp(STREAM_TYPES[t], chosen) == 0) procs[which].stream_index = (int)t;
-                        int ci = find_cache_entry(cache, cache_count, cams[which].ip); 
-                        if (ci < 0 && cache_count < MAX_CAMERAS) ci = (int)(cache_count++);
-                        safe_strncpy(cache[ci].ip, cams[which].ip, IP_MAX); 
-                        safe_strncpy(cache[ci].best_stream, chosen, sizeof(cache[ci].best_stream)); 
-                        safe_strncpy(cache[ci].resolution, chosen_res, RES_MAX);
-                        cache[ci].fps = chosen_fps; 
-                        cache[ci].score = chosen_score; 
-                        cache[ci].last_success = time(NULL); 
-                        log_msg("DEBUG", "Updated cache for %s after recovery", cams[which].ip);
-                        save_cache_json(cache, cache_count);
-                        retry_delay = 5; // Reset delay
-                    } else {
-                        log_msg("ERROR", "Failed to restart FFmpeg for %s", cams[which].ip);
-                    }
-                } else { 
-                    log_msg("ERROR", "Could not recover camera %d (%s)", which, cams[which].ip); 
+            ej_emit(EJ_EXIT, (int)i, procs[i].stream_index, (int)procs[i].pid, status, (int32_t)(time(NULL) - procs[i].started));
+            if (capture_on) logcap_exited((int)i, procs[i].pid, status);
+            if (frames_on) {
+                fhist_summary_t fs;
+                fhist_summary((int)i, &fs);
+                fhist_unwatch((int)i);
+                if (fs.intervals > 0)
+                    ROC_INFO(RLOG_HEALTH, "Camera %zu frame intervals: p50 %.1fms p99 %.1fms max %.1fms, %llu gap(s) over %.1fms",
+                            i, fs.p50_us / 1000.0, fs.p99_us / 1000.0, fs.max_us / 1000.0,
+                            (unsigned long long)fs.gaps, 2 * fs.nominal_us / 1000.0);
+            }
+            if (i < cam_metrics_count) atomic_fetch_add_explicit(&cam_metrics[i].exits, 1, memory_order_relaxed);
+            procs_changed = 1;
+            if (recovery_begin(&rec[i], &cams[i], procs[i].stream_index, now_ms)) {
+                if (episode_start == 0) episode_start = now_ms;
+                episode_cams++;
+                history_log(cams[i].ip, HIST_OUTAGE, procs[i].stream_index, 0, -1, 0);
+            }
+        }
+
+        /* Collect finished recovery attempts */
+        for (size_t i = 0; i < cam_count && i < MAX_CAMERAS; ++i) {
+            struct recovery *r = &rec[i];
+            if (!r->in_flight) continue;
+            pthread_mutex_lock(&recovery_lock);
+            int done = r->done;
+            pthread_mutex_unlock(&recovery_lock);
+            if (!done) continue;
+            pthread_join(r->thread, NULL);
+            r->in_flight = 0;
+            admission_release(&probe_gate);
+            history_log_probes((int)i, cams[i].ip, r->probed);
+            int ci = find_cache_entry(cache, cache_count, cams[i].ip);
+            if (ci >= 0) {
+                cache_merge_alts(&cache[ci], r->probed);
+                cache_mark_dirty(ci);
+            }
+            if (r->ok) {
+                ROC_DEBUG(RLOG_RECOVERY, "Recovery selected stream %s for camera %zu", STREAM_TYPES[r->chosen_st], i);
+                r->ready = 1;
+            } else {
+                if (!r->reachable) ROC_WARN(RLOG_RECOVERY, "Camera %s unreachable on 1935", cams[i].ip);
+                else ROC_WARN(RLOG_RECOVERY, "No valid stream for camera %s", cams[i].ip);
+                recovery_backoff(r, (int)i, now_ms);
+            }
+        }
+
+        /* Restart recovered cameras, highest priority first, as spawn tokens allow */
+        size_t prio[MAX_CAMERAS];
+        size_t nready = recovery_priority(rec, cam_count, 1, prio);
+        for (size_t k = 0; k < nready; ++k) {
+            size_t i = prio[k];
+            struct recovery *r = &rec[i];
+            if (!admission_try_acquire(&spawn_limiter, now_ms)) break;
+            admission_release(&spawn_limiter);
+            const char *chosen = STREAM_TYPES[r->chosen_st];
+            r->ready = 0;
+            ROC_DEBUG(RLOG_RECOVERY, "Restarting FFmpeg with stream %s", chosen);
+            pid_t pid = spawn_ffmpeg((int)i, &cams[i], chosen, r->probed[r->chosen_st].info.fps);
+            if (pid <= 0) {
+                ROC_ERROR(RLOG_RECOVERY, "Failed to restart FFmpeg for %s", cams[i].ip);
+                recovery_backoff(r, (int)i, now_ms);
+                continue;
+            }
+            procs[i].pid = pid; 
+            procs[i].cam_index = (int)i; 
+            procs[i].alive = 1;
+            procs[i].degraded = 0; 
+            procs[i].adopted = 0;
+            procs[i].started = time(NULL);
+            proc_start_ticks(pid, &procs[i].start_ticks);
+            procs[i].stream_index = (int)r->chosen_st;
+            procs_changed = 1;
+            /* failed_stream is -1 for a camera's first start, which is no restart */
+            if (r->failed_stream >= 0 && i < cam_metrics_count)
+                atomic_fetch_add_explicit(&cam_metrics[i].restarts, 1, memory_order_relaxed);
+            int ci = find_cache_entry(cache, cache_count, cams[i].ip); 
+            if (ci < 0 && cache_count < MAX_CAMERAS) ci = (int)(cache_count++);
+            if (ci >= 0) {
+                cache_store_result(&cache[ci], cams[i].ip, chosen, &r->probed[r->chosen_st], r->profile);
+                cache_merge_alts(&cache[ci], r->probed);
+                cache_mark_dirty(ci);
+            }
+            ROC_INFO(RLOG_RECOVERY, "Camera %zu (%s) streaming %s %.1fs after going down (%d failed attempt(s))",
+                    i, cams[i].ip, chosen, (double)(now_ms - r->down_ms) / 1000.0, r->attempt);
+            trace_complete((int)i, "recovery", "camera_down", r->down_ms * 1000000ULL, trace_now_ns(),
+                           "back on %s after %d failed attempt(s)", chosen, r->attempt);
+            if (r->failed_stream >= 0) {
+                if ((size_t)r->failed_stream != r->chosen_st) {
+                    history_log(cams[i].ip, HIST_SWITCH, (int)r->chosen_st, 1, r->failed_stream, 0);
+                    ej_emit(EJ_SWITCH, (int)i, (int)r->chosen_st, (int)pid, r->failed_stream, 0);
                 }
+                history_log(cams[i].ip, HIST_RECOVERY, (int)r->chosen_st, 1, -1, (int32_t)(now_ms - r->down_ms));
             }
+            r->active = 0;
         }
+
+        if (procs_changed) save_proc_state(cams, cam_count, procs);
+
+        /* Admit due recovery attempts in priority order */
+        size_t nwait = recovery_priority(rec, cam_count, 0, prio);
+        for (size_t k = 0; k < nwait; ++k) {
+            size_t i = prio[k];
+            struct recovery *r = &rec[i];
+            if (r->next_ms > now_ms || link_down[i]) continue;
+            if (!device_exists((int)i)) { 
+                ROC_ERROR(RLOG_RECOVERY, "/dev/video%zu missing, aborting restart", i + VIDEO_DEVICE_OFFSET); 
+                r->active = 0;
+                continue; 
+            }
+            if (!admission_try_acquire(&probe_gate, now_ms)) break;
+            int ci = find_cache_entry(cache, cache_count, cams[i].ip);
+            refresh_reliability(r->reliability, cams[i].ip);
+            r->validated = failover_order(ci >= 0 ? &cache[ci] : NULL, r->failed_stream, r->reliability, r->order);
+            r->done = 0;
+            int err = pthread_create(&r->thread, NULL, recovery_attempt, r);
+            if (err != 0) {
+                ROC_ERROR(RLOG_RECOVERY, "Failed to start recovery attempt for camera %zu: %s", i, strerror(err));
+                admission_release(&probe_gate);
+                recovery_backoff(r, (int)i, now_ms);
+                continue;
+            }
+            r->in_flight = 1;
+            ROC_DEBUG(RLOG_RECOVERY, "Recovery attempt %d for camera %zu (%s) admitted (%zu pre-validated alternatives, %d in flight)",
+                    r->attempt + 1, i, cams[i].ip, r->validated, probe_gate.in_flight);
+        }
+
+        /* Full-rig recovery time: first camera down until the last one is back */
+        size_t down = 0;
+        for (size_t i = 0; i < cam_count && i < MAX_CAMERAS; ++i) 
+            if (rec[i].active) down++;
+        if (down == 0 && episode_start != 0) {
+            ROC_INFO(RLOG_RECOVERY, "Rig recovered: %d camera(s) back in %.1fs", episode_cams,
+                    (double)(admission_now_ms() - episode_start) / 1000.0);
+            trace_complete(TRACE_TRACK_RIG, "recovery", "rig_recovery", episode_start * 1000000ULL, trace_now_ns(),
+                           "%d camera(s)", episode_cams);
+            episode_start = 0;
+            episode_cams = 0;
+        }
+
         time_t now = time(NULL); 
-        if (now - last_save > 60) { 
-            log_msg("DEBUG", "Periodic cache save");
-            save_cache_json(cache, cache_count); 
-            last_save = now; 
+        /* Changed entries go to the writer thread, which coalesces them into one batch per window */
+        cache_flush_dirty(cache, cache_count);
+        cache_persist_batch_t pb;
+        if (cache_persist_poll(&pb)) {
+            if (pb.error) ROC_ERROR(RLOG_CACHE, "msync %s: %s", DISCOVERY_CACHE_BIN, strerror(pb.error));
+            ROC_INFO(RLOG_CACHE, "Cache write: %d of %d submitted record(s) changed, %dms (sync=%s)",
+                    pb.written, pb.submitted, pb.write_ms, cache_sync_name(cache_cfg.sync));
+        }
+        if (now - last_passive >= health_cfg.passive_interval_sec) {
+            int ok = passive_health_check(cams, cam_count, procs) == 0;
+            if (!ok && passive_ok)
+                ROC_WARN(RLOG_HEALTH, "sock_diag unavailable (%s), falling back to active reachability sweeps", strerror(errno));
+            passive_ok = ok;
+            last_passive = now;
+            log_error_check(cams, cam_count, procs);
         }
-        if (now - last_probe_time > 60) { 
+        if (!passive_ok && now - last_probe_time >= health_cfg.interval_sec) { 
+            /* One concurrent sweep over every live camera: bounded by one deadline, not one per camera */
+            reach_target_t targets[MAX_CAMERAS];
+            size_t target_cam[MAX_CAMERAS];
+            size_t nt = 0;
             for (size_t i = 0; i < cam_count && i < MAX_CAMERAS; ++i) {
-                if (procs[i].alive) {
-                    log_msg("DEBUG", "Active probe check for camera %zu: ip=%s", i, cams[i].ip);
-                    if (!test_tcp_connect(cams[i].ip, 1935, 2)) {
-                        log_msg("WARNING", "Active probe failed for camera %zu (%s), killing FFmpeg pid=%d to trigger recovery", 
-                                i, cams[i].ip, (int)procs[i].pid);
-                        kill(procs[i].pid, SIGTERM);
-                    }
+                if (!procs[i].alive) continue;
+                targets[nt] = (reach_target_t){ .ip = cams[i].ip, .port = 1935 };
+                target_cam[nt++] = i;
+            }
+            uint64_t sweep_start = admission_now_ms();
+            int up = reach_sweep(targets, nt, health_cfg.timeout_ms);
+            if (up < 0) {
+                ROC_ERROR(RLOG_HEALTH, "Reachability sweep failed: %s", strerror(errno));
+            } else {
+                ROC_DEBUG(RLOG_HEALTH, "Reachability sweep: %d/%zu camera(s) up in %llums", up, nt,
+                        (unsigned long long)(admission_now_ms() - sweep_start));
+                for (size_t k = 0; k < nt; ++k) {
+                    size_t i = target_cam[k];
+                    note_reach(i < cam_metrics_count ? &cam_metrics[i] : NULL, targets[k].reachable, targets[k].connect_ms);
+                    if (targets[k].reachable) continue;
+                    ROC_WARN(RLOG_HEALTH, "Active probe failed for camera %zu (%s): %s, killing FFmpeg pid=%d to trigger recovery", 
+                            i, cams[i].ip, strerror(targets[k].error), (int)procs[i].pid);
+                    ej_emit(EJ_REACH, (int)i, EJ_NONE, 0, 0, targets[k].error);
+                    ej_emit(EJ_STALL, (int)i, procs[i].stream_index, (int)procs[i].pid, EJ_STALL_UNREACHABLE, targets[k].error);
+                    kill(procs[i].pid, SIGTERM);
                 }
             }
             last_probe_time = now;
         }
-        log_msg("DEBUG", "Monitor loop iteration, exit_flag=%d", exit_flag);
-        sleep(1);
+        /* Merge finished background re-probes, then queue the next one */
+        reprobe_result_t rr;
+        if (reprobe_poll(&rr) && rr.cam_index >= 0 && (size_t)rr.cam_index < cam_count) {
+            int ci = find_cache_entry(cache, cache_count, cams[rr.cam_index].ip);
+            if (ci >= 0) {
+                struct stream_alt *sa = &cache[ci].alts[rr.stream_index];
+                alt_from_probe(sa, rr.ok, &rr.info, &score_profiles[cams[rr.cam_index].profile]);
+                sa->last_probe = rr.when;
+                history_log(cams[rr.cam_index].ip, HIST_PROBE, rr.stream_index, rr.ok, -1, (int32_t)(sa->score * 100.0));
+                ej_emit(EJ_PROBE, rr.cam_index, rr.stream_index, 0, rr.ok, (int32_t)(sa->score * 100.0));
+                cache_mark_dirty(ci);
+                if (rr.ok && sa->score > cache[ci].score)
+                    ROC_INFO(RLOG_PROBE, "Camera %d (%s): alternative stream %s now scores %.2f (current %s %.2f)",
+                            rr.cam_index, cams[rr.cam_index].ip, STREAM_TYPES[rr.stream_index], sa->score,
+                            cache[ci].best_stream, cache[ci].score);
+            }
+        }
+        if (resources_cfg.sample_interval_sec > 0 && now - last_sample >= resources_cfg.sample_interval_sec) {
+            sample_children(procs, cam_count);
+            last_sample = now;
+        }
+        if (now - last_reprobe >= REPROBE_INTERVAL) {
+            if (children_over_budget())
+                ROC_DEBUG(RLOG_PROBE, "Holding background re-probe: FFmpeg children use %.0f%% of %ld CPUs",
+                        children_cpu_pct / (double)online_cpus, online_cpus);
+            else
+                schedule_reprobe(cams, cam_count, procs, cache, cache_count, &reprobe_cursor);
+            last_reprobe = now;
+        }
+        if (reload_log_levels) {
+            reload_log_levels = 0;
+            log_configure();
+        }
+        publish_metrics(procs, rec, cam_count);
+        ROC_DEBUG(RLOG_MAIN, "Monitor loop iteration, exit_flag=%d", exit_flag);
+        /* Tick faster while cameras are recovering so admitted work starts promptly;
+         * a link or neighbour event or a takeover request ends the wait early */
+        struct pollfd pfd[2];
+        nfds_t npfd = 0;
+        if (nlfd >= 0) pfd[npfd++] = (struct pollfd){ .fd = nlfd, .events = POLLIN };
+        if (hofd >= 0) pfd[npfd++] = (struct pollfd){ .fd = hofd, .events = POLLIN };
+        poll(pfd, npfd, down > 0 ? 100 : 1000);
+    }
+    if (exit_flag) ROC_INFO(RLOG_MAIN, "Signal %d received", (int)exit_flag);
+    if (nlfd >= 0) close(nlfd);
+    if (hofd >= 0) {
+        close(hofd);
+        unlink(HANDOFF_SOCKET);
     }
 
-    log_msg("INFO", "Shutting down, terminating children");
-    for (size_t i = 0; i < cam_count && i < MAX_CAMERAS; ++i) 
-        if (procs[i].alive && procs[i].pid > 0) { 
-            log_msg("DEBUG", "Terminating FFmpeg pid=%d for camera %d", 
-                    (int)procs[i].pid, (int)i);
-            kill(procs[i].pid, SIGTERM); 
-            waitpid(procs[i].pid, NULL, 0); 
+    ROC_INFO(RLOG_MAIN, detach_children ? "Shutting down, leaving children running for the next videopipe"
+                                    : "Shutting down, terminating children");
+    /* After a handover the successor waits for us to exit, so attempts get a
+     * bounded time to finish their current probe; any still running then are
+     * left behind (their ffprobe dies with them) */
+    uint64_t attempt_deadline = admission_now_ms() + (uint64_t)HANDOVER_ATTEMPT_WAIT_MS;
+    for (size_t i = 0; i < cam_count && i < MAX_CAMERAS; ++i) {
+        if (!rec[i].in_flight) continue;
+        int done = !atomic_load(&handed_over);
+        while (!done) {
+            pthread_mutex_lock(&recovery_lock);
+            done = rec[i].done;
+            pthread_mutex_unlock(&recovery_lock);
+            if (done || admission_now_ms() >= attempt_deadline) break;
+            struct timespec ts = { 0, 50 * 1000000L };
+            nanosleep(&ts, NULL);
+        }
+        if (done) {
+            pthread_join(rec[i].thread, NULL);
+        } else {
+            ROC_WARN(RLOG_RECOVERY, "Leaving the recovery attempt for camera %zu (%s) behind", i, cams[i].ip);
+            pthread_detach(rec[i].thread);
         }
-    log_msg("DEBUG", "Saving final cache");
-    save_cache_json(cache, cache_count);
-    log_msg("DEBUG", "Closing log file");
-    if (logf && logf != stderr) fclose(logf);
-    log_msg("INFO", "Exiting videopipe");
+    }
+    reprobe_stop();
+    if (detach_children) {
+        /* The next videopipe adopts whatever is still alive from the state file */
+        save_proc_state(cams, cam_count, procs);
+    } else {
+        for (size_t i = 0; i < cam_count && i < MAX_CAMERAS; ++i) 
+            if (procs[i].alive && procs[i].pid > 0) { 
+                ROC_DEBUG(RLOG_PROC, "Terminating FFmpeg pid=%d for camera %d", 
+                        (int)procs[i].pid, (int)i);
+                kill(procs[i].pid, SIGTERM); 
+                if (!procs[i].adopted) {
+                    waitpid(procs[i].pid, NULL, 0); 
+                    continue;
+                }
+                /* Adopted processes cannot be waited for; give each a few seconds to go */
+                for (int t = 0; t < 50 && adopted_alive(&procs[i]); ++t) {
+                    struct timespec ts = { 0, 100 * 1000000L };
+                    nanosleep(&ts, NULL);
+                }
+            }
+        unlink(PROC_STATE_FILE);
+    }
+    /* Before the tailer stops, so it still counts the last flushed errors */
+    if (capture_on) logcap_stop();
+    if (frames_on) fhist_stop();
+    log_tail_stop();
+    metrics_stop();
+    for (size_t i = 0; i < MAX_CAMERAS; ++i) pstat_close(&child_stats[i]);
+    ROC_DEBUG(RLOG_CACHE, "Saving final cache");
+    cache_flush_dirty(cache, cache_count);
+    cache_persist_stop();
+    save_cache(cache, cache_count);
+    save_cache_json(cache, cache_count); // Human-readable copy
+    dcache_close(&cache_store);
+    ROC_INFO(RLOG_MAIN, "Exiting videopipe");
+    trace_close();
+    ej_close();
+    ROC_DEBUG(RLOG_MAIN, "Closing log file");
+    log_close();
     return 0;
 }
\ No newline at end of file